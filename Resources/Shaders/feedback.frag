@@ -0,0 +1,21 @@
+#version 330 core
+
+in vec2 virtualUv;
+out vec4 FragColor;
+
+// Texels per side of the finest level, pages per side of the finest level, and level count
+uniform float virtualSize;
+uniform float pagesPerSide;
+uniform int levelCount;
+
+// log2 of the feedback downscale: derivatives are that much larger than on screen
+uniform float levelBias;
+
+// Page the screen reads here, as bytes: x, y, level, 255
+void main() {
+    vec2 texel = virtualUv * virtualSize;
+    float lod = 0.5 * log2(max(dot(dFdx(texel), dFdx(texel)), dot(dFdy(texel), dFdy(texel)))) - levelBias;
+    int level = clamp(int(floor(lod)), 0, levelCount - 1);
+    vec2 page = floor(clamp(virtualUv, 0.0, 0.99999) * (pagesPerSide / exp2(float(level))));
+    FragColor = vec4(page, float(level), 255.0) / 255.0;
+}
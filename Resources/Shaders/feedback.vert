@@ -0,0 +1,15 @@
+#version 330 core
+
+layout (location = 0) in vec3 position;
+
+uniform mat4 MVP;
+
+// xy: scale and offset of the virtual texture u coordinate, zw: same for v
+uniform vec4 virtualTransform;
+
+out vec2 virtualUv;
+
+void main() {
+    gl_Position = MVP * vec4(position, 1.0);
+    virtualUv = vec2(position.x * virtualTransform.x + virtualTransform.y, position.z * virtualTransform.z + virtualTransform.w);
+}
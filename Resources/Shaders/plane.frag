@@ -1,8 +1,107 @@
 #version 330 core
 
-in vec4 materialColor;
+in vec2 weightsUv;
+in vec2 shadingUv;
+in vec2 detailUv;
+in vec2 virtualUv;
+in vec3 localPosition;
+in float viewDepth;
+in vec2 slope;
 out vec4 FragColor;
 
+// Packed grass, sand, rock and snow weights
+uniform sampler2D materialWeights;
+uniform sampler2DArray materialLayers;
+
+// Virtual texture of the materials: page table (one mip per level) and the atlas of resident pages
+uniform int virtualTexture;
+uniform sampler2D pageTable;
+uniform sampler2D pageAtlas;
+uniform float virtualSize;
+uniform float pagesPerSide;
+uniform int levelCount;
+// Slot size, page size and border in texels, atlas size
+uniform vec4 atlasLayout;
+
+// rgb: normal, a: ambient occlusion
+uniform sampler2D shading;
+uniform int ambientOcclusion;
+
+// Cascades of the sun shadows, cascadeSplits holds the far view depth of each
+uniform vec3 sunDirection;
+uniform int shadows;
+uniform sampler2DArrayShadow shadowMap;
+uniform mat4 lightVP[3];
+uniform vec4 cascadeSplits;
+
+// Chunks drawn by refined patches, one texel per chunk, discarded from the base terrain
+uniform int detailPatches;
+uniform sampler2D detailMask;
+uniform float detailMaskScale;
+
+const float sunIntensity = 0.8;
+const float ambientIntensity = 0.35;
+
+float sunVisibility() {
+    int cascade = viewDepth < cascadeSplits.x ? 0 : (viewDepth < cascadeSplits.y ? 1 : 2);
+    if (viewDepth >= cascadeSplits.z)
+        return 1.0;
+
+    vec4 position = lightVP[cascade] * vec4(localPosition, 1.0);
+    vec3 coords = position.xyz * 0.5 + 0.5;
+
+    // 3x3 percentage closer filtering, each tap is already bilinear
+    vec2 texel = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+    float visibility = 0.0;
+    for (int y = -1; y <= 1; ++y)
+        for (int x = -1; x <= 1; ++x)
+            visibility += texture(shadowMap, vec4(coords.xy + vec2(x, y) * texel, float(cascade), coords.z));
+    return visibility / 9.0;
+}
+
+// Color of the finest resident page covering the level the screen needs here, 0 alpha if none is resident
+vec4 virtualColor() {
+    vec2 texel = virtualUv * virtualSize;
+    float lod = 0.5 * log2(max(dot(dFdx(texel), dFdx(texel)), dot(dFdy(texel), dFdy(texel))));
+    int level = clamp(int(floor(lod)), 0, levelCount - 1);
+    vec4 entry = textureLod(pageTable, virtualUv, float(level)) * 255.0;
+    if (entry.a < 0.5)
+        return vec4(0.0);
+
+    vec2 inPage = fract(clamp(virtualUv, 0.0, 0.99999) * (pagesPerSide / exp2(floor(entry.b + 0.5))));
+    vec2 atlasTexel = floor(entry.rg + 0.5) * atlasLayout.x + atlasLayout.z + inPage * atlasLayout.y;
+    return vec4(texture(pageAtlas, atlasTexel / atlasLayout.w).rgb, 1.0);
+}
+
+vec3 materialColor() {
+    vec4 weights = texture(materialWeights, weightsUv);
+    weights /= max(dot(weights, vec4(1.0)), 1e-3);
+
+    vec3 color = weights.r * texture(materialLayers, vec3(detailUv, 0.0)).rgb
+               + weights.g * texture(materialLayers, vec3(detailUv, 1.0)).rgb
+               + weights.b * texture(materialLayers, vec3(detailUv, 2.0)).rgb
+               + weights.a * texture(materialLayers, vec3(detailUv, 3.0)).rgb;
+    return color;
+}
+
 void main() {
-    FragColor = materialColor;
-}
\ No newline at end of file
+    // The material layers until the virtual texture has a page here, both sampled in uniform control flow
+    vec4 paged = virtualTexture != 0 ? virtualColor() : vec4(0.0);
+    vec3 color = mix(materialColor(), paged.rgb, paged.a);
+
+    vec4 surface = texture(shading, shadingUv);
+    vec3 normal = normalize(surface.rgb * 2.0 - 1.0);
+    // The baked normal as a slope, plus the slope of the patch detail
+    if (slope != vec2(0.0))
+        normal = normalize(normal / max(normal.y, 0.05) - vec3(slope.x, 0.0, slope.y));
+    float ambient = ambientOcclusion != 0 ? surface.a : 1.0;
+    float sun = max(dot(normal, sunDirection), 0.0);
+    if (shadows != 0 && sun > 0.0)
+        sun *= sunVisibility();
+
+    FragColor = vec4(color * (sunIntensity * sun + ambientIntensity * ambient), 1.0);
+
+    // After the derivatives of the lookups above
+    if (detailPatches != 0 && texture(detailMask, virtualUv * detailMaskScale).r > 0.5)
+        discard;
+}
@@ -1,12 +1,33 @@
 #version 330 core
 
 layout (location = 0) in vec3 position;
+// Slope of the detail added by a refined patch, 0 on the base terrain
+layout (location = 1) in vec2 detailSlope;
 
 uniform mat4 MVP;
 
-out vec4 materialColor;
+// xy: scale and offset of the weights u coordinate, zw: same for v
+uniform vec4 weightsTransform;
+// Same for the normals and occlusion texture
+uniform vec4 shadingTransform;
+// Same for the virtual texture, [0, 1] over the map
+uniform vec4 virtualTransform;
+
+out vec2 weightsUv;
+out vec2 shadingUv;
+out vec2 detailUv;
+out vec2 virtualUv;
+out vec3 localPosition;
+out float viewDepth;
+out vec2 slope;
 
 void main() {
     gl_Position = MVP * vec4(position, 1.0);
-    materialColor = vec4(0.0, 1.0, 0.0, 1.0);
-}
\ No newline at end of file
+    weightsUv = vec2(position.x * weightsTransform.x + weightsTransform.y, position.z * weightsTransform.z + weightsTransform.w);
+    shadingUv = vec2(position.x * shadingTransform.x + shadingTransform.y, position.z * shadingTransform.z + shadingTransform.w);
+    detailUv = position.xz;
+    virtualUv = vec2(position.x * virtualTransform.x + virtualTransform.y, position.z * virtualTransform.z + virtualTransform.w);
+    localPosition = position;
+    viewDepth = gl_Position.w;
+    slope = detailSlope;
+}
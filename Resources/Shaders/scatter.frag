@@ -0,0 +1,12 @@
+#version 330 core
+
+in vec3 vertexNormal;
+in vec3 vertexColor;
+out vec4 FragColor;
+
+const vec3 lightDirection = normalize(vec3(0.4, 1.0, 0.3));
+
+void main() {
+    float diffuse = max(dot(normalize(vertexNormal), lightDirection), 0.0);
+    FragColor = vec4(vertexColor * (0.35 + 0.65 * diffuse), 1.0);
+}
@@ -0,0 +1,25 @@
+#version 330 core
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec3 color;
+
+// Per instance: world position and uniform scale, rotation around the vertical axis
+layout (location = 3) in vec4 instancePositionScale;
+layout (location = 4) in float instanceRotation;
+
+uniform mat4 VP;
+
+out vec3 vertexNormal;
+out vec3 vertexColor;
+
+void main() {
+    float c = cos(instanceRotation);
+    float s = sin(instanceRotation);
+    mat3 rotation = mat3(c, 0.0, -s, 0.0, 1.0, 0.0, s, 0.0, c);
+
+    vec3 world = rotation * position * instancePositionScale.w + instancePositionScale.xyz;
+    gl_Position = VP * vec4(world, 1.0);
+    vertexNormal = rotation * normal;
+    vertexColor = color;
+}
@@ -0,0 +1,16 @@
+#version 330 core
+
+in float waterDepth;
+out vec4 FragColor;
+
+const vec3 shallowColor = vec3(0.25, 0.55, 0.65);
+const vec3 deepColor = vec3(0.05, 0.18, 0.35);
+
+void main() {
+    // Dry cells and the thin film around them are not drawn
+    if (waterDepth < 0.002)
+        discard;
+
+    float deep = clamp(waterDepth * 4.0, 0.0, 1.0);
+    FragColor = vec4(mix(shallowColor, deepColor, deep), mix(0.45, 0.85, deep));
+}
@@ -0,0 +1,20 @@
+#version 330 core
+
+layout (location = 0) in vec2 gridPosition;
+
+uniform mat4 VP;
+
+// xy: local position of sample (0, 0), z: distance between samples
+uniform vec3 gridTransform;
+
+// r: water surface height, g: depth
+uniform sampler2D water;
+
+out float waterDepth;
+
+void main() {
+    vec2 surface = texelFetch(water, ivec2(gridPosition), 0).rg;
+    vec2 xz = gridTransform.xy + gridPosition * gridTransform.z;
+    gl_Position = VP * vec4(xz.x, surface.r, xz.y, 1.0);
+    waterDepth = surface.g;
+}
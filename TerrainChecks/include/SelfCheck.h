@@ -0,0 +1,35 @@
+#ifndef SELF_CHECK_H
+#define SELF_CHECK_H
+
+#include <cstdint>
+#include <iosfwd>
+
+struct SelfCheckSettings
+{
+    // Multiplies every time budget, e.g. 4 for a debug build or a loaded machine
+    float budgetScale = 1.f;
+    bool budgets = true;
+
+    // Mutated inputs per fuzzed parser
+    int fuzzIterations = 4000;
+    uint32_t seed = 1;
+};
+
+// Checks of the generation kernels, run by the TerrainChecks executable (ctest) without a test framework:
+// - properties: range, continuity, determinism and seed independence of the noise, scalar and SIMD paths giving the
+//   same values, Mat4 / LookAt / projection invariants, codec round trips, cached tiles and aprons bit-identical to
+//   the whole map, PNG / TIFF / raw imports decoding their exact samples, resampling that keeps a raster at its own
+//   size and a ramp linear
+// - fuzzing: deterministic mutations of valid presets, encoded tiles, heightmap files and command lines, which must be rejected or
+//   accepted cleanly, never crash or read out of bounds
+// - budgets: single-thread cost of each hot kernel against a fixed ns per sample, so that a slowdown fails the run
+namespace SelfCheck
+{
+    // Command line: [--budget-scale X] [--no-budgets] [--fuzz N] [--fuzz-seed S]
+    void ParseArguments(int argc, char** argv, SelfCheckSettings& settings);
+
+    // Print one line per group and per failure, return the number of failed checks
+    int Run(std::ostream& out, const SelfCheckSettings& settings);
+}
+
+#endif // SELF_CHECK_H
@@ -0,0 +1,1217 @@
+#include "SelfCheck.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "BiomeClassifier.h"
+#include "CompressedHeightmap.h"
+#include "DistributedGenerator.h"
+#include "GridMesh.h"
+#include "HeightmapImport.h"
+#include "HorizonAO.h"
+#include "MeshExporter.h"
+#include "Parallel.h"
+#include "PerlinNoise.h"
+#include "Preset.h"
+#include "Sculpt.h"
+#include "TerrainSimplifier.h"
+#include "TileCache.h"
+#include "TileGeneration.h"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    template<typename... Args>
+    std::string Text(const Args&... args)
+    {
+        std::ostringstream stream;
+        (stream << ... << args);
+        return stream.str();
+    }
+
+    // Failures are printed as they happen, under the group being run
+    class Checks
+    {
+    public:
+        explicit Checks(std::ostream& out) : m_out(out) {}
+
+        std::ostream& out() { return m_out; }
+
+        void group(const char* name) { m_out << name << std::endl; }
+
+        // One check of a property over many inputs: what describes the first counterexample, if any
+        bool expect(bool passed, const std::string& what)
+        {
+            ++m_count;
+            if (!passed)
+            {
+                ++m_failures;
+                m_out << "  FAILED: " << what << std::endl;
+            }
+            return passed;
+        }
+
+        int count() const { return m_count; }
+        int failures() const { return m_failures; }
+
+    private:
+        std::ostream& m_out;
+        int m_count = 0;
+        int m_failures = 0;
+    };
+
+    // Deterministic inputs, the same on every platform for a given seed
+    class Random
+    {
+    public:
+        explicit Random(uint32_t seed) : m_engine(seed) {}
+
+        float uniform(float min, float max) { return min + (max - min) * static_cast<float>(m_engine() >> 8) * (1.f / 16777216.f); }
+        int integer(int min, int max)
+        {
+            const uint32_t range = static_cast<uint32_t>(max) - static_cast<uint32_t>(min) + 1u;
+            return static_cast<int>(static_cast<uint32_t>(min) + m_engine() % range);
+        }
+
+    private:
+        std::mt19937 m_engine;
+    };
+
+    // Parsers report rejected inputs on std::cerr, thousands of times while fuzzing
+    class SilenceErrors
+    {
+    public:
+        SilenceErrors() : m_previous(std::cerr.rdbuf(&m_null)) {}
+        ~SilenceErrors() { std::cerr.rdbuf(m_previous); }
+
+    private:
+        struct NullBuffer : std::streambuf
+        {
+            int overflow(int c) override { return traits_type::not_eof(c); }
+        };
+
+        NullBuffer m_null;
+        std::streambuf* m_previous;
+    };
+
+    bool Near(float a, float b, float tolerance) { return std::abs(a - b) <= tolerance; }
+
+    // Perlin noise of PerlinNoise.h: linear blend of the corner gradients, clamped at 0
+    void CheckPerlin(Checks& checks, Random& random)
+    {
+        checks.group("perlin() / randomGradient() / interpolate()");
+
+        std::string range, determinism, continuity, lattice, gradient, blend;
+        constexpr float epsilon = 1e-3f;
+        for (int i = 0; i < 20000; ++i)
+        {
+            const float x = random.uniform(-1000.f, 1000.f);
+            const float y = random.uniform(-1000.f, 1000.f);
+            const int seed = random.integer(-100000, 100000);
+
+            const float value = perlin(x, y, seed);
+            if (range.empty() && !(value >= 0.f && value <= 1.f))
+                range = Text("perlin(", x, ", ", y, ", ", seed, ") = ", value, " is outside [0, 1]");
+            if (determinism.empty() && perlin(x, y, seed) != value)
+                determinism = Text("perlin(", x, ", ", y, ", ", seed, ") changes between calls");
+
+            // The corner gradients are unit vectors and the offsets at most sqrt(2), so the slope is bounded
+            const float dx = perlin(x + epsilon, y, seed) - value;
+            const float dy = perlin(x, y + epsilon, seed) - value;
+            if (continuity.empty() && (std::abs(dx) > 8.f * epsilon || std::abs(dy) > 8.f * epsilon))
+                continuity = Text("perlin jumps by ", std::max(std::abs(dx), std::abs(dy)), " around (", x, ", ", y, ")");
+
+            const int ix = random.integer(-100000, 100000);
+            const int iy = random.integer(-100000, 100000);
+            if (lattice.empty() && perlin(static_cast<float>(ix), static_cast<float>(iy), seed) != 0.f)
+                lattice = Text("perlin(", ix, ", ", iy, ", ", seed, ") is not 0 on the lattice");
+
+            const vector2 g = randomGradient(ix, iy, seed);
+            const vector2 again = randomGradient(ix, iy, seed);
+            if (gradient.empty() && (!Near(g.x * g.x + g.y * g.y, 1.f, 1e-5f) || g.x != again.x || g.y != again.y))
+                gradient = Text("randomGradient(", ix, ", ", iy, ", ", seed, ") is not a stable unit vector");
+
+            const float a0 = random.uniform(-10.f, 10.f);
+            const float a1 = random.uniform(-10.f, 10.f);
+            const float w = random.uniform(-0.5f, 1.5f);
+            const float blended = interpolate(a0, a1, w);
+            const float low = std::min(a0, a1) - 1e-5f;
+            const float high = std::max(a0, a1) + 1e-5f;
+            const bool endpoints = interpolate(a0, a1, 0.f) == a0 && interpolate(a0, a1, 1.f) == a1
+                && interpolate(a0, a1, -1.f) == a0 && interpolate(a0, a1, 2.f) == a1;
+            if (blend.empty() && (blended < low || blended > high || !endpoints))
+                blend = Text("interpolate(", a0, ", ", a1, ", ", w, ") = ", blended);
+        }
+
+        checks.expect(range.empty(), range);
+        checks.expect(determinism.empty(), determinism);
+        checks.expect(continuity.empty(), continuity);
+        checks.expect(lattice.empty(), lattice);
+        checks.expect(gradient.empty(), gradient);
+        checks.expect(blend.empty(), blend);
+
+        // Neighbor seeds must give unrelated fields, not shifted or scaled copies
+        constexpr int grid = 64;
+        for (int seed = 0; seed < 4; ++seed)
+        {
+            double sumA = 0.0, sumB = 0.0, sumAB = 0.0, sumAA = 0.0, sumBB = 0.0;
+            for (int i = 0; i < grid * grid; ++i)
+            {
+                const float x = (i % grid) * 0.37f;
+                const float y = (i / grid) * 0.37f;
+                const double a = perlin(x, y, seed);
+                const double b = perlin(x, y, seed + 1);
+                sumA += a;
+                sumB += b;
+                sumAB += a * b;
+                sumAA += a * a;
+                sumBB += b * b;
+            }
+            const double n = grid * grid;
+            const double covariance = sumAB / n - sumA / n * sumB / n;
+            const double deviation = std::sqrt((sumAA / n - sumA / n * sumA / n) * (sumBB / n - sumB / n * sumB / n));
+            const double correlation = deviation > 0.0 ? covariance / deviation : 1.0;
+            checks.expect(std::abs(correlation) < 0.25, Text("perlin seeds ", seed, " and ", seed + 1, " are correlated (", correlation, ")"));
+        }
+    }
+
+    // Every engine has a scalar and a SIMD path, which must agree exactly
+    void CheckNoiseEngines(Checks& checks, Random& random)
+    {
+        checks.group("NoiseEngine");
+
+        constexpr int count = 37; // Not a multiple of the SIMD width
+        for (int type = 0; type < static_cast<int>(NoiseType::COUNT); ++type)
+        {
+            const int seed = random.integer(-100000, 100000);
+            const auto engine = Noise::CreateEngine(static_cast<NoiseType>(type), seed);
+            const auto same = Noise::CreateEngine(static_cast<NoiseType>(type), seed);
+            const auto other = Noise::CreateEngine(static_cast<NoiseType>(type), seed + 1);
+            const char* name = Noise::Name(engine->getType());
+            const bool worley = engine->getType() == NoiseType::WORLEY_F1 || engine->getType() == NoiseType::WORLEY_F2;
+            const float low = worley ? 0.f : -1.05f;
+            const float high = worley ? 1.5f : 1.05f;
+
+            std::string row, split, batch, range, determinism, continuity;
+            bool seedMatters = false;
+            float values[count], parts[count], xs[count], ys[count];
+            for (int i = 0; i < 500; ++i)
+            {
+                // Far cells: the float offsets must stay exact anywhere in the world
+                const int64_t cellX = static_cast<int64_t>(random.integer(-1 << 30, 1 << 30)) << 10;
+                const int64_t cellY = static_cast<int64_t>(random.integer(-1 << 30, 1 << 30)) << 10;
+                const float x0 = random.uniform(0.f, 4.f);
+                const float dx = random.uniform(0.01f, 0.3f);
+                const float y = random.uniform(0.f, 4.f);
+
+                engine->sampleRow(cellX, cellY, x0, dx, y, count, values);
+                const int cut = random.integer(1, count - 1);
+                engine->sampleRow(cellX, cellY, x0, dx, y, cut, parts);
+                engine->sampleRow(cellX, cellY, x0, dx, y, count - cut, parts + cut, cut);
+                for (int j = 0; j < count; ++j)
+                {
+                    const float x = x0 + static_cast<float>(j) * dx;
+                    const float scalar = engine->sample(cellX, cellY, x, y);
+                    if (row.empty() && values[j] != scalar)
+                        row = Text(name, " sampleRow differs from sample at x = ", x, ": ", values[j], " vs ", scalar);
+                    if (split.empty() && parts[j] != values[j])
+                        split = Text(name, " sampleRow split at ", cut, " differs at ", j);
+                    if (range.empty() && !(scalar >= low && scalar <= high))
+                        range = Text(name, " sample ", scalar, " is outside [", low, ", ", high, "]");
+                    if (determinism.empty() && same->sample(cellX, cellY, x, y) != scalar)
+                        determinism = Text(name, " engines with the same seed differ");
+                    seedMatters = seedMatters || other->sample(cellX, cellY, x, y) != scalar;
+
+                    // Every engine is continuous, Worley distances included
+                    constexpr float epsilon = 1e-3f;
+                    const float step = engine->sample(cellX, cellY, x + epsilon, y) - scalar;
+                    if (continuity.empty() && std::abs(step) > 16.f * epsilon)
+                        continuity = Text(name, " jumps by ", step, " at x = ", x);
+                }
+
+                for (int j = 0; j < count; ++j)
+                {
+                    xs[j] = random.uniform(-64.f, 64.f);
+                    ys[j] = random.uniform(-64.f, 64.f);
+                }
+                engine->sampleBatch(xs, ys, count, values);
+                for (int j = 0; j < count && batch.empty(); ++j)
+                {
+                    if (values[j] != engine->sample(xs[j], ys[j]))
+                        batch = Text(name, " sampleBatch differs from sample at (", xs[j], ", ", ys[j], ")");
+                }
+            }
+
+            checks.expect(row.empty(), row);
+            checks.expect(split.empty(), split);
+            checks.expect(batch.empty(), batch);
+            checks.expect(range.empty(), range);
+            checks.expect(determinism.empty(), determinism);
+            checks.expect(continuity.empty(), continuity);
+            checks.expect(seedMatters, Text(name, " ignores its seed"));
+        }
+    }
+
+    float MaxDifference(const Mat4<float>& a, const Mat4<float>& b)
+    {
+        float difference = 0.f;
+        for (int i = 0; i < 16; ++i)
+            difference = std::max(difference, std::abs(a.data()[i] - b.data()[i]));
+        return difference;
+    }
+
+    void CheckMatrices(Checks& checks, Random& random)
+    {
+        checks.group("Mat4 / Math::LookAt");
+
+        std::string inverse, orthonormal, eye, target;
+        for (int i = 0; i < 2000; ++i)
+        {
+            const Point3d<float> t(random.uniform(-100.f, 100.f), random.uniform(-100.f, 100.f), random.uniform(-100.f, 100.f));
+            const Mat4<float> m = Mat4<float>::translation(t) * Mat4<float>::rotationX(random.uniform(-3.f, 3.f))
+                * Mat4<float>::rotationY(random.uniform(-3.f, 3.f)) * Mat4<float>::rotationZ(random.uniform(-3.f, 3.f));
+            const float error = MaxDifference(m * Math::Inverse(m), Mat4<float>::identity());
+            if (inverse.empty() && error > 1e-4f)
+                inverse = Text("M * Inverse(M) is off the identity by ", error);
+
+            const Point3d<float> position(random.uniform(-100.f, 100.f), random.uniform(-100.f, 100.f), random.uniform(-100.f, 100.f));
+            const Point3d<float> center(random.uniform(-100.f, 100.f), random.uniform(-100.f, 100.f), random.uniform(-100.f, 100.f));
+            const Point3d<float> d = center - position;
+            const float distance = std::sqrt(d.x * d.x + d.y * d.y + d.z * d.z);
+            if (distance < 1.f || std::abs(d.y) > 0.99f * distance)
+                continue;
+
+            const Mat4<float> view = Math::LookAt(position, center, Point3d<float>(0.f, 1.f, 0.f));
+            for (int a = 0; a < 3; ++a)
+            {
+                for (int b = 0; b < 3; ++b)
+                {
+                    const float dot = view(a, 0) * view(b, 0) + view(a, 1) * view(b, 1) + view(a, 2) * view(b, 2);
+                    if (orthonormal.empty() && !Near(dot, a == b ? 1.f : 0.f, 1e-5f))
+                        orthonormal = Text("LookAt rows ", a, " and ", b, " have a dot product of ", dot);
+                }
+            }
+
+            const Point3d<float> p = Math::TransformPoint(view, position);
+            if (eye.empty() && !(Near(p.x, 0.f, 1e-3f) && Near(p.y, 0.f, 1e-3f) && Near(p.z, 0.f, 1e-3f)))
+                eye = Text("LookAt moves the eye to (", p.x, ", ", p.y, ", ", p.z, ")");
+            const Point3d<float> c = Math::TransformPoint(view, center);
+            if (target.empty() && !(Near(c.x, 0.f, 1e-3f) && Near(c.y, 0.f, 1e-3f) && Near(c.z, -distance, 1e-3f * distance)))
+                target = Text("LookAt puts the target at (", c.x, ", ", c.y, ", ", c.z, "), not on -z");
+        }
+        checks.expect(inverse.empty(), inverse);
+        checks.expect(orthonormal.empty(), orthonormal);
+        checks.expect(eye.empty(), eye);
+        checks.expect(target.empty(), target);
+
+        // Near and far planes at -1 and 1 in NDC, the frustum edge at 1
+        const float fov = Math::Radians(45.f);
+        const Mat4<float> projection = Mat4<float>::projection(1.5f, fov, 0.1f, 100.f);
+        const Point3d<float> nearPoint = Math::TransformPoint(projection, Point3d<float>(0.f, 0.f, -0.1f));
+        const Point3d<float> farPoint = Math::TransformPoint(projection, Point3d<float>(0.f, 0.f, -100.f));
+        const Point3d<float> edge = Math::TransformPoint(projection, Point3d<float>(15.f * std::tan(fov / 2.f), 10.f * std::tan(fov / 2.f), -10.f));
+        checks.expect(Near(nearPoint.z, -1.f, 1e-4f) && Near(farPoint.z, 1.f, 1e-3f), Text("projection maps the planes to ", nearPoint.z, " and ", farPoint.z));
+        checks.expect(Near(edge.x, 1.f, 1e-4f) && Near(edge.y, 1.f, 1e-4f), Text("projection maps the frustum corner to (", edge.x, ", ", edge.y, ")"));
+
+        const Mat4<float> orthographic = Mat4<float>::orthographic(-2.f, 6.f, -1.f, 3.f, 0.5f, 20.f);
+        const Point3d<float> low = Math::TransformPoint(orthographic, Point3d<float>(-2.f, -1.f, -0.5f));
+        const Point3d<float> high = Math::TransformPoint(orthographic, Point3d<float>(6.f, 3.f, -20.f));
+        checks.expect(Near(low.x, -1.f, 1e-5f) && Near(low.y, -1.f, 1e-5f) && Near(low.z, -1.f, 1e-5f)
+            && Near(high.x, 1.f, 1e-5f) && Near(high.y, 1.f, 1e-5f) && Near(high.z, 1.f, 1e-5f), "orthographic does not map its box to [-1, 1]");
+    }
+
+    std::vector<float> RandomHeights(Random& random, int width, int height)
+    {
+        std::vector<float> heights(static_cast<size_t>(width) * height);
+        float value = 0.f;
+        for (float& h : heights)
+        {
+            value = std::clamp(value + random.uniform(-0.05f, 0.05f), -1.f, 2.f);
+            h = value;
+        }
+        return heights;
+    }
+
+    void CheckCodec(Checks& checks, Random& random)
+    {
+        checks.group("HeightCodec");
+
+        const int width = 67;
+        const int height = 45;
+        const std::vector<float> heights = RandomHeights(random, width, height);
+        std::vector<float> decoded(heights.size());
+        for (int encoding = 0; encoding < static_cast<int>(HeightEncoding::COUNT); ++encoding)
+        {
+            const EncodedTile tile = HeightCodec::Encode(heights.data(), width, height, width, static_cast<HeightEncoding>(encoding));
+            const bool valid = HeightCodec::Decode(tile, decoded.data(), width);
+            float error = 0.f;
+            for (size_t i = 0; i < heights.size(); ++i)
+                error = std::max(error, std::abs(decoded[i] - heights[i]));
+            checks.expect(valid && error <= HeightCodec::MaxError(tile),
+                Text(HeightCodec::Name(tile.encoding), " round trip error ", error, " over its bound ", HeightCodec::MaxError(tile)));
+        }
+    }
+
+    // Tiles read with their apron through the cache, eroded or not, are bit-identical to the same samples of the
+    // whole map, clamped to its border outside of it. Sizes are not multiples of the tile size.
+    void CheckTileCache(Checks& checks, Random& random)
+    {
+        checks.group("TileCache");
+
+        GenerationSettings settings;
+        settings.seed = random.integer(0, 1000);
+        settings.size = 97;
+        settings.step = 16.f / (settings.size - 1);
+        std::vector<float> map(static_cast<size_t>(settings.size) * settings.size);
+        std::vector<float> heights;
+        for (int iterations : { 0, 5, 40 })
+        {
+            settings.erosion.iterations = iterations;
+            TileGeneration::GenerateMap(settings, map);
+            for (int tileSize : { 16, 37 })
+            {
+                TileCache cache(settings, tileSize);
+                const int apron = random.integer(1, 8);
+                int mismatches = 0;
+                for (int ty = 0; ty < cache.getTilesY(); ++ty)
+                {
+                    for (int tx = 0; tx < cache.getTilesX(); ++tx)
+                    {
+                        cache.readWithApron(tx, ty, apron, heights);
+                        const int width = std::min(tileSize, settings.size - tx * tileSize) + 2 * apron;
+                        const int height = std::min(tileSize, settings.size - ty * tileSize) + 2 * apron;
+                        if (heights.size() != static_cast<size_t>(width) * height)
+                        {
+                            ++mismatches;
+                            continue;
+                        }
+                        for (int y = 0; y < height; ++y)
+                        {
+                            const int my = std::clamp(ty * tileSize - apron + y, 0, settings.size - 1);
+                            for (int x = 0; x < width; ++x)
+                            {
+                                const int mx = std::clamp(tx * tileSize - apron + x, 0, settings.size - 1);
+                                if (std::memcmp(&heights[static_cast<size_t>(y) * width + x], &map[static_cast<size_t>(my) * settings.size + mx], sizeof(float)) != 0)
+                                    ++mismatches;
+                            }
+                        }
+                    }
+                }
+                checks.expect(mismatches == 0, Text(mismatches, " apron samples differ from the map (erosion ", iterations,
+                                                    ", tile ", tileSize, ", apron ", apron, ")"));
+            }
+        }
+    }
+
+    // Dabs only change samples inside their bounds, in the direction of their mode, and the history undoes and redoes
+    // whole strokes bit for bit. The size is not a multiple of the SIMD width nor of the history tiles.
+    void CheckSculpt(Checks& checks, Random& random)
+    {
+        checks.group("Sculpt");
+
+        const int size = 77;
+        std::vector<float> heights = RandomHeights(random, size, size);
+        const std::vector<float> original = heights;
+        std::vector<std::vector<float>> strokes;
+
+        SculptHistory history;
+        history.reset(size);
+        TerrainSimplifier edited(size);
+        edited.computeErrors(heights.data());
+        for (int mode = 0; mode < static_cast<int>(BrushMode::COUNT); ++mode)
+        {
+            for (int d = 0; d < 3; ++d)
+            {
+                Brush brush;
+                brush.mode = static_cast<BrushMode>(mode);
+                brush.radius = random.uniform(1.f, 30.f);
+                brush.strength = random.uniform(0.01f, 0.5f);
+                brush.hardness = random.uniform(0.f, 1.f);
+                const float x = random.uniform(-10.f, size + 10.f);
+                const float y = random.uniform(-10.f, size + 10.f);
+
+                const HeightRect bounds = Sculpt::Bounds(size, brush, x, y);
+                history.touch(heights.data(), bounds);
+                const std::vector<float> before = heights;
+                const HeightRect rect = Sculpt::Apply(heights.data(), size, brush, x, y);
+
+                int outside = 0;
+                int wrongWay = 0;
+                for (int sy = 0; sy < size; ++sy)
+                {
+                    for (int sx = 0; sx < size; ++sx)
+                    {
+                        const float delta = heights[sy * size + sx] - before[sy * size + sx];
+                        if (delta == 0.f)
+                            continue;
+                        if (sx < rect.x || sy < rect.y || sx >= rect.x + rect.width || sy >= rect.y + rect.height ||
+                            sx < bounds.x || sy < bounds.y || sx >= bounds.x + bounds.width || sy >= bounds.y + bounds.height)
+                            ++outside;
+                        if ((brush.mode == BrushMode::RAISE && delta < 0.f) || (brush.mode == BrushMode::LOWER && delta > 0.f))
+                            ++wrongWay;
+                    }
+                }
+                checks.expect(outside == 0, Text(Sculpt::Name(brush.mode), " dab at ", x, ", ", y, " changed ", outside, " samples outside its rect"));
+                checks.expect(wrongWay == 0, Text(Sculpt::Name(brush.mode), " dab at ", x, ", ", y, " moved ", wrongWay, " samples the wrong way"));
+            }
+            const HeightRect stroke = history.endStroke(heights.data());
+            edited.updateErrors(heights.data(), stroke.x, stroke.y, stroke.width, stroke.height);
+            strokes.push_back(heights);
+        }
+
+        // Errors updated over the strokes only, as those of the whole map
+        TerrainSimplifier whole(size);
+        whole.computeErrors(heights.data());
+        for (float maxError : { 0.f, 0.01f, 0.05f, 0.2f })
+        {
+            std::vector<uint32_t> updated;
+            std::vector<uint32_t> computed;
+            edited.extract(maxError, updated);
+            whole.extract(maxError, computed);
+            checks.expect(updated == computed, Text("errors updated after the strokes extract another mesh at ", maxError));
+        }
+
+        for (int step = static_cast<int>(strokes.size()) - 1; step >= 0; --step)
+        {
+            history.undo(heights.data());
+            const std::vector<float>& expected = step > 0 ? strokes[step - 1] : original;
+            checks.expect(std::memcmp(heights.data(), expected.data(), heights.size() * sizeof(float)) == 0,
+                          Text("undo of stroke ", step, " is not exact"));
+        }
+        checks.expect(!history.canUndo(), "steps left to undo");
+        for (size_t step = 0; step < strokes.size(); ++step)
+        {
+            history.redo(heights.data());
+            checks.expect(std::memcmp(heights.data(), strokes[step].data(), heights.size() * sizeof(float)) == 0,
+                          Text("redo of stroke ", step, " is not exact"));
+        }
+
+        // Straight down on a sample, the hit is its height
+        HeightfieldView heightfield;
+        heightfield.heights = heights.data();
+        heightfield.size = size;
+        const int sx = random.integer(0, size - 1);
+        const int sy = random.integer(0, size - 1);
+        const Point3d<float> above(heightfield.origin.x + sx * heightfield.step, 10.f, heightfield.origin.y + sy * heightfield.step);
+        Point3d<float> hit;
+        const bool found = Sculpt::Raycast(heightfield, above, Point3d<float>(0.f, -1.f, 0.f), 20.f, hit);
+        checks.expect(found && Near(hit.y, heightfield.sample(sx, sy), 1e-3f),
+                      Text("ray down on sample ", sx, ", ", sy, " hit ", hit.y, " instead of ", heightfield.sample(sx, sy)));
+    }
+
+    // Small valid rasters of every import format, and the samples a reader must decode from them
+    struct TestRaster
+    {
+        std::string name;
+        RasterFormat format = RasterFormat::PNG16;
+        int width = 0;
+        int height = 0;
+        std::vector<uint8_t> bytes;
+        std::vector<float> samples;
+    };
+
+    void Append16(std::vector<uint8_t>& bytes, uint32_t value, bool bigEndian)
+    {
+        const uint8_t low = static_cast<uint8_t>(value & 0xFF);
+        const uint8_t high = static_cast<uint8_t>((value >> 8) & 0xFF);
+        bytes.insert(bytes.end(), { bigEndian ? high : low, bigEndian ? low : high });
+    }
+
+    void Append32(std::vector<uint8_t>& bytes, uint32_t value, bool bigEndian)
+    {
+        Append16(bytes, bigEndian ? value >> 16 : value & 0xFFFF, bigEndian);
+        Append16(bytes, bigEndian ? value & 0xFFFF : value >> 16, bigEndian);
+    }
+
+    // Grayscale PNG with every row filter type, its data split in two IDAT chunks
+    TestRaster PngRaster(Random& random, int width, int height, int bitDepth, bool alpha)
+    {
+        TestRaster raster{ Text("PNG ", bitDepth, alpha ? " gray + alpha" : " gray"), RasterFormat::PNG16, width, height };
+        const int bytesPerSample = bitDepth / 8;
+        const size_t bytesPerPixel = static_cast<size_t>(bytesPerSample) * (alpha ? 2 : 1);
+        const size_t rowBytes = width * bytesPerPixel;
+        std::vector<uint8_t> row(rowBytes);
+        std::vector<uint8_t> previous(rowBytes, 0);
+        std::vector<uint8_t> scanlines;
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                uint8_t* pixel = row.data() + x * bytesPerPixel;
+                const int value = random.integer(0, bitDepth == 16 ? 65535 : 255);
+                if (bitDepth == 16)
+                {
+                    pixel[0] = static_cast<uint8_t>(value >> 8);
+                    pixel[1] = static_cast<uint8_t>(value & 0xFF);
+                    raster.samples.push_back(value * (1.f / 65535.f));
+                }
+                else
+                {
+                    pixel[0] = static_cast<uint8_t>(value);
+                    raster.samples.push_back(value * (1.f / 255.f));
+                }
+                for (int k = 0; alpha && k < bytesPerSample; ++k)
+                    pixel[bytesPerSample + k] = static_cast<uint8_t>(random.integer(0, 255));
+            }
+
+            const int filter = y % 5;
+            scanlines.push_back(static_cast<uint8_t>(filter));
+            for (size_t i = 0; i < rowBytes; ++i)
+            {
+                const int a = i >= bytesPerPixel ? row[i - bytesPerPixel] : 0;
+                const int b = previous[i];
+                const int c = i >= bytesPerPixel ? previous[i - bytesPerPixel] : 0;
+                const int pa = std::abs(b - c);
+                const int pb = std::abs(a - c);
+                const int pc = std::abs(a + b - 2 * c);
+                const int predictions[5] = { 0, a, b, (a + b) >> 1, pa <= pb && pa <= pc ? a : pb <= pc ? b : c };
+                scanlines.push_back(static_cast<uint8_t>(row[i] - predictions[filter]));
+            }
+            previous = row;
+        }
+
+        uLongf compressedSize = compressBound(static_cast<uLong>(scanlines.size()));
+        std::vector<uint8_t> compressed(compressedSize);
+        compress2(compressed.data(), &compressedSize, scanlines.data(), static_cast<uLong>(scanlines.size()), Z_BEST_SPEED);
+        compressed.resize(compressedSize);
+
+        std::vector<uint8_t>& bytes = raster.bytes;
+        bytes = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+        auto chunk = [&](const char* type, const uint8_t* data, size_t size)
+        {
+            Append32(bytes, static_cast<uint32_t>(size), true);
+            const size_t start = bytes.size();
+            bytes.insert(bytes.end(), type, type + 4);
+            bytes.insert(bytes.end(), data, data + size);
+            Append32(bytes, static_cast<uint32_t>(crc32(0, bytes.data() + start, static_cast<uInt>(bytes.size() - start))), true);
+        };
+        std::vector<uint8_t> header;
+        Append32(header, width, true);
+        Append32(header, height, true);
+        header.insert(header.end(), { static_cast<uint8_t>(bitDepth), static_cast<uint8_t>(alpha ? 4 : 0), 0, 0, 0 });
+        chunk("IHDR", header.data(), header.size());
+        const size_t half = compressed.size() / 2;
+        chunk("IDAT", compressed.data(), half);
+        chunk("IDAT", compressed.data() + half, compressed.size() - half);
+        chunk("IEND", nullptr, 0);
+        return raster;
+    }
+
+    // Uncompressed TIFF in strips of 3 rows: sample format 1 (uint16), 2 (int16) or 3 (float32)
+    TestRaster TiffRaster(Random& random, int width, int height, int sampleFormat, bool bigEndian)
+    {
+        const char* names[] = { "", "uint16", "int16", "float32" };
+        TestRaster raster{ Text("TIFF ", names[sampleFormat], bigEndian ? " big endian" : ""), RasterFormat::TIFF, width, height };
+        const int bits = sampleFormat == 3 ? 32 : 16;
+        const uint32_t rowsPerStrip = 3;
+        const uint32_t rowBytes = static_cast<uint32_t>(width) * bits / 8;
+        const uint32_t strips = (height + rowsPerStrip - 1) / rowsPerStrip;
+
+        std::vector<uint8_t>& bytes = raster.bytes;
+        bytes = { static_cast<uint8_t>(bigEndian ? 'M' : 'I'), static_cast<uint8_t>(bigEndian ? 'M' : 'I') };
+        Append16(bytes, 42, bigEndian);
+        Append32(bytes, 0, bigEndian); // IFD offset, set once known
+        for (int i = 0; i < width * height; ++i)
+        {
+            if (sampleFormat == 3)
+            {
+                const float value = random.uniform(-2.f, 2.f);
+                uint32_t valueBits;
+                std::memcpy(&valueBits, &value, sizeof(valueBits));
+                Append32(bytes, valueBits, bigEndian);
+                raster.samples.push_back(value);
+            }
+            else
+            {
+                const int value = random.integer(0, 65535);
+                Append16(bytes, value, bigEndian);
+                raster.samples.push_back(sampleFormat == 2 ? static_cast<int16_t>(value) * (1.f / 32767.f) : value * (1.f / 65535.f));
+            }
+        }
+
+        const uint32_t offsetsPosition = static_cast<uint32_t>(bytes.size());
+        for (uint32_t s = 0; s < strips; ++s)
+            Append32(bytes, 8 + s * rowsPerStrip * rowBytes, bigEndian);
+        const uint32_t countsPosition = static_cast<uint32_t>(bytes.size());
+        for (uint32_t s = 0; s < strips; ++s)
+            Append32(bytes, std::min(rowsPerStrip, height - s * rowsPerStrip) * rowBytes, bigEndian);
+
+        const uint32_t ifd = static_cast<uint32_t>(bytes.size());
+        std::vector<uint8_t> ifdOffset;
+        Append32(ifdOffset, ifd, bigEndian);
+        std::copy(ifdOffset.begin(), ifdOffset.end(), bytes.begin() + 4);
+        const std::pair<uint16_t, uint32_t> scalars[] = { { 256, width }, { 257, height }, { 258, bits }, { 259, 1 },
+                                                          { 277, 1 }, { 278, rowsPerStrip }, { 339, sampleFormat } };
+        Append16(bytes, static_cast<uint32_t>(std::size(scalars)) + 2, bigEndian);
+        for (const auto& [tag, value] : scalars)
+        {
+            Append16(bytes, tag, bigEndian);
+            Append16(bytes, 4, bigEndian);
+            Append32(bytes, 1, bigEndian);
+            Append32(bytes, value, bigEndian);
+        }
+        // A single strip keeps its offset and count in the entry
+        for (const auto& [tag, position] : { std::pair<uint16_t, uint32_t>{ 273, offsetsPosition }, { 279, countsPosition } })
+        {
+            Append16(bytes, tag, bigEndian);
+            Append16(bytes, 4, bigEndian);
+            Append32(bytes, strips, bigEndian);
+            Append32(bytes, strips == 1 ? (tag == 273 ? 8 : rowBytes * height) : position, bigEndian);
+        }
+        Append32(bytes, 0, bigEndian);
+        return raster;
+    }
+
+    TestRaster RawRaster(Random& random, int width, int height)
+    {
+        TestRaster raster{ "raw float32", RasterFormat::RAW_FLOAT32, width, height };
+        raster.samples = RandomHeights(random, width, height);
+        raster.bytes.resize(raster.samples.size() * sizeof(float));
+        std::memcpy(raster.bytes.data(), raster.samples.data(), raster.bytes.size());
+        return raster;
+    }
+
+    std::vector<TestRaster> TestRasters(Random& random)
+    {
+        std::vector<TestRaster> rasters;
+        rasters.push_back(PngRaster(random, 13, 11, 16, false));
+        rasters.push_back(PngRaster(random, 9, 12, 8, true));
+        rasters.push_back(TiffRaster(random, 11, 10, 1, false));
+        rasters.push_back(TiffRaster(random, 7, 2, 2, true));
+        rasters.push_back(TiffRaster(random, 10, 8, 3, false));
+        rasters.push_back(RawRaster(random, 12, 9));
+        return rasters;
+    }
+
+    // File the import checks write their rasters to, removed with it
+    class ScratchFile
+    {
+    public:
+        ScratchFile()
+            : m_path((std::filesystem::temp_directory_path() / Text("terrain_core_checks_", std::random_device()(), ".bin")).string())
+        {
+        }
+        ~ScratchFile()
+        {
+            std::error_code error;
+            std::filesystem::remove(m_path, error);
+        }
+
+        const std::string& path() const { return m_path; }
+
+        bool write(const std::vector<uint8_t>& bytes) const
+        {
+            std::ofstream file(m_path, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+            return static_cast<bool>(file);
+        }
+
+    private:
+        std::string m_path;
+    };
+
+    ImportSettings RasterSettings(const TestRaster& raster, const ScratchFile& file)
+    {
+        ImportSettings settings;
+        settings.path = file.path();
+        settings.format = raster.format;
+        settings.rawWidth = raster.width;
+        settings.rawHeight = raster.height;
+        return settings;
+    }
+
+    // Every row of the raster through HeightmapImport::Open and readRow, false as soon as the reader fails
+    bool ReadRaster(const ImportSettings& settings, std::vector<float>& samples, bool& finite)
+    {
+        samples.clear();
+        finite = true;
+        const std::unique_ptr<RasterReader> reader = HeightmapImport::Open(settings);
+        if (!reader)
+            return false;
+        std::vector<float> row(reader->getWidth());
+        for (int y = 0; y < reader->getHeight(); ++y)
+        {
+            if (!reader->readRow(row))
+                return false;
+            for (float sample : row)
+                finite = finite && std::isfinite(sample);
+            samples.insert(samples.end(), row.begin(), row.end());
+        }
+        return true;
+    }
+
+    // Readers decode the exact samples of each format, and resampling a raster to its own size gives it back
+    // while a linear ramp stays linear at any size (bicubic away from its clamped borders)
+    void CheckImport(Checks& checks, Random& random)
+    {
+        checks.group("HeightmapImport");
+
+        const ScratchFile file;
+        std::vector<float> samples;
+        bool finite = true;
+        for (const TestRaster& raster : TestRasters(random))
+        {
+            file.write(raster.bytes);
+            const bool read = ReadRaster(RasterSettings(raster, file), samples, finite);
+            checks.expect(read && samples == raster.samples, Text(raster.name, " does not decode to its samples"));
+        }
+
+        const int sourceSize = 33;
+        TestRaster ramp = RawRaster(random, sourceSize, sourceSize);
+        const TestRaster noise = ramp;
+        auto rampValue = [&](double x, double y) { return 0.25 + 0.5 * x / (sourceSize - 1) + 0.25 * y / (sourceSize - 1); };
+        for (int y = 0; y < sourceSize; ++y)
+            for (int x = 0; x < sourceSize; ++x)
+                ramp.samples[static_cast<size_t>(y) * sourceSize + x] = static_cast<float>(rampValue(x, y));
+        std::memcpy(ramp.bytes.data(), ramp.samples.data(), ramp.bytes.size());
+
+        for (ResampleFilter filter : { ResampleFilter::BILINEAR, ResampleFilter::BICUBIC })
+        {
+            const char* filterName = filter == ResampleFilter::BICUBIC ? "bicubic" : "bilinear";
+            std::vector<float> heights;
+            auto importRaster = [&](const TestRaster& raster, int size)
+            {
+                file.write(raster.bytes);
+                ImportSettings settings = RasterSettings(raster, file);
+                settings.size = size;
+                settings.filter = filter;
+                heights.assign(static_cast<size_t>(size) * size, std::numeric_limits<float>::quiet_NaN());
+                return HeightmapImport::Import(settings, [&](int firstRow, int rowCount, std::span<const float> band)
+                {
+                    std::copy(band.begin(), band.begin() + static_cast<size_t>(rowCount) * size, heights.begin() + static_cast<size_t>(firstRow) * size);
+                });
+            };
+
+            const bool identity = importRaster(noise, sourceSize) && heights == noise.samples;
+            checks.expect(identity, Text(filterName, " resampling to the source size changes the samples"));
+
+            for (int size : { 20, 50 })
+            {
+                float error = std::numeric_limits<float>::infinity();
+                if (importRaster(ramp, size))
+                {
+                    error = 0.f;
+                    const double ratio = static_cast<double>(sourceSize - 1) / (size - 1);
+                    for (int y = 0; y < size; ++y)
+                    {
+                        for (int x = 0; x < size; ++x)
+                        {
+                            const double sx = x * ratio;
+                            const double sy = y * ratio;
+                            const bool clamped = sx < 1.0 || sy < 1.0 || sx > sourceSize - 2.0 || sy > sourceSize - 2.0;
+                            if (filter == ResampleFilter::BICUBIC && clamped)
+                                continue;
+                            error = std::max(error, static_cast<float>(std::abs(heights[static_cast<size_t>(y) * size + x] - rampValue(sx, sy))));
+                        }
+                    }
+                }
+                checks.expect(error <= 1e-5f, Text(filterName, " resampling of a ramp to ", size, " is off by ", error));
+            }
+        }
+    }
+
+    // Mutations of a valid input: bit flips, inserted tokens, erased and duplicated ranges
+    std::string Mutate(Random& random, std::string text, const std::vector<std::string>& tokens)
+    {
+        const int mutations = random.integer(1, 4);
+        for (int m = 0; m < mutations; ++m)
+        {
+            const int position = random.integer(0, static_cast<int>(text.size()));
+            const int length = random.integer(1, 16);
+            switch (random.integer(0, 4))
+            {
+            case 0:
+                if (position < static_cast<int>(text.size()))
+                    text[position] = static_cast<char>(text[position] ^ (1 << random.integer(0, 7)));
+                break;
+            case 1:
+                text.insert(position, tokens[random.integer(0, static_cast<int>(tokens.size()) - 1)]);
+                break;
+            case 2:
+                text.erase(position, length);
+                break;
+            case 3:
+                text.insert(random.integer(0, static_cast<int>(text.size())), text.substr(position, length));
+                break;
+            default:
+                if (position < static_cast<int>(text.size()))
+                    text[position] = static_cast<char>(random.integer(0, 255));
+                break;
+            }
+        }
+        return text;
+    }
+
+    // Accepted presets must be complete and survive a write / read round trip unchanged
+    void FuzzPresets(Checks& checks, Random& random, int iterations)
+    {
+        TerrainPreset base;
+        base.seed = 42;
+        base.size = 257;
+        base.maxError = 0.01f;
+        base.noise = { { NoiseType::PERLIN, 1, 1.f, 0 }, { NoiseType::OPENSIMPLEX2, 4, 0.25f, 1 }, { NoiseType::WORLEY_F1, 9, 0.1f, 2 } };
+        base.erosion.iterations = 8;
+        std::ostringstream written;
+        Preset::Write(written, base);
+
+        const std::vector<std::string> tokens = { "\n", "=", "#", " ", "[", "]", "[noise]\n", "[erosion]\n", "[biomes]\n", "-", "0", "1e38",
+            "-1", "nan", "inf", "2147483648", "frequency = 0\n", "size = 1\n", "extent = -3\n", "type = value\n", "\r", "\t" };
+
+        int accepted = 0;
+        std::string invariant, roundTrip;
+        {
+            const SilenceErrors silence;
+            for (int i = 0; i < iterations; ++i)
+            {
+                std::istringstream input(Mutate(random, written.str(), tokens));
+                TerrainPreset preset;
+                if (!Preset::Read(input, preset, "fuzz"))
+                    continue;
+                ++accepted;
+
+                bool valid = preset.size >= 2 && std::isfinite(preset.extent) && preset.extent > 0.f
+                    && !preset.noise.empty() && preset.noise.size() <= GenerationSettings::MAX_NOISE_STAGES;
+                for (const NoiseStage& stage : preset.noise)
+                    valid = valid && stage.frequency >= 1;
+                if (invariant.empty() && !valid)
+                    invariant = Text("accepted an invalid preset:\n", input.str());
+
+                std::ostringstream first;
+                Preset::Write(first, preset);
+                std::istringstream again(first.str());
+                TerrainPreset reread;
+                std::ostringstream second;
+                if (Preset::Read(again, reread, "fuzz"))
+                    Preset::Write(second, reread);
+                if (roundTrip.empty() && first.str() != second.str())
+                    roundTrip = Text("preset changes through a write / read round trip:\n", first.str());
+            }
+        }
+        checks.out() << "  presets: " << iterations << " mutations, " << accepted << " accepted" << std::endl;
+        checks.expect(invariant.empty(), invariant);
+        checks.expect(roundTrip.empty(), roundTrip);
+    }
+
+    // Corrupt tiles must be rejected without reading past their data
+    void FuzzTiles(Checks& checks, Random& random, int iterations)
+    {
+        constexpr int size = 64;
+        const std::vector<float> heights = RandomHeights(random, size, size);
+        std::vector<EncodedTile> tiles;
+        for (int encoding = 0; encoding < static_cast<int>(HeightEncoding::COUNT); ++encoding)
+            tiles.push_back(HeightCodec::Encode(heights.data(), size, size, size, static_cast<HeightEncoding>(encoding)));
+
+        int rejected = 0;
+        std::string truncation;
+        std::vector<float> decoded(static_cast<size_t>(2 * size) * 2 * size);
+        for (int i = 0; i < iterations; ++i)
+        {
+            EncodedTile tile = tiles[random.integer(0, static_cast<int>(tiles.size()) - 1)];
+            bool truncated = false;
+            switch (random.integer(0, 3))
+            {
+            case 0:
+                for (int flips = random.integer(1, 8); flips > 0; --flips)
+                    tile.data[random.integer(0, static_cast<int>(tile.data.size()) - 1)] ^= static_cast<uint8_t>(1 << random.integer(0, 7));
+                break;
+            case 1:
+                tile.data.resize(random.integer(0, static_cast<int>(tile.data.size()) - 1));
+                truncated = true;
+                break;
+            case 2:
+                tile.width = random.integer(1, 2 * size);
+                tile.height = random.integer(1, 2 * size);
+                break;
+            default:
+                tile.encoding = static_cast<HeightEncoding>(random.integer(0, static_cast<int>(HeightEncoding::COUNT)));
+                break;
+            }
+
+            const bool valid = HeightCodec::Decode(tile, decoded.data(), tile.width);
+            rejected += valid ? 0 : 1;
+            if (truncation.empty() && truncated && valid)
+                truncation = Text("a ", HeightCodec::Name(tile.encoding), " tile truncated to ", tile.data.size(), " bytes decodes");
+        }
+        checks.out() << "  tiles: " << iterations << " mutations, " << rejected << " rejected" << std::endl;
+        checks.expect(truncation.empty(), truncation);
+    }
+
+    // Corrupt heightmap files must be rejected or decode to finite samples, never read past their data
+    void FuzzImports(Checks& checks, Random& random, int iterations)
+    {
+        const std::vector<TestRaster> rasters = TestRasters(random);
+        const ScratchFile file;
+        int rejected = 0;
+        std::string truncation;
+        std::string nonFinite;
+        std::vector<float> samples;
+        for (int i = 0; i < iterations; ++i)
+        {
+            const TestRaster& raster = rasters[random.integer(0, static_cast<int>(rasters.size()) - 1)];
+            std::vector<uint8_t> bytes = raster.bytes;
+            bool truncated = false;
+            switch (random.integer(0, 3))
+            {
+            case 0:
+                for (int flips = random.integer(1, 8); flips > 0; --flips)
+                    bytes[random.integer(0, static_cast<int>(bytes.size()) - 1)] ^= static_cast<uint8_t>(1 << random.integer(0, 7));
+                break;
+            case 1:
+                // Less than half of any raster misses pixel data, or the TIFF directory behind it
+                bytes.resize(random.integer(0, static_cast<int>(bytes.size()) / 2 - 1));
+                truncated = true;
+                break;
+            case 2:
+                // Headers: sizes, bit depths, tags and offsets
+                for (int writes = random.integer(1, 4); writes > 0; --writes)
+                    bytes[random.integer(0, std::min(static_cast<int>(bytes.size()), 64) - 1)] = static_cast<uint8_t>(random.integer(0, 255));
+                break;
+            default:
+            {
+                const int first = random.integer(0, static_cast<int>(bytes.size()) - 1);
+                const int last = random.integer(first, static_cast<int>(bytes.size()) - 1);
+                const std::vector<uint8_t> range(bytes.begin() + first, bytes.begin() + last + 1);
+                bytes.insert(bytes.begin() + random.integer(0, static_cast<int>(bytes.size())), range.begin(), range.end());
+                break;
+            }
+            }
+
+            bool valid = false;
+            bool finite = true;
+            if (file.write(bytes))
+            {
+                const SilenceErrors silence;
+                valid = ReadRaster(RasterSettings(raster, file), samples, finite);
+            }
+            rejected += valid ? 0 : 1;
+            if (truncation.empty() && truncated && valid)
+                truncation = Text("a ", raster.name, " file truncated to ", bytes.size(), " bytes decodes");
+            if (nonFinite.empty() && !finite)
+                nonFinite = Text("a mutated ", raster.name, " file decodes to non-finite samples");
+        }
+        checks.out() << "  imports: " << iterations << " mutations, " << rejected << " rejected" << std::endl;
+        checks.expect(truncation.empty(), truncation);
+        checks.expect(nonFinite.empty(), nonFinite);
+    }
+
+    // Command lines of every batch mode: any token soup gives usable settings
+    void FuzzArguments(Checks& checks, Random& random, int iterations)
+    {
+        const std::vector<std::string> tokens = { "--export", "--export-size", "--seed", "--scale", "--coordinator", "--workers",
+            "--world-size", "--tile", "--erosion", "--port", "--out", "--verify", "--budget-scale", "--fuzz",
+            "--fuzz-seed", "--no-budgets", "-1", "0", "7", "2147483647", "-2147483648", "abc", "1e9", "nan", "", "out.glb" };
+
+        std::string invalid;
+        for (int i = 0; i < iterations; ++i)
+        {
+            std::vector<std::string> arguments = { "TerrainGenerator" };
+            for (int count = random.integer(0, 8); count > 0; --count)
+                arguments.push_back(tokens[random.integer(0, static_cast<int>(tokens.size()) - 1)]);
+            std::vector<char*> argv;
+            for (std::string& argument : arguments)
+                argv.push_back(argument.data());
+            const int argc = static_cast<int>(argv.size());
+
+            ExportSettings exportSettings;
+            TerrainPreset exportPreset;
+            MeshExport::ParseArguments(argc, argv.data(), exportSettings, exportPreset);
+            DistributedSettings distributed;
+            Distributed::ParseArguments(argc, argv.data(), distributed);
+            SelfCheckSettings selfCheck;
+            SelfCheck::ParseArguments(argc, argv.data(), selfCheck);
+
+            const bool valid = exportSettings.width >= 2 && exportSettings.step > 0.f && distributed.workerCount >= 1
+                && distributed.tileSize >= 16 && distributed.preset.size >= 2 && distributed.preset.erosion.iterations >= 0
+                && selfCheck.budgetScale > 0.f && selfCheck.fuzzIterations >= 0;
+            if (invalid.empty() && !valid)
+            {
+                invalid = "invalid settings from the command line";
+                for (size_t a = 1; a < arguments.size(); ++a)
+                    invalid += " \"" + arguments[a] + "\"";
+            }
+        }
+        checks.out() << "  command lines: " << iterations << " mutations" << std::endl;
+        checks.expect(invalid.empty(), invalid);
+    }
+
+    // Best of three runs (the first also warms the caches), in ns per item against budget * scale
+    template<typename Kernel>
+    void Budget(Checks& checks, const SelfCheckSettings& settings, const char* name, double items, const char* unit, double budget, Kernel&& kernel)
+    {
+        double best = std::numeric_limits<double>::max();
+        for (int run = 0; run < 3; ++run)
+        {
+            const auto start = Clock::now();
+            kernel();
+            best = std::min(best, std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+        }
+
+        const double cost = best / items;
+        const double limit = budget * settings.budgetScale;
+        checks.out() << "  " << name << ": " << cost << " " << unit << " (budget " << limit << ")" << std::endl;
+        checks.expect(cost <= limit, Text(name, " costs ", cost, " ", unit, ", over its budget of ", limit));
+    }
+
+    // About three times the cost measured on one thread of a release build, debug builds need --budget-scale
+    void CheckBudgets(Checks& checks, const SelfCheckSettings& settings)
+    {
+        checks.group("Budgets (one thread)");
+
+        const int previousLimit = Parallel::ThreadLimit().exchange(1);
+
+        constexpr int rowLength = 1024;
+        constexpr int rowCount = 256;
+        std::vector<float> row(rowLength);
+        float checksum = 0.f;
+        Budget(checks, settings, "perlin()", rowLength * rowCount, "ns/sample", 300.0, [&]
+        {
+            for (int y = 0; y < rowCount; ++y)
+                for (int x = 0; x < rowLength; ++x)
+                    checksum += perlin(x / 64.f, y / 64.f, 0);
+        });
+
+        // Worley engines search 3x3 cells
+        const double engineBudgets[] = { 25.0, 40.0, 25.0, 50.0, 50.0 };
+        static_assert(std::size(engineBudgets) == static_cast<size_t>(NoiseType::COUNT));
+        for (int type = 0; type < static_cast<int>(NoiseType::COUNT); ++type)
+        {
+            const auto engine = Noise::CreateEngine(static_cast<NoiseType>(type), 0);
+            const std::string name = Text(Noise::Name(engine->getType()), " sampleRow");
+            Budget(checks, settings, name.c_str(), rowLength * rowCount, "ns/sample", engineBudgets[type], [&]
+            {
+                for (int y = 0; y < rowCount; ++y)
+                {
+                    engine->sampleRow(0.f, 1.f / 64.f, y / 64.f, rowLength, row.data());
+                    checksum += row[y];
+                }
+            });
+        }
+
+        constexpr int size = 1024;
+        const size_t samples = static_cast<size_t>(size) * size;
+        TerrainPreset preset;
+        preset.size = size;
+        preset.noise = { { NoiseType::PERLIN, 1, 1.f, 0 }, { NoiseType::PERLIN, 4, 0.25f, 1 }, { NoiseType::PERLIN, 16, 0.06f, 2 } };
+        const GenerationSettings generation = preset.generation();
+        std::vector<float> heights(samples);
+        Budget(checks, settings, "GenerateNoise, 3 stages", static_cast<double>(samples), "ns/sample", 75.0, [&]
+        {
+            TileGeneration::GenerateNoise(generation, 0, 0, size, size, heights);
+        });
+
+        constexpr int erosionSize = 512;
+        ErosionSettings erosion;
+        erosion.iterations = 8;
+        std::vector<float> eroded(static_cast<size_t>(erosionSize) * erosionSize);
+        Budget(checks, settings, "Erosion::Thermal", static_cast<double>(eroded.size()) * erosion.iterations, "ns/sample/iteration", 30.0, [&]
+        {
+            for (int y = 0; y < erosionSize; ++y)
+                std::copy_n(heights.begin() + static_cast<size_t>(y) * size, erosionSize, eroded.begin() + static_cast<size_t>(y) * erosionSize);
+            Erosion::Thermal(eroded, erosionSize, erosionSize, erosion);
+        });
+
+        const BiomeClassifier classifier;
+        std::vector<uint8_t> weights(samples * 4);
+        Budget(checks, settings, "BiomeClassifier::classify", static_cast<double>(samples), "ns/sample", 30.0, [&]
+        {
+            classifier.classify(heights, size, weights);
+        });
+
+        HeightfieldView view;
+        view.heights = heights.data();
+        view.size = size;
+        view.step = preset.step();
+        std::vector<float> positions(GridMesh::PositionCount(size));
+        std::vector<uint32_t> indices(GridMesh::IndexCount(size));
+        Budget(checks, settings, "GridMesh::Write", static_cast<double>(samples), "ns/vertex", 16.0, [&]
+        {
+            GridMesh::Write(view, positions, indices);
+        });
+
+        CompressedHeightmap compressed(size, size);
+        compressed.encode(heights);
+        std::vector<float> decoded(samples);
+        Budget(checks, settings, "CompressedHeightmap::decode", static_cast<double>(samples), "ns/sample", 4.0, [&]
+        {
+            compressed.decode(decoded);
+        });
+
+        // A new baker each run, an updated one would skip the unchanged tiles
+        Budget(checks, settings, "HorizonAO bake", static_cast<double>(samples), "ns/texel", 260.0, [&]
+        {
+            HorizonAO occlusion;
+            occlusion.update(view);
+            checksum += occlusion.getTexels()[0];
+        });
+
+        Parallel::ThreadLimit() = previousLimit;
+        checks.out() << "  (checksum " << checksum << ")" << std::endl;
+    }
+}
+
+namespace SelfCheck
+{
+    void ParseArguments(int argc, char** argv, SelfCheckSettings& settings)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+
+            if (arg == "--budget-scale" && hasValue)
+            {
+                const float scale = static_cast<float>(std::atof(argv[++i]));
+                settings.budgetScale = scale > 0.f ? scale : 1.f;
+            }
+            else if (arg == "--no-budgets")
+                settings.budgets = false;
+            else if (arg == "--fuzz" && hasValue)
+                settings.fuzzIterations = std::max(0, std::atoi(argv[++i]));
+            else if (arg == "--fuzz-seed" && hasValue)
+                settings.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+    }
+
+    int Run(std::ostream& out, const SelfCheckSettings& settings)
+    {
+        const auto start = Clock::now();
+        Checks checks(out);
+        Random random(settings.seed);
+
+        CheckPerlin(checks, random);
+        CheckNoiseEngines(checks, random);
+        CheckMatrices(checks, random);
+        CheckCodec(checks, random);
+        CheckSculpt(checks, random);
+        CheckTileCache(checks, random);
+        CheckImport(checks, random);
+
+        checks.group("Fuzzing");
+        FuzzPresets(checks, random, settings.fuzzIterations);
+        FuzzTiles(checks, random, settings.fuzzIterations);
+        FuzzImports(checks, random, settings.fuzzIterations);
+        FuzzArguments(checks, random, settings.fuzzIterations);
+
+        if (settings.budgets)
+            CheckBudgets(checks, settings);
+
+        out << checks.count() << " checks, " << checks.failures() << " failed, "
+            << std::chrono::duration<double>(Clock::now() - start).count() << " s" << std::endl;
+        return checks.failures();
+    }
+}
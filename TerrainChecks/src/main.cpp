@@ -0,0 +1,11 @@
+#include <iostream>
+
+#include "SelfCheck.h"
+
+// Properties, fuzzing and cost budgets of the core, exit code 1 if any check fails
+int main(int argc, char** argv)
+{
+    SelfCheckSettings settings;
+    SelfCheck::ParseArguments(argc, argv, settings);
+    return SelfCheck::Run(std::cout, settings) == 0 ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+#ifndef BIOME_CLASSIFIER_H
+#define BIOME_CLASSIFIER_H
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Color3.h"
+#include "MathHelper.h"
+
+// Material layers, in the order of the RGBA channels of the weights texture
+enum class Material
+{
+    GRASS,
+    SAND,
+    ROCK,
+    SNOW,
+    COUNT
+};
+
+// Base albedo of a material, modulated by procedural detail where it is drawn
+Color3<float> MaterialColor(Material material);
+
+struct BiomeSettings
+{
+    int seed = 0;
+
+    // World position of the sample (0, 0) and distance between two samples
+    Point2d<float> origin = { -1.f, -1.f };
+    float step = 1.f;
+    float heightScale = 1.f;
+
+    // Moisture and temperature noise frequency, in world units
+    float climateFrequency = 0.15f;
+
+    float sandHeight = 0.06f;
+    float snowHeight = 0.5f;
+    float rockSlope = 0.9f;
+};
+
+// Classify heightmap samples into packed RGBA8 material weights (grass, sand, rock, snow)
+class BiomeClassifier
+{
+public:
+    static constexpr int TILE_SIZE = 32;
+
+    // Climate noise is evaluated every CLIMATE_STEP samples and bilinearly interpolated in between
+    static constexpr int CLIMATE_STEP = 16;
+
+    explicit BiomeClassifier(const BiomeSettings& settings = {});
+
+    const BiomeSettings& getSettings() const { return m_settings; }
+    void setSettings(const BiomeSettings& settings) { m_settings = settings; }
+
+    // Classify a whole size x size heightmap into size x size RGBA weights, tiles are processed in parallel.
+    // False if a span is smaller than the map.
+    bool classify(std::span<const float> heights, int size, std::span<uint8_t> weights) const;
+
+    // Classify only the samples of [x0, x0 + width) x [y0, y0 + height), e.g. a regenerated chunk
+    bool classifyRegion(std::span<const float> heights, int size, int x0, int y0, int width, int height, std::span<uint8_t> weights) const;
+
+private:
+    // Moisture and temperature sampled every CLIMATE_STEP samples
+    struct ClimateLattice
+    {
+        int x0 = 0;
+        int y0 = 0;
+        int width = 0;
+        std::vector<float> moisture;
+        std::vector<float> temperature;
+    };
+
+    BiomeSettings m_settings;
+
+    void classifyTile(const float* heights, int size, const ClimateLattice& climate, int x0, int y0, int x1, int y1, uint8_t* weights) const;
+};
+
+#endif // BIOME_CLASSIFIER_H
@@ -21,4 +21,4 @@ struct Color3
     T r, g, b;
 };
 
-#endif COLOR3_H
\ No newline at end of file
+#endif // COLOR3_H
\ No newline at end of file
@@ -0,0 +1,97 @@
+#ifndef COMPRESSED_HEIGHTMAP_H
+#define COMPRESSED_HEIGHTMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+enum class HeightEncoding
+{
+    QUANTIZED16,        // 16-bit quantization over the tile range, 2 bytes per sample
+    QUANTIZED_DELTA,    // Same quantized values, predicted from the two rows above and bit-packed
+    LOSSLESS,           // Exact float bits (order preserving), predicted from the two rows above and bit-packed
+    COUNT
+};
+
+// One encoded tile. Quantized encodings map [minHeight, minHeight + 65535 * step] on 16 bits.
+struct EncodedTile
+{
+    HeightEncoding encoding = HeightEncoding::QUANTIZED16;
+    int width = 0;
+    int height = 0;
+    float minHeight = 0.f;
+    float step = 0.f;
+    std::vector<uint8_t> data;
+};
+
+namespace HeightCodec
+{
+    const char* Name(HeightEncoding encoding);
+
+    // Encode width x height samples, rows are stride floats apart.
+    // Quantized encodings use the finest of 65536 levels over the tile range, or coarser levels when an absolute
+    // error tolerance is given: fewer levels means smaller residuals, so better compression of the delta encoding.
+    EncodedTile Encode(const float* heights, int width, int height, int stride, HeightEncoding encoding, float tolerance = 0.f);
+
+    // Decode into width x height floats, rows are stride floats apart. SIMD reconstruction of whole rows.
+    // False if the data does not match the tile size, e.g. a truncated or corrupt tile: nothing past it is read.
+    bool Decode(const EncodedTile& tile, float* heights, int stride);
+
+    // Bound of the absolute difference between decoded and original heights
+    float MaxError(const EncodedTile& tile);
+}
+
+// Heightmap kept in compressed tiles, e.g. the cold part of a world too large to stay in floats
+class CompressedHeightmap
+{
+public:
+    static constexpr int DEFAULT_TILE_SIZE = 64;
+
+    CompressedHeightmap(int width = 0, int height = 0, HeightEncoding encoding = HeightEncoding::QUANTIZED_DELTA,
+                        float tolerance = 0.f, int tileSize = DEFAULT_TILE_SIZE);
+
+    int getWidth() const { return m_width; }
+    int getHeight() const { return m_height; }
+    int getTileSize() const { return m_tileSize; }
+    int getTilesX() const { return m_tilesX; }
+    int getTilesY() const { return m_tilesY; }
+    HeightEncoding getEncoding() const { return m_encoding; }
+    float getTolerance() const { return m_tolerance; }
+
+    // Encode a whole width x height heightmap, tiles in parallel. False if heights holds less than that.
+    bool encode(std::span<const float> heights);
+
+    // Encode the tile (tx, ty) from a heightmap with rows stride floats apart, pointing at its first sample
+    void setTile(int tx, int ty, const float* heights, int stride);
+
+    const EncodedTile& getTile(int tx, int ty) const { return m_tiles[ty * m_tilesX + tx]; }
+
+    // Decode a tile into a getTileSize()^2 buffer (rows are getTileSize() floats apart), false if it is too small or the tile is corrupt
+    bool decodeTile(int tx, int ty, std::span<float> heights) const;
+
+    // Decode everything into a width x height buffer, false if it is too small or a tile is corrupt
+    bool decode(std::span<float> heights) const;
+
+    size_t compressedBytes() const;
+    size_t uncompressedBytes() const { return static_cast<size_t>(m_width) * m_height * sizeof(float); }
+    float maxError() const;
+
+private:
+    int m_width;
+    int m_height;
+    int m_tileSize;
+    int m_tilesX;
+    int m_tilesY;
+    HeightEncoding m_encoding;
+    float m_tolerance;
+    std::vector<EncodedTile> m_tiles;
+};
+
+// Heap bytes of the encoded tiles, for the caches charging their entries
+inline size_t MemoryBytes(const CompressedHeightmap& heightmap)
+{
+    return heightmap.compressedBytes();
+}
+
+#endif // COMPRESSED_HEIGHTMAP_H
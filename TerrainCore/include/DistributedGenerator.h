@@ -0,0 +1,42 @@
+#ifndef DISTRIBUTED_GENERATOR_H
+#define DISTRIBUTED_GENERATOR_H
+
+#include <string>
+
+#include "Preset.h"
+
+// Settings of the multi-process generation (see README)
+struct DistributedSettings
+{
+    // Generated map, the command line overrides its size, seed, erosion and height scale
+    TerrainPreset preset;
+
+    // Worker processes spawned on this machine, and tile edge in samples
+    int workerCount = 4;
+    int tileSize = 256;
+
+    // Listening port of the coordinator, 0 picks a free one
+    int port = 0;
+
+    // Optional output (same formats as --export), and comparison against a single-process generation
+    std::string outputPath;
+    bool verify = false;
+};
+
+// Coordinator / worker tile generation over localhost TCP.
+// The coordinator spawns worker processes of this executable, hands out tiles on demand and assembles the map;
+// workers generate a tile with its erosion halo, so the map is bit-identical to a single-process generation.
+namespace Distributed
+{
+    // Return true if the command line asks for the coordinator mode, and fill the settings
+    bool ParseArguments(int argc, char** argv, DistributedSettings& settings);
+
+    // Return true if the process was spawned as a worker: --worker HOST:PORT [--threads N]
+    bool ParseWorkerArguments(int argc, char** argv, std::string& address, int& threadCount);
+
+    // Process entry points, return the process exit code
+    int RunCoordinator(const DistributedSettings& settings, const char* executable);
+    int RunWorker(const std::string& address, int threadCount);
+}
+
+#endif // DISTRIBUTED_GENERATOR_H
@@ -0,0 +1,26 @@
+#ifndef EROSION_H
+#define EROSION_H
+
+#include <span>
+
+struct ErosionSettings
+{
+    int iterations = 0;
+
+    // Height difference between neighbours above which material slides, and fraction of the excess moved per iteration
+    float talus = 0.004f;
+    float rate = 0.1f;
+};
+
+namespace Erosion
+{
+    // Thermal erosion of a width x height heightmap. Every iteration reads the previous one only (Jacobi),
+    // so a sample depends on the samples within `iterations` of it: a region eroded with a halo of that
+    // size matches the same samples of the whole map bit for bit. False if heights holds less than width * height.
+    bool Thermal(std::span<float> heights, int width, int height, const ErosionSettings& settings);
+
+    // Samples of margin needed around a region for an exact result
+    inline int Halo(const ErosionSettings& settings) { return settings.iterations > 0 ? settings.iterations : 0; }
+}
+
+#endif // EROSION_H
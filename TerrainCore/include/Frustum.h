@@ -0,0 +1,48 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <array>
+#include <cmath>
+
+#include "MathHelper.h"
+
+// View frustum planes extracted from a view-projection matrix, normals point inside
+struct Frustum
+{
+    std::array<Point4d<float>, 6> planes;
+
+    explicit Frustum(const Mat4<float>& VP)
+    {
+        // Gribb-Hartmann: row 3 +/- rows 0, 1 and 2 of the clip transform
+        for (int i = 0; i < 3; ++i)
+        {
+            for (int side = 0; side < 2; ++side)
+            {
+                const float sign = side == 0 ? 1.f : -1.f;
+                Point4d<float> plane(VP(3, 0) + sign * VP(i, 0), VP(3, 1) + sign * VP(i, 1),
+                                     VP(3, 2) + sign * VP(i, 2), VP(3, 3) + sign * VP(i, 3));
+                const float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+                if (length > 0.f)
+                    plane = Point4d<float>(plane.x / length, plane.y / length, plane.z / length, plane.w / length);
+                planes[i * 2 + side] = plane;
+            }
+        }
+    }
+
+    // False only if the box is entirely outside one of the planes
+    bool intersects(const Point3d<float>& boxMin, const Point3d<float>& boxMax) const
+    {
+        for (const Point4d<float>& p : planes)
+        {
+            // Corner of the box the furthest along the plane normal
+            const float x = p.x >= 0.f ? boxMax.x : boxMin.x;
+            const float y = p.y >= 0.f ? boxMax.y : boxMin.y;
+            const float z = p.z >= 0.f ? boxMax.z : boxMin.z;
+            if (p.x * x + p.y * y + p.z * z + p.w < 0.f)
+                return false;
+        }
+        return true;
+    }
+};
+
+#endif // FRUSTUM_H
@@ -0,0 +1,184 @@
+#ifndef GENERATION_GRAPH_H
+#define GENERATION_GRAPH_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+#include "MemoryAccounting.h"
+#include "Preset.h"
+#include "TerrainSimplifier.h"
+
+// FNV-1a hash of node inputs. Values are added field by field, padding bytes never reach the hash.
+class InputHash
+{
+public:
+    template<typename T>
+    InputHash& add(const T& value)
+    {
+        static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>);
+        unsigned char bytes[sizeof(T)];
+        std::memcpy(bytes, &value, sizeof(T));
+        for (unsigned char byte : bytes)
+            m_value = (m_value ^ byte) * 0x100000001B3ull;
+        return *this;
+    }
+
+    uint64_t value() const { return m_value; }
+
+private:
+    uint64_t m_value = 0xCBF29CE484222325ull;
+};
+
+// Output of a graph node for the last few input keys. A node only recomputes when the hash of its
+// inputs (its own parameters and the keys of the nodes it reads) was not seen recently.
+// Entries with a MemoryBytes() overload are charged to tag.
+template<typename T>
+class CachedNode
+{
+public:
+    explicit CachedNode(size_t capacity = 2, MemoryTag tag = MemoryTag::CACHES)
+        : m_capacity(std::max<size_t>(1, capacity))
+        , m_memory(tag)
+    {}
+
+    // compute() returns the output, it only runs on a miss
+    template<typename Fn>
+    std::shared_ptr<const T> evaluate(uint64_t key, Fn&& compute)
+    {
+        for (size_t i = 0; i < m_entries.size(); ++i)
+        {
+            if (m_entries[i].key == key)
+            {
+                std::rotate(m_entries.begin(), m_entries.begin() + i, m_entries.begin() + i + 1);
+                ++m_hits;
+                return m_entries.front().value;
+            }
+        }
+
+        auto value = std::make_shared<const T>(compute());
+        ++m_misses;
+
+        if (m_entries.size() >= m_capacity)
+            m_entries.pop_back();
+        m_entries.insert(m_entries.begin(), { key, value });
+        updateMemory();
+        return value;
+    }
+
+    // Output computed elsewhere for key, e.g. read from a disk cache
+    void insert(uint64_t key, std::shared_ptr<const T> value)
+    {
+        for (size_t i = 0; i < m_entries.size(); ++i)
+        {
+            if (m_entries[i].key == key)
+            {
+                m_entries.erase(m_entries.begin() + i);
+                break;
+            }
+        }
+
+        if (m_entries.size() >= m_capacity)
+            m_entries.pop_back();
+        m_entries.insert(m_entries.begin(), { key, std::move(value) });
+        updateMemory();
+    }
+
+    void clear()
+    {
+        m_entries.clear();
+        updateMemory();
+    }
+
+    // Keep the most recent output only, e.g. over a memory budget
+    void trim()
+    {
+        if (m_entries.size() > 1)
+        {
+            m_entries.resize(1);
+            updateMemory();
+        }
+    }
+
+    int getHits() const { return m_hits; }
+    int getMisses() const { return m_misses; }
+
+private:
+    struct Entry
+    {
+        uint64_t key;
+        std::shared_ptr<const T> value;
+    };
+
+    size_t m_capacity;
+    std::vector<Entry> m_entries;
+    int m_hits = 0;
+    int m_misses = 0;
+    MemoryCharge m_memory;
+
+    void updateMemory()
+    {
+        if constexpr (requires(const T& value) { MemoryBytes(value); })
+        {
+            size_t bytes = 0;
+            for (const Entry& entry : m_entries)
+                bytes += MemoryBytes(*entry.value);
+            m_memory.set(bytes);
+        }
+    }
+};
+
+// Evaluation time of the nodes recomputed since the last reset, in milliseconds (0 when cached)
+struct GraphStats
+{
+    double heightsTime = 0.0;
+    double materialsTime = 0.0;
+    double errorsTime = 0.0;
+};
+
+// Lazy generation pipeline of a preset:
+//
+//   heights (noise stages, erosion) -> materials (biomes)
+//                                   -> simplification errors
+//
+// Nothing is computed until an output is requested, and only the nodes whose inputs changed since then run.
+class GenerationGraph
+{
+public:
+    void setPreset(const TerrainPreset& preset) { m_preset = preset; }
+    const TerrainPreset& getPreset() const { return m_preset; }
+
+    // Keys of the node outputs for the current preset, without evaluating anything
+    uint64_t heightsKey() const;
+    uint64_t materialsKey() const;
+
+    // Placement of the samples in the local frame
+    BiomeSettings biomeSettings() const;
+
+    std::shared_ptr<const std::vector<float>> heights();
+    std::shared_ptr<const std::vector<uint8_t>> materials();
+    std::shared_ptr<const TerrainSimplifier> simplifier();
+
+    // Heights of the current preset obtained without generating them (session cache): the next heights() returns
+    // them. False if there are not size * size of them.
+    bool setHeights(std::vector<float> heights);
+
+    const GraphStats& getStats() const { return m_stats; }
+    void resetStats() { m_stats = GraphStats(); }
+
+    // Drop the outputs of earlier presets, the current ones stay
+    void trimCaches();
+
+private:
+    TerrainPreset m_preset;
+    GraphStats m_stats;
+
+    CachedNode<std::vector<float>> m_heights{ 2, MemoryTag::HEIGHTMAPS };
+    CachedNode<std::vector<uint8_t>> m_materials{ 2, MemoryTag::MATERIALS };
+    CachedNode<TerrainSimplifier> m_simplifier;   // Its errors use a tagged allocator
+};
+
+#endif // GENERATION_GRAPH_H
@@ -0,0 +1,29 @@
+#ifndef GRID_MESH_H
+#define GRID_MESH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "Heightfield.h"
+#include "TerrainSimplifier.h"
+
+// Full-resolution mesh of a heightfield: one vertex per sample, two triangles per cell
+namespace GridMesh
+{
+    // Floats (x, y, z per vertex) and indices of a size x size heightfield
+    inline size_t PositionCount(int size) { return size > 0 ? static_cast<size_t>(size) * size * 3 : 0; }
+    inline size_t IndexCount(int size) { return size > 1 ? static_cast<size_t>(size - 1) * (size - 1) * 6 : 0; }
+
+    // Write into caller buffers of at least PositionCount and IndexCount elements, rows in parallel.
+    // False if one of them is too small.
+    bool Write(const HeightfieldView& heightfield, std::span<float> positions, std::span<uint32_t> indices);
+
+    TerrainMesh Build(const HeightfieldView& heightfield);
+
+    // Positions of the samples [x, x + width) of row y, e.g. to update the vertices under an edit. Vertex
+    // (x, y) of the mesh is at float (y * size + x) * 3.
+    void WriteRow(const HeightfieldView& heightfield, int x, int y, int width, float* positions);
+}
+
+#endif // GRID_MESH_H
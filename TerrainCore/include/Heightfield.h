@@ -0,0 +1,58 @@
+#ifndef HEIGHTFIELD_H
+#define HEIGHTFIELD_H
+
+#include <algorithm>
+#include <cmath>
+
+#include "MathHelper.h"
+
+// Read-only view of a square heightmap placed in the world, sample (x, y) is at origin + (x, y) * step
+struct HeightfieldView
+{
+    const float* heights = nullptr;
+    int size = 0;
+    Point2d<float> origin = { -1.f, -1.f };
+    float step = 1.f;
+    float heightScale = 1.f;
+
+    bool valid() const { return heights != nullptr && size >= 2; }
+    float extent() const { return (size - 1) * step; }
+
+    bool contains(float x, float z) const
+    {
+        return x >= origin.x && z >= origin.y && x <= origin.x + extent() && z <= origin.y + extent();
+    }
+
+    // Unscaled sample, clamped to the borders
+    float sample(int x, int y) const
+    {
+        x = std::clamp(x, 0, size - 1);
+        y = std::clamp(y, 0, size - 1);
+        return heights[y * size + x];
+    }
+
+    // Bilinear world height at (x, z)
+    float height(float x, float z) const
+    {
+        const float gx = std::clamp((x - origin.x) / step, 0.f, static_cast<float>(size - 1));
+        const float gy = std::clamp((z - origin.y) / step, 0.f, static_cast<float>(size - 1));
+        const int x0 = std::min(static_cast<int>(gx), size - 2);
+        const int y0 = std::min(static_cast<int>(gy), size - 2);
+        const float fx = gx - x0;
+        const float fy = gy - y0;
+
+        const float top = sample(x0, y0) + (sample(x0 + 1, y0) - sample(x0, y0)) * fx;
+        const float bottom = sample(x0, y0 + 1) + (sample(x0 + 1, y0 + 1) - sample(x0, y0 + 1)) * fx;
+        return (top + (bottom - top) * fy) * heightScale;
+    }
+
+    // World slope (rise over run) at (x, z), central differences of the bilinear height
+    float slope(float x, float z) const
+    {
+        const float dx = (height(x + step, z) - height(x - step, z)) / (2.f * step);
+        const float dz = (height(x, z + step) - height(x, z - step)) / (2.f * step);
+        return std::sqrt(dx * dx + dz * dz);
+    }
+};
+
+#endif // HEIGHTFIELD_H
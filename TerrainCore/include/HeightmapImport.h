@@ -0,0 +1,105 @@
+#ifndef HEIGHTMAP_IMPORT_H
+#define HEIGHTMAP_IMPORT_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+
+#include "CompressedHeightmap.h"
+#include "Preset.h"
+#include "TileGeneration.h"
+
+enum class RasterFormat
+{
+    PNG16,          // Grayscale PNG, 16 or 8 bits, not interlaced
+    RAW_FLOAT32,    // Headerless little-endian float32 rows, size given by the settings
+    TIFF            // Baseline TIFF / GeoTIFF: one uncompressed uint16, int16 or float32 channel in strips
+};
+
+enum class ResampleFilter
+{
+    BILINEAR,
+    BICUBIC         // Catmull-Rom, 4x4 source samples
+};
+
+// Raster decoded one row at a time, top to bottom: only the current row (and the zlib state) is held
+class RasterReader
+{
+public:
+    virtual ~RasterReader() = default;
+
+    int getWidth() const { return m_width; }
+    int getHeight() const { return m_height; }
+
+    // Decode the next row into getWidth() floats. Integer samples are normalized: unsigned to [0, 1], signed to [-1, 1].
+    // False past the last row or on a truncated / corrupt file.
+    virtual bool readRow(std::span<float> row) = 0;
+
+protected:
+    int m_width = 0;
+    int m_height = 0;
+};
+
+struct ImportSettings
+{
+    std::string path;
+    RasterFormat format = RasterFormat::PNG16;
+
+    // Size of a raw raster, which has no header
+    int rawWidth = 0;
+    int rawHeight = 0;
+
+    // size x size output samples over the top-left square of the raster
+    int size = 1024;
+    ResampleFilter filter = ResampleFilter::BICUBIC;
+
+    // Output height = offset + scale * sample
+    float scale = 1.f;
+    float offset = 0.f;
+
+    // Procedural detail over the imported heights: the noise stages of the preset on the same grid, without erosion
+    bool addNoise = false;
+    GenerationSettings noise;
+
+    // Storage of Import into tiles
+    HeightEncoding encoding = HeightEncoding::LOSSLESS;
+    float tolerance = 0.f;
+};
+
+struct ImportStats
+{
+    int sourceWidth = 0;
+    int sourceHeight = 0;
+    uint64_t sourceBytes = 0;
+
+    // Most source rows held at once by the resampling window
+    int peakSourceRows = 0;
+    double seconds = 0.0;
+};
+
+// Receives output rows [firstRow, firstRow + rowCount) in increasing order, size samples per row
+using HeightBandSink = std::function<void(int firstRow, int rowCount, std::span<const float> heights)>;
+
+// Streaming heightmap import, e.g. of DEMs much larger than memory: the raster is decoded row by row and resampled
+// into the output grid one band of rows at a time, so that only the source rows under the current band (plus the
+// bicubic margin) are resident. Output rows of a band are resampled in parallel, detail noise is added per band.
+namespace HeightmapImport
+{
+    RasterFormat FormatFromPath(const std::string& path);
+
+    // Reader of the raster, nullptr (with the reason on std::cerr) if it is missing or not supported
+    std::unique_ptr<RasterReader> Open(const ImportSettings& settings);
+
+    bool Import(const ImportSettings& settings, const HeightBandSink& sink, ImportStats* stats = nullptr);
+
+    // Import into a size x size tiled heightmap of the settings encoding, bands of one tile row
+    bool Import(const ImportSettings& settings, CompressedHeightmap& heightmap, ImportStats* stats = nullptr);
+
+    // Command line: --import FILE [--import-size N] [--import-raw WxH] [--import-filter bilinear|bicubic]
+    // [--import-scale F] [--import-offset F] [--import-noise AMPLITUDE], the noise stages coming from the preset
+    bool ParseArguments(int argc, char** argv, ImportSettings& settings, const TerrainPreset& preset);
+}
+
+#endif // HEIGHTMAP_IMPORT_H
@@ -0,0 +1,72 @@
+#ifndef HORIZON_AO_H
+#define HORIZON_AO_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Heightfield.h"
+#include "MemoryAccounting.h"
+
+struct HorizonAOSettings
+{
+    int directions = 8;
+    int steps = 6;             // Samples per direction
+    float radius = 2.f;        // Horizon search distance in world units
+    int maxResolution = 1024;  // Texels per side, larger heightmaps are baked every few samples
+};
+
+// Normals and horizon-based ambient occlusion of a heightfield, baked on the CPU. In every direction the
+// highest horizon angle within the radius is searched at exponentially growing distances; the occlusion is the
+// average sine of those angles. Texels are baked in tiles (in parallel), and a new heightfield only rebakes the
+// tiles whose heights changed, and the tiles within the radius of them.
+class HorizonAO
+{
+public:
+    static constexpr int TILE_SIZE = 64; // Texels
+
+    explicit HorizonAO(const HorizonAOSettings& settings = {});
+
+    // Bake the tiles affected by the changes since the last call, returns them
+    const std::vector<int>& update(const HeightfieldView& heightfield);
+
+    // Rebake around the samples [x, x + width) x [y, y + height), e.g. after a local edit
+    const std::vector<int>& updateRegion(const HeightfieldView& heightfield, int x, int y, int width, int height);
+
+    // Normals only of the texels depending on the samples [x, x + width) x [y, y + height), returns their tiles.
+    // Cheap enough for every dab of a brush, the occlusion waits for updateRegion().
+    const std::vector<int>& updateNormals(const HeightfieldView& heightfield, int x, int y, int width, int height);
+
+    // Texel (x, y) is heightmap sample (x * stride, y * stride)
+    int getSize() const { return m_size; }
+    int getStride() const { return m_stride; }
+    int getTilesPerSide() const { return m_tiles; }
+
+    // RGBA per texel: normal * 0.5 + 0.5, then ambient light (1 unoccluded)
+    const TaggedVector<uint8_t, MemoryTag::SHADING>& getTexels() const { return m_texels; }
+
+    // Last update, in milliseconds
+    double getBakeTime() const { return m_bakeTime; }
+
+private:
+    HorizonAOSettings m_settings;
+    int m_size = 0;
+    int m_stride = 1;
+    int m_tiles = 0; // Per side
+    TaggedVector<uint8_t, MemoryTag::SHADING> m_texels;
+
+    // Heights under each tile, and what every texel depends on, at the last bake
+    std::vector<uint64_t> m_tileHashes;
+    uint64_t m_layoutKey = 0;
+
+    std::vector<int> m_dirty;
+    double m_bakeTime = 0.0;
+
+    int radiusInTiles(const HeightfieldView& heightfield) const;
+    uint64_t hashTile(const HeightfieldView& heightfield, int tile) const;
+    void markAround(std::vector<uint8_t>& marked, int tx0, int ty0, int tx1, int ty1, int radius) const;
+    void bake(const HeightfieldView& heightfield, const std::vector<uint8_t>& marked);
+    void bakeTile(const HeightfieldView& heightfield, int tile);
+    void writeNormal(const HeightfieldView& heightfield, int tx, int ty);
+};
+
+#endif // HORIZON_AO_H
@@ -0,0 +1,14 @@
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <cstdint>
+#include <string>
+
+namespace Image
+{
+    // Write 8-bit pixels (1 = gray, 3 = RGB, 4 = RGBA channels) to a PNG file.
+    // Rows are deflated one at a time, so no second copy of the image is made.
+    bool WritePng(const std::string& filePath, int width, int height, int channels, const uint8_t* pixels, bool flipVertically = false);
+}
+
+#endif // IMAGE_WRITER_H
@@ -0,0 +1,108 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct Job;
+
+// Counts the unfinished jobs submitted with it. Jobs submitted "after" a fence start once it is done.
+class JobFence
+{
+public:
+    JobFence() = default;
+    JobFence(const JobFence&) = delete;
+    JobFence& operator=(const JobFence&) = delete;
+
+    bool done() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+
+    // While the last job schedules the waiting jobs: the fence is not done yet, its waiter must not destroy it
+    static constexpr int SIGNALLING = -1;
+
+    std::atomic<int> m_pending = 0;
+    std::atomic<Job*> m_waiting = nullptr; // Jobs to schedule when the fence is done
+};
+
+// Execution interval of a job, in seconds since the creation of the job system
+struct JobTrace
+{
+    const char* name;
+    int thread;
+    double start;
+    double end;
+};
+
+// Work-stealing job system. Every worker thread, and the thread that created the system, owns a lock-free
+// deque (Chase-Lev): it pushes and pops jobs at the bottom, idle threads steal from the top of the others.
+// Waiting on a fence executes jobs instead of blocking, so jobs can wait on other jobs.
+// Threads that are not part of the system submit through a shared queue.
+class JobSystem
+{
+public:
+    // threadCount includes the creating thread, 0 for Parallel::ThreadCount()
+    explicit JobSystem(int threadCount = 0);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // Shared system, created by the first thread that uses it
+    static JobSystem& Instance();
+
+    int getThreadCount() const { return static_cast<int>(m_threads.size()); }
+
+    // Run fn on any thread. fence (optional) counts the job until it has finished, the job does not start
+    // before `after` (optional) is done. name shows in the timeline, it must outlive the traces.
+    void run(std::function<void()> fn, JobFence* fence = nullptr, JobFence* after = nullptr, const char* name = nullptr);
+
+    // Execute jobs until the fence is done
+    void wait(const JobFence& fence);
+
+    // Timeline of the executed jobs, collected when profiling only
+    void setProfiling(bool profiling) { m_profiling.store(profiling, std::memory_order_relaxed); }
+    bool isProfiling() const { return m_profiling.load(std::memory_order_relaxed); }
+
+    // Move the traces recorded since the last call into traces
+    void collectTraces(std::vector<JobTrace>& traces);
+
+    double now() const { return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count(); }
+
+private:
+    struct ThreadState;
+
+    std::vector<std::unique_ptr<ThreadState>> m_threads;
+    std::vector<std::thread> m_workers;
+
+    // Jobs submitted by threads outside the system
+    std::mutex m_externalMutex;
+    std::vector<Job*> m_external;
+    std::atomic<int> m_externalCount = 0;
+
+    // Incremented by every submission, idle workers sleep on it
+    std::atomic<uint32_t> m_epoch = 0;
+    std::atomic<bool> m_stop = false;
+    std::atomic<bool> m_profiling = false;
+
+    const std::chrono::steady_clock::time_point m_start = std::chrono::steady_clock::now();
+
+    int threadIndex() const;
+    Job* allocate();
+    void push(Job* job);
+    Job* findJob(int index);
+    void execute(Job* job, int index);
+    void schedule(Job* list);
+    void scheduleWaiting(JobFence& fence);
+    void signal(JobFence& fence);
+    void workerLoop(int index);
+};
+
+#endif // JOB_SYSTEM_H
@@ -235,6 +235,19 @@ public:
         P(2, 2) = -(farPlane + nearPlane) / (farPlane - nearPlane);
         P(2, 3) = -(2.f * farPlane * nearPlane) / (farPlane - nearPlane);
         P(3, 2) = -1.f;
+        P(3, 3) = 0.f;
+        return P;
+    }
+
+    static Mat4<T> orthographic(const T& left, const T& right, const T& bottom, const T& top, const T& nearPlane, const T& farPlane)
+    {
+        Mat4<T> P = identity();
+        P(0, 0) = 2.f / (right - left);
+        P(1, 1) = 2.f / (top - bottom);
+        P(2, 2) = -2.f / (farPlane - nearPlane);
+        P(0, 3) = -(right + left) / (right - left);
+        P(1, 3) = -(top + bottom) / (top - bottom);
+        P(2, 3) = -(farPlane + nearPlane) / (farPlane - nearPlane);
         return P;
     }
 
@@ -305,15 +318,15 @@ namespace Math
         Mat4<T> result = Mat4<T>::identity();
 
         result(0, 0) = s.x;
-        result(0, 1) = u.x;
-        result(0, 2) = -f.x;
+        result(0, 1) = s.y;
+        result(0, 2) = s.z;
 
-        result(1, 0) = s.y;
+        result(1, 0) = u.x;
         result(1, 1) = u.y;
-        result(1, 2) = -f.y;
+        result(1, 2) = u.z;
 
-        result(2, 0) = s.z;
-        result(2, 1) = u.z;
+        result(2, 0) = -f.x;
+        result(2, 1) = -f.y;
         result(2, 2) = -f.z;
 
         result(0, 3) = -s.x * position.x - s.y * position.y - s.z * position.z;
@@ -322,6 +335,52 @@ namespace Math
 
         return result;
     }
+
+    // Inverse from the cofactors, identity if the matrix is singular
+    template<typename T>
+    Mat4<T> Inverse(const Mat4<T>& m)
+    {
+        const T* a = m.data();
+        T inv[16];
+        inv[0] = a[5] * a[10] * a[15] - a[5] * a[11] * a[14] - a[9] * a[6] * a[15] + a[9] * a[7] * a[14] + a[13] * a[6] * a[11] - a[13] * a[7] * a[10];
+        inv[4] = -a[4] * a[10] * a[15] + a[4] * a[11] * a[14] + a[8] * a[6] * a[15] - a[8] * a[7] * a[14] - a[12] * a[6] * a[11] + a[12] * a[7] * a[10];
+        inv[8] = a[4] * a[9] * a[15] - a[4] * a[11] * a[13] - a[8] * a[5] * a[15] + a[8] * a[7] * a[13] + a[12] * a[5] * a[11] - a[12] * a[7] * a[9];
+        inv[12] = -a[4] * a[9] * a[14] + a[4] * a[10] * a[13] + a[8] * a[5] * a[14] - a[8] * a[6] * a[13] - a[12] * a[5] * a[10] + a[12] * a[6] * a[9];
+        inv[1] = -a[1] * a[10] * a[15] + a[1] * a[11] * a[14] + a[9] * a[2] * a[15] - a[9] * a[3] * a[14] - a[13] * a[2] * a[11] + a[13] * a[3] * a[10];
+        inv[5] = a[0] * a[10] * a[15] - a[0] * a[11] * a[14] - a[8] * a[2] * a[15] + a[8] * a[3] * a[14] + a[12] * a[2] * a[11] - a[12] * a[3] * a[10];
+        inv[9] = -a[0] * a[9] * a[15] + a[0] * a[11] * a[13] + a[8] * a[1] * a[15] - a[8] * a[3] * a[13] - a[12] * a[1] * a[11] + a[12] * a[3] * a[9];
+        inv[13] = a[0] * a[9] * a[14] - a[0] * a[10] * a[13] - a[8] * a[1] * a[14] + a[8] * a[2] * a[13] + a[12] * a[1] * a[10] - a[12] * a[2] * a[9];
+        inv[2] = a[1] * a[6] * a[15] - a[1] * a[7] * a[14] - a[5] * a[2] * a[15] + a[5] * a[3] * a[14] + a[13] * a[2] * a[7] - a[13] * a[3] * a[6];
+        inv[6] = -a[0] * a[6] * a[15] + a[0] * a[7] * a[14] + a[4] * a[2] * a[15] - a[4] * a[3] * a[14] - a[12] * a[2] * a[7] + a[12] * a[3] * a[6];
+        inv[10] = a[0] * a[5] * a[15] - a[0] * a[7] * a[13] - a[4] * a[1] * a[15] + a[4] * a[3] * a[13] + a[12] * a[1] * a[7] - a[12] * a[3] * a[5];
+        inv[14] = -a[0] * a[5] * a[14] + a[0] * a[6] * a[13] + a[4] * a[1] * a[14] - a[4] * a[2] * a[13] - a[12] * a[1] * a[6] + a[12] * a[2] * a[5];
+        inv[3] = -a[1] * a[6] * a[11] + a[1] * a[7] * a[10] + a[5] * a[2] * a[11] - a[5] * a[3] * a[10] - a[9] * a[2] * a[7] + a[9] * a[3] * a[6];
+        inv[7] = a[0] * a[6] * a[11] - a[0] * a[7] * a[10] - a[4] * a[2] * a[11] + a[4] * a[3] * a[10] + a[8] * a[2] * a[7] - a[8] * a[3] * a[6];
+        inv[11] = -a[0] * a[5] * a[11] + a[0] * a[7] * a[9] + a[4] * a[1] * a[11] - a[4] * a[3] * a[9] - a[8] * a[1] * a[7] + a[8] * a[3] * a[5];
+        inv[15] = a[0] * a[5] * a[10] - a[0] * a[6] * a[9] - a[4] * a[1] * a[10] + a[4] * a[2] * a[9] + a[8] * a[1] * a[6] - a[8] * a[2] * a[5];
+
+        const T determinant = a[0] * inv[0] + a[1] * inv[4] + a[2] * inv[8] + a[3] * inv[12];
+        if (determinant == 0)
+        {
+            return Mat4<T>::identity();
+        }
+
+        Mat4<T> result;
+        for (int i = 0; i < 16; ++i)
+            result(i % 4, i / 4) = inv[i] / determinant;
+        return result;
+    }
+
+    // Point transformed by a projective matrix, divided by w
+    template<typename T>
+    Point3d<T> TransformPoint(const Mat4<T>& m, const Point3d<T>& p)
+    {
+        const T x = m(0, 0) * p.x + m(0, 1) * p.y + m(0, 2) * p.z + m(0, 3);
+        const T y = m(1, 0) * p.x + m(1, 1) * p.y + m(1, 2) * p.z + m(1, 3);
+        const T z = m(2, 0) * p.x + m(2, 1) * p.y + m(2, 2) * p.z + m(2, 3);
+        const T w = m(3, 0) * p.x + m(3, 1) * p.y + m(3, 2) * p.z + m(3, 3);
+        return { x / w, y / w, z / w };
+    }
 }
 
-#endif MATHHELPER_H
\ No newline at end of file
+#endif // MATHHELPER_H
\ No newline at end of file
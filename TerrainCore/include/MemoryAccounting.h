@@ -0,0 +1,140 @@
+#ifndef MEMORY_ACCOUNTING_H
+#define MEMORY_ACCOUNTING_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Subsystems memory is accounted to
+enum class MemoryTag : uint8_t
+{
+    HEIGHTMAPS,
+    MESHES,
+    MATERIALS,
+    SHADING,
+    CACHES,
+    SCATTER,
+    WATER,
+    DETAIL,
+    VIRTUAL_TEXTURE,
+    SHADOWS,
+    COUNT
+};
+
+enum class MemoryDomain : uint8_t
+{
+    CPU,
+    GPU,    // GL buffers and textures, by their allocated size
+    COUNT
+};
+
+// Bytes per tag and domain at one moment
+struct MemoryUsage
+{
+    static constexpr int TAG_COUNT = static_cast<int>(MemoryTag::COUNT);
+    static constexpr int DOMAIN_COUNT = static_cast<int>(MemoryDomain::COUNT);
+
+    std::array<std::array<int64_t, DOMAIN_COUNT>, TAG_COUNT> bytes = {};
+
+    int64_t get(MemoryTag tag, MemoryDomain domain) const { return bytes[static_cast<int>(tag)][static_cast<int>(domain)]; }
+    int64_t total(MemoryDomain domain) const;
+};
+
+// Process-wide counters, updated by tagged allocators and charges from any thread
+namespace Memory
+{
+    const char* Name(MemoryTag tag);
+
+    void Add(MemoryTag tag, MemoryDomain domain, int64_t bytes);
+    int64_t Used(MemoryTag tag, MemoryDomain domain);
+    MemoryUsage Snapshot();
+}
+
+// Bytes of one owner under a tag, e.g. the GL objects of a renderer or the entries of a cache:
+// set() replaces its previous amount, destruction removes it
+class MemoryCharge
+{
+public:
+    explicit MemoryCharge(MemoryTag tag, MemoryDomain domain = MemoryDomain::CPU)
+        : m_tag(tag)
+        , m_domain(domain)
+    {}
+    ~MemoryCharge() { set(0); }
+
+    MemoryCharge(const MemoryCharge&) = delete;
+    MemoryCharge& operator=(const MemoryCharge&) = delete;
+
+    void set(size_t bytes)
+    {
+        Memory::Add(m_tag, m_domain, static_cast<int64_t>(bytes) - static_cast<int64_t>(m_bytes));
+        m_bytes = bytes;
+    }
+    void add(int64_t bytes) { set(static_cast<size_t>(static_cast<int64_t>(m_bytes) + bytes)); }
+    size_t bytes() const { return m_bytes; }
+
+private:
+    MemoryTag m_tag;
+    MemoryDomain m_domain;
+    size_t m_bytes = 0;
+};
+
+// std::allocator counting its live bytes under Tag
+template<typename T, MemoryTag Tag>
+struct TaggedAllocator
+{
+    using value_type = T;
+
+    template<typename U>
+    struct rebind
+    {
+        using other = TaggedAllocator<U, Tag>;
+    };
+
+    TaggedAllocator() noexcept = default;
+    template<typename U>
+    TaggedAllocator(const TaggedAllocator<U, Tag>&) noexcept {}
+
+    T* allocate(size_t count)
+    {
+        T* data = std::allocator<T>().allocate(count);
+        Memory::Add(Tag, MemoryDomain::CPU, static_cast<int64_t>(count * sizeof(T)));
+        return data;
+    }
+
+    void deallocate(T* data, size_t count) noexcept
+    {
+        Memory::Add(Tag, MemoryDomain::CPU, -static_cast<int64_t>(count * sizeof(T)));
+        std::allocator<T>().deallocate(data, count);
+    }
+
+    template<typename U>
+    bool operator==(const TaggedAllocator<U, Tag>&) const noexcept { return true; }
+};
+
+template<typename T, MemoryTag Tag>
+using TaggedVector = std::vector<T, TaggedAllocator<T, Tag>>;
+
+// Heap bytes of a value, for the caches charging their entries
+template<typename T, typename Allocator>
+size_t MemoryBytes(const std::vector<T, Allocator>& values)
+{
+    return values.capacity() * sizeof(T);
+}
+
+// Budgets per tag and domain, 0 for none. Owners read theirs to evict cached data or coarsen what they draw.
+class MemoryBudgets
+{
+public:
+    size_t get(MemoryTag tag, MemoryDomain domain) const { return m_bytes[static_cast<int>(tag)][static_cast<int>(domain)]; }
+    void set(MemoryTag tag, MemoryDomain domain, size_t bytes) { m_bytes[static_cast<int>(tag)][static_cast<int>(domain)] = bytes; }
+
+    // Bytes of the tag above its budget, 0 within it
+    size_t excess(MemoryTag tag, MemoryDomain domain, const MemoryUsage& usage) const;
+
+private:
+    std::array<std::array<size_t, MemoryUsage::DOMAIN_COUNT>, MemoryUsage::TAG_COUNT> m_bytes = {};
+};
+
+#endif // MEMORY_ACCOUNTING_H
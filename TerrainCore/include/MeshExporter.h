@@ -0,0 +1,74 @@
+#ifndef MESH_EXPORTER_H
+#define MESH_EXPORTER_H
+
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+
+#include "MathHelper.h"
+#include "Preset.h"
+#include "TerrainSimplifier.h"
+
+enum class ExportFormat
+{
+    OBJ,
+    GLB,
+    RAW
+};
+
+// Fill rows [firstRow, firstRow + rowCount) of the heightmap, width samples per row.
+// Rows are requested in increasing order, a few at a time, so the terrain never has to be resident.
+// heights holds exactly rowCount * width samples.
+using HeightRowSource = std::function<void(int firstRow, int rowCount, std::span<float> heights)>;
+
+struct ExportSettings
+{
+    ExportFormat format = ExportFormat::GLB;
+    std::string path;
+
+    // Heightmap samples
+    int width = 0;
+    int height = 0;
+
+    // World placement, same convention as the viewer terrain
+    Point2d<float> origin = { -1.f, -1.f };
+    float step = 1.f;
+    float heightScale = 1.f;
+
+    // Rows generated per chunk, and size of the file write buffer
+    int chunkRows = 64;
+    size_t bufferSize = 4 << 20;
+};
+
+struct ExportStats
+{
+    uint64_t bytesWritten = 0;
+    double seconds = 0.0;
+    int fileCount = 0;
+
+    double megabytesPerSecond() const { return seconds > 0.0 ? bytesWritten / (1024.0 * 1024.0) / seconds : 0.0; }
+};
+
+// Streaming exporters: memory stays bounded by a few chunks of rows whatever the terrain size.
+//
+// OBJ: text positions, normals, uvs and faces, emitted chunk by chunk.
+// GLB: glTF 2.0 binary with interleaved position/normal/uv and uint32 indices. A file is limited to 4 GiB,
+//      so large terrains are split into tiles "name_x_y.glb" (sharing their border samples).
+// RAW: "TRRN" header followed by, per sample, a float32 height and an octahedral int16x2 normal.
+//      Positions and uvs follow from the header, triangles are the implicit grid.
+namespace MeshExport
+{
+    ExportFormat FormatFromPath(const std::string& path);
+
+    bool ExportGrid(const ExportSettings& settings, const HeightRowSource& source, ExportStats* stats = nullptr);
+
+    // Export an in-memory mesh (e.g. a simplified terrain), OBJ or GLB only
+    bool ExportMesh(const TerrainMesh& mesh, ExportFormat format, const std::string& path, ExportStats* stats = nullptr);
+
+    // Command line: --export FILE [--export-size N] [--seed S] [--scale F], overriding the preset (size defaults to 1024)
+    bool ParseArguments(int argc, char** argv, ExportSettings& settings, TerrainPreset& preset);
+    int Run(const ExportSettings& settings, const GenerationSettings& generation);
+}
+
+#endif // MESH_EXPORTER_H
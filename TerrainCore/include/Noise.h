@@ -0,0 +1,64 @@
+#ifndef NOISE_H
+#define NOISE_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+
+enum class NoiseType
+{
+    PERLIN,         // Gradient noise with a quintic fade
+    OPENSIMPLEX2,
+    VALUE,
+    WORLEY_F1,      // Distance to the closest feature point
+    WORLEY_F2,      // Distance to the second closest feature point
+    COUNT
+};
+
+// 2D coherent noise with a unit lattice. Gradient and value engines return about [-1, 1],
+// Worley engines a distance in lattice units (about [0, 1.2]).
+// Every engine has a scalar and a 4-wide SIMD path computed by the same code, so both give the same values.
+//
+// Positions are a 64-bit lattice cell plus a float offset: noise(cellX + x, cellY + y). The cell part is folded
+// into the hashes once per call, so the float math of the hot loop stays precise anywhere in a very large world
+// as long as the offsets stay small.
+class NoiseEngine
+{
+public:
+    virtual ~NoiseEngine() = default;
+
+    NoiseType getType() const { return m_type; }
+    int getSeed() const { return m_seed; }
+
+    virtual float sample(int64_t cellX, int64_t cellY, float x, float y) const = 0;
+    float sample(float x, float y) const { return sample(0, 0, x, y); }
+
+    // out[i] = sample(x[i], y[i])
+    virtual void sampleBatch(const float* x, const float* y, int count, float* out) const = 0;
+
+    // out[i] = sample(cellX, cellY, x0 + (first + i) * dx, y), e.g. a heightmap row.
+    // A row split in several calls with first offsets gives exactly the same values as a single call.
+    virtual void sampleRow(int64_t cellX, int64_t cellY, float x0, float dx, float y, int count, float* out, int first = 0) const = 0;
+    void sampleRow(float x0, float dx, float y, int count, float* out) const { sampleRow(0, 0, x0, dx, y, count, out); }
+
+protected:
+    NoiseEngine(NoiseType type, int seed)
+        : m_type(type)
+        , m_seed(seed)
+    {}
+
+    NoiseType m_type;
+    int m_seed;
+};
+
+namespace Noise
+{
+    const char* Name(NoiseType type);
+
+    std::unique_ptr<NoiseEngine> CreateEngine(NoiseType type, int seed);
+
+    // Time every engine, scalar and batched, and print the cost in ns/sample
+    void Benchmark(std::ostream& out, int sampleCount = 1 << 22);
+}
+
+#endif // NOISE_H
@@ -0,0 +1,24 @@
+#ifndef OUTPUT_SPAN_H
+#define OUTPUT_SPAN_H
+
+#include <cstddef>
+#include <iostream>
+#include <span>
+
+// Outputs of the public API are written to caller-provided spans, so callers choose where the memory comes from
+// and can reuse it between calls
+namespace OutputSpan
+{
+    // False, with a message, if the buffer holds fewer than count elements
+    template<typename T>
+    bool Fits(std::span<T> buffer, size_t count, const char* function)
+    {
+        if (buffer.size() >= count)
+            return true;
+
+        std::cerr << function << ": output holds " << buffer.size() << " elements, " << count << " needed." << std::endl;
+        return false;
+    }
+}
+
+#endif // OUTPUT_SPAN_H
@@ -0,0 +1,68 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <type_traits>
+
+#include "JobSystem.h"
+
+namespace Parallel
+{
+    // Upper bound on the threads used by For, 0 for all hardware threads (e.g. several worker processes on one machine)
+    inline std::atomic<int>& ThreadLimit()
+    {
+        static std::atomic<int> limit = 0;
+        return limit;
+    }
+
+    inline int ThreadCount()
+    {
+        const int hardware = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+        const int limit = ThreadLimit().load(std::memory_order_relaxed);
+        return limit > 0 ? std::min(hardware, limit) : hardware;
+    }
+
+    // Call fn(i) for every i in [begin, end), items are distributed dynamically over the job system threads.
+    // The calling thread takes part, and executes other jobs while the last items finish elsewhere.
+    template<typename Fn>
+    void For(int begin, int end, Fn&& fn)
+    {
+        const int count = end - begin;
+        if (count <= 0)
+            return;
+
+        const int threadCount = std::min(ThreadCount(), count);
+        if (threadCount == 1)
+        {
+            for (int i = begin; i < end; ++i)
+                fn(i);
+            return;
+        }
+
+        struct Shared
+        {
+            std::atomic<int> next;
+            int end;
+            std::remove_reference_t<Fn>* fn;
+        } shared = { begin, end, &fn };
+
+        // Captures a single reference, so that the job does not allocate
+        auto worker = [&shared]()
+        {
+            for (int i = shared.next++; i < shared.end; i = shared.next++)
+                (*shared.fn)(i);
+        };
+
+        JobSystem& jobs = JobSystem::Instance();
+        JobFence fence;
+        for (int t = 1; t < threadCount; ++t)
+            jobs.run(worker, &fence, nullptr, "Parallel::For");
+
+        worker();
+        jobs.wait(fence);
+    }
+}
+
+#endif // PARALLEL_H
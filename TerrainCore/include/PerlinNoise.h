@@ -12,6 +12,7 @@ vector2 randomGradient(int ix, int iy, int seed);
 float dotGridGradient(int ix, int iy, float x, float y, int seed);
 float interpolate(float a0, float a1, float w);
 float perlin(float x, float y, int seed);
-std::vector<std::vector<float>> generatePerlinNoise(int width, int height, int seed);
+// Noise at (x, y) * frequency for every sample of a width x height grid
+std::vector<std::vector<float>> generatePerlinNoise(int width, int height, int seed, float frequency = 0.1f);
 
 #endif // PERLIN_NOISE_H
\ No newline at end of file
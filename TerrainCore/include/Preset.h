@@ -0,0 +1,63 @@
+#ifndef PRESET_H
+#define PRESET_H
+
+#include <algorithm>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "BiomeClassifier.h"
+#include "TileGeneration.h"
+
+// Complete description of a generated terrain: two runs of the same preset give the same terrain
+struct TerrainPreset
+{
+    int seed = 0;
+
+    // size x size samples over extent x extent world units
+    int size = 100;
+    float extent = 16.f;
+    float heightScale = 1.f;
+    WorldOrigin origin;
+
+    std::vector<NoiseStage> noise = { NoiseStage() };
+    ErosionSettings erosion;
+
+    // Only the thresholds and climate frequency are authored, placement follows the fields above
+    BiomeSettings biomes;
+
+    // Adaptive mesh, 0 = full resolution
+    float maxError = 0.f;
+
+    float step() const { return extent / (std::max(2, size) - 1); }
+
+    GenerationSettings generation() const;
+};
+
+// Text preset files, "key = value" lines grouped in [sections], '#' starts a comment:
+//
+//   seed = 42
+//   size = 256
+//   [noise]              one section per stage, summed in order
+//   type = perlin
+//   frequency = 1
+//   amplitude = 1
+//   [erosion]
+//   iterations = 16
+//   [biomes]
+//   snow_height = 0.45
+//
+// Missing keys keep their default value.
+namespace Preset
+{
+    bool Read(std::istream& stream, TerrainPreset& preset, const std::string& name = "preset");
+    void Write(std::ostream& stream, const TerrainPreset& preset);
+
+    bool Load(const std::string& filePath, TerrainPreset& preset);
+    bool Save(const std::string& filePath, const TerrainPreset& preset);
+
+    // Command line: --preset FILE. Return false if the file cannot be loaded.
+    bool ParseArguments(int argc, char** argv, TerrainPreset& preset);
+}
+
+#endif // PRESET_H
@@ -0,0 +1,138 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "MathHelper.h"
+#include "WorldOrigin.h"
+
+// Camera pose displayed by a frame, and the input sampled for it
+struct ReplayFrame
+{
+    WorldOrigin origin;
+    Point3d<float> position;
+    float yaw = 0.f;
+    float pitch = 0.f;
+
+    uint8_t movement = 0;   // Held movement keys, bit i for CameraMovement i
+    float mouseX = 0.f;
+    float mouseY = 0.f;
+};
+
+// Viewer parameter set before a frame is drawn. Values are text, a preset is its whole file.
+struct ReplayEvent
+{
+    int frame = 0;
+    std::string key;
+    std::string value;
+};
+
+// Viewer parameters by key, compared between frames to record the changes
+using ReplayParameters = std::map<std::string, std::string>;
+
+struct Recording
+{
+    // Simulated seconds per replayed frame, whatever the frame rate of the recording
+    double timestep = 1.0 / 60.0;
+
+    std::vector<ReplayFrame> frames;
+    std::vector<ReplayEvent> events;    // By frame, every parameter is set on frame 0
+};
+
+// Per replayed frame, times in milliseconds
+struct FrameMetrics
+{
+    int frame = 0;
+    double cpuTime = 0.0;
+    double gpuTime = -1.0;  // Negative when the GPU timer is not available
+    int drawCalls = 0;
+    uint64_t triangles = 0;
+    uint64_t uploadBytes = 0;
+    int stateChanges = 0;   // GL bindings issued
+};
+
+struct ReplaySummary
+{
+    int frames = 0;
+    double meanCpuTime = 0.0;
+    double p95CpuTime = 0.0;
+    double maxCpuTime = 0.0;
+    double meanGpuTime = -1.0;
+    double p95GpuTime = -1.0;
+    double meanDrawCalls = 0.0;
+    double meanTriangles = 0.0;
+    double meanStateChanges = 0.0;
+    uint64_t uploadBytes = 0;
+};
+
+struct ReplaySettings
+{
+    std::string recordPath;     // Record the session into this file
+    std::string replayPath;     // Replay this recording, then exit
+    std::string metricsPath;    // Metrics of the replay, JSON for a .json path, CSV otherwise
+    double timestep = 1.0 / 60.0;
+};
+
+// Records the frames of a session, the parameters changed since the previous frame becoming events
+class ReplayRecorder
+{
+public:
+    explicit ReplayRecorder(double timestep = 1.0 / 60.0);
+
+    void addFrame(const ReplayFrame& frame, const ReplayParameters& parameters);
+
+    const Recording& getRecording() const { return m_recording; }
+
+private:
+    Recording m_recording;
+    ReplayParameters m_parameters;
+};
+
+// Text recordings, one line per frame and per event, in frame order:
+//
+//   timestep 0.016666668
+//   set 0 shadows 1
+//   set 0 preset {       multi-line values until a "}" line
+//   seed = 42
+//   }
+//   frame 0 <origin x y z> <position x y z> <yaw> <pitch> <movement> <mouse x> <mouse y>
+//
+// Floats are written with the fewest digits reading back the same value, a replay sees the recorded poses exactly.
+namespace Replay
+{
+    // Malformed lines and non-numeric values of numeric parameters are reported as name:line
+    bool Read(std::istream& stream, Recording& recording, const std::string& name = "recording");
+    void Write(std::ostream& stream, const Recording& recording);
+
+    bool Load(const std::string& filePath, Recording& recording);
+    bool Save(const std::string& filePath, const Recording& recording);
+
+    // Whole text as a finite float, false for anything else
+    bool ParseNumber(std::string_view text, float& value);
+
+    // Parameters whose value the viewer reads as a number (sun angles)
+    bool IsNumericParameter(const std::string& key);
+
+    // Events set before the frame is drawn
+    std::span<const ReplayEvent> Events(const Recording& recording, int frame);
+
+    ReplaySummary Summarize(std::span<const FrameMetrics> metrics);
+
+    void WriteCsv(std::ostream& stream, std::span<const FrameMetrics> metrics);
+    void WriteJson(std::ostream& stream, std::span<const FrameMetrics> metrics);
+
+    // JSON for a .json path, CSV otherwise
+    bool SaveMetrics(const std::string& filePath, std::span<const FrameMetrics> metrics);
+
+    // Command line: --record FILE [--record-step SECONDS], or --replay FILE [--replay-out METRICS].
+    // Return true if either mode is requested.
+    bool ParseArguments(int argc, char** argv, ReplaySettings& settings);
+}
+
+#endif // REPLAY_H
@@ -0,0 +1,60 @@
+#ifndef SCATTER_H
+#define SCATTER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Heightfield.h"
+
+// Placement rule of one kind of instance
+struct ScatterRule
+{
+    // Minimum distance between two instances, in world units
+    float radius = 0.1f;
+
+    // Accepted range of unscaled heights and of slopes (rise over run)
+    float minHeight = 0.f;
+    float maxHeight = 1.f;
+    float minSlope = 0.f;
+    float maxSlope = 1.f;
+
+    // Probability to keep a valid Poisson sample
+    float density = 1.f;
+
+    // Uniform instance scale range
+    float minScale = 1.f;
+    float maxScale = 1.f;
+};
+
+// Per-instance data, uploaded as is in the instance buffers
+struct ScatterInstance
+{
+    float x, y, z;
+    float scale;
+    float rotation;
+};
+
+// Deterministic Poisson-disk scattering over an infinite grid of cells.
+// Every cell of size radius / sqrt(2) holds a hashed candidate per round; a candidate is kept when no point of
+// a previous round and no better ranked candidate of its round are closer than radius. The outcome of a cell only
+// depends on the cells around it, so any chunk can be generated alone, in any order, on any thread, and always
+// gives the same instances, without seams with its neighbours.
+class ScatterGenerator
+{
+public:
+    static constexpr int ROUNDS = 3;
+
+    ScatterGenerator(uint32_t seed = 0, uint32_t layer = 0, const ScatterRule& rule = {});
+
+    const ScatterRule& getRule() const { return m_rule; }
+
+    // Instances whose position is inside [x0, x0 + size) x [z0, z0 + size)
+    void generate(const HeightfieldView& heightfield, float x0, float z0, float size, std::vector<ScatterInstance>& instances) const;
+
+private:
+    uint32_t m_seed;
+    uint32_t m_layer;
+    ScatterRule m_rule;
+};
+
+#endif // SCATTER_H
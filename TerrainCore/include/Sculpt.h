@@ -0,0 +1,127 @@
+#ifndef SCULPT_H
+#define SCULPT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+#include "Heightfield.h"
+#include "MathHelper.h"
+#include "MemoryAccounting.h"
+
+enum class BrushMode
+{
+    RAISE,
+    LOWER,
+    SMOOTH,     // Towards the mean of the 3x3 neighbors
+    COUNT
+};
+
+// Round brush over the samples of a heightmap: full strength within hardness * radius, then a smooth falloff
+struct Brush
+{
+    BrushMode mode = BrushMode::RAISE;
+    float radius = 12.f;        // Samples
+    float strength = 0.01f;     // Heightmap units at the center for raise and lower, fraction of the way to the mean for smooth
+    float hardness = 0.3f;
+};
+
+// Samples [x, x + width) x [y, y + height) of a heightmap
+struct HeightRect
+{
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+
+    bool empty() const { return width <= 0 || height <= 0; }
+
+    // Bounding rectangle of both, empty ones are ignored
+    HeightRect merged(const HeightRect& other) const;
+};
+
+namespace Sculpt
+{
+    const char* Name(BrushMode mode);
+
+    // Samples a dab centered on sample (x, y) of a size x size heightmap can change
+    HeightRect Bounds(int size, const Brush& brush, float x, float y);
+
+    // Apply one dab, 4 samples at a time and rows in parallel. Returns the samples it changed.
+    HeightRect Apply(float* heights, int size, const Brush& brush, float x, float y);
+
+    // First point of the ray origin + t * direction (t in [0, maxDistance], frame of the heightfield) under the
+    // surface, refined by bisection. False if it stays above.
+    bool Raycast(const HeightfieldView& heightfield, const Point3d<float>& origin, const Point3d<float>& direction,
+                 float maxDistance, Point3d<float>& hit);
+}
+
+// Undo steps of sculpting as compact deltas. A stroke keeps the tiles it touches as they were before it; when it ends
+// only the XOR of their bits with the new heights is kept, split in byte planes and deflated. Untouched samples XOR to
+// zero and cost almost nothing, and XOR is its own inverse: the same delta undoes and redoes the stroke exactly.
+class SculptHistory
+{
+public:
+    static constexpr int TILE_SIZE = 32;
+
+    // maxBytes: deltas kept, the oldest steps are dropped beyond it
+    explicit SculptHistory(size_t maxBytes = size_t(64) << 20);
+
+    SculptHistory(const SculptHistory&) = delete;
+    SculptHistory& operator=(const SculptHistory&) = delete;
+
+    // New size x size heightmap: every step is dropped
+    void reset(int size);
+
+    // Before a dab changes rect: its tiles keep their heights from before the stroke
+    void touch(const float* heights, const HeightRect& rect);
+
+    // The stroke becomes one undo step, returns the samples it changed (empty if none)
+    HeightRect endStroke(const float* heights);
+
+    bool canUndo() const { return !m_undo.empty(); }
+    bool canRedo() const { return !m_redo.empty(); }
+
+    // Revert or replay a step on the heights it was recorded on, returns the samples it changed
+    HeightRect undo(float* heights);
+    HeightRect redo(float* heights);
+
+    int getStepCount() const { return static_cast<int>(m_undo.size() + m_redo.size()); }
+    size_t getBytes() const { return m_bytes; }
+
+private:
+    struct TileDelta
+    {
+        int tile = 0;
+        std::vector<uint8_t> data;
+    };
+
+    struct Step
+    {
+        HeightRect rect;
+        std::vector<TileDelta> tiles;
+        size_t bytes = 0;
+    };
+
+    int m_size = 0;
+    int m_tiles = 0; // Per side
+    size_t m_maxBytes;
+    size_t m_bytes = 0;
+
+    // Bits of the tiles touched by the current stroke, before it
+    std::unordered_map<int, std::vector<uint32_t>> m_stroke;
+
+    std::deque<Step> m_undo;
+    std::vector<Step> m_redo;
+
+    // Deltas and stroke tiles
+    MemoryCharge m_memory{ MemoryTag::HEIGHTMAPS };
+
+    HeightRect tileRect(int tile) const;
+    HeightRect apply(const Step& step, float* heights) const;
+    void updateMemory();
+};
+
+#endif // SCULPT_H
@@ -0,0 +1,20 @@
+#ifndef SESSION_CACHE_H
+#define SESSION_CACHE_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+// Heights of the last session on disk, so that a restart does not generate them again.
+// The file is keyed by GenerationGraph::heightsKey() and stores lossless HeightCodec tiles: restored heights are
+// bit-identical to generated ones. A file written by another version of the generation is ignored.
+namespace SessionCache
+{
+    bool Save(const std::string& path, uint64_t heightsKey, int size, std::span<const float> heights);
+
+    // False if the file is missing, corrupt, or holds other heights (key or size)
+    bool Load(const std::string& path, uint64_t heightsKey, int size, std::vector<float>& heights);
+}
+
+#endif // SESSION_CACHE_H
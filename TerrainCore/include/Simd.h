@@ -0,0 +1,225 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TERRAIN_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Minimal 4-wide float and uint32 vectors: SSE2 when available, plain scalar code otherwise.
+// Comparisons return lane masks (all bits set or cleared) to be used with Select.
+namespace Simd
+{
+#ifdef TERRAIN_SIMD_SSE2
+    struct Float4
+    {
+        __m128 v;
+
+        Float4() : v(_mm_setzero_ps()) {}
+        Float4(__m128 v_) : v(v_) {}
+        Float4(float s) : v(_mm_set1_ps(s)) {}
+
+        static Float4 Load(const float* p) { return _mm_loadu_ps(p); }
+        void store(float* p) const { _mm_storeu_ps(p, v); }
+    };
+
+    inline Float4 operator+(const Float4& a, const Float4& b) { return _mm_add_ps(a.v, b.v); }
+    inline Float4 operator-(const Float4& a, const Float4& b) { return _mm_sub_ps(a.v, b.v); }
+    inline Float4 operator*(const Float4& a, const Float4& b) { return _mm_mul_ps(a.v, b.v); }
+    inline Float4 Min(const Float4& a, const Float4& b) { return _mm_min_ps(a.v, b.v); }
+    inline Float4 Max(const Float4& a, const Float4& b) { return _mm_max_ps(a.v, b.v); }
+    inline Float4 Sqrt(const Float4& a) { return _mm_sqrt_ps(a.v); }
+    inline Float4 operator<(const Float4& a, const Float4& b) { return _mm_cmplt_ps(a.v, b.v); }
+    inline Float4 operator>(const Float4& a, const Float4& b) { return _mm_cmpgt_ps(a.v, b.v); }
+    inline Float4 Select(const Float4& mask, const Float4& a, const Float4& b) { return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)); }
+
+    struct Int4
+    {
+        __m128i v;
+
+        Int4() : v(_mm_setzero_si128()) {}
+        Int4(__m128i v_) : v(v_) {}
+        Int4(uint32_t s) : v(_mm_set1_epi32(static_cast<int>(s))) {}
+
+        static Int4 Load(const uint32_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+        void store(uint32_t* p) const { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    };
+
+    inline Int4 operator+(const Int4& a, const Int4& b) { return _mm_add_epi32(a.v, b.v); }
+    inline Int4 operator-(const Int4& a, const Int4& b) { return _mm_sub_epi32(a.v, b.v); }
+    inline Int4 operator^(const Int4& a, const Int4& b) { return _mm_xor_si128(a.v, b.v); }
+    inline Int4 operator&(const Int4& a, const Int4& b) { return _mm_and_si128(a.v, b.v); }
+    inline Int4 operator|(const Int4& a, const Int4& b) { return _mm_or_si128(a.v, b.v); }
+    inline Int4 operator>>(const Int4& a, int n) { return _mm_srli_epi32(a.v, n); } // Logical
+    inline Int4 operator<<(const Int4& a, int n) { return _mm_slli_epi32(a.v, n); }
+
+    // Low 32 bits of the products, SSE2 only multiplies lanes 0 and 2
+    inline Int4 operator*(const Int4& a, const Int4& b)
+    {
+        const __m128i even = _mm_mul_epu32(a.v, b.v);
+        const __m128i odd = _mm_mul_epu32(_mm_srli_si128(a.v, 4), _mm_srli_si128(b.v, 4));
+        return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+    }
+
+    // Float lanes holding integral values to two's complement integers, and back
+    inline Int4 ToInt(const Float4& a) { return _mm_cvttps_epi32(a.v); }
+    inline Float4 ToFloat(const Int4& a) { return _mm_cvtepi32_ps(a.v); }
+
+    inline Float4 Floor(const Float4& a)
+    {
+        const __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+        return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, a.v), _mm_set1_ps(1.f)));
+    }
+
+    inline Int4 Select(const Float4& mask, const Int4& a, const Int4& b)
+    {
+        const __m128i m = _mm_castps_si128(mask.v);
+        return _mm_or_si128(_mm_and_si128(m, a.v), _mm_andnot_si128(m, b.v));
+    }
+
+    // 4 uint16 widened to uint32 lanes
+    inline Int4 LoadU16(const void* p) { return _mm_unpacklo_epi16(_mm_loadl_epi64(static_cast<const __m128i*>(p)), _mm_setzero_si128()); }
+
+    // Same bits, other type
+    inline Float4 AsFloat(const Int4& a) { return _mm_castsi128_ps(a.v); }
+    inline Int4 AsInt(const Float4& a) { return _mm_castps_si128(a.v); }
+
+    // Flip the sign of the lanes whose bit 31 is set in bits
+    inline Float4 FlipSign(const Float4& a, const Int4& bits) { return _mm_xor_ps(a.v, _mm_castsi128_ps(_mm_and_si128(bits.v, _mm_set1_epi32(INT32_MIN)))); }
+
+    // Write 4 RGBA8 pixels from 4 channel vectors in [0, 1]
+    inline void StoreUnormRgba8(Float4 r, Float4 g, Float4 b, Float4 a, uint8_t* out)
+    {
+        _MM_TRANSPOSE4_PS(r.v, g.v, b.v, a.v);
+        const __m128 s = _mm_set1_ps(255.f);
+        const __m128i p01 = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(r.v, s)), _mm_cvtps_epi32(_mm_mul_ps(g.v, s)));
+        const __m128i p23 = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(b.v, s)), _mm_cvtps_epi32(_mm_mul_ps(a.v, s)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(p01, p23));
+    }
+#else
+    struct Float4
+    {
+        float v[4];
+
+        Float4() : v{ 0.f, 0.f, 0.f, 0.f } {}
+        Float4(float s) : v{ s, s, s, s } {}
+
+        static Float4 Load(const float* p) { Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = p[i]; return r; }
+        void store(float* p) const { for (int i = 0; i < 4; ++i) p[i] = v[i]; }
+    };
+
+    inline Float4 operator+(const Float4& a, const Float4& b) { Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] + b.v[i]; return r; }
+    inline Float4 operator-(const Float4& a, const Float4& b) { Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] - b.v[i]; return r; }
+    inline Float4 operator*(const Float4& a, const Float4& b) { Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] * b.v[i]; return r; }
+    inline Float4 Min(const Float4& a, const Float4& b) { Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return r; }
+    inline Float4 Max(const Float4& a, const Float4& b) { Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return r; }
+    inline Float4 Sqrt(const Float4& a) { Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = std::sqrt(a.v[i]); return r; }
+
+    inline Float4 MaskFromBool(const bool (&m)[4])
+    {
+        Float4 r;
+        for (int i = 0; i < 4; ++i)
+        {
+            const uint32_t bits = m[i] ? ~0u : 0u;
+            std::memcpy(&r.v[i], &bits, sizeof(bits));
+        }
+        return r;
+    }
+    inline Float4 operator<(const Float4& a, const Float4& b) { bool m[4]; for (int i = 0; i < 4; ++i) m[i] = a.v[i] < b.v[i]; return MaskFromBool(m); }
+    inline Float4 operator>(const Float4& a, const Float4& b) { return b < a; }
+    inline Float4 Select(const Float4& mask, const Float4& a, const Float4& b)
+    {
+        Float4 r;
+        for (int i = 0; i < 4; ++i)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &mask.v[i], sizeof(bits));
+            r.v[i] = bits ? a.v[i] : b.v[i];
+        }
+        return r;
+    }
+
+    struct Int4
+    {
+        uint32_t v[4];
+
+        Int4() : v{ 0, 0, 0, 0 } {}
+        Int4(uint32_t s) : v{ s, s, s, s } {}
+
+        static Int4 Load(const uint32_t* p) { Int4 r; for (int i = 0; i < 4; ++i) r.v[i] = p[i]; return r; }
+        void store(uint32_t* p) const { for (int i = 0; i < 4; ++i) p[i] = v[i]; }
+    };
+
+    inline Int4 operator+(const Int4& a, const Int4& b) { Int4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] + b.v[i]; return r; }
+    inline Int4 operator-(const Int4& a, const Int4& b) { Int4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] - b.v[i]; return r; }
+    inline Int4 operator*(const Int4& a, const Int4& b) { Int4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] * b.v[i]; return r; }
+    inline Int4 operator^(const Int4& a, const Int4& b) { Int4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] ^ b.v[i]; return r; }
+    inline Int4 operator&(const Int4& a, const Int4& b) { Int4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] & b.v[i]; return r; }
+    inline Int4 operator|(const Int4& a, const Int4& b) { Int4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] | b.v[i]; return r; }
+    inline Int4 operator>>(const Int4& a, int n) { Int4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] >> n; return r; }
+    inline Int4 operator<<(const Int4& a, int n) { Int4 r; for (int i = 0; i < 4; ++i) r.v[i] = a.v[i] << n; return r; }
+
+    inline Int4 ToInt(const Float4& a) { Int4 r; for (int i = 0; i < 4; ++i) r.v[i] = static_cast<uint32_t>(static_cast<int32_t>(a.v[i])); return r; }
+    inline Float4 ToFloat(const Int4& a) { Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = static_cast<float>(static_cast<int32_t>(a.v[i])); return r; }
+    inline Float4 Floor(const Float4& a) { Float4 r; for (int i = 0; i < 4; ++i) r.v[i] = std::floor(a.v[i]); return r; }
+
+    inline Int4 LoadU16(const void* p) { uint16_t u[4]; std::memcpy(u, p, sizeof(u)); Int4 r; for (int i = 0; i < 4; ++i) r.v[i] = u[i]; return r; }
+    inline Float4 AsFloat(const Int4& a) { Float4 r; std::memcpy(r.v, a.v, sizeof(r.v)); return r; }
+    inline Int4 AsInt(const Float4& a) { Int4 r; std::memcpy(r.v, a.v, sizeof(r.v)); return r; }
+
+    inline Int4 Select(const Float4& mask, const Int4& a, const Int4& b)
+    {
+        Int4 r;
+        for (int i = 0; i < 4; ++i)
+        {
+            uint32_t bits;
+            std::memcpy(&bits, &mask.v[i], sizeof(bits));
+            r.v[i] = bits ? a.v[i] : b.v[i];
+        }
+        return r;
+    }
+
+    inline Float4 FlipSign(const Float4& a, const Int4& bits)
+    {
+        Float4 r;
+        for (int i = 0; i < 4; ++i)
+        {
+            uint32_t value;
+            std::memcpy(&value, &a.v[i], sizeof(value));
+            value ^= bits.v[i] & 0x80000000u;
+            std::memcpy(&r.v[i], &value, sizeof(value));
+        }
+        return r;
+    }
+
+    inline void StoreUnormRgba8(Float4 r, Float4 g, Float4 b, Float4 a, uint8_t* out)
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            out[i * 4 + 0] = static_cast<uint8_t>(r.v[i] * 255.f + 0.5f);
+            out[i * 4 + 1] = static_cast<uint8_t>(g.v[i] * 255.f + 0.5f);
+            out[i * 4 + 2] = static_cast<uint8_t>(b.v[i] * 255.f + 0.5f);
+            out[i * 4 + 3] = static_cast<uint8_t>(a.v[i] * 255.f + 0.5f);
+        }
+    }
+#endif
+
+    inline Float4 Saturate(const Float4& a) { return Min(Float4(1.f), Max(Float4(0.f), a)); }
+
+    // table[index] per lane, there is no gather instruction before AVX2
+    inline Float4 Gather(const float* table, const Int4& index)
+    {
+        alignas(16) uint32_t i[4];
+        alignas(16) float r[4];
+        index.store(i);
+        for (int lane = 0; lane < 4; ++lane)
+            r[lane] = table[i[lane]];
+        return Float4::Load(r);
+    }
+}
+
+#endif // SIMD_H
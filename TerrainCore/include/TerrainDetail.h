@@ -0,0 +1,104 @@
+#ifndef TERRAIN_DETAIL_H
+#define TERRAIN_DETAIL_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "Heightfield.h"
+#include "MathHelper.h"
+#include "MemoryAccounting.h"
+
+struct DetailSettings
+{
+    int chunkCells = 16;        // Base cells per patch side
+    int maxRefinement = 8;      // Sub-cells per base cell side in the closest patches, a power of two
+    float cellPixels = 8.f;     // Chunks are refined until their sub-cells cover at most about this many pixels
+    int maxPatches = 24;        // Refined chunks at most, the closest ones
+    float amplitude = 0.3f;     // Height of the first detail octave, in base cells
+    float fadeCells = 4.f;      // The detail fades in over this many base cells from unrefined chunks
+    size_t maxBytes = 0;        // Mesh bytes of the refined chunks, 0 for no limit: the farthest are coarsened to fit
+    int seed = 0;
+};
+
+// Refinement of a chunk and of its neighbors: everything its patch depends on besides the heights
+struct DetailPatch
+{
+    int chunkX = 0;
+    int chunkY = 0;
+    float distance = 0.f;       // From the camera to the chunk bounds
+
+    // Sub-cells per base cell side of the 3x3 chunks around, row-major with the patch itself at 4.
+    // 1 for an unrefined chunk, 0 outside the map.
+    std::array<uint8_t, 9> neighborhood = {};
+
+    int refinement() const { return neighborhood[4]; }
+
+    // Equal keys build equal patches over the same heights
+    uint64_t key() const;
+};
+
+struct DetailMesh
+{
+    TaggedVector<float, MemoryTag::DETAIL> vertices;    // Per vertex: x, y, z, then the detail slope along x and z
+    TaggedVector<uint32_t, MemoryTag::DETAIL> indices;
+
+    static constexpr int VERTEX_FLOATS = 5;
+};
+
+// Chunks of the heightfield refined around the camera. A refined chunk is drawn by a patch of chunkCells * refinement
+// sub-cells per side whose heights add detail octaves, finer than the base samples, to the bilinear base heights:
+// the detail near the viewer grows with the screen size of the chunks, not with the size of the world.
+class DetailLevels
+{
+public:
+    explicit DetailLevels(const DetailSettings& settings = {});
+
+    const DetailSettings& getSettings() const { return m_settings; }
+    void setSettings(const DetailSettings& settings);
+
+    // New heights: their bounds per chunk are computed again
+    void setHeightfield(const HeightfieldView& heightfield);
+    const HeightfieldView& getHeightfield() const { return m_heightfield; }
+
+    // Same heights with the samples [x, x + width) x [y, y + height) edited, e.g. by a brush: only the bounds of the
+    // chunks over them are computed again
+    void updateRegion(const HeightfieldView& heightfield, int x, int y, int width, int height);
+
+    // Refine the chunks for a camera at camera, in the frame of the heightfield. pixelScale is the size in pixels of
+    // a unit at unit distance, viewport height / (2 tan(fov / 2)).
+    void update(const Point3d<float>& camera, float pixelScale);
+
+    int getChunksPerSide() const { return m_chunksPerSide; }
+    int getRefinement(int chunkX, int chunkY) const;
+
+    // Refined chunks, closest first
+    const std::vector<DetailPatch>& getPatches() const { return m_patches; }
+
+private:
+    DetailSettings m_settings;
+    HeightfieldView m_heightfield;
+    int m_chunksPerSide = 0;
+
+    // World height range per chunk
+    std::vector<float> m_minHeights;
+    std::vector<float> m_maxHeights;
+
+    std::vector<uint8_t> m_refinements;
+    std::vector<DetailPatch> m_patches;
+
+    void updateBounds(int chunk);
+};
+
+namespace TerrainDetail
+{
+    // Mesh of a refined chunk. Detail is one function of the position whatever the refinement, and it fades to zero
+    // towards unrefined chunks, so patches meet the base mesh and each other: on an edge shared with a coarser patch,
+    // the vertices between its own are interpolated. Safe to call from several threads.
+    DetailMesh BuildPatch(const HeightfieldView& heightfield, const DetailSettings& settings, const DetailPatch& patch);
+
+    // Vertex and index bytes of a full patch of that refinement, for budgets
+    size_t PatchBytes(const DetailSettings& settings, int refinement);
+}
+
+#endif // TERRAIN_DETAIL_H
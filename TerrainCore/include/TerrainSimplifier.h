@@ -0,0 +1,53 @@
+#ifndef TERRAIN_SIMPLIFIER_H
+#define TERRAIN_SIMPLIFIER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "MathHelper.h"
+#include "MemoryAccounting.h"
+
+// Indexed triangle mesh, triangles are counter-clockwise seen from above
+struct TerrainMesh
+{
+    TaggedVector<float, MemoryTag::MESHES> positions; // x, y, z per vertex
+    TaggedVector<uint32_t, MemoryTag::MESHES> indices;
+
+    size_t vertexCount() const { return positions.size() / 3; }
+    size_t triangleCount() const { return indices.size() / 3; }
+};
+
+// Error-bounded adaptive triangulation of a square heightmap (right-triangulated irregular network, RTIN).
+// The heightmap is embedded in a (2^k + 1) grid, every vertex gets the worst vertical error of the triangles
+// that depend on it, then any error threshold can be extracted crack-free without recomputing the errors.
+class TerrainSimplifier
+{
+public:
+    explicit TerrainSimplifier(int size);
+
+    int getSize() const { return m_size; }
+    int getGridSize() const { return m_gridSize; }
+
+    // Compute the vertex errors of a size x size heightmap, one level of the hierarchy at a time in parallel
+    void computeErrors(const float* heights);
+
+    // Same errors after an edit of the samples [x, x + width) x [y, y + height) of the heights given to
+    // computeErrors(): only the triangles over them and their ancestors are computed again
+    void updateErrors(const float* heights, int x, int y, int width, int height);
+
+    // Triangles whose vertical error is at most maxError (heightmap units), as heightmap sample indices
+    void extract(float maxError, std::vector<uint32_t>& triangles) const;
+
+    // World-space mesh: sample (x, y) is placed at origin + (x, y) * step, heights are multiplied by heightScale
+    TerrainMesh buildMesh(const float* heights, float maxError, const Point2d<float>& origin, float step, float heightScale) const;
+
+private:
+    int m_size;
+    int m_gridSize;
+    TaggedVector<float, MemoryTag::MESHES> m_errors;
+
+    // Error of the triangle of hypotenuse (a, b) and right angle corner c, from the errors of its children if any
+    float triangleError(const float* heights, int ax, int ay, int bx, int by, int cx, int cy, bool children) const;
+};
+
+#endif // TERRAIN_SIMPLIFIER_H
@@ -0,0 +1,80 @@
+#ifndef TILE_CACHE_H
+#define TILE_CACHE_H
+
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "TileGeneration.h"
+
+struct TileCacheStats
+{
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t generatedSamples = 0; // Noise samples, each one is generated once while its tile stays cached
+    double generationSeconds = 0.0;
+};
+
+// Generated tiles of a map, shared by everything reading the map in tiles: a tile and its apron (the border of
+// neighbor samples needed by normals or erosion across its edges) come from the same cached tiles, so overlapping
+// regions are not generated again. Two levels are cached: the noise of a tile, and its final heights, eroded
+// over the noise of the tile and its erosion halo. Heights are bit-identical to TileGeneration::GenerateTile.
+// Thread safe: concurrent requests for the same tile wait for a single generation.
+class TileCache
+{
+public:
+    using Tile = std::shared_ptr<const std::vector<float>>;
+
+    // capacity is the number of tiles kept per level, least recently used first out
+    explicit TileCache(const GenerationSettings& settings, int tileSize = 128, size_t capacity = 256);
+
+    const GenerationSettings& getSettings() const { return m_settings; }
+    int getTileSize() const { return m_tileSize; }
+    int getTilesX() const { return m_tiles; }
+    int getTilesY() const { return m_tiles; }
+
+    // Final heights of tile (tx, ty), row-major, tileSize wide (less on the last column and row)
+    Tile tile(int tx, int ty);
+
+    // Samples [x0, x0 + width) x [y0, y0 + height) of the map, samples outside it are clamped to the border.
+    // False if heights holds less than width * height.
+    bool read(int x0, int y0, int width, int height, std::span<float> heights);
+
+    // Tile (tx, ty) grown by apron samples on every side
+    void readWithApron(int tx, int ty, int apron, std::vector<float>& heights);
+
+    TileCacheStats getStats() const;
+    void clear();
+
+private:
+    struct Entry
+    {
+        std::shared_future<Tile> value;
+        uint64_t lastUse = 0;
+    };
+    using Level = std::unordered_map<uint64_t, Entry>;
+
+    GenerationSettings m_settings;
+    int m_tileSize;
+    int m_tiles; // Per side
+    size_t m_capacity;
+
+    mutable std::mutex m_mutex;
+    Level m_noise;
+    Level m_heights;
+    uint64_t m_clock = 0;
+    TileCacheStats m_stats;
+
+    template<typename Fn>
+    Tile cached(Level& level, int tx, int ty, Fn&& generate);
+
+    Tile noiseTile(int tx, int ty);
+    void readLevel(bool noise, int x0, int y0, int width, int height, float* heights);
+    int tileWidth(int tx) const;
+};
+
+#endif // TILE_CACHE_H
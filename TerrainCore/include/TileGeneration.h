@@ -0,0 +1,57 @@
+#ifndef TILE_GENERATION_H
+#define TILE_GENERATION_H
+
+#include <span>
+
+#include "Erosion.h"
+#include "Noise.h"
+#include "WorldOrigin.h"
+
+// One layer of the heightmap: noise at an integer multiple of the base frequency, so that world
+// origins stay on the noise lattice, weighted by amplitude. Stages are summed, then clamped at 0.
+struct NoiseStage
+{
+    NoiseType type = NoiseType::PERLIN;
+    int frequency = 1;
+    float amplitude = 1.f;
+    int seedOffset = 0;
+};
+
+// Everything the heights of a map depend on, plain data so that it can be sent to worker processes
+struct GenerationSettings
+{
+    static constexpr int MAX_NOISE_STAGES = 8;
+
+    int seed = 0;
+    NoiseStage stages[MAX_NOISE_STAGES];
+    int stageCount = 1;
+
+    // size x size samples, sample (x, y) at local (-1 + x * step, -1 + y * step) of the world origin
+    int size = 100;
+    float step = 16.f / 99.f;
+    WorldOrigin origin;
+
+    ErosionSettings erosion;
+};
+
+namespace TileGeneration
+{
+    // Summed noise stages of the samples [x0, x0 + width) x [y0, y0 + height), before erosion.
+    // A sample does not depend on the region it is generated with. False if heights holds less than width * height.
+    bool GenerateNoise(const GenerationSettings& settings, int x0, int y0, int width, int height, std::span<float> heights);
+
+    // Add the summed noise stages of the same samples to heights, without the clamp at 0: e.g. detail over imported heights
+    bool AddNoise(const GenerationSettings& settings, int x0, int y0, int width, int height, std::span<float> heights);
+
+    // Samples [x0, x0 + width) x [y0, y0 + height) of the map: noise over the region grown by the erosion halo
+    // (clamped to the map), erosion, then the inner samples. Bit-identical to the same samples of a whole map.
+    bool GenerateTile(const GenerationSettings& settings, int x0, int y0, int width, int height, std::span<float> heights);
+
+    // The whole size x size map
+    inline bool GenerateMap(const GenerationSettings& settings, std::span<float> heights)
+    {
+        return GenerateTile(settings, 0, 0, settings.size, settings.size, heights);
+    }
+}
+
+#endif // TILE_GENERATION_H
@@ -0,0 +1,157 @@
+#ifndef VIRTUAL_TEXTURE_H
+#define VIRTUAL_TEXTURE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct VirtualTextureSettings
+{
+    // Pages of the finest level per side, a power of two up to 256 (page coordinates are 8-bit in the feedback)
+    int pagesPerSide = 128;
+
+    // Texels per page side, stored with a VirtualTextureCache::BORDER texel margin for bilinear filtering
+    int pageSize = 128;
+
+    // The physical cache holds slotsPerSide^2 pages, however large the virtual texture is
+    int slotsPerSide = 16;
+
+    // Per frame: bytes of generated pages uploaded, and pages generated in the background at once
+    size_t uploadBudget = 1 << 20;
+    int maxPendingPages = 16;
+};
+
+// Page of the virtual texture, level 0 is the finest (pagesPerSide^2 pages), each level halves the page count per side
+struct VirtualPage
+{
+    int level = 0;
+    int x = 0;
+    int y = 0;
+
+    uint32_t key() const { return (static_cast<uint32_t>(level) << 16) | (static_cast<uint32_t>(y) << 8) | static_cast<uint32_t>(x); }
+};
+
+struct VirtualTextureStats
+{
+    int residentPages = 0;
+    int pendingPages = 0;
+
+    // Distinct pages read by the last feedback, and how many of them were not resident
+    int requestedPages = 0;
+    int missingPages = 0;
+
+    // Last frame
+    int generatedPages = 0;
+    int evictedPages = 0;
+    size_t uploadedBytes = 0;
+    double generationTime = 0.0;    // Mean per page, in milliseconds
+};
+
+// Residency of a virtual texture in a fixed cache of page slots, without any OpenGL call.
+// The frames report the pages they read (feedback), the missing ones are requested coarsest first, and generated
+// pages replace the least recently used ones. The page table has one mip per level: each entry holds the slot of
+// the finest resident page covering it, so a missing page falls back on its closest resident ancestor.
+class VirtualTextureCache
+{
+public:
+    static constexpr int BORDER = 1;
+
+    // Page table entry bytes (slot x, slot y, level, 255), 0 alpha where no page is resident
+    static constexpr int ENTRY_BYTES = 4;
+
+    struct Rect
+    {
+        int x0 = 0;
+        int y0 = 0;
+        int x1 = 0;
+        int y1 = 0;
+
+        bool empty() const { return x1 <= x0 || y1 <= y0; }
+    };
+
+    explicit VirtualTextureCache(const VirtualTextureSettings& settings = {});
+
+    const VirtualTextureSettings& getSettings() const { return m_settings; }
+    int getLevelCount() const { return m_levelCount; }
+    int getPagesPerSide(int level) const { return m_settings.pagesPerSide >> level; }
+    int getSlotSize() const { return m_settings.pageSize + 2 * BORDER; }
+    int getAtlasSize() const { return getSlotSize() * m_settings.slotsPerSide; }
+
+    // Drop every page, e.g. for new materials: nothing is resident until pages are generated again
+    void clear();
+
+    // Pages read by a frame: RGBA8 texels (page x, page y, level, 255), 0 alpha where no page is read
+    void addFeedback(std::span<const uint8_t> texels);
+
+    // Missing pages of the feedback and their missing ancestors, coarsest then most read first, at most maxCount.
+    // They stay pending, and are not requested again, until made resident or cancelled.
+    std::vector<VirtualPage> takeRequests(int maxCount);
+
+    // Store a generated page in a free slot, or in the least recently used one: pages read by the current
+    // feedback and the coarsest page are never evicted. Returns the slot (x + y * slotsPerSide), -1 if none is free.
+    int makeResident(const VirtualPage& page);
+    void cancel(const VirtualPage& page);
+
+    // Next frame: the pages read by the last one can be evicted again
+    void endFrame();
+
+    bool isResident(const VirtualPage& page) const;
+
+    // Page table mip of a level, getPagesPerSide(level)^2 entries, and the entries changed since clearDirty()
+    const std::vector<uint8_t>& getPageTable(int level) const { return m_tables[level]; }
+    const Rect& getDirtyRect(int level) const { return m_dirty[level]; }
+    void clearDirty();
+
+    const VirtualTextureStats& getStats() const { return m_stats; }
+
+private:
+    struct Slot
+    {
+        VirtualPage page;
+        uint32_t lastUsed = 0;
+        bool used = false;
+    };
+
+    VirtualTextureSettings m_settings;
+    int m_levelCount = 1;
+    uint32_t m_frame = 1;
+
+    std::vector<Slot> m_slots;
+    std::vector<std::vector<int>> m_slotOf;     // Per level and page, -1 when not resident
+    std::vector<std::vector<uint8_t>> m_tables;
+    std::vector<Rect> m_dirty;
+
+    std::unordered_map<uint32_t, int> m_readCounts;   // Pages read by the feedback of the current frame
+    std::unordered_set<uint32_t> m_pending;
+
+    VirtualTextureStats m_stats;
+
+    int& slotOf(const VirtualPage& page) { return m_slotOf[page.level][page.y * getPagesPerSide(page.level) + page.x]; }
+    int slotOf(const VirtualPage& page) const { return m_slotOf[page.level][page.y * getPagesPerSide(page.level) + page.x]; }
+    void updateTable(const VirtualPage& page);
+};
+
+// Materials the pages are generated from: BiomeClassifier weights of a size x size heightmap, whose samples span
+// [0, 1]^2 of the virtual texture and extent world units per side
+struct MaterialPageSource
+{
+    std::shared_ptr<const std::vector<uint8_t>> weights;
+    int size = 0;
+    float extent = 1.f;
+    int seed = 0;
+};
+
+namespace VirtualTexture
+{
+    // getSlotSize()^2 RGBA8 texels of a page, border included: the material weights blended with procedural detail
+    // in world space, whose octaves finer than the texels of the page level are faded out.
+    // False if texels is too small or the source has no weights.
+    bool GenerateMaterialPage(const MaterialPageSource& source, const VirtualTextureSettings& settings, const VirtualPage& page,
+                              std::span<uint8_t> texels);
+}
+
+#endif // VIRTUAL_TEXTURE_H
@@ -0,0 +1,100 @@
+#ifndef WATER_H
+#define WATER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "Heightfield.h"
+#include "MemoryAccounting.h"
+
+struct WaterSettings
+{
+    float gravity = 9.81f;
+    float timeStep = 0.01f;    // Simulated seconds per step
+    float damping = 0.995f;    // Part of the flux kept from one step to the next, lets lakes settle
+    float evaporation = 0.f;   // Part of the depth lost per second
+    float epsilon = 1e-5f;     // Depth change per step below which a tile is settled
+    double budget = 4.0;       // Milliseconds of solver per update, the simulation slows down past it
+};
+
+struct WaterStats
+{
+    int steps = 0;
+    int activeTiles = 0;
+    int tileCount = 0;
+    double solverTime = 0.0;   // Milliseconds
+    bool overBudget = false;   // Simulated time was dropped to stay within the budget
+};
+
+// Shallow water over a heightfield with the virtual pipe model ("Fast Hydraulic Erosion Simulation and
+// Visualization on GPU", Mei et al.): every cell exchanges flux with its 4 neighbors through pipes driven by the
+// difference of water surface heights. Cells are grouped in tiles; only active tiles (with flow) compute fluxes,
+// and only they and their neighbors update depths. A tile whose depths stop changing is settled until water
+// flows into it again, so still lakes and dry land cost nothing. Tiles are solved in parallel.
+class WaterSimulation
+{
+public:
+    static constexpr int TILE_SIZE = 32;
+
+    explicit WaterSimulation(const WaterSettings& settings = {});
+
+    // New ground, the water is cleared. The heights are copied.
+    void setTerrain(const HeightfieldView& heightfield);
+
+    const WaterSettings& getSettings() const { return m_settings; }
+    void setSettings(const WaterSettings& settings) { m_settings = settings; }
+
+    // Positions in the local frame of the heightfield
+    void addWater(float x, float z, float radius, float depth);
+    void addSource(float x, float z, float rate); // Depth per second on one cell
+    void rain(float depth);
+    void clear();
+
+    // Advance by seconds of real time, within the solver budget
+    void update(double seconds);
+
+    int getSize() const { return m_size; }
+    int getTilesPerSide() const { return m_tiles; }
+    float depth(int x, int y) const { return m_depth[index(x, y)]; }
+    float ground(int x, int y) const { return m_ground[index(x, y)]; }
+
+    // Tiles whose depths changed since the last call
+    void takeDirtyTiles(std::vector<int>& tiles);
+
+    const WaterStats& getStats() const { return m_stats; }
+
+private:
+    struct Source
+    {
+        int cell;
+        float rate;
+    };
+
+    WaterSettings m_settings;
+    int m_size = 0;
+    int m_tiles = 0; // Per side
+    Point2d<float> m_origin = { 0.f, 0.f };
+    float m_cellSize = 1.f;
+
+    TaggedVector<float, MemoryTag::WATER> m_ground; // World heights
+    TaggedVector<float, MemoryTag::WATER> m_depth;
+    TaggedVector<float, MemoryTag::WATER> m_flux;   // 4 per cell: left, right, up, down
+
+    std::vector<uint8_t> m_active;
+    std::vector<uint8_t> m_dirty;
+    std::vector<Source> m_sources;
+
+    double m_accumulator = 0.0;
+    WaterStats m_stats;
+
+    size_t index(int x, int y) const { return static_cast<size_t>(y) * m_size + x; }
+    int tileOf(int x, int y) const { return (y / TILE_SIZE) * m_tiles + x / TILE_SIZE; }
+    bool toCell(float x, float z, int& cx, int& cy) const;
+    void activateAround(int cx, int cy, int radius);
+
+    void step();
+    void computeFlux(int tile);
+    bool updateDepth(int tile);
+};
+
+#endif // WATER_H
@@ -0,0 +1,23 @@
+#ifndef WORLD_ORIGIN_H
+#define WORLD_ORIGIN_H
+
+#include <cstdint>
+
+#include "MathHelper.h"
+
+// Integer world position of a local frame (camera, terrain chunk). Coordinates inside a frame stay small floats;
+// large distances are only subtracted in 64-bit integers, and the small result converted to float.
+struct WorldOrigin
+{
+    int64_t x = 0;
+    int64_t y = 0;
+    int64_t z = 0;
+};
+
+// Position of the frame "to" in the frame "from"
+inline Point3d<float> RelativeOffset(const WorldOrigin& from, const WorldOrigin& to)
+{
+    return { static_cast<float>(to.x - from.x), static_cast<float>(to.y - from.y), static_cast<float>(to.z - from.z) };
+}
+
+#endif // WORLD_ORIGIN_H
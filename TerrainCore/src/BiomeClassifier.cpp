@@ -0,0 +1,176 @@
+#include "BiomeClassifier.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "OutputSpan.h"
+#include "Parallel.h"
+#include "PerlinNoise.h"
+#include "Simd.h"
+
+namespace
+{
+    constexpr int MOISTURE_SEED_OFFSET = 7919;
+    constexpr int TEMPERATURE_SEED_OFFSET = 104729;
+
+    using Simd::Float4;
+
+    inline float Saturate(float v)
+    {
+        return std::min(1.f, std::max(0.f, v));
+    }
+
+    // Smooth step with a precomputed 1 / (edge1 - edge0)
+    inline Float4 SmoothStep(const Float4& edge0, const Float4& inverseWidth, const Float4& v)
+    {
+        const Float4 t = Simd::Saturate((v - edge0) * inverseWidth);
+        return t * t * (Float4(3.f) - Float4(2.f) * t);
+    }
+}
+
+Color3<float> MaterialColor(Material material)
+{
+    // Until real textures are authored
+    static const Color3<float> colors[] = {
+        { 0.26f, 0.48f, 0.16f }, // Grass
+        { 0.76f, 0.70f, 0.50f }, // Sand
+        { 0.45f, 0.42f, 0.40f }, // Rock
+        { 0.94f, 0.95f, 0.97f }  // Snow
+    };
+    return colors[std::clamp(static_cast<int>(material), 0, static_cast<int>(Material::COUNT) - 1)];
+}
+
+BiomeClassifier::BiomeClassifier(const BiomeSettings& settings)
+    : m_settings(settings)
+{
+}
+
+bool BiomeClassifier::classify(std::span<const float> heights, int size, std::span<uint8_t> weights) const
+{
+    return classifyRegion(heights, size, 0, 0, size, size, weights);
+}
+
+bool BiomeClassifier::classifyRegion(std::span<const float> heights, int size, int x0, int y0, int width, int height, std::span<uint8_t> weights) const
+{
+    const size_t samples = static_cast<size_t>(std::max(0, size)) * std::max(0, size);
+    if (!OutputSpan::Fits(heights, samples, "BiomeClassifier::classifyRegion") ||
+        !OutputSpan::Fits(weights, samples * 4, "BiomeClassifier::classifyRegion"))
+        return false;
+
+    x0 = std::max(0, x0);
+    y0 = std::max(0, y0);
+    const int x1 = std::min(size, x0 + width);
+    const int y1 = std::min(size, y0 + height);
+    if (x1 <= x0 || y1 <= y0)
+        return true;
+
+    // Coarse climate lattice, aligned on global sample indices so any region split gives the same result
+    ClimateLattice climate;
+    climate.x0 = x0 / CLIMATE_STEP;
+    climate.y0 = y0 / CLIMATE_STEP;
+    climate.width = (x1 - 1) / CLIMATE_STEP + 2 - climate.x0;
+    const int latticeHeight = (y1 - 1) / CLIMATE_STEP + 2 - climate.y0;
+    climate.moisture.resize(climate.width * latticeHeight);
+    climate.temperature.resize(climate.width * latticeHeight);
+
+    const float frequency = m_settings.climateFrequency * m_settings.step * CLIMATE_STEP;
+    Parallel::For(0, latticeHeight, [&](int cy)
+    {
+        for (int cx = 0; cx < climate.width; ++cx)
+        {
+            const float nx = m_settings.origin.x * m_settings.climateFrequency + (climate.x0 + cx) * frequency;
+            const float ny = m_settings.origin.y * m_settings.climateFrequency + (climate.y0 + cy) * frequency;
+            climate.moisture[cy * climate.width + cx] = Saturate(perlin(nx, ny, m_settings.seed + MOISTURE_SEED_OFFSET) * 2.f);
+            climate.temperature[cy * climate.width + cx] = Saturate(perlin(nx, ny, m_settings.seed + TEMPERATURE_SEED_OFFSET) * 2.f);
+        }
+    });
+
+    const int tilesX = (x1 - x0 + TILE_SIZE - 1) / TILE_SIZE;
+    const int tilesY = (y1 - y0 + TILE_SIZE - 1) / TILE_SIZE;
+
+    Parallel::For(0, tilesX * tilesY, [&](int tile)
+    {
+        const int tx = x0 + (tile % tilesX) * TILE_SIZE;
+        const int ty = y0 + (tile / tilesX) * TILE_SIZE;
+        classifyTile(heights.data(), size, climate, tx, ty, std::min(x1, tx + TILE_SIZE), std::min(y1, ty + TILE_SIZE), weights.data());
+    });
+    return true;
+}
+
+void BiomeClassifier::classifyTile(const float* heights, int size, const ClimateLattice& climate, int x0, int y0, int x1, int y1, uint8_t* weights) const
+{
+    const BiomeSettings& s = m_settings;
+    const int width = x1 - x0;
+    const int paddedWidth = (width + 3) & ~3;
+    const float inverseStep = 1.f / CLIMATE_STEP;
+    const float slopeFactor = s.heightScale / (2.f * s.step);
+
+    // Rock blends between 0.75 and 1.25 times the rock slope, compared squared to skip the square roots
+    const float rockStart = (s.rockSlope * 0.75f) * (s.rockSlope * 0.75f);
+    const float rockInverseWidth = 1.f / ((s.rockSlope * 1.25f) * (s.rockSlope * 1.25f) - rockStart);
+
+    // Rows are padded to a multiple of 4 samples for the SIMD pass
+    float rowHeight[TILE_SIZE] = {}, rowSlope[TILE_SIZE] = {}, rowMoisture[TILE_SIZE] = {}, rowTemperature[TILE_SIZE] = {};
+    uint8_t rowWeights[TILE_SIZE * 4];
+
+    for (int y = y0; y < y1; ++y)
+    {
+        const float* row = heights + y * size;
+        const float* rowUp = heights + std::max(0, y - 1) * size;
+        const float* rowDown = heights + std::min(size - 1, y + 1) * size;
+
+        // Climate lattice interpolated along y once per row, then along x per sample
+        const int cx0 = x0 / CLIMATE_STEP;
+        const int cx1 = (x1 - 1) / CLIMATE_STEP + 1;
+        const int cy = y / CLIMATE_STEP - climate.y0;
+        const float fy = (y % CLIMATE_STEP) * inverseStep;
+        const float* moisture0 = &climate.moisture[cy * climate.width + cx0 - climate.x0];
+        const float* moisture1 = moisture0 + climate.width;
+        const float* temperature0 = &climate.temperature[cy * climate.width + cx0 - climate.x0];
+        const float* temperature1 = temperature0 + climate.width;
+
+        float moistureRow[TILE_SIZE / CLIMATE_STEP + 2], temperatureRow[TILE_SIZE / CLIMATE_STEP + 2];
+        for (int c = 0; c <= cx1 - cx0; ++c)
+        {
+            moistureRow[c] = moisture0[c] + (moisture1[c] - moisture0[c]) * fy;
+            temperatureRow[c] = temperature0[c] + (temperature1[c] - temperature0[c]) * fy;
+        }
+
+        // Gather inputs (edge samples are clamped)
+        for (int i = 0; i < width; ++i)
+        {
+            const int x = x0 + i;
+            const float dx = (row[std::min(size - 1, x + 1)] - row[std::max(0, x - 1)]) * slopeFactor;
+            const float dz = (rowDown[x] - rowUp[x]) * slopeFactor;
+            rowHeight[i] = row[x] * s.heightScale;
+            rowSlope[i] = dx * dx + dz * dz;
+
+            const int cx = x / CLIMATE_STEP - cx0;
+            const float fx = (x % CLIMATE_STEP) * inverseStep;
+            rowMoisture[i] = moistureRow[cx] + (moistureRow[cx + 1] - moistureRow[cx]) * fx;
+            rowTemperature[i] = temperatureRow[cx] + (temperatureRow[cx + 1] - temperatureRow[cx]) * fx;
+        }
+
+        // Layered weights: rock on steep slopes, then snow on cold heights, then sand on dry shores, grass elsewhere.
+        // Each layer takes its share of what remains so the four weights always sum to one.
+        for (int i = 0; i < paddedWidth; i += 4)
+        {
+            const Float4 height = Float4::Load(rowHeight + i);
+            const Float4 rock = SmoothStep(Float4(rockStart), Float4(rockInverseWidth), Float4::Load(rowSlope + i));
+            const Float4 snowLine = Float4(s.snowHeight - 0.05f) - Float4(0.25f) * (Float4(1.f) - Float4::Load(rowTemperature + i));
+            const Float4 snow = SmoothStep(snowLine, Float4(10.f), height);
+            const Float4 sandLine = Float4(s.sandHeight - 0.04f) + Float4(0.1f) * (Float4(1.f) - Float4::Load(rowMoisture + i));
+            const Float4 sand = Float4(1.f) - SmoothStep(sandLine, Float4(25.f), height);
+
+            const Float4 remainingRock = Float4(1.f) - rock;
+            const Float4 snowWeight = snow * remainingRock;
+            const Float4 remainingSnow = remainingRock - snowWeight;
+            const Float4 sandWeight = sand * remainingSnow;
+            const Float4 grassWeight = remainingSnow - sandWeight;
+
+            Simd::StoreUnormRgba8(grassWeight, sandWeight, rock, snowWeight, rowWeights + i * 4);
+        }
+
+        std::memcpy(weights + (static_cast<size_t>(y) * size + x0) * 4, rowWeights, width * 4);
+    }
+}
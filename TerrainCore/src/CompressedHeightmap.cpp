@@ -0,0 +1,391 @@
+#include "CompressedHeightmap.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include "OutputSpan.h"
+#include "Parallel.h"
+#include "Simd.h"
+
+namespace
+{
+    // Residuals are bit-packed by blocks of 16, each block starts with its bit width
+    constexpr int BLOCK = 16;
+
+    // Trailing bytes so that the decoder can always read 8 bytes at once
+    constexpr size_t PADDING = 8;
+
+    uint32_t OrderedBits(float value)
+    {
+        const uint32_t bits = std::bit_cast<uint32_t>(value);
+        return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+    }
+
+    uint32_t ZigZag(uint32_t residual)
+    {
+        const int32_t r = static_cast<int32_t>(residual);
+        return static_cast<uint32_t>((r << 1) ^ (r >> 31));
+    }
+
+    // Quantized values or ordered float bits of the tile, row-major
+    void Values(const float* heights, int width, int height, int stride, float tolerance, EncodedTile& tile, std::vector<uint32_t>& values)
+    {
+        values.resize(static_cast<size_t>(width) * height);
+        if (tile.encoding == HeightEncoding::LOSSLESS)
+        {
+            for (int y = 0; y < height; ++y)
+                for (int x = 0; x < width; ++x)
+                    values[y * width + x] = OrderedBits(heights[y * stride + x]);
+            return;
+        }
+
+        float minHeight = heights[0];
+        float maxHeight = heights[0];
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                minHeight = std::min(minHeight, heights[y * stride + x]);
+                maxHeight = std::max(maxHeight, heights[y * stride + x]);
+            }
+        }
+
+        tile.minHeight = minHeight;
+        tile.step = std::max((maxHeight - minHeight) / 65535.f, 2.f * tolerance);
+        const float inverseStep = tile.step > 0.f ? 1.f / tile.step : 0.f;
+        for (int y = 0; y < height; ++y)
+            for (int x = 0; x < width; ++x)
+                values[y * width + x] = static_cast<uint32_t>(std::clamp(std::lround((heights[y * stride + x] - minHeight) * inverseStep), 0l, 65535l));
+    }
+
+    // First row from the left neighbour, second row from the row above, then linear extrapolation of the two rows above.
+    // Vertical prediction only, so that a whole row is reconstructed at once with SIMD.
+    void PackResiduals(const std::vector<uint32_t>& values, int width, int height, std::vector<uint8_t>& data)
+    {
+        const size_t count = values.size();
+        std::vector<uint32_t> residuals((count + BLOCK - 1) / BLOCK * BLOCK, 0);
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                const size_t i = static_cast<size_t>(y) * width + x;
+                uint32_t prediction = 0;
+                if (y == 0)
+                    prediction = x > 0 ? values[i - 1] : 0;
+                else if (y == 1)
+                    prediction = values[i - width];
+                else
+                    prediction = 2 * values[i - width] - values[i - 2 * width];
+                residuals[i] = ZigZag(values[i] - prediction);
+            }
+        }
+
+        data.clear();
+        data.reserve(residuals.size() + PADDING);
+        for (size_t block = 0; block < residuals.size(); block += BLOCK)
+        {
+            uint32_t all = 0;
+            for (int i = 0; i < BLOCK; ++i)
+                all |= residuals[block + i];
+            const int bits = std::bit_width(all);
+            data.push_back(static_cast<uint8_t>(bits));
+
+            // 16 values of the same width fill exactly 2 * bits bytes
+            uint64_t buffer = 0;
+            int buffered = 0;
+            for (int i = 0; i < BLOCK; ++i)
+            {
+                buffer |= static_cast<uint64_t>(residuals[block + i]) << buffered;
+                buffered += bits;
+                while (buffered >= 8)
+                {
+                    data.push_back(static_cast<uint8_t>(buffer));
+                    buffer >>= 8;
+                    buffered -= 8;
+                }
+            }
+        }
+        data.insert(data.end(), PADDING, 0);
+    }
+
+    // False if the data is not a valid packing of count residuals
+    bool UnpackResiduals(const std::vector<uint8_t>& data, size_t count, uint32_t* residuals)
+    {
+        const uint8_t* in = data.data();
+        const uint8_t* end = in + data.size();
+        for (size_t block = 0; block < count; block += BLOCK)
+        {
+            if (in == end)
+                return false;
+            const int bits = *in++;
+            if (bits > 32 || static_cast<size_t>(end - in) < 2 * static_cast<size_t>(bits) + PADDING)
+                return false;
+            const uint64_t mask = (uint64_t(1) << bits) - 1;
+            for (int i = 0; i < BLOCK; ++i)
+            {
+                const int bit = i * bits;
+                uint64_t word;
+                std::memcpy(&word, in + (bit >> 3), sizeof(word));
+                residuals[block + i] = static_cast<uint32_t>((word >> (bit & 7)) & mask);
+            }
+            in += 2 * bits;
+        }
+        return true;
+    }
+
+    // Quantized values or ordered bits back to floats, 4 at a time
+    template<bool LOSSLESS>
+    void StoreRow(const uint32_t* values, int width, float minHeight, float step, float* out)
+    {
+        using namespace Simd;
+        int x = 0;
+        for (; x + 4 <= width; x += 4)
+        {
+            const Int4 v = Int4::Load(values + x);
+            if constexpr (LOSSLESS)
+                AsFloat(v ^ (((v >> 31) - Int4(1u)) | Int4(0x80000000u))).store(out + x);
+            else
+                (Float4(minHeight) + ToFloat(v) * Float4(step)).store(out + x);
+        }
+        for (; x < width; ++x)
+        {
+            const uint32_t v = values[x];
+            if constexpr (LOSSLESS)
+                out[x] = std::bit_cast<float>(v ^ (((v >> 31) - 1u) | 0x80000000u));
+            else
+                out[x] = minHeight + static_cast<float>(v) * step;
+        }
+    }
+
+    template<bool LOSSLESS>
+    bool DecodeResiduals(const EncodedTile& tile, float* heights, int stride)
+    {
+        using namespace Simd;
+        const int width = tile.width;
+        const size_t count = static_cast<size_t>(width) * tile.height;
+
+        // At least one byte per block, checked before sizing anything from the tile dimensions
+        const size_t blocks = (count + BLOCK - 1) / BLOCK;
+        if (tile.data.size() < blocks + PADDING)
+            return false;
+
+        thread_local std::vector<uint32_t> values;
+        values.resize(blocks * BLOCK);
+        if (!UnpackResiduals(tile.data, count, values.data()))
+            return false;
+
+        auto unZigZag = [](uint32_t z) { return (z >> 1) ^ (0u - (z & 1u)); };
+
+        // First row: running sum, the only serial part
+        uint32_t* row = values.data();
+        row[0] = unZigZag(row[0]);
+        for (int x = 1; x < width; ++x)
+            row[x] = row[x - 1] + unZigZag(row[x]);
+        StoreRow<LOSSLESS>(row, width, tile.minHeight, tile.step, heights);
+
+        for (int y = 1; y < tile.height; ++y)
+        {
+            row = values.data() + static_cast<size_t>(y) * width;
+            const uint32_t* up = row - width;
+            const uint32_t* upUp = y >= 2 ? up - width : nullptr;
+
+            int x = 0;
+            for (; x + 4 <= width; x += 4)
+            {
+                const Int4 z = Int4::Load(row + x);
+                const Int4 residual = (z >> 1) ^ (Int4(0u) - (z & Int4(1u)));
+                const Int4 u = Int4::Load(up + x);
+                const Int4 prediction = upUp ? u + u - Int4::Load(upUp + x) : u;
+                (prediction + residual).store(row + x);
+            }
+            for (; x < width; ++x)
+                row[x] = (upUp ? 2 * up[x] - upUp[x] : up[x]) + unZigZag(row[x]);
+
+            StoreRow<LOSSLESS>(row, width, tile.minHeight, tile.step, heights + static_cast<size_t>(y) * stride);
+        }
+        return true;
+    }
+}
+
+namespace HeightCodec
+{
+    const char* Name(HeightEncoding encoding)
+    {
+        switch (encoding)
+        {
+        case HeightEncoding::QUANTIZED16: return "Quantized 16-bit";
+        case HeightEncoding::QUANTIZED_DELTA: return "Quantized delta";
+        case HeightEncoding::LOSSLESS: return "Lossless";
+        default: return "Unknown";
+        }
+    }
+
+    EncodedTile Encode(const float* heights, int width, int height, int stride, HeightEncoding encoding, float tolerance)
+    {
+        EncodedTile tile;
+        tile.encoding = encoding;
+        tile.width = width;
+        tile.height = height;
+        if (width <= 0 || height <= 0)
+            return tile;
+
+        std::vector<uint32_t> values;
+        Values(heights, width, height, stride, tolerance, tile, values);
+
+        if (encoding == HeightEncoding::QUANTIZED16)
+        {
+            tile.data.resize(values.size() * sizeof(uint16_t) + PADDING);
+            for (size_t i = 0; i < values.size(); ++i)
+            {
+                const uint16_t q = static_cast<uint16_t>(values[i]);
+                std::memcpy(&tile.data[i * sizeof(uint16_t)], &q, sizeof(q));
+            }
+        }
+        else
+        {
+            PackResiduals(values, width, height, tile.data);
+        }
+        tile.data.shrink_to_fit();
+        return tile;
+    }
+
+    bool Decode(const EncodedTile& tile, float* heights, int stride)
+    {
+        if (tile.width <= 0 || tile.height <= 0)
+            return true;
+
+        switch (tile.encoding)
+        {
+        case HeightEncoding::QUANTIZED16:
+        {
+            using namespace Simd;
+            // LoadU16 reads 8 bytes, the padding covers the last samples
+            if (tile.data.size() < static_cast<size_t>(tile.width) * tile.height * sizeof(uint16_t) + PADDING)
+                return false;
+            const uint8_t* in = tile.data.data();
+            const Float4 minHeight(tile.minHeight);
+            const Float4 step(tile.step);
+            for (int y = 0; y < tile.height; ++y)
+            {
+                const uint8_t* row = in + static_cast<size_t>(y) * tile.width * sizeof(uint16_t);
+                float* out = heights + static_cast<size_t>(y) * stride;
+                int x = 0;
+                for (; x + 4 <= tile.width; x += 4)
+                    (minHeight + ToFloat(LoadU16(row + x * sizeof(uint16_t))) * step).store(out + x);
+                for (; x < tile.width; ++x)
+                {
+                    uint16_t q;
+                    std::memcpy(&q, row + x * sizeof(uint16_t), sizeof(q));
+                    out[x] = tile.minHeight + q * tile.step;
+                }
+            }
+            return true;
+        }
+
+        case HeightEncoding::QUANTIZED_DELTA:
+            return DecodeResiduals<false>(tile, heights, stride);
+
+        case HeightEncoding::LOSSLESS:
+            return DecodeResiduals<true>(tile, heights, stride);
+
+        default:
+            return false;
+        }
+    }
+
+    float MaxError(const EncodedTile& tile)
+    {
+        // Rounding to the nearest level, plus the float rounding of minHeight + level * step
+        if (tile.encoding == HeightEncoding::LOSSLESS)
+            return 0.f;
+        return tile.step * 0.5f + (std::abs(tile.minHeight) + 65535.f * tile.step) * std::numeric_limits<float>::epsilon();
+    }
+}
+
+CompressedHeightmap::CompressedHeightmap(int width, int height, HeightEncoding encoding, float tolerance, int tileSize)
+    : m_width(std::max(0, width))
+    , m_height(std::max(0, height))
+    , m_tileSize(std::max(4, tileSize))
+    , m_encoding(encoding)
+    , m_tolerance(std::max(0.f, tolerance))
+{
+    m_tilesX = (m_width + m_tileSize - 1) / m_tileSize;
+    m_tilesY = (m_height + m_tileSize - 1) / m_tileSize;
+    m_tiles.resize(static_cast<size_t>(m_tilesX) * m_tilesY);
+}
+
+bool CompressedHeightmap::encode(std::span<const float> heights)
+{
+    if (!OutputSpan::Fits(heights, uncompressedBytes() / sizeof(float), "CompressedHeightmap::encode"))
+        return false;
+
+    Parallel::For(0, static_cast<int>(m_tiles.size()), [&](int i)
+    {
+        const int tx = i % m_tilesX;
+        const int ty = i / m_tilesX;
+        setTile(tx, ty, heights.data() + static_cast<size_t>(ty) * m_tileSize * m_width + tx * m_tileSize, m_width);
+    });
+    return true;
+}
+
+void CompressedHeightmap::setTile(int tx, int ty, const float* heights, int stride)
+{
+    const int width = std::min(m_tileSize, m_width - tx * m_tileSize);
+    const int height = std::min(m_tileSize, m_height - ty * m_tileSize);
+    m_tiles[ty * m_tilesX + tx] = HeightCodec::Encode(heights, width, height, stride, m_encoding, m_tolerance);
+}
+
+bool CompressedHeightmap::decodeTile(int tx, int ty, std::span<float> heights) const
+{
+    if (!OutputSpan::Fits(heights, static_cast<size_t>(m_tileSize) * m_tileSize, "CompressedHeightmap::decodeTile"))
+        return false;
+
+    if (!HeightCodec::Decode(getTile(tx, ty), heights.data(), m_tileSize))
+    {
+        std::cerr << "CompressedHeightmap::decodeTile: tile (" << tx << ", " << ty << ") is corrupt." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool CompressedHeightmap::decode(std::span<float> heights) const
+{
+    if (!OutputSpan::Fits(heights, uncompressedBytes() / sizeof(float), "CompressedHeightmap::decode"))
+        return false;
+
+    std::atomic<int> corrupt = 0;
+    Parallel::For(0, static_cast<int>(m_tiles.size()), [&](int i)
+    {
+        const int tx = i % m_tilesX;
+        const int ty = i / m_tilesX;
+        if (!HeightCodec::Decode(m_tiles[i], heights.data() + static_cast<size_t>(ty) * m_tileSize * m_width + tx * m_tileSize, m_width))
+            ++corrupt;
+    });
+    if (corrupt > 0)
+    {
+        std::cerr << "CompressedHeightmap::decode: " << corrupt << " corrupt tiles." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+size_t CompressedHeightmap::compressedBytes() const
+{
+    size_t bytes = 0;
+    for (const EncodedTile& tile : m_tiles)
+        bytes += sizeof(EncodedTile) + tile.data.capacity();
+    return bytes;
+}
+
+float CompressedHeightmap::maxError() const
+{
+    float error = 0.f;
+    for (const EncodedTile& tile : m_tiles)
+        error = std::max(error, HeightCodec::MaxError(tile));
+    return error;
+}
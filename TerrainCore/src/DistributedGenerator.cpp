@@ -0,0 +1,466 @@
+#include "DistributedGenerator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "MeshExporter.h"
+#include "Parallel.h"
+
+namespace
+{
+#ifdef _WIN32
+    using SocketHandle = SOCKET;
+    const SocketHandle INVALID_HANDLE = INVALID_SOCKET;
+    constexpr int SEND_FLAGS = 0;
+
+    void CloseSocket(SocketHandle socket) { closesocket(socket); }
+#else
+    using SocketHandle = int;
+    const SocketHandle INVALID_HANDLE = -1;
+    constexpr int SEND_FLAGS = MSG_NOSIGNAL; // A dead peer is an error code, not a signal
+
+    void CloseSocket(SocketHandle socket) { close(socket); }
+#endif
+
+    // Winsock must be initialised once per process
+    struct NetworkScope
+    {
+#ifdef _WIN32
+        bool valid;
+        NetworkScope() { WSADATA data; valid = WSAStartup(MAKEWORD(2, 2), &data) == 0; }
+        ~NetworkScope() { if (valid) WSACleanup(); }
+#else
+        bool valid = true;
+#endif
+    };
+
+    // Worker connections must come up within this delay
+    constexpr int ACCEPT_TIMEOUT_SECONDS = 30;
+    constexpr int CONNECT_ATTEMPTS = 50;
+
+    constexpr uint32_t MESSAGE_MAGIC = 0x54524E47; // "TRNG"
+
+    enum class MessageType : uint32_t
+    {
+        HELLO,
+        JOB,
+        RESULT,
+        STOP
+    };
+
+    struct MessageHeader
+    {
+        uint32_t magic;
+        MessageType type;
+        uint32_t size; // Payload bytes
+    };
+
+    struct TileRect
+    {
+        int32_t x0, y0, width, height;
+    };
+
+    // Coordinator and workers are the same executable, so the settings travel as they are in memory
+    struct JobMessage
+    {
+        GenerationSettings settings;
+        TileRect tile;
+    };
+    static_assert(std::is_trivially_copyable_v<JobMessage>);
+
+    bool SendAll(SocketHandle socket, const void* data, size_t size)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0)
+        {
+            const int chunk = static_cast<int>(std::min<size_t>(size, 1 << 30));
+            const int sent = send(socket, bytes, chunk, SEND_FLAGS);
+            if (sent <= 0)
+                return false;
+            bytes += sent;
+            size -= sent;
+        }
+        return true;
+    }
+
+    bool ReceiveAll(SocketHandle socket, void* data, size_t size)
+    {
+        char* bytes = static_cast<char*>(data);
+        while (size > 0)
+        {
+            const int chunk = static_cast<int>(std::min<size_t>(size, 1 << 30));
+            const int received = recv(socket, bytes, chunk, 0);
+            if (received <= 0)
+                return false;
+            bytes += received;
+            size -= received;
+        }
+        return true;
+    }
+
+    bool SendMessage(SocketHandle socket, MessageType type, const void* payload = nullptr, size_t size = 0)
+    {
+        const MessageHeader header = { MESSAGE_MAGIC, type, static_cast<uint32_t>(size) };
+        return SendAll(socket, &header, sizeof(header)) && (size == 0 || SendAll(socket, payload, size));
+    }
+
+    bool ReceiveHeader(SocketHandle socket, MessageHeader& header)
+    {
+        return ReceiveAll(socket, &header, sizeof(header)) && header.magic == MESSAGE_MAGIC;
+    }
+
+    void DisableDelay(SocketHandle socket)
+    {
+        const int enable = 1;
+        setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&enable), sizeof(enable));
+    }
+
+    bool ParseAddress(const std::string& address, sockaddr_in& result)
+    {
+        const size_t colon = address.rfind(':');
+        if (colon == std::string::npos)
+            return false;
+
+        std::memset(&result, 0, sizeof(result));
+        result.sin_family = AF_INET;
+        result.sin_port = htons(static_cast<uint16_t>(std::atoi(address.c_str() + colon + 1)));
+        return inet_pton(AF_INET, address.substr(0, colon).c_str(), &result.sin_addr) == 1;
+    }
+
+    // Wait for a connection on a listening socket, INVALID_HANDLE on timeout
+    SocketHandle AcceptWithTimeout(SocketHandle listener, int seconds)
+    {
+        fd_set set;
+        FD_ZERO(&set);
+        FD_SET(listener, &set);
+        timeval timeout = { seconds, 0 };
+        if (select(static_cast<int>(listener) + 1, &set, nullptr, nullptr, &timeout) <= 0)
+            return INVALID_HANDLE;
+        return accept(listener, nullptr, nullptr);
+    }
+
+    std::vector<TileRect> SplitTiles(int size, int tileSize)
+    {
+        std::vector<TileRect> tiles;
+        for (int y = 0; y < size; y += tileSize)
+        {
+            for (int x = 0; x < size; x += tileSize)
+                tiles.push_back({ x, y, std::min(tileSize, size - x), std::min(tileSize, size - y) });
+        }
+        return tiles;
+    }
+
+    void CopyTile(const TileRect& tile, const float* source, float* map, int size)
+    {
+        for (int y = 0; y < tile.height; ++y)
+        {
+            const float* row = source + static_cast<size_t>(y) * tile.width;
+            std::copy(row, row + tile.width, map + static_cast<size_t>(tile.y0 + y) * size + tile.x0);
+        }
+    }
+
+    double SecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+namespace Distributed
+{
+    bool ParseArguments(int argc, char** argv, DistributedSettings& settings)
+    {
+        bool coordinatorMode = false;
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+
+            if (arg == "--coordinator")
+                coordinatorMode = true;
+            else if (arg == "--workers" && hasValue)
+                settings.workerCount = std::max(1, std::atoi(argv[++i]));
+            else if (arg == "--world-size" && hasValue)
+                settings.preset.size = std::max(2, std::atoi(argv[++i]));
+            else if (arg == "--tile" && hasValue)
+                settings.tileSize = std::max(16, std::atoi(argv[++i]));
+            else if (arg == "--seed" && hasValue)
+                settings.preset.seed = std::atoi(argv[++i]);
+            else if (arg == "--erosion" && hasValue)
+                settings.preset.erosion.iterations = std::max(0, std::atoi(argv[++i]));
+            else if (arg == "--port" && hasValue)
+                settings.port = std::atoi(argv[++i]);
+            else if (arg == "--out" && hasValue)
+                settings.outputPath = argv[++i];
+            else if (arg == "--scale" && hasValue)
+                settings.preset.heightScale = static_cast<float>(std::atof(argv[++i]));
+            else if (arg == "--verify")
+                settings.verify = true;
+        }
+
+        return coordinatorMode;
+    }
+
+    bool ParseWorkerArguments(int argc, char** argv, std::string& address, int& threadCount)
+    {
+        bool workerMode = false;
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+
+            if (arg == "--worker" && hasValue)
+            {
+                workerMode = true;
+                address = argv[++i];
+            }
+            else if (arg == "--threads" && hasValue)
+                threadCount = std::max(0, std::atoi(argv[++i]));
+        }
+        return workerMode;
+    }
+
+    int RunCoordinator(const DistributedSettings& settings, const char* executable)
+    {
+        const NetworkScope network;
+        if (!network.valid)
+        {
+            std::cerr << "Network initialisation failed." << std::endl;
+            return -1;
+        }
+
+        SocketHandle listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(settings.port));
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t addressSize = sizeof(address);
+        if (listener == INVALID_HANDLE
+            || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+            || listen(listener, settings.workerCount) != 0
+            || getsockname(listener, reinterpret_cast<sockaddr*>(&address), &addressSize) != 0)
+        {
+            std::cerr << "Cannot listen on port " << settings.port << "." << std::endl;
+            if (listener != INVALID_HANDLE)
+                CloseSocket(listener);
+            return -1;
+        }
+
+        // The hardware threads are shared between the workers
+        const int workerThreads = std::max(1, Parallel::ThreadCount() / settings.workerCount);
+        std::string command = std::string("\"") + executable + "\" --worker 127.0.0.1:" + std::to_string(ntohs(address.sin_port))
+                            + " --threads " + std::to_string(workerThreads);
+#ifdef _WIN32
+        command = "\"" + command + "\""; // cmd strips the outer quotes
+#endif
+
+        std::vector<std::thread> processes;
+        for (int i = 0; i < settings.workerCount; ++i)
+            processes.emplace_back([command]() { std::system(command.c_str()); });
+
+        std::vector<SocketHandle> connections;
+        while (static_cast<int>(connections.size()) < settings.workerCount)
+        {
+            const SocketHandle connection = AcceptWithTimeout(listener, ACCEPT_TIMEOUT_SECONDS);
+            if (connection == INVALID_HANDLE)
+                break;
+
+            MessageHeader hello;
+            if (!ReceiveHeader(connection, hello) || hello.type != MessageType::HELLO)
+            {
+                CloseSocket(connection);
+                continue;
+            }
+            DisableDelay(connection);
+            connections.push_back(connection);
+        }
+        CloseSocket(listener);
+
+        if (static_cast<int>(connections.size()) < settings.workerCount)
+            std::cerr << connections.size() << " of " << settings.workerCount << " workers connected." << std::endl;
+
+        // Tiles are handed out on demand, so faster workers take more of them
+        const GenerationSettings generation = settings.preset.generation();
+        const int size = generation.size;
+        const std::vector<TileRect> tiles = SplitTiles(size, settings.tileSize);
+        std::vector<float> map(static_cast<size_t>(size) * size);
+        std::vector<char> done(tiles.size(), 0);
+        std::vector<int> tileCounts(connections.size(), 0);
+        std::atomic<int> nextTile = 0;
+
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> links;
+        for (size_t c = 0; c < connections.size(); ++c)
+        {
+            links.emplace_back([&, c]()
+            {
+                const SocketHandle connection = connections[c];
+                std::vector<float> heights;
+                for (int t = nextTile++; t < static_cast<int>(tiles.size()); t = nextTile++)
+                {
+                    const TileRect& tile = tiles[t];
+                    const JobMessage job = { generation, tile };
+                    const size_t resultSize = static_cast<size_t>(tile.width) * tile.height * sizeof(float);
+                    heights.resize(static_cast<size_t>(tile.width) * tile.height);
+
+                    MessageHeader header;
+                    TileRect resultTile;
+                    if (!SendMessage(connection, MessageType::JOB, &job, sizeof(job))
+                        || !ReceiveHeader(connection, header) || header.type != MessageType::RESULT
+                        || header.size != sizeof(TileRect) + resultSize
+                        || !ReceiveAll(connection, &resultTile, sizeof(resultTile))
+                        || !ReceiveAll(connection, heights.data(), resultSize))
+                    {
+                        // The remaining tiles go to the other workers, this one is generated in-process later
+                        std::cerr << "Worker " << c << " dropped out." << std::endl;
+                        return;
+                    }
+
+                    CopyTile(tile, heights.data(), map.data(), size);
+                    done[t] = 1;
+                    ++tileCounts[c];
+                }
+                SendMessage(connection, MessageType::STOP);
+            });
+        }
+        for (auto& link : links)
+            link.join();
+
+        int localTiles = 0;
+        for (size_t t = 0; t < tiles.size(); ++t)
+        {
+            if (done[t])
+                continue;
+            const TileRect& tile = tiles[t];
+            std::vector<float> heights(static_cast<size_t>(tile.width) * tile.height);
+            TileGeneration::GenerateTile(generation, tile.x0, tile.y0, tile.width, tile.height, heights);
+            CopyTile(tile, heights.data(), map.data(), size);
+            ++localTiles;
+        }
+        const double generationTime = SecondsSince(start);
+
+        for (SocketHandle connection : connections)
+            CloseSocket(connection);
+        for (auto& process : processes)
+            process.join();
+
+        std::cout << "Generated " << size << "x" << size << " samples in " << tiles.size() << " tiles of " << settings.tileSize
+                  << " (halo " << Erosion::Halo(generation.erosion) << ") in " << generationTime << " s" << std::endl;
+        for (size_t c = 0; c < connections.size(); ++c)
+            std::cout << "  worker " << c << ": " << tileCounts[c] << " tiles" << std::endl;
+        if (localTiles > 0)
+            std::cout << "  coordinator: " << localTiles << " tiles" << std::endl;
+
+        int result = 0;
+        if (settings.verify)
+        {
+            const auto verifyStart = std::chrono::steady_clock::now();
+            std::vector<float> reference(map.size());
+            TileGeneration::GenerateMap(generation, reference);
+            const double referenceTime = SecondsSince(verifyStart);
+
+            const bool identical = std::memcmp(reference.data(), map.data(), map.size() * sizeof(float)) == 0;
+            std::cout << "Single process: " << referenceTime << " s, speedup " << referenceTime / generationTime
+                      << (identical ? ", identical" : ", MISMATCH") << std::endl;
+            if (!identical)
+                result = -1;
+        }
+
+        if (!settings.outputPath.empty())
+        {
+            ExportSettings exportSettings;
+            exportSettings.path = settings.outputPath;
+            exportSettings.format = MeshExport::FormatFromPath(settings.outputPath);
+            exportSettings.width = exportSettings.height = size;
+            exportSettings.step = generation.step;
+            exportSettings.heightScale = settings.preset.heightScale;
+
+            auto source = [&](int firstRow, int rowCount, std::span<float> heights)
+            {
+                std::copy(map.begin() + static_cast<size_t>(firstRow) * size, map.begin() + static_cast<size_t>(firstRow + rowCount) * size, heights.begin());
+            };
+            if (!MeshExport::ExportGrid(exportSettings, source))
+            {
+                std::cerr << "Export to " << settings.outputPath << " failed." << std::endl;
+                result = -1;
+            }
+        }
+
+        return result;
+    }
+
+    int RunWorker(const std::string& address, int threadCount)
+    {
+        const NetworkScope network;
+        sockaddr_in coordinator;
+        if (!network.valid || !ParseAddress(address, coordinator))
+        {
+            std::cerr << "Invalid coordinator address " << address << "." << std::endl;
+            return -1;
+        }
+
+        Parallel::ThreadLimit() = threadCount;
+
+        // The coordinator may still be starting
+        SocketHandle connection = INVALID_HANDLE;
+        for (int attempt = 0; attempt < CONNECT_ATTEMPTS && connection == INVALID_HANDLE; ++attempt)
+        {
+            connection = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            if (connection != INVALID_HANDLE && connect(connection, reinterpret_cast<sockaddr*>(&coordinator), sizeof(coordinator)) != 0)
+            {
+                CloseSocket(connection);
+                connection = INVALID_HANDLE;
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            }
+        }
+        if (connection == INVALID_HANDLE || !SendMessage(connection, MessageType::HELLO))
+        {
+            std::cerr << "Cannot connect to " << address << "." << std::endl;
+            if (connection != INVALID_HANDLE)
+                CloseSocket(connection);
+            return -1;
+        }
+        DisableDelay(connection);
+
+        std::vector<char> result;
+        MessageHeader header;
+        while (ReceiveHeader(connection, header) && header.type == MessageType::JOB && header.size == sizeof(JobMessage))
+        {
+            JobMessage job;
+            if (!ReceiveAll(connection, &job, sizeof(job)))
+                break;
+
+            const TileRect& tile = job.tile;
+            const size_t heightsSize = static_cast<size_t>(tile.width) * tile.height * sizeof(float);
+            result.resize(sizeof(TileRect) + heightsSize);
+            std::memcpy(result.data(), &tile, sizeof(TileRect));
+            TileGeneration::GenerateTile(job.settings, tile.x0, tile.y0, tile.width, tile.height,
+                                         std::span<float>(reinterpret_cast<float*>(result.data() + sizeof(TileRect)), heightsSize / sizeof(float)));
+
+            if (!SendMessage(connection, MessageType::RESULT, result.data(), result.size()))
+                break;
+        }
+
+        CloseSocket(connection);
+        return 0;
+    }
+}
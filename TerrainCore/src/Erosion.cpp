@@ -0,0 +1,68 @@
+#include "Erosion.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "OutputSpan.h"
+#include "Parallel.h"
+
+namespace Erosion
+{
+    bool Thermal(std::span<float> heights, int width, int height, const ErosionSettings& settings)
+    {
+        if (settings.iterations <= 0 || width <= 0 || height <= 0)
+            return true;
+        if (!OutputSpan::Fits(heights, static_cast<size_t>(width) * height, "Erosion::Thermal"))
+            return false;
+
+        // 4 neighbours: rates above 1/8 could overshoot
+        const float rate = std::clamp(settings.rate, 0.f, 0.125f);
+        const float talus = settings.talus;
+
+        std::vector<float> next(static_cast<size_t>(width) * height);
+        float* current = heights.data();
+        float* target = next.data();
+
+        for (int iteration = 0; iteration < settings.iterations; ++iteration)
+        {
+            Parallel::For(0, height, [&](int y)
+            {
+                const float* row = current + static_cast<size_t>(y) * width;
+                float* out = target + static_cast<size_t>(y) * width;
+                for (int x = 0; x < width; ++x)
+                {
+                    const float h = row[x];
+
+                    // Pairwise exchanges are antisymmetric, so material is conserved
+                    auto exchange = [&](float neighbour)
+                    {
+                        const float difference = neighbour - h;
+                        if (difference > talus)
+                            return rate * (difference - talus);
+                        if (difference < -talus)
+                            return rate * (difference + talus);
+                        return 0.f;
+                    };
+
+                    float delta = 0.f;
+                    if (x > 0)
+                        delta += exchange(row[x - 1]);
+                    if (x + 1 < width)
+                        delta += exchange(row[x + 1]);
+                    if (y > 0)
+                        delta += exchange(row[x - width]);
+                    if (y + 1 < height)
+                        delta += exchange(row[x + width]);
+
+                    out[x] = h + delta;
+                }
+            });
+
+            std::swap(current, target);
+        }
+
+        if (current != heights.data())
+            std::copy(current, current + static_cast<size_t>(width) * height, heights.data());
+        return true;
+    }
+}
@@ -0,0 +1,107 @@
+#include "GenerationGraph.h"
+
+#include <chrono>
+
+namespace
+{
+    // Run compute and store its duration in milliseconds
+    template<typename Fn>
+    auto Timed(double& time, Fn&& compute)
+    {
+        return [&time, &compute]()
+        {
+            const auto start = std::chrono::steady_clock::now();
+            auto result = compute();
+            time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            return result;
+        };
+    }
+}
+
+uint64_t GenerationGraph::heightsKey() const
+{
+    const GenerationSettings settings = m_preset.generation();
+
+    InputHash hash;
+    hash.add(settings.seed).add(settings.size).add(settings.step)
+        .add(settings.origin.x).add(settings.origin.z)
+        .add(settings.erosion.iterations).add(settings.erosion.talus).add(settings.erosion.rate)
+        .add(settings.stageCount);
+    for (int s = 0; s < settings.stageCount; ++s)
+    {
+        const NoiseStage& stage = settings.stages[s];
+        hash.add(stage.type).add(stage.frequency).add(stage.amplitude).add(stage.seedOffset);
+    }
+    return hash.value();
+}
+
+uint64_t GenerationGraph::materialsKey() const
+{
+    const BiomeSettings settings = biomeSettings();
+
+    InputHash hash;
+    hash.add(heightsKey()).add(settings.seed).add(settings.origin.x).add(settings.origin.y).add(settings.step)
+        .add(settings.heightScale).add(settings.climateFrequency)
+        .add(settings.sandHeight).add(settings.snowHeight).add(settings.rockSlope);
+    return hash.value();
+}
+
+BiomeSettings GenerationGraph::biomeSettings() const
+{
+    BiomeSettings settings = m_preset.biomes;
+    settings.seed = m_preset.seed;
+    settings.origin = { -1.f, -1.f };
+    settings.step = m_preset.step();
+    settings.heightScale = m_preset.heightScale;
+    return settings;
+}
+
+std::shared_ptr<const std::vector<float>> GenerationGraph::heights()
+{
+    return m_heights.evaluate(heightsKey(), Timed(m_stats.heightsTime, [&]()
+    {
+        const GenerationSettings settings = m_preset.generation();
+        std::vector<float> heights(static_cast<size_t>(settings.size) * settings.size);
+        TileGeneration::GenerateMap(settings, heights);
+        return heights;
+    }));
+}
+
+std::shared_ptr<const std::vector<uint8_t>> GenerationGraph::materials()
+{
+    return m_materials.evaluate(materialsKey(), Timed(m_stats.materialsTime, [&]()
+    {
+        const auto map = heights();
+        const int size = m_preset.size;
+        std::vector<uint8_t> weights(static_cast<size_t>(size) * size * 4);
+        BiomeClassifier(biomeSettings()).classify(*map, size, weights);
+        return weights;
+    }));
+}
+
+std::shared_ptr<const TerrainSimplifier> GenerationGraph::simplifier()
+{
+    return m_simplifier.evaluate(heightsKey(), Timed(m_stats.errorsTime, [&]()
+    {
+        const auto map = heights();
+        TerrainSimplifier simplifier(m_preset.size);
+        simplifier.computeErrors(map->data());
+        return simplifier;
+    }));
+}
+
+bool GenerationGraph::setHeights(std::vector<float> heights)
+{
+    if (heights.size() != static_cast<size_t>(m_preset.size) * m_preset.size)
+        return false;
+
+    m_heights.insert(heightsKey(), std::make_shared<const std::vector<float>>(std::move(heights)));
+    return true;
+}
+
+void GenerationGraph::trimCaches()
+{
+    m_heights.trim();
+    m_materials.trim();
+    m_simplifier.trim();
+}
@@ -0,0 +1,57 @@
+#include "GridMesh.h"
+
+#include "OutputSpan.h"
+#include "Parallel.h"
+
+namespace GridMesh
+{
+    bool Write(const HeightfieldView& heightfield, std::span<float> positions, std::span<uint32_t> indices)
+    {
+        const int size = heightfield.valid() ? heightfield.size : 0;
+        if (!OutputSpan::Fits(positions, PositionCount(size), "GridMesh::Write") ||
+            !OutputSpan::Fits(indices, IndexCount(size), "GridMesh::Write"))
+            return false;
+
+        Parallel::For(0, size, [&](int y)
+        {
+            WriteRow(heightfield, 0, y, size, positions.data() + static_cast<size_t>(y) * size * 3);
+
+            if (y + 1 == size)
+                return;
+
+            uint32_t* index = indices.data() + static_cast<size_t>(y) * (size - 1) * 6;
+            for (int x = 0; x + 1 < size; ++x)
+            {
+                const uint32_t v = y * size + x;
+                *index++ = v;
+                *index++ = v + size;
+                *index++ = v + size + 1;
+                *index++ = v;
+                *index++ = v + size + 1;
+                *index++ = v + 1;
+            }
+        });
+        return true;
+    }
+
+    void WriteRow(const HeightfieldView& heightfield, int x, int y, int width, float* positions)
+    {
+        const float* row = heightfield.heights + static_cast<size_t>(y) * heightfield.size;
+        for (int i = x; i < x + width; ++i)
+        {
+            *positions++ = heightfield.origin.x + i * heightfield.step;
+            *positions++ = row[i] * heightfield.heightScale;
+            *positions++ = heightfield.origin.y + y * heightfield.step;
+        }
+    }
+
+    TerrainMesh Build(const HeightfieldView& heightfield)
+    {
+        const int size = heightfield.valid() ? heightfield.size : 0;
+        TerrainMesh mesh;
+        mesh.positions.resize(PositionCount(size));
+        mesh.indices.resize(IndexCount(size));
+        Write(heightfield, mesh.positions, mesh.indices);
+        return mesh;
+    }
+}
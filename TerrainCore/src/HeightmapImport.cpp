@@ -0,0 +1,742 @@
+#include "HeightmapImport.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <zlib.h>
+
+#include "OutputSpan.h"
+#include "Parallel.h"
+
+namespace
+{
+    // Output rows per band of the band sink import
+    constexpr int BAND_ROWS = 64;
+
+    // Compressed bytes fed to inflate at once
+    constexpr size_t PNG_INPUT_BYTES = 64 << 10;
+
+    // Bounds of the header fields, so that a corrupt file cannot allocate much
+    constexpr int MAX_RASTER_SIDE = 1 << 20;
+    constexpr uint32_t MAX_TIFF_STRIPS = 1 << 24;
+
+    float Finite(float value)
+    {
+        // No-data samples of DEMs (NaN, infinities) would spread through the resampling
+        return std::isfinite(value) ? value : 0.f;
+    }
+
+    // Grayscale PNG: chunks are read as inflate needs them, scanlines are unfiltered against the previous one
+    class PngReader : public RasterReader
+    {
+    public:
+        explicit PngReader(const std::string& path)
+            : m_path(path), m_file(path, std::ios::binary)
+        {
+        }
+
+        ~PngReader() override
+        {
+            if (m_inflating)
+                inflateEnd(&m_stream);
+        }
+
+        bool open()
+        {
+            constexpr uint8_t SIGNATURE[8] = { 137, 'P', 'N', 'G', '\r', '\n', 26, '\n' };
+            uint8_t signature[8];
+            uint8_t header[8];
+            uint8_t ihdr[13];
+            if (!read(signature, sizeof(signature)) || std::memcmp(signature, SIGNATURE, sizeof(SIGNATURE)) != 0
+                || !read(header, sizeof(header)) || BigEndian32(header) != sizeof(ihdr) || std::memcmp(header + 4, "IHDR", 4) != 0
+                || !read(ihdr, sizeof(ihdr)) || !m_file.ignore(4))
+                return fail("is not a PNG file");
+
+            const uint32_t width = BigEndian32(ihdr);
+            const uint32_t height = BigEndian32(ihdr + 4);
+            const int bitDepth = ihdr[8];
+            const int colorType = ihdr[9];
+            if (width == 0 || height == 0 || width > MAX_RASTER_SIDE || height > MAX_RASTER_SIDE)
+                return fail("has an invalid size");
+            if ((colorType != 0 && colorType != 4) || (bitDepth != 8 && bitDepth != 16))
+                return fail("is not an 8 or 16-bit grayscale PNG");
+            if (ihdr[10] != 0 || ihdr[11] != 0 || ihdr[12] != 0)
+                return fail("is interlaced or uses an unknown compression");
+
+            m_width = static_cast<int>(width);
+            m_height = static_cast<int>(height);
+            m_bytesPerSample = bitDepth / 8;
+            // Gray + alpha: the alpha channel is skipped
+            m_bytesPerPixel = m_bytesPerSample * (colorType == 4 ? 2 : 1);
+            m_row.assign(1 + static_cast<size_t>(m_width) * m_bytesPerPixel, 0);
+            m_previous.assign(m_row.size(), 0);
+            m_input.resize(PNG_INPUT_BYTES);
+
+            m_stream = {};
+            if (inflateInit(&m_stream) != Z_OK)
+                return fail("cannot be inflated");
+            m_inflating = true;
+            return true;
+        }
+
+        bool readRow(std::span<float> row) override
+        {
+            if (m_rowIndex >= m_height || !OutputSpan::Fits(row, m_width, "PngReader::readRow"))
+                return false;
+
+            m_stream.next_out = m_row.data();
+            m_stream.avail_out = static_cast<uInt>(m_row.size());
+            while (m_stream.avail_out > 0)
+            {
+                if (m_stream.avail_in == 0 && !fillInput())
+                    return fail("is truncated");
+
+                const int result = inflate(&m_stream, Z_NO_FLUSH);
+                if (result == Z_STREAM_END && m_stream.avail_out > 0)
+                    return fail("has fewer rows than its header");
+                if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+                    return fail("is corrupt");
+            }
+
+            if (!unfilter())
+                return fail("has an unknown row filter");
+
+            const uint8_t* data = m_row.data() + 1;
+            if (m_bytesPerSample == 2)
+            {
+                for (int x = 0; x < m_width; ++x)
+                {
+                    const uint8_t* sample = data + static_cast<size_t>(x) * m_bytesPerPixel;
+                    row[x] = ((sample[0] << 8) | sample[1]) * (1.f / 65535.f);
+                }
+            }
+            else
+            {
+                for (int x = 0; x < m_width; ++x)
+                    row[x] = data[static_cast<size_t>(x) * m_bytesPerPixel] * (1.f / 255.f);
+            }
+
+            m_row.swap(m_previous);
+            ++m_rowIndex;
+            return true;
+        }
+
+    private:
+        static uint32_t BigEndian32(const uint8_t* bytes)
+        {
+            return (static_cast<uint32_t>(bytes[0]) << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+        }
+
+        bool read(void* data, size_t bytes)
+        {
+            return static_cast<bool>(m_file.read(static_cast<char*>(data), bytes));
+        }
+
+        bool fail(const char* reason)
+        {
+            std::cerr << m_path << " " << reason << "." << std::endl;
+            return false;
+        }
+
+        // Next compressed bytes, from the current IDAT chunk or the following ones
+        bool fillInput()
+        {
+            while (m_chunkRemaining == 0)
+            {
+                uint8_t header[8];
+                if (!read(header, sizeof(header)) || std::memcmp(header + 4, "IEND", 4) == 0)
+                    return false;
+
+                const uint32_t length = BigEndian32(header);
+                if (std::memcmp(header + 4, "IDAT", 4) == 0)
+                    m_chunkRemaining = length;
+                else if (!m_file.ignore(static_cast<std::streamsize>(length) + 4))
+                    return false;
+
+                // Empty IDAT, skip its CRC
+                if (m_chunkRemaining == 0 && std::memcmp(header + 4, "IDAT", 4) == 0 && !m_file.ignore(4))
+                    return false;
+            }
+
+            const size_t bytes = std::min<size_t>(m_chunkRemaining, m_input.size());
+            if (!read(m_input.data(), bytes))
+                return false;
+            m_chunkRemaining -= static_cast<uint32_t>(bytes);
+            if (m_chunkRemaining == 0 && !m_file.ignore(4))
+                return false;
+
+            m_stream.next_in = m_input.data();
+            m_stream.avail_in = static_cast<uInt>(bytes);
+            return true;
+        }
+
+        bool unfilter()
+        {
+            uint8_t* row = m_row.data() + 1;
+            const uint8_t* prior = m_previous.data() + 1;
+            const size_t bytes = m_row.size() - 1;
+            const size_t bpp = m_bytesPerPixel;
+            switch (m_row[0])
+            {
+            case 0:
+                break;
+            case 1:
+                for (size_t i = bpp; i < bytes; ++i)
+                    row[i] = static_cast<uint8_t>(row[i] + row[i - bpp]);
+                break;
+            case 2:
+                for (size_t i = 0; i < bytes; ++i)
+                    row[i] = static_cast<uint8_t>(row[i] + prior[i]);
+                break;
+            case 3:
+                for (size_t i = 0; i < bytes; ++i)
+                    row[i] = static_cast<uint8_t>(row[i] + (((i >= bpp ? row[i - bpp] : 0) + prior[i]) >> 1));
+                break;
+            case 4:
+                for (size_t i = 0; i < bytes; ++i)
+                {
+                    const int a = i >= bpp ? row[i - bpp] : 0;
+                    const int b = prior[i];
+                    const int c = i >= bpp ? prior[i - bpp] : 0;
+                    const int pa = std::abs(b - c);
+                    const int pb = std::abs(a - c);
+                    const int pc = std::abs(a + b - 2 * c);
+                    row[i] = static_cast<uint8_t>(row[i] + (pa <= pb && pa <= pc ? a : pb <= pc ? b : c));
+                }
+                break;
+            default:
+                return false;
+            }
+            return true;
+        }
+
+        std::string m_path;
+        std::ifstream m_file;
+        z_stream m_stream = {};
+        bool m_inflating = false;
+        uint32_t m_chunkRemaining = 0;
+        std::vector<uint8_t> m_input;
+
+        int m_bytesPerSample = 2;
+        int m_bytesPerPixel = 2;
+        int m_rowIndex = 0;
+
+        // Filter byte followed by the scanline
+        std::vector<uint8_t> m_row;
+        std::vector<uint8_t> m_previous;
+    };
+
+    // Baseline TIFF: the first image of the file, read through its strip offsets
+    class TiffReader : public RasterReader
+    {
+    public:
+        explicit TiffReader(const std::string& path)
+            : m_path(path), m_file(path, std::ios::binary)
+        {
+        }
+
+        bool open()
+        {
+            uint8_t header[8];
+            if (!read(header, sizeof(header)) || !(header[0] == header[1] && (header[0] == 'I' || header[0] == 'M')))
+                return fail("is not a TIFF file");
+            m_bigEndian = header[0] == 'M';
+            if (value16(header + 2) == 43)
+                return fail("is a BigTIFF, which is not supported");
+            if (value16(header + 2) != 42)
+                return fail("is not a TIFF file");
+
+            uint8_t count[2];
+            if (!seek(value32(header + 4)) || !read(count, sizeof(count)))
+                return fail("is truncated");
+
+            uint32_t width = 0, height = 0, rowsPerStrip = 0;
+            int bitsPerSample = 1, samplesPerPixel = 1, compression = 1, sampleFormat = 1;
+            bool tiled = false;
+            std::array<uint8_t, 12> offsetsEntry = {}, countsEntry = {};
+            for (int i = 0, entries = value16(count); i < entries; ++i)
+            {
+                std::array<uint8_t, 12> entry;
+                if (!read(entry.data(), entry.size()))
+                    return fail("is truncated");
+
+                const uint32_t value = scalar(entry.data());
+                switch (value16(entry.data()))
+                {
+                case 256: width = value; break;
+                case 257: height = value; break;
+                case 258: bitsPerSample = static_cast<int>(value); break;
+                case 259: compression = static_cast<int>(value); break;
+                case 273: offsetsEntry = entry; break;
+                case 277: samplesPerPixel = static_cast<int>(value); break;
+                case 278: rowsPerStrip = value; break;
+                case 279: countsEntry = entry; break;
+                case 322: tiled = true; break;
+                case 339: sampleFormat = static_cast<int>(value); break;
+                default: break;     // GeoTIFF and other tags, e.g. georeferencing, are ignored
+                }
+            }
+
+            if (width == 0 || height == 0 || width > MAX_RASTER_SIDE || height > MAX_RASTER_SIDE)
+                return fail("has an invalid size");
+            if (tiled || compression != 1)
+                return fail("is tiled or compressed, only uncompressed strips are supported");
+            if (samplesPerPixel != 1)
+                return fail("has more than one channel");
+            if (!((bitsPerSample == 16 && (sampleFormat == 1 || sampleFormat == 2)) || (bitsPerSample == 32 && sampleFormat == 3)))
+                return fail("is not uint16, int16 or float32");
+
+            m_width = static_cast<int>(width);
+            m_height = static_cast<int>(height);
+            m_sampleFormat = sampleFormat;
+            m_rowBytes = static_cast<size_t>(m_width) * (bitsPerSample / 8);
+            m_rowsPerStrip = rowsPerStrip == 0 ? height : std::min(rowsPerStrip, height);
+
+            const uint32_t stripCount = (height + m_rowsPerStrip - 1) / m_rowsPerStrip;
+            if (!values(offsetsEntry.data(), m_stripOffsets) || !values(countsEntry.data(), m_stripBytes)
+                || m_stripOffsets.size() < stripCount || m_stripBytes.size() < stripCount)
+                return fail("has invalid strips");
+
+            m_buffer.resize(m_rowBytes);
+            return true;
+        }
+
+        bool readRow(std::span<float> row) override
+        {
+            if (m_rowIndex >= m_height || !OutputSpan::Fits(row, m_width, "TiffReader::readRow"))
+                return false;
+
+            const uint32_t strip = static_cast<uint32_t>(m_rowIndex) / m_rowsPerStrip;
+            const uint64_t inStrip = static_cast<uint64_t>(m_rowIndex % m_rowsPerStrip) * m_rowBytes;
+            if (inStrip + m_rowBytes > m_stripBytes[strip])
+                return fail("has a truncated strip");
+
+            // Strips usually follow each other, seek only when they do not
+            const uint64_t offset = m_stripOffsets[strip] + inStrip;
+            if (offset != m_position && !seek(offset))
+                return fail("is truncated");
+            if (!read(m_buffer.data(), m_rowBytes))
+                return fail("is truncated");
+            m_position = offset + m_rowBytes;
+
+            const uint8_t* data = m_buffer.data();
+            for (int x = 0; x < m_width; ++x)
+            {
+                if (m_sampleFormat == 3)
+                {
+                    const uint32_t bits = value32(data + 4 * static_cast<size_t>(x));
+                    float sample;
+                    std::memcpy(&sample, &bits, sizeof(sample));
+                    row[x] = Finite(sample);
+                }
+                else if (m_sampleFormat == 2)
+                    row[x] = static_cast<int16_t>(value16(data + 2 * static_cast<size_t>(x))) * (1.f / 32767.f);
+                else
+                    row[x] = value16(data + 2 * static_cast<size_t>(x)) * (1.f / 65535.f);
+            }
+
+            ++m_rowIndex;
+            return true;
+        }
+
+    private:
+        bool read(void* data, size_t bytes)
+        {
+            return static_cast<bool>(m_file.read(static_cast<char*>(data), bytes));
+        }
+
+        bool seek(uint64_t offset)
+        {
+            m_file.clear();
+            return static_cast<bool>(m_file.seekg(static_cast<std::streamoff>(offset)));
+        }
+
+        bool fail(const char* reason)
+        {
+            std::cerr << m_path << " " << reason << "." << std::endl;
+            return false;
+        }
+
+        uint16_t value16(const uint8_t* bytes) const
+        {
+            return m_bigEndian ? static_cast<uint16_t>((bytes[0] << 8) | bytes[1]) : static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+        }
+
+        uint32_t value32(const uint8_t* bytes) const
+        {
+            return m_bigEndian ? (static_cast<uint32_t>(bytes[0]) << 24) | (bytes[1] << 16) | (bytes[2] << 8) | bytes[3]
+                               : bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+        }
+
+        // Single SHORT or LONG value of an IFD entry
+        uint32_t scalar(const uint8_t* entry) const
+        {
+            return value16(entry + 2) == 3 ? value16(entry + 8) : value32(entry + 8);
+        }
+
+        // SHORT or LONG array of an IFD entry, stored in the entry itself when it fits in 4 bytes
+        bool values(const uint8_t* entry, std::vector<uint64_t>& result)
+        {
+            const int type = value16(entry + 2);
+            const uint32_t count = value32(entry + 4);
+            if ((type != 3 && type != 4) || count == 0 || count > MAX_TIFF_STRIPS)
+                return false;
+
+            const size_t size = type == 3 ? 2 : 4;
+            std::vector<uint8_t> bytes(count * size);
+            if (bytes.size() <= 4)
+                std::memcpy(bytes.data(), entry + 8, bytes.size());
+            else if (!seek(value32(entry + 8)) || !read(bytes.data(), bytes.size()))
+                return false;
+
+            result.resize(count);
+            for (uint32_t i = 0; i < count; ++i)
+                result[i] = size == 2 ? value16(bytes.data() + 2 * i) : value32(bytes.data() + 4 * i);
+            return true;
+        }
+
+        std::string m_path;
+        std::ifstream m_file;
+        bool m_bigEndian = false;
+
+        int m_sampleFormat = 1;
+        size_t m_rowBytes = 0;
+        uint32_t m_rowsPerStrip = 0;
+        std::vector<uint64_t> m_stripOffsets;
+        std::vector<uint64_t> m_stripBytes;
+
+        int m_rowIndex = 0;
+        uint64_t m_position = ~0ull;
+        std::vector<uint8_t> m_buffer;
+    };
+
+    // Headerless float32 rows, little-endian as written by this and most tools on x86 / ARM
+    class RawReader : public RasterReader
+    {
+    public:
+        explicit RawReader(const std::string& path)
+            : m_path(path), m_file(path, std::ios::binary)
+        {
+        }
+
+        bool open(int width, int height)
+        {
+            std::error_code error;
+            const uint64_t bytes = std::filesystem::file_size(m_path, error);
+            if (!m_file || error)
+            {
+                std::cerr << "Cannot read " << m_path << "." << std::endl;
+                return false;
+            }
+            if (width <= 0 || height <= 0 || width > MAX_RASTER_SIDE || height > MAX_RASTER_SIDE)
+            {
+                std::cerr << m_path << ": a raw raster needs its size, e.g. --import-raw 4096x4096." << std::endl;
+                return false;
+            }
+            if (bytes < static_cast<uint64_t>(width) * height * sizeof(float))
+            {
+                std::cerr << m_path << " holds fewer than " << width << " x " << height << " floats." << std::endl;
+                return false;
+            }
+
+            m_width = width;
+            m_height = height;
+            return true;
+        }
+
+        bool readRow(std::span<float> row) override
+        {
+            if (m_rowIndex >= m_height || !OutputSpan::Fits(row, m_width, "RawReader::readRow"))
+                return false;
+            if (!m_file.read(reinterpret_cast<char*>(row.data()), static_cast<std::streamsize>(m_width) * sizeof(float)))
+            {
+                std::cerr << m_path << " is truncated." << std::endl;
+                return false;
+            }
+
+            for (int x = 0; x < m_width; ++x)
+                row[x] = Finite(row[x]);
+            ++m_rowIndex;
+            return true;
+        }
+
+    private:
+        std::string m_path;
+        std::ifstream m_file;
+        int m_rowIndex = 0;
+    };
+
+    // Source samples and weights of one output coordinate
+    struct Taps
+    {
+        int index[4] = {};
+        float weight[4] = {};
+    };
+
+    // Output coordinates [0, outputSize) spread over source [0, sourceSize - 1], corners on corners
+    std::vector<Taps> ComputeTaps(int sourceSize, int outputSize, ResampleFilter filter)
+    {
+        std::vector<Taps> taps(outputSize);
+        const double ratio = outputSize > 1 ? static_cast<double>(sourceSize - 1) / (outputSize - 1) : 0.0;
+        for (int i = 0; i < outputSize; ++i)
+        {
+            const double position = i * ratio;
+            const int base = std::min(static_cast<int>(position), std::max(0, sourceSize - 2));
+            const float t = static_cast<float>(position - base);
+            Taps& tap = taps[i];
+            if (filter == ResampleFilter::BICUBIC)
+            {
+                // Catmull-Rom, clamped at the borders
+                const float t2 = t * t;
+                const float t3 = t2 * t;
+                tap.weight[0] = 0.5f * (-t3 + 2.f * t2 - t);
+                tap.weight[1] = 0.5f * (3.f * t3 - 5.f * t2 + 2.f);
+                tap.weight[2] = 0.5f * (-3.f * t3 + 4.f * t2 + t);
+                tap.weight[3] = 0.5f * (t3 - t2);
+                for (int k = 0; k < 4; ++k)
+                    tap.index[k] = std::clamp(base - 1 + k, 0, sourceSize - 1);
+            }
+            else
+            {
+                tap.weight[0] = 1.f - t;
+                tap.weight[1] = t;
+                tap.index[0] = base;
+                tap.index[1] = std::min(base + 1, sourceSize - 1);
+            }
+        }
+        return taps;
+    }
+
+    bool ImportBands(const ImportSettings& settings, int bandRows, const HeightBandSink& sink, ImportStats* stats)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const std::unique_ptr<RasterReader> reader = HeightmapImport::Open(settings);
+        if (!reader)
+            return false;
+
+        const int size = settings.size;
+        if (size < 2)
+        {
+            std::cerr << "HeightmapImport: the output size must be 2 or more." << std::endl;
+            return false;
+        }
+
+        // Top-left square of the raster, the terrain being square
+        const int width = reader->getWidth();
+        const int source = std::min(width, reader->getHeight());
+        const int tapCount = settings.filter == ResampleFilter::BICUBIC ? 4 : 2;
+        const std::vector<Taps> columns = ComputeTaps(source, size, settings.filter);
+        const std::vector<Taps> rows = ComputeTaps(source, size, settings.filter);
+
+        // Only the source rows used by a band are kept, in recycled buffers; the others are decoded and dropped
+        std::vector<char> used(source, 0);
+        for (const Taps& tap : rows)
+        {
+            for (int k = 0; k < tapCount; ++k)
+                used[tap.index[k]] = 1;
+        }
+        std::vector<int> slotOf(source, -1);
+        std::vector<std::vector<float>> slots;
+        std::vector<int> freeSlots;
+        std::vector<float> decoded(width);
+        int nextRow = 0;
+        int firstKept = 0;
+        int peakRows = 0;
+
+        std::vector<float> band(static_cast<size_t>(bandRows) * size);
+        for (int y0 = 0; y0 < size; y0 += bandRows)
+        {
+            const int count = std::min(bandRows, size - y0);
+            const int first = rows[y0].index[0];
+            const int last = rows[y0 + count - 1].index[tapCount - 1];
+
+            // Release the rows above the band
+            for (; firstKept < std::min(first, nextRow); ++firstKept)
+            {
+                if (slotOf[firstKept] >= 0)
+                {
+                    freeSlots.push_back(slotOf[firstKept]);
+                    slotOf[firstKept] = -1;
+                }
+            }
+
+            for (; nextRow <= last; ++nextRow)
+            {
+                if (!reader->readRow(decoded))
+                    return false;
+                if (!used[nextRow] || nextRow < first)
+                    continue;
+
+                if (freeSlots.empty())
+                {
+                    freeSlots.push_back(static_cast<int>(slots.size()));
+                    slots.emplace_back(source);
+                }
+                slotOf[nextRow] = freeSlots.back();
+                freeSlots.pop_back();
+                std::copy(decoded.begin(), decoded.begin() + source, slots[slotOf[nextRow]].begin());
+            }
+            peakRows = std::max(peakRows, static_cast<int>(slots.size() - freeSlots.size()));
+
+            Parallel::For(0, count, [&](int r)
+            {
+                const Taps& rowTaps = rows[y0 + r];
+                const float* sourceRows[4] = {};
+                for (int k = 0; k < tapCount; ++k)
+                    sourceRows[k] = slots[slotOf[rowTaps.index[k]]].data();
+
+                float* output = band.data() + static_cast<size_t>(r) * size;
+                for (int x = 0; x < size; ++x)
+                {
+                    const Taps& columnTaps = columns[x];
+                    float value = 0.f;
+                    for (int j = 0; j < tapCount; ++j)
+                    {
+                        float line = 0.f;
+                        for (int i = 0; i < tapCount; ++i)
+                            line += columnTaps.weight[i] * sourceRows[j][columnTaps.index[i]];
+                        value += rowTaps.weight[j] * line;
+                    }
+                    output[x] = settings.offset + settings.scale * value;
+                }
+            });
+
+            const std::span<float> heights(band.data(), static_cast<size_t>(count) * size);
+            if (settings.addNoise && !TileGeneration::AddNoise(settings.noise, 0, y0, size, count, heights))
+                return false;
+            sink(y0, count, heights);
+        }
+
+        if (stats)
+        {
+            stats->sourceWidth = width;
+            stats->sourceHeight = reader->getHeight();
+            std::error_code error;
+            stats->sourceBytes = std::filesystem::file_size(settings.path, error);
+            stats->peakSourceRows = peakRows;
+            stats->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        return true;
+    }
+}
+
+namespace HeightmapImport
+{
+    RasterFormat FormatFromPath(const std::string& path)
+    {
+        std::string extension = std::filesystem::path(path).extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (extension == ".raw" || extension == ".f32" || extension == ".bin")
+            return RasterFormat::RAW_FLOAT32;
+        if (extension == ".tif" || extension == ".tiff")
+            return RasterFormat::TIFF;
+        return RasterFormat::PNG16;
+    }
+
+    std::unique_ptr<RasterReader> Open(const ImportSettings& settings)
+    {
+        if (!std::filesystem::exists(settings.path))
+        {
+            std::cerr << "Cannot read " << settings.path << "." << std::endl;
+            return nullptr;
+        }
+
+        switch (settings.format)
+        {
+        case RasterFormat::PNG16:
+        {
+            auto reader = std::make_unique<PngReader>(settings.path);
+            return reader->open() ? std::move(reader) : nullptr;
+        }
+        case RasterFormat::TIFF:
+        {
+            auto reader = std::make_unique<TiffReader>(settings.path);
+            return reader->open() ? std::move(reader) : nullptr;
+        }
+        case RasterFormat::RAW_FLOAT32:
+        {
+            auto reader = std::make_unique<RawReader>(settings.path);
+            return reader->open(settings.rawWidth, settings.rawHeight) ? std::move(reader) : nullptr;
+        }
+        }
+        return nullptr;
+    }
+
+    bool Import(const ImportSettings& settings, const HeightBandSink& sink, ImportStats* stats)
+    {
+        return ImportBands(settings, BAND_ROWS, sink, stats);
+    }
+
+    bool Import(const ImportSettings& settings, CompressedHeightmap& heightmap, ImportStats* stats)
+    {
+        heightmap = CompressedHeightmap(settings.size, settings.size, settings.encoding, settings.tolerance);
+        const int tileSize = heightmap.getTileSize();
+
+        // A band is one row of tiles, encoded in parallel
+        return ImportBands(settings, tileSize, [&](int firstRow, int, std::span<const float> heights)
+        {
+            Parallel::For(0, heightmap.getTilesX(), [&](int tx)
+            {
+                heightmap.setTile(tx, firstRow / tileSize, heights.data() + tx * tileSize, settings.size);
+            });
+        }, stats);
+    }
+
+    bool ParseArguments(int argc, char** argv, ImportSettings& settings, const TerrainPreset& preset)
+    {
+        bool importMode = false;
+        float noiseAmplitude = 0.f;
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+
+            if (arg == "--import" && hasValue)
+            {
+                importMode = true;
+                settings.path = argv[++i];
+            }
+            else if (arg == "--import-size" && hasValue)
+                settings.size = std::max(2, std::atoi(argv[++i]));
+            else if (arg == "--import-raw" && hasValue)
+            {
+                const std::string size = argv[++i];
+                const size_t separator = size.find('x');
+                settings.rawWidth = std::atoi(size.c_str());
+                settings.rawHeight = separator != std::string::npos ? std::atoi(size.c_str() + separator + 1) : settings.rawWidth;
+            }
+            else if (arg == "--import-filter" && hasValue)
+                settings.filter = std::string(argv[++i]) == "bilinear" ? ResampleFilter::BILINEAR : ResampleFilter::BICUBIC;
+            else if (arg == "--import-scale" && hasValue)
+                settings.scale = static_cast<float>(std::atof(argv[++i]));
+            else if (arg == "--import-offset" && hasValue)
+                settings.offset = static_cast<float>(std::atof(argv[++i]));
+            else if (arg == "--import-noise" && hasValue)
+                noiseAmplitude = static_cast<float>(std::atof(argv[++i]));
+        }
+
+        settings.format = FormatFromPath(settings.path);
+
+        // Noise of the preset at the output resolution, scaled
+        if (noiseAmplitude != 0.f)
+        {
+            TerrainPreset detail = preset;
+            detail.size = settings.size;
+            settings.noise = detail.generation();
+            for (int s = 0; s < settings.noise.stageCount; ++s)
+                settings.noise.stages[s].amplitude *= noiseAmplitude;
+            settings.addNoise = true;
+        }
+
+        return importMode;
+    }
+}
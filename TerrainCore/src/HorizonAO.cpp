@@ -0,0 +1,263 @@
+#include "HorizonAO.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "Parallel.h"
+
+namespace
+{
+    // FNV-1a over 32-bit words
+    uint64_t HashWords(uint64_t hash, const void* data, size_t count)
+    {
+        const uint32_t* words = static_cast<const uint32_t*>(data);
+        for (size_t i = 0; i < count; ++i)
+            hash = (hash ^ words[i]) * 0x100000001B3ull;
+        return hash;
+    }
+
+    template<typename T>
+    uint64_t HashValue(uint64_t hash, const T& value)
+    {
+        static_assert(sizeof(T) % 4 == 0);
+        uint32_t words[sizeof(T) / 4];
+        std::memcpy(words, &value, sizeof(T));
+        return HashWords(hash, words, sizeof(T) / 4);
+    }
+
+    uint8_t ToByte(float value)
+    {
+        return static_cast<uint8_t>(std::clamp(value, 0.f, 1.f) * 255.f + 0.5f);
+    }
+}
+
+HorizonAO::HorizonAO(const HorizonAOSettings& settings)
+    : m_settings(settings)
+{
+}
+
+int HorizonAO::radiusInTiles(const HeightfieldView& heightfield) const
+{
+    const float radiusTexels = m_settings.radius / (heightfield.step * m_stride);
+    return static_cast<int>(std::ceil((radiusTexels + 1.f) / TILE_SIZE));
+}
+
+void HorizonAO::markAround(std::vector<uint8_t>& marked, int tx0, int ty0, int tx1, int ty1, int radius) const
+{
+    for (int ty = std::max(0, ty0 - radius); ty <= std::min(m_tiles - 1, ty1 + radius); ++ty)
+        for (int tx = std::max(0, tx0 - radius); tx <= std::min(m_tiles - 1, tx1 + radius); ++tx)
+            marked[ty * m_tiles + tx] = 1;
+}
+
+const std::vector<int>& HorizonAO::update(const HeightfieldView& heightfield)
+{
+    const auto start = std::chrono::steady_clock::now();
+    m_dirty.clear();
+    if (!heightfield.valid())
+        return m_dirty;
+
+    const int stride = std::max(1, (heightfield.size + m_settings.maxResolution - 1) / std::max(1, m_settings.maxResolution));
+    const int size = (heightfield.size - 1) / stride + 1;
+    const int tiles = (size + TILE_SIZE - 1) / TILE_SIZE;
+
+    uint64_t layoutKey = 0xCBF29CE484222325ull;
+    layoutKey = HashValue(layoutKey, heightfield.size);
+    layoutKey = HashValue(layoutKey, stride);
+    layoutKey = HashValue(layoutKey, heightfield.step);
+    layoutKey = HashValue(layoutKey, heightfield.heightScale);
+    layoutKey = HashValue(layoutKey, m_settings.directions);
+    layoutKey = HashValue(layoutKey, m_settings.steps);
+    layoutKey = HashValue(layoutKey, m_settings.radius);
+
+    const bool relayout = layoutKey != m_layoutKey || m_texels.empty();
+    if (relayout)
+    {
+        m_layoutKey = layoutKey;
+        m_stride = stride;
+        m_size = size;
+        m_tiles = tiles;
+        m_texels.assign(static_cast<size_t>(size) * size * 4, 255);
+        m_tileHashes.assign(static_cast<size_t>(tiles) * tiles, 0);
+    }
+
+    // Heights under every tile
+    std::vector<uint64_t> hashes(m_tileHashes.size());
+    Parallel::For(0, static_cast<int>(hashes.size()), [&](int tile) { hashes[tile] = hashTile(heightfield, tile); });
+
+    std::vector<uint8_t> marked(hashes.size(), relayout ? 1 : 0);
+    if (!relayout)
+    {
+        const int radius = radiusInTiles(heightfield);
+        for (int tile = 0; tile < static_cast<int>(hashes.size()); ++tile)
+        {
+            if (hashes[tile] != m_tileHashes[tile])
+                markAround(marked, tile % m_tiles, tile / m_tiles, tile % m_tiles, tile / m_tiles, radius);
+        }
+    }
+    m_tileHashes = std::move(hashes);
+
+    bake(heightfield, marked);
+    m_bakeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return m_dirty;
+}
+
+const std::vector<int>& HorizonAO::updateRegion(const HeightfieldView& heightfield, int x, int y, int width, int height)
+{
+    if (m_texels.empty() || !heightfield.valid() || width <= 0 || height <= 0)
+        return update(heightfield);
+
+    const auto start = std::chrono::steady_clock::now();
+    m_dirty.clear();
+
+    const int tileSamples = TILE_SIZE * m_stride;
+    const int last = heightfield.size - 1;
+    const int tx0 = std::clamp(x, 0, last) / tileSamples;
+    const int ty0 = std::clamp(y, 0, last) / tileSamples;
+    const int tx1 = std::clamp(x + width - 1, 0, last) / tileSamples;
+    const int ty1 = std::clamp(y + height - 1, 0, last) / tileSamples;
+
+    // The edited tiles are up to date for the next update()
+    for (int ty = ty0; ty <= ty1; ++ty)
+        for (int tx = tx0; tx <= tx1; ++tx)
+            m_tileHashes[ty * m_tiles + tx] = hashTile(heightfield, ty * m_tiles + tx);
+
+    std::vector<uint8_t> marked(m_tileHashes.size(), 0);
+    markAround(marked, tx0, ty0, tx1, ty1, radiusInTiles(heightfield));
+    bake(heightfield, marked);
+    m_bakeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return m_dirty;
+}
+
+const std::vector<int>& HorizonAO::updateNormals(const HeightfieldView& heightfield, int x, int y, int width, int height)
+{
+    if (m_texels.empty() || !heightfield.valid() || width <= 0 || height <= 0)
+        return update(heightfield);
+
+    const auto start = std::chrono::steady_clock::now();
+    m_dirty.clear();
+
+    // Texels whose central differences read the samples, one texel spacing around them
+    const int tx0 = std::max(0, (x - m_stride) / m_stride);
+    const int ty0 = std::max(0, (y - m_stride) / m_stride);
+    const int tx1 = std::min(m_size - 1, (x + width - 1 + m_stride + m_stride - 1) / m_stride);
+    const int ty1 = std::min(m_size - 1, (y + height - 1 + m_stride + m_stride - 1) / m_stride);
+    if (tx1 < tx0 || ty1 < ty0)
+        return m_dirty;
+
+    Parallel::For(ty0, ty1 + 1, [&](int ty)
+    {
+        for (int tx = tx0; tx <= tx1; ++tx)
+            writeNormal(heightfield, tx, ty);
+    });
+    for (int ty = ty0 / TILE_SIZE; ty <= ty1 / TILE_SIZE; ++ty)
+        for (int tx = tx0 / TILE_SIZE; tx <= tx1 / TILE_SIZE; ++tx)
+            m_dirty.push_back(ty * m_tiles + tx);
+
+    m_bakeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return m_dirty;
+}
+
+uint64_t HorizonAO::hashTile(const HeightfieldView& heightfield, int tile) const
+{
+    const int x0 = (tile % m_tiles) * TILE_SIZE * m_stride;
+    const int y0 = (tile / m_tiles) * TILE_SIZE * m_stride;
+    const int x1 = std::min(heightfield.size, x0 + TILE_SIZE * m_stride);
+    const int y1 = std::min(heightfield.size, y0 + TILE_SIZE * m_stride);
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for (int y = y0; y < y1; ++y)
+        hash = HashWords(hash, heightfield.heights + static_cast<size_t>(y) * heightfield.size + x0, x1 - x0);
+    return hash;
+}
+
+void HorizonAO::bake(const HeightfieldView& heightfield, const std::vector<uint8_t>& marked)
+{
+    for (int tile = 0; tile < static_cast<int>(marked.size()); ++tile)
+    {
+        if (marked[tile])
+            m_dirty.push_back(tile);
+    }
+
+    Parallel::For(0, static_cast<int>(m_dirty.size()), [&](int i) { bakeTile(heightfield, m_dirty[i]); });
+}
+
+void HorizonAO::bakeTile(const HeightfieldView& heightfield, int tile)
+{
+    // Sample offsets along every direction, exponentially spaced: near occluders matter most
+    struct Tap { int dx, dy; float inverseDistance; };
+    const int directionCount = std::max(1, m_settings.directions);
+    const int stepCount = std::max(1, m_settings.steps);
+    const float firstDistance = static_cast<float>(m_stride);
+    const float growth = std::max(1.f, m_settings.radius / heightfield.step / firstDistance);
+    const float scale = heightfield.heightScale;
+    const float step = heightfield.step;
+
+    std::vector<Tap> taps(static_cast<size_t>(directionCount) * stepCount);
+    int reach = 0;
+    for (int d = 0; d < directionCount; ++d)
+    {
+        const float angle = d * 6.2831853f / directionCount;
+        for (int i = 0; i < stepCount; ++i)
+        {
+            const float distance = firstDistance * std::pow(growth, stepCount > 1 ? static_cast<float>(i) / (stepCount - 1) : 1.f);
+            Tap& tap = taps[d * stepCount + i];
+            tap.dx = static_cast<int>(std::lround(std::cos(angle) * distance));
+            tap.dy = static_cast<int>(std::lround(std::sin(angle) * distance));
+            tap.inverseDistance = scale / (std::sqrt(static_cast<float>(tap.dx * tap.dx + tap.dy * tap.dy)) * step);
+            reach = std::max({ reach, std::abs(tap.dx), std::abs(tap.dy) });
+        }
+    }
+
+    const int size = heightfield.size;
+    const int last = size - 1;
+    const float* heights = heightfield.heights;
+    const int tx0 = (tile % m_tiles) * TILE_SIZE;
+    const int ty0 = (tile / m_tiles) * TILE_SIZE;
+
+    for (int ty = ty0; ty < std::min(m_size, ty0 + TILE_SIZE); ++ty)
+    {
+        for (int tx = tx0; tx < std::min(m_size, tx0 + TILE_SIZE); ++tx)
+        {
+            const int sx = std::min(tx * m_stride, last);
+            const int sy = std::min(ty * m_stride, last);
+            const float* center = heights + static_cast<size_t>(sy) * size + sx;
+            const bool inside = sx >= reach && sy >= reach && sx + reach <= last && sy + reach <= last;
+
+            float occlusion = 0.f;
+            for (int d = 0; d < directionCount; ++d)
+            {
+                float maxSlope = 0.f;
+                for (int i = 0; i < stepCount; ++i)
+                {
+                    // Near the borders the search stops at the edge of the map
+                    const Tap& tap = taps[d * stepCount + i];
+                    if (!inside && (sx + tap.dx < 0 || sy + tap.dy < 0 || sx + tap.dx > last || sy + tap.dy > last))
+                        break;
+                    maxSlope = std::max(maxSlope, (center[tap.dy * size + tap.dx] - *center) * tap.inverseDistance);
+                }
+                occlusion += maxSlope / std::sqrt(1.f + maxSlope * maxSlope);
+            }
+
+            writeNormal(heightfield, tx, ty);
+            m_texels[(static_cast<size_t>(ty) * m_size + tx) * 4 + 3] = ToByte(1.f - occlusion / directionCount);
+        }
+    }
+}
+
+void HorizonAO::writeNormal(const HeightfieldView& heightfield, int tx, int ty)
+{
+    // Central differences over the texel spacing
+    const int last = heightfield.size - 1;
+    const int sx = std::min(tx * m_stride, last);
+    const int sy = std::min(ty * m_stride, last);
+    const float scale = heightfield.heightScale / (2.f * m_stride * heightfield.step);
+    const float dx = (heightfield.sample(sx + m_stride, sy) - heightfield.sample(sx - m_stride, sy)) * scale;
+    const float dz = (heightfield.sample(sx, sy + m_stride) - heightfield.sample(sx, sy - m_stride)) * scale;
+    const float length = std::sqrt(dx * dx + 1.f + dz * dz);
+
+    uint8_t* texel = &m_texels[(static_cast<size_t>(ty) * m_size + tx) * 4];
+    texel[0] = ToByte(-dx / length * 0.5f + 0.5f);
+    texel[1] = ToByte(1.f / length * 0.5f + 0.5f);
+    texel[2] = ToByte(-dz / length * 0.5f + 0.5f);
+}
@@ -0,0 +1,100 @@
+#include "ImageWriter.h"
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <zlib.h>
+
+namespace
+{
+    constexpr size_t IDAT_CHUNK_SIZE = 1 << 16;
+
+    void WriteU32(std::ofstream& file, uint32_t v)
+    {
+        const uint8_t bytes[4] = { uint8_t(v >> 24), uint8_t(v >> 16), uint8_t(v >> 8), uint8_t(v) };
+        file.write(reinterpret_cast<const char*>(bytes), 4);
+    }
+
+    void WriteChunk(std::ofstream& file, const char* type, const uint8_t* data, size_t size)
+    {
+        WriteU32(file, static_cast<uint32_t>(size));
+        file.write(type, 4);
+        if (size > 0)
+            file.write(reinterpret_cast<const char*>(data), size);
+
+        uLong crc = crc32(0L, reinterpret_cast<const Bytef*>(type), 4);
+        if (size > 0)
+            crc = crc32(crc, data, static_cast<uInt>(size));
+        WriteU32(file, static_cast<uint32_t>(crc));
+    }
+}
+
+namespace Image
+{
+    bool WritePng(const std::string& filePath, int width, int height, int channels, const uint8_t* pixels, bool flipVertically)
+    {
+        static const uint8_t colorTypes[5] = { 0, 0, 4, 2, 6 };
+        if (width <= 0 || height <= 0 || channels < 1 || channels > 4 || pixels == nullptr)
+            return false;
+
+        std::ofstream file(filePath, std::ios::binary);
+        if (!file.is_open())
+        {
+            std::cerr << "Impossible to write image " << filePath << std::endl;
+            return false;
+        }
+
+        static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        file.write(reinterpret_cast<const char*>(signature), 8);
+
+        uint8_t header[13] = {};
+        header[0] = uint8_t(width >> 24); header[1] = uint8_t(width >> 16); header[2] = uint8_t(width >> 8); header[3] = uint8_t(width);
+        header[4] = uint8_t(height >> 24); header[5] = uint8_t(height >> 16); header[6] = uint8_t(height >> 8); header[7] = uint8_t(height);
+        header[8] = 8; // Bit depth
+        header[9] = colorTypes[channels];
+        WriteChunk(file, "IHDR", header, sizeof(header));
+
+        z_stream stream = {};
+        if (deflateInit(&stream, Z_BEST_SPEED) != Z_OK)
+            return false;
+
+        const size_t stride = static_cast<size_t>(width) * channels;
+        std::vector<uint8_t> row(stride + 1);
+        std::vector<uint8_t> out(IDAT_CHUNK_SIZE);
+
+        stream.next_out = out.data();
+        stream.avail_out = static_cast<uInt>(out.size());
+
+        for (int y = 0; y < height; ++y)
+        {
+            const int srcY = flipVertically ? height - 1 - y : y;
+            const uint8_t* src = pixels + srcY * stride;
+
+            // "Sub" filter: cheap and compresses smooth previews well
+            row[0] = 1;
+            for (size_t i = 0; i < stride; ++i)
+                row[i + 1] = static_cast<uint8_t>(src[i] - (i >= static_cast<size_t>(channels) ? src[i - channels] : 0));
+
+            stream.next_in = row.data();
+            stream.avail_in = static_cast<uInt>(row.size());
+
+            const int flush = (y == height - 1) ? Z_FINISH : Z_NO_FLUSH;
+            int status = Z_OK;
+            do
+            {
+                status = deflate(&stream, flush);
+                if (stream.avail_out == 0 || status == Z_STREAM_END)
+                {
+                    WriteChunk(file, "IDAT", out.data(), out.size() - stream.avail_out);
+                    stream.next_out = out.data();
+                    stream.avail_out = static_cast<uInt>(out.size());
+                }
+            } while (stream.avail_in > 0 || (flush == Z_FINISH && status != Z_STREAM_END));
+        }
+
+        deflateEnd(&stream);
+        WriteChunk(file, "IEND", nullptr, 0);
+
+        return file.good();
+    }
+}
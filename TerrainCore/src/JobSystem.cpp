@@ -0,0 +1,392 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+#include "Parallel.h"
+
+struct Job
+{
+    std::function<void()> fn;
+    JobFence* fence = nullptr;
+    const char* name = nullptr;
+    Job* next = nullptr; // Link in the waiting list of a fence
+
+    // Pool slots are reused once the job has run, heap jobs are deleted
+    std::atomic<bool> busy = false;
+    bool pooled = false;
+};
+
+namespace
+{
+    // Jobs in flight per deque, a full deque runs new jobs inline
+    constexpr int64_t DEQUE_CAPACITY = 4096;
+    constexpr size_t POOL_SIZE = 4096;
+
+    // Rounds of stealing before an idle worker sleeps
+    constexpr int IDLE_SPINS = 64;
+
+    // Chase-Lev deque with a fixed capacity ("Correct and Efficient Work-Stealing for Weak Memory Models").
+    // push and pop are called by the owner only, steal by any thread.
+    class WorkDeque
+    {
+    public:
+        bool push(Job* job)
+        {
+            const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+            const int64_t top = m_top.load(std::memory_order_acquire);
+            if (bottom - top >= DEQUE_CAPACITY)
+                return false;
+
+            m_jobs[bottom & (DEQUE_CAPACITY - 1)].store(job, std::memory_order_relaxed);
+            m_bottom.store(bottom + 1, std::memory_order_release);
+            return true;
+        }
+
+        Job* pop()
+        {
+            const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+            m_bottom.store(bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t top = m_top.load(std::memory_order_relaxed);
+
+            if (top > bottom)
+            {
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+
+            Job* job = m_jobs[bottom & (DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+            if (top == bottom)
+            {
+                // Last job: race against the thieves
+                if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    job = nullptr;
+                m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            }
+            return job;
+        }
+
+        Job* steal()
+        {
+            int64_t top = m_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+            if (top >= bottom)
+                return nullptr;
+
+            Job* job = m_jobs[top & (DEQUE_CAPACITY - 1)].load(std::memory_order_relaxed);
+            if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                return nullptr;
+            return job;
+        }
+
+    private:
+        alignas(64) std::atomic<int64_t> m_top = 0;
+        alignas(64) std::atomic<int64_t> m_bottom = 0;
+        std::atomic<Job*> m_jobs[DEQUE_CAPACITY] = {};
+    };
+
+    // Index of the current thread in the system it belongs to
+    thread_local const JobSystem* t_system = nullptr;
+    thread_local int t_index = -1;
+}
+
+struct alignas(64) JobSystem::ThreadState
+{
+    WorkDeque deque;
+
+    // Only the owner allocates from its pool
+    std::unique_ptr<Job[]> pool = std::make_unique<Job[]>(POOL_SIZE);
+    size_t nextJob = 0;
+
+    // Traces are appended by the owner, moved out by collectTraces
+    std::mutex traceMutex;
+    std::vector<JobTrace> traces;
+
+    uint32_t random = 0;
+};
+
+JobSystem::JobSystem(int threadCount)
+{
+    if (threadCount <= 0)
+        threadCount = Parallel::ThreadCount();
+
+    for (int i = 0; i < threadCount; ++i)
+    {
+        m_threads.push_back(std::make_unique<ThreadState>());
+        m_threads.back()->random = 0x9E3779B9u * (i + 1);
+    }
+
+    // The creating thread is thread 0
+    t_system = this;
+    t_index = 0;
+
+    for (int i = 1; i < threadCount; ++i)
+    {
+        m_workers.emplace_back([this, i]()
+        {
+            t_system = this;
+            t_index = i;
+            workerLoop(i);
+        });
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    m_stop.store(true);
+    m_epoch.fetch_add(1);
+    m_epoch.notify_all();
+    for (auto& worker : m_workers)
+        worker.join();
+
+    if (t_system == this)
+        t_system = nullptr;
+}
+
+JobSystem& JobSystem::Instance()
+{
+    static JobSystem system;
+    return system;
+}
+
+int JobSystem::threadIndex() const
+{
+    return t_system == this ? t_index : -1;
+}
+
+Job* JobSystem::allocate()
+{
+    const int index = threadIndex();
+    if (index >= 0)
+    {
+        ThreadState& state = *m_threads[index];
+        for (size_t attempt = 0; attempt < POOL_SIZE; ++attempt)
+        {
+            Job& job = state.pool[state.nextJob++ & (POOL_SIZE - 1)];
+            if (!job.busy.load(std::memory_order_acquire))
+            {
+                job.busy.store(true, std::memory_order_relaxed);
+                job.pooled = true;
+                return &job;
+            }
+        }
+    }
+
+    // Pool exhausted, or a thread outside the system
+    Job* job = new Job();
+    job->busy.store(true, std::memory_order_relaxed);
+    return job;
+}
+
+void JobSystem::run(std::function<void()> fn, JobFence* fence, JobFence* after, const char* name)
+{
+    if (fence)
+    {
+        int pending = fence->m_pending.load(std::memory_order_relaxed);
+        while (pending == JobFence::SIGNALLING || !fence->m_pending.compare_exchange_weak(pending, pending + 1, std::memory_order_relaxed))
+        {
+            if (pending == JobFence::SIGNALLING)
+            {
+                std::this_thread::yield();
+                pending = fence->m_pending.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    Job* job = allocate();
+    job->fn = std::move(fn);
+    job->fence = fence;
+    job->name = name;
+    job->next = nullptr;
+
+    if (after && !after->done())
+    {
+        Job* head = after->m_waiting.load(std::memory_order_relaxed);
+        do
+        {
+            job->next = head;
+        } while (!after->m_waiting.compare_exchange_weak(head, job, std::memory_order_seq_cst, std::memory_order_relaxed));
+
+        // Otherwise the last job of `after` schedules it. If it finished meanwhile, it may have missed this job.
+        int pending;
+        while ((pending = after->m_pending.load(std::memory_order_seq_cst)) == JobFence::SIGNALLING)
+            std::this_thread::yield();
+        if (pending == 0)
+            scheduleWaiting(*after);
+        return;
+    }
+
+    push(job);
+}
+
+void JobSystem::push(Job* job)
+{
+    const int index = threadIndex();
+    if (index >= 0)
+    {
+        if (!m_threads[index]->deque.push(job))
+        {
+            execute(job, index);
+            return;
+        }
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(m_externalMutex);
+        m_external.push_back(job);
+        m_externalCount.fetch_add(1, std::memory_order_release);
+    }
+
+    m_epoch.fetch_add(1, std::memory_order_release);
+    m_epoch.notify_one();
+}
+
+void JobSystem::scheduleWaiting(JobFence& fence)
+{
+    schedule(fence.m_waiting.exchange(nullptr, std::memory_order_seq_cst));
+}
+
+void JobSystem::schedule(Job* job)
+{
+    while (job)
+    {
+        Job* next = job->next;
+        push(job);
+        job = next;
+    }
+}
+
+Job* JobSystem::findJob(int index)
+{
+    if (index >= 0)
+    {
+        if (Job* job = m_threads[index]->deque.pop())
+            return job;
+    }
+
+    if (m_externalCount.load(std::memory_order_acquire) > 0)
+    {
+        std::lock_guard<std::mutex> lock(m_externalMutex);
+        if (!m_external.empty())
+        {
+            Job* job = m_external.back();
+            m_external.pop_back();
+            m_externalCount.fetch_sub(1, std::memory_order_relaxed);
+            return job;
+        }
+    }
+
+    // Steal from the others, starting at a random victim
+    const int threadCount = static_cast<int>(m_threads.size());
+    uint32_t random = index >= 0 ? (m_threads[index]->random = m_threads[index]->random * 1664525u + 1013904223u) : 0u;
+    const int first = static_cast<int>((random >> 16) % threadCount);
+    for (int i = 0; i < threadCount; ++i)
+    {
+        const int victim = (first + i) % threadCount;
+        if (victim == index)
+            continue;
+        if (Job* job = m_threads[victim]->deque.steal())
+            return job;
+    }
+    return nullptr;
+}
+
+void JobSystem::execute(Job* job, int index)
+{
+    if (index >= 0 && isProfiling())
+    {
+        const double start = now();
+        job->fn();
+        const double end = now();
+
+        ThreadState& state = *m_threads[index];
+        std::lock_guard<std::mutex> lock(state.traceMutex);
+        state.traces.push_back({ job->name ? job->name : "job", index, start, end });
+    }
+    else
+    {
+        job->fn();
+    }
+
+    // Release the job before signalling, a dependent job may reuse its slot
+    JobFence* fence = job->fence;
+    job->fn = nullptr;
+    if (job->pooled)
+        job->busy.store(false, std::memory_order_release);
+    else
+        delete job;
+
+    if (fence)
+        signal(*fence);
+}
+
+void JobSystem::signal(JobFence& fence)
+{
+    int pending = fence.m_pending.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        if (pending == 1)
+        {
+            // Last job: take the waiting jobs before the fence reads as done, from then on it may be destroyed
+            // (even when nobody waits on it directly: waiting on a dependent fence is enough)
+            if (fence.m_pending.compare_exchange_weak(pending, JobFence::SIGNALLING, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                Job* waiting = fence.m_waiting.exchange(nullptr, std::memory_order_seq_cst);
+                fence.m_pending.store(0, std::memory_order_seq_cst);
+                schedule(waiting);
+                return;
+            }
+        }
+        else if (fence.m_pending.compare_exchange_weak(pending, pending - 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return;
+        }
+    }
+}
+
+void JobSystem::wait(const JobFence& fence)
+{
+    const int index = threadIndex();
+    while (!fence.done())
+    {
+        if (Job* job = findJob(index))
+            execute(job, index);
+        else
+            std::this_thread::yield();
+    }
+}
+
+void JobSystem::collectTraces(std::vector<JobTrace>& traces)
+{
+    for (auto& state : m_threads)
+    {
+        std::lock_guard<std::mutex> lock(state->traceMutex);
+        traces.insert(traces.end(), state->traces.begin(), state->traces.end());
+        state->traces.clear();
+    }
+}
+
+void JobSystem::workerLoop(int index)
+{
+    int idle = 0;
+    while (!m_stop.load(std::memory_order_relaxed))
+    {
+        // Read the epoch first: a job pushed after the search changes it and cancels the sleep
+        const uint32_t epoch = m_epoch.load(std::memory_order_acquire);
+        if (Job* job = findJob(index))
+        {
+            execute(job, index);
+            idle = 0;
+        }
+        else if (++idle < IDLE_SPINS)
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            m_epoch.wait(epoch, std::memory_order_acquire);
+            idle = 0;
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#include "MemoryAccounting.h"
+
+#include <atomic>
+
+namespace
+{
+    std::array<std::array<std::atomic<int64_t>, MemoryUsage::DOMAIN_COUNT>, MemoryUsage::TAG_COUNT>& Counters()
+    {
+        static std::array<std::array<std::atomic<int64_t>, MemoryUsage::DOMAIN_COUNT>, MemoryUsage::TAG_COUNT> counters = {};
+        return counters;
+    }
+}
+
+int64_t MemoryUsage::total(MemoryDomain domain) const
+{
+    int64_t sum = 0;
+    for (const auto& tag : bytes)
+        sum += tag[static_cast<int>(domain)];
+    return sum;
+}
+
+namespace Memory
+{
+    const char* Name(MemoryTag tag)
+    {
+        switch (tag)
+        {
+        case MemoryTag::HEIGHTMAPS: return "Heightmaps";
+        case MemoryTag::MESHES: return "Meshes";
+        case MemoryTag::MATERIALS: return "Materials";
+        case MemoryTag::SHADING: return "Shading";
+        case MemoryTag::CACHES: return "Caches";
+        case MemoryTag::SCATTER: return "Scatter";
+        case MemoryTag::WATER: return "Water";
+        case MemoryTag::DETAIL: return "Detail";
+        case MemoryTag::VIRTUAL_TEXTURE: return "Virtual texture";
+        case MemoryTag::SHADOWS: return "Shadows";
+        default: return "Unknown";
+        }
+    }
+
+    void Add(MemoryTag tag, MemoryDomain domain, int64_t bytes)
+    {
+        Counters()[static_cast<int>(tag)][static_cast<int>(domain)].fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    int64_t Used(MemoryTag tag, MemoryDomain domain)
+    {
+        return Counters()[static_cast<int>(tag)][static_cast<int>(domain)].load(std::memory_order_relaxed);
+    }
+
+    MemoryUsage Snapshot()
+    {
+        MemoryUsage usage;
+        for (int tag = 0; tag < MemoryUsage::TAG_COUNT; ++tag)
+        {
+            for (int domain = 0; domain < MemoryUsage::DOMAIN_COUNT; ++domain)
+                usage.bytes[tag][domain] = Counters()[tag][domain].load(std::memory_order_relaxed);
+        }
+        return usage;
+    }
+}
+
+size_t MemoryBudgets::excess(MemoryTag tag, MemoryDomain domain, const MemoryUsage& usage) const
+{
+    const size_t budget = get(tag, domain);
+    const int64_t used = usage.get(tag, domain);
+    return budget > 0 && used > static_cast<int64_t>(budget) ? static_cast<size_t>(used) - budget : 0;
+}
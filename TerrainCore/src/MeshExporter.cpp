@@ -0,0 +1,683 @@
+#include "MeshExporter.h"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include "TileCache.h"
+
+namespace
+{
+    // Largest GLB tile side in samples, keeps vertices (32 B) + indices (24 B per cell) under 4 GiB
+    constexpr int GLB_MAX_TILE_SAMPLES = 8193;
+
+    constexpr uint32_t RAW_VERSION = 1;
+
+    // Fixed size output buffer in front of an ofstream
+    class BufferedWriter
+    {
+    public:
+        BufferedWriter(const std::string& path, size_t bufferSize)
+            : m_file(path, std::ios::binary)
+        {
+            m_buffer.resize(std::max<size_t>(bufferSize, 1024));
+        }
+
+        ~BufferedWriter() { flush(); }
+
+        bool good() const { return m_file.good(); }
+        uint64_t bytesWritten() const { return m_written + m_used; }
+
+        void write(const void* data, size_t size)
+        {
+            if (m_used + size > m_buffer.size())
+            {
+                flush();
+                if (size > m_buffer.size())
+                {
+                    m_file.write(static_cast<const char*>(data), size);
+                    m_written += size;
+                    return;
+                }
+            }
+            std::memcpy(m_buffer.data() + m_used, data, size);
+            m_used += size;
+        }
+
+        template<typename T>
+        void writeValue(const T& value) { write(&value, sizeof(T)); }
+
+        void writeText(const char* text) { write(text, std::strlen(text)); }
+
+        // Direct access to at least size free bytes, to format numbers in place
+        char* reserve(size_t size)
+        {
+            if (m_used + size > m_buffer.size())
+                flush();
+            return m_buffer.data() + m_used;
+        }
+        void commit(size_t size) { m_used += size; }
+
+        void writeFloat(float value)
+        {
+            char* out = reserve(32);
+            commit(std::to_chars(out, out + 32, value).ptr - out);
+        }
+
+        void writeUInt(uint64_t value)
+        {
+            char* out = reserve(24);
+            commit(std::to_chars(out, out + 24, value).ptr - out);
+        }
+
+        void flush()
+        {
+            if (m_used > 0)
+            {
+                m_file.write(m_buffer.data(), m_used);
+                m_written += m_used;
+                m_used = 0;
+            }
+        }
+
+        // Overwrite bytes already written (e.g. a header), the write position is restored
+        void patch(uint64_t offset, const void* data, size_t size)
+        {
+            flush();
+            const auto end = m_file.tellp();
+            m_file.seekp(static_cast<std::streamoff>(offset));
+            m_file.write(static_cast<const char*>(data), size);
+            m_file.seekp(end);
+        }
+
+    private:
+        std::ofstream m_file;
+        std::vector<char> m_buffer;
+        size_t m_used = 0;
+        uint64_t m_written = 0;
+    };
+
+    struct Vertex
+    {
+        float position[3];
+        float normal[3];
+        float uv[2];
+    };
+    static_assert(sizeof(Vertex) == 32, "GLB vertices are interleaved with a 32 bytes stride");
+
+    // glTF 2.0 binary container, vertices then indices are streamed in the BIN chunk
+    class GlbWriter
+    {
+    public:
+        GlbWriter(const std::string& path, size_t bufferSize, uint64_t vertexCount, uint64_t indexCount)
+            : m_writer(path, bufferSize)
+            , m_vertexCount(vertexCount)
+            , m_indexCount(indexCount)
+        {
+            // The JSON needs the position bounds, reserve room for the longest numbers and rewrite it at the end
+            m_min[0] = m_min[1] = m_min[2] = -1.23456789e+38f;
+            m_max[0] = m_max[1] = m_max[2] = -1.23456789e+38f;
+            m_jsonLength = (json().size() + 3) & ~size_t(3);
+            m_min[0] = m_min[1] = m_min[2] = std::numeric_limits<float>::max();
+            m_max[0] = m_max[1] = m_max[2] = -std::numeric_limits<float>::max();
+
+            const uint64_t binLength = vertexCount * sizeof(Vertex) + indexCount * sizeof(uint32_t);
+            const uint64_t total = 12 + 8 + m_jsonLength + 8 + binLength;
+            m_valid = total <= std::numeric_limits<uint32_t>::max();
+
+            m_writer.writeValue<uint32_t>(0x46546C67); // "glTF"
+            m_writer.writeValue<uint32_t>(2);
+            m_writer.writeValue<uint32_t>(static_cast<uint32_t>(total));
+
+            m_writer.writeValue<uint32_t>(static_cast<uint32_t>(m_jsonLength));
+            m_writer.writeValue<uint32_t>(0x4E4F534A); // "JSON"
+            const std::string placeholder(m_jsonLength, ' ');
+            m_writer.write(placeholder.data(), placeholder.size());
+
+            m_writer.writeValue<uint32_t>(static_cast<uint32_t>(binLength));
+            m_writer.writeValue<uint32_t>(0x004E4942); // "BIN"
+        }
+
+        bool valid() const { return m_valid && m_writer.good(); }
+
+        void writeVertex(const Vertex& vertex)
+        {
+            for (int i = 0; i < 3; ++i)
+            {
+                m_min[i] = std::min(m_min[i], vertex.position[i]);
+                m_max[i] = std::max(m_max[i], vertex.position[i]);
+            }
+            m_writer.writeValue(vertex);
+        }
+
+        void writeIndex(uint32_t index) { m_writer.writeValue(index); }
+
+        uint64_t finish()
+        {
+            std::string text = json();
+            text.resize(m_jsonLength, ' ');
+            m_writer.patch(20, text.data(), text.size());
+            m_writer.flush();
+            return m_writer.bytesWritten();
+        }
+
+    private:
+        BufferedWriter m_writer;
+        uint64_t m_vertexCount;
+        uint64_t m_indexCount;
+        size_t m_jsonLength = 0;
+        float m_min[3];
+        float m_max[3];
+        bool m_valid = false;
+
+        std::string json() const
+        {
+            const uint64_t vertexBytes = m_vertexCount * sizeof(Vertex);
+            const uint64_t indexBytes = m_indexCount * sizeof(uint32_t);
+
+            char bounds[160];
+            std::snprintf(bounds, sizeof(bounds), "\"min\":[%.9g,%.9g,%.9g],\"max\":[%.9g,%.9g,%.9g]",
+                          m_min[0], m_min[1], m_min[2], m_max[0], m_max[1], m_max[2]);
+
+            const std::string n = std::to_string(m_vertexCount);
+            return std::string("{\"asset\":{\"version\":\"2.0\",\"generator\":\"Terrain-generator\"},")
+                + "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+                + "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":3}]}],"
+                + "\"buffers\":[{\"byteLength\":" + std::to_string(vertexBytes + indexBytes) + "}],"
+                + "\"bufferViews\":["
+                + "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":" + std::to_string(vertexBytes) + ",\"byteStride\":32,\"target\":34962},"
+                + "{\"buffer\":0,\"byteOffset\":" + std::to_string(vertexBytes) + ",\"byteLength\":" + std::to_string(indexBytes) + ",\"target\":34963}],"
+                + "\"accessors\":["
+                + "{\"bufferView\":0,\"byteOffset\":0,\"componentType\":5126,\"count\":" + n + ",\"type\":\"VEC3\"," + bounds + "},"
+                + "{\"bufferView\":0,\"byteOffset\":12,\"componentType\":5126,\"count\":" + n + ",\"type\":\"VEC3\"},"
+                + "{\"bufferView\":0,\"byteOffset\":24,\"componentType\":5126,\"count\":" + n + ",\"type\":\"VEC2\"},"
+                + "{\"bufferView\":1,\"byteOffset\":0,\"componentType\":5125,\"count\":" + std::to_string(m_indexCount) + ",\"type\":\"SCALAR\"}]}";
+        }
+    };
+
+    // Streams heightmap rows chunk by chunk and calls fn(y, previous, row, next) for every row in order.
+    // Only chunkRows + 2 rows are resident.
+    template<typename Fn>
+    void ForEachRow(const ExportSettings& settings, const HeightRowSource& source, Fn&& fn)
+    {
+        const int width = settings.width;
+        const int height = settings.height;
+        const int chunkRows = std::max(1, settings.chunkRows);
+
+        std::vector<float> window(static_cast<size_t>(chunkRows + 2) * width);
+        int windowFirst = 0;
+        int windowCount = 0;
+
+        auto row = [&](int y) { return window.data() + static_cast<size_t>(y - windowFirst) * width; };
+
+        for (int bandStart = 0; bandStart < height; bandStart += chunkRows)
+        {
+            const int bandEnd = std::min(height, bandStart + chunkRows);
+
+            // Keep the two rows shared with the previous band, then generate the missing ones
+            const int keepFirst = std::max(windowFirst, bandStart - 1);
+            const int keepCount = windowFirst + windowCount - keepFirst;
+            if (keepCount > 0 && keepFirst != windowFirst)
+                std::memmove(window.data(), row(keepFirst), static_cast<size_t>(keepCount) * width * sizeof(float));
+            windowFirst = keepCount > 0 ? keepFirst : bandStart;
+            windowCount = std::max(0, keepCount);
+
+            const int needEnd = std::min(height, bandEnd + 1);
+            const int firstMissing = windowFirst + windowCount;
+            if (needEnd > firstMissing)
+            {
+                source(firstMissing, needEnd - firstMissing, std::span<float>(row(firstMissing), static_cast<size_t>(needEnd - firstMissing) * width));
+                windowCount += needEnd - firstMissing;
+            }
+
+            for (int y = bandStart; y < bandEnd; ++y)
+                fn(y, row(std::max(0, y - 1)), row(y), row(std::min(height - 1, y + 1)));
+        }
+    }
+
+    void GridNormal(const ExportSettings& settings, int x, const float* previous, const float* row, const float* next, float* normal)
+    {
+        const int left = std::max(0, x - 1);
+        const int right = std::min(settings.width - 1, x + 1);
+        const float dx = (row[right] - row[left]) * settings.heightScale / (std::max(1, right - left) * settings.step);
+        const float dz = (next[x] - previous[x]) * settings.heightScale / (2.f * settings.step);
+
+        const float length = std::sqrt(dx * dx + 1.f + dz * dz);
+        normal[0] = -dx / length;
+        normal[1] = 1.f / length;
+        normal[2] = -dz / length;
+    }
+
+    void GridVertex(const ExportSettings& settings, int x, int y, const float* previous, const float* row, const float* next, Vertex& vertex)
+    {
+        vertex.position[0] = settings.origin.x + x * settings.step;
+        vertex.position[1] = row[x] * settings.heightScale;
+        vertex.position[2] = settings.origin.y + y * settings.step;
+        GridNormal(settings, x, previous, row, next, vertex.normal);
+        vertex.uv[0] = settings.width > 1 ? static_cast<float>(x) / (settings.width - 1) : 0.f;
+        vertex.uv[1] = settings.height > 1 ? static_cast<float>(y) / (settings.height - 1) : 0.f;
+    }
+
+    void WriteObjVertex(BufferedWriter& writer, const Vertex& vertex)
+    {
+        writer.writeText("v ");
+        writer.writeFloat(vertex.position[0]); writer.writeText(" ");
+        writer.writeFloat(vertex.position[1]); writer.writeText(" ");
+        writer.writeFloat(vertex.position[2]); writer.writeText("\nvn ");
+        writer.writeFloat(vertex.normal[0]); writer.writeText(" ");
+        writer.writeFloat(vertex.normal[1]); writer.writeText(" ");
+        writer.writeFloat(vertex.normal[2]); writer.writeText("\nvt ");
+        writer.writeFloat(vertex.uv[0]); writer.writeText(" ");
+        writer.writeFloat(vertex.uv[1]); writer.writeText("\n");
+    }
+
+    void WriteObjFace(BufferedWriter& writer, uint64_t a, uint64_t b, uint64_t c)
+    {
+        // OBJ indices start at 1, position / uv / normal share the same index
+        const uint64_t face[3] = { a + 1, b + 1, c + 1 };
+        writer.writeText("f");
+        for (uint64_t v : face)
+        {
+            writer.writeText(" ");
+            writer.writeUInt(v); writer.writeText("/");
+            writer.writeUInt(v); writer.writeText("/");
+            writer.writeUInt(v);
+        }
+        writer.writeText("\n");
+    }
+
+    bool ExportGridObj(const ExportSettings& settings, const HeightRowSource& source, ExportStats& stats)
+    {
+        BufferedWriter writer(settings.path, settings.bufferSize);
+        if (!writer.good())
+            return false;
+
+        writer.writeText("# Terrain-generator grid export\n");
+
+        // Faces of a row of cells are written as soon as both of its rows of vertices are
+        const uint64_t width = settings.width;
+        ForEachRow(settings, source, [&](int y, const float* previous, const float* row, const float* next)
+        {
+            Vertex vertex;
+            for (int x = 0; x < settings.width; ++x)
+            {
+                GridVertex(settings, x, y, previous, row, next, vertex);
+                WriteObjVertex(writer, vertex);
+            }
+
+            if (y == 0)
+                return;
+
+            for (uint64_t x = 0; x + 1 < width; ++x)
+            {
+                const uint64_t v = (y - 1) * width + x;
+                WriteObjFace(writer, v, v + width, v + width + 1);
+                WriteObjFace(writer, v, v + width + 1, v + 1);
+            }
+        });
+
+        writer.flush();
+        stats.bytesWritten += writer.bytesWritten();
+        stats.fileCount = 1;
+        return writer.good();
+    }
+
+    bool ExportGridGlb(const ExportSettings& settings, const HeightRowSource& source, ExportStats& stats)
+    {
+        constexpr int tileCells = GLB_MAX_TILE_SAMPLES - 1;
+        const int tilesX = std::max(1, (settings.width - 2) / tileCells + 1);
+        const int tilesY = std::max(1, (settings.height - 2) / tileCells + 1);
+
+        auto tilePath = [&](int tx, int ty)
+        {
+            if (tilesX == 1 && tilesY == 1)
+                return settings.path;
+
+            const std::filesystem::path path(settings.path);
+            return (path.parent_path() / (path.stem().string() + "_" + std::to_string(tx) + "_" + std::to_string(ty) + path.extension().string())).string();
+        };
+
+        // One row of tiles is open at a time, tiles share their border rows and columns
+        std::vector<std::unique_ptr<GlbWriter>> tiles;
+        int tileRow = -1;
+        bool ok = true;
+
+        auto tileSpan = [](int tile, int samples, int& first, int& count)
+        {
+            first = tile * tileCells;
+            count = std::min(samples - first, GLB_MAX_TILE_SAMPLES);
+        };
+
+        auto finishTiles = [&]()
+        {
+            int firstY, rowsY;
+            tileSpan(tileRow, settings.height, firstY, rowsY);
+            for (int tx = 0; tx < tilesX; ++tx)
+            {
+                int firstX, columns;
+                tileSpan(tx, settings.width, firstX, columns);
+
+                // Indices only depend on the grid size
+                GlbWriter& tile = *tiles[tx];
+                for (uint32_t y = 0; y + 1 < static_cast<uint32_t>(rowsY); ++y)
+                {
+                    for (uint32_t x = 0; x + 1 < static_cast<uint32_t>(columns); ++x)
+                    {
+                        const uint32_t v = y * columns + x;
+                        const uint32_t triangles[6] = { v, v + columns, v + columns + 1, v, v + columns + 1, v + 1 };
+                        for (uint32_t index : triangles)
+                            tile.writeIndex(index);
+                    }
+                }
+                ok &= tile.valid();
+                stats.bytesWritten += tile.finish();
+                ++stats.fileCount;
+            }
+            tiles.clear();
+        };
+
+        auto openTiles = [&](int ty)
+        {
+            tileRow = ty;
+            int firstY, rowsY;
+            tileSpan(ty, settings.height, firstY, rowsY);
+            for (int tx = 0; tx < tilesX; ++tx)
+            {
+                int firstX, columns;
+                tileSpan(tx, settings.width, firstX, columns);
+                const uint64_t vertices = static_cast<uint64_t>(columns) * rowsY;
+                const uint64_t indices = static_cast<uint64_t>(columns - 1) * (rowsY - 1) * 6;
+                tiles.push_back(std::make_unique<GlbWriter>(tilePath(tx, ty), settings.bufferSize / tilesX, vertices, indices));
+                ok &= tiles.back()->valid();
+            }
+        };
+
+        ForEachRow(settings, source, [&](int y, const float* previous, const float* row, const float* next)
+        {
+            if (!ok)
+                return;
+            if (tileRow < 0)
+                openTiles(0);
+
+            Vertex vertex;
+            auto writeRow = [&]()
+            {
+                for (int tx = 0; tx < tilesX; ++tx)
+                {
+                    int firstX, columns;
+                    tileSpan(tx, settings.width, firstX, columns);
+                    for (int x = firstX; x < firstX + columns; ++x)
+                    {
+                        GridVertex(settings, x, y, previous, row, next, vertex);
+                        tiles[tx]->writeVertex(vertex);
+                    }
+                }
+            };
+
+            writeRow();
+
+            int firstY, rowsY;
+            tileSpan(tileRow, settings.height, firstY, rowsY);
+            if (y == firstY + rowsY - 1)
+            {
+                finishTiles();
+                if (tileRow + 1 < tilesY)
+                {
+                    // The last row of a tile is also the first row of the next one
+                    openTiles(tileRow + 1);
+                    writeRow();
+                }
+            }
+        });
+
+        return ok;
+    }
+
+    void OctahedralEncode(const float* n, int16_t* out)
+    {
+        // Project on the octahedron around the up (y) axis, fold the lower half
+        const float l1 = std::abs(n[0]) + std::abs(n[1]) + std::abs(n[2]);
+        float u = n[0] / l1;
+        float v = n[2] / l1;
+        if (n[1] < 0.f)
+        {
+            const float fu = (1.f - std::abs(v)) * (u >= 0.f ? 1.f : -1.f);
+            const float fv = (1.f - std::abs(u)) * (v >= 0.f ? 1.f : -1.f);
+            u = fu;
+            v = fv;
+        }
+        out[0] = static_cast<int16_t>(std::lround(std::clamp(u, -1.f, 1.f) * 32767.f));
+        out[1] = static_cast<int16_t>(std::lround(std::clamp(v, -1.f, 1.f) * 32767.f));
+    }
+
+    bool ExportGridRaw(const ExportSettings& settings, const HeightRowSource& source, ExportStats& stats)
+    {
+        BufferedWriter writer(settings.path, settings.bufferSize);
+        if (!writer.good())
+            return false;
+
+        writer.write("TRRN", 4);
+        writer.writeValue<uint32_t>(RAW_VERSION);
+        writer.writeValue<uint32_t>(settings.width);
+        writer.writeValue<uint32_t>(settings.height);
+        writer.writeValue<float>(settings.origin.x);
+        writer.writeValue<float>(settings.origin.y);
+        writer.writeValue<float>(settings.step);
+        writer.writeValue<float>(settings.heightScale);
+
+        ForEachRow(settings, source, [&](int, const float* previous, const float* row, const float* next)
+        {
+            for (int x = 0; x < settings.width; ++x)
+            {
+                float normal[3];
+                int16_t encoded[2];
+                GridNormal(settings, x, previous, row, next, normal);
+                OctahedralEncode(normal, encoded);
+
+                writer.writeValue<float>(row[x] * settings.heightScale);
+                writer.write(encoded, sizeof(encoded));
+            }
+        });
+
+        writer.flush();
+        stats.bytesWritten += writer.bytesWritten();
+        stats.fileCount = 1;
+        return writer.good();
+    }
+
+    // Smooth vertex normals and planar uvs of an indexed mesh
+    std::vector<Vertex> MeshVertices(const TerrainMesh& mesh)
+    {
+        std::vector<Vertex> vertices(mesh.vertexCount());
+        float minX = std::numeric_limits<float>::max(), maxX = -minX, minZ = minX, maxZ = -minX;
+        for (size_t i = 0; i < vertices.size(); ++i)
+        {
+            Vertex& v = vertices[i];
+            std::memcpy(v.position, &mesh.positions[i * 3], sizeof(v.position));
+            v.normal[0] = v.normal[1] = v.normal[2] = 0.f;
+            minX = std::min(minX, v.position[0]); maxX = std::max(maxX, v.position[0]);
+            minZ = std::min(minZ, v.position[2]); maxZ = std::max(maxZ, v.position[2]);
+        }
+
+        // Area-weighted face normals
+        for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3)
+        {
+            Vertex& a = vertices[mesh.indices[t]];
+            Vertex& b = vertices[mesh.indices[t + 1]];
+            Vertex& c = vertices[mesh.indices[t + 2]];
+            const Point3d<float> ab(b.position[0] - a.position[0], b.position[1] - a.position[1], b.position[2] - a.position[2]);
+            const Point3d<float> ac(c.position[0] - a.position[0], c.position[1] - a.position[1], c.position[2] - a.position[2]);
+            const Point3d<float> n = Math::Cross(ab, ac);
+            for (Vertex* v : { &a, &b, &c })
+            {
+                v->normal[0] += n.x;
+                v->normal[1] += n.y;
+                v->normal[2] += n.z;
+            }
+        }
+
+        for (Vertex& v : vertices)
+        {
+            const Point3d<float> n = Math::Normalize(Point3d<float>(v.normal[0], v.normal[1], v.normal[2]));
+            v.normal[0] = n.x;
+            v.normal[1] = n.y;
+            v.normal[2] = n.z;
+            v.uv[0] = maxX > minX ? (v.position[0] - minX) / (maxX - minX) : 0.f;
+            v.uv[1] = maxZ > minZ ? (v.position[2] - minZ) / (maxZ - minZ) : 0.f;
+        }
+
+        return vertices;
+    }
+}
+
+namespace MeshExport
+{
+    ExportFormat FormatFromPath(const std::string& path)
+    {
+        std::string extension = std::filesystem::path(path).extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        if (extension == ".obj")
+            return ExportFormat::OBJ;
+        if (extension == ".glb")
+            return ExportFormat::GLB;
+        return ExportFormat::RAW;
+    }
+
+    bool ExportGrid(const ExportSettings& settings, const HeightRowSource& source, ExportStats* stats)
+    {
+        if (settings.width < 2 || settings.height < 2 || settings.path.empty())
+            return false;
+
+        ExportStats localStats;
+        const auto start = std::chrono::steady_clock::now();
+
+        bool ok = false;
+        switch (settings.format)
+        {
+        case ExportFormat::OBJ:
+            ok = ExportGridObj(settings, source, localStats);
+            break;
+
+        case ExportFormat::GLB:
+            ok = ExportGridGlb(settings, source, localStats);
+            break;
+
+        case ExportFormat::RAW:
+            ok = ExportGridRaw(settings, source, localStats);
+            break;
+        }
+
+        localStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (stats)
+            *stats = localStats;
+        return ok;
+    }
+
+    bool ExportMesh(const TerrainMesh& mesh, ExportFormat format, const std::string& path, ExportStats* stats)
+    {
+        ExportStats localStats;
+        const auto start = std::chrono::steady_clock::now();
+        const std::vector<Vertex> vertices = MeshVertices(mesh);
+
+        bool ok = false;
+        if (format == ExportFormat::OBJ)
+        {
+            BufferedWriter writer(path, 4 << 20);
+            writer.writeText("# Terrain-generator mesh export\n");
+            for (const Vertex& vertex : vertices)
+                WriteObjVertex(writer, vertex);
+            for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3)
+                WriteObjFace(writer, mesh.indices[t], mesh.indices[t + 1], mesh.indices[t + 2]);
+
+            writer.flush();
+            ok = writer.good();
+            localStats.bytesWritten = writer.bytesWritten();
+        }
+        else if (format == ExportFormat::GLB)
+        {
+            GlbWriter writer(path, 4 << 20, vertices.size(), mesh.indices.size());
+            for (const Vertex& vertex : vertices)
+                writer.writeVertex(vertex);
+            for (uint32_t index : mesh.indices)
+                writer.writeIndex(index);
+
+            ok = writer.valid();
+            localStats.bytesWritten = writer.finish();
+        }
+
+        localStats.fileCount = ok ? 1 : 0;
+        localStats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (stats)
+            *stats = localStats;
+        return ok;
+    }
+
+    bool ParseArguments(int argc, char** argv, ExportSettings& settings, TerrainPreset& preset)
+    {
+        bool exportMode = false;
+        int size = 1024;
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+
+            if (arg == "--export" && hasValue)
+            {
+                exportMode = true;
+                settings.path = argv[++i];
+            }
+            else if (arg == "--export-size" && hasValue)
+                size = std::max(2, std::atoi(argv[++i]));
+            else if (arg == "--seed" && hasValue)
+                preset.seed = std::atoi(argv[++i]);
+            else if (arg == "--scale" && hasValue)
+                preset.heightScale = static_cast<float>(std::atof(argv[++i]));
+        }
+
+        // Same extent as the viewer terrain, at any resolution
+        preset.size = size;
+        settings.format = FormatFromPath(settings.path);
+        settings.width = settings.height = preset.size;
+        settings.step = preset.step();
+        settings.heightScale = preset.heightScale;
+
+        return exportMode;
+    }
+
+    int Run(const ExportSettings& settings, const GenerationSettings& generation)
+    {
+        // Same heights as the viewer terrain, read through tiles: the erosion halo of a band of rows is
+        // the noise of the neighbor bands, generated once. Enough tiles are kept for a band and its halo.
+        constexpr int tileSize = 256;
+        const int tilesX = (settings.width + tileSize - 1) / tileSize;
+        const int haloTiles = (Erosion::Halo(generation.erosion) + tileSize - 1) / tileSize;
+        TileCache tiles(generation, tileSize, static_cast<size_t>(tilesX) * (2 + 2 * haloTiles));
+        auto source = [&](int firstRow, int rowCount, std::span<float> heights)
+        {
+            tiles.read(0, firstRow, settings.width, rowCount, heights);
+        };
+
+        ExportStats stats;
+        if (!ExportGrid(settings, source, &stats))
+        {
+            std::cerr << "Export to " << settings.path << " failed." << std::endl;
+            return -1;
+        }
+
+        std::cout << "Exported " << settings.width << "x" << settings.height << " samples to " << stats.fileCount << " file(s): "
+                  << stats.bytesWritten / (1024.0 * 1024.0) << " MB in " << stats.seconds << " s ("
+                  << stats.megabytesPerSecond() << " MB/s)" << std::endl;
+        return 0;
+    }
+}
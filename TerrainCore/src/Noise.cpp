@@ -0,0 +1,390 @@
+#include "Noise.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ostream>
+#include <vector>
+
+#include "PerlinNoise.h"
+#include "Simd.h"
+
+namespace
+{
+    using Simd::Float4;
+    using Simd::Int4;
+
+    // Scalar counterparts of the Simd functions, so the kernels below compile for float and Float4
+    inline float Min(float a, float b) { return a < b ? a : b; }
+    inline float Max(float a, float b) { return a > b ? a : b; }
+    inline float Sqrt(float a) { return std::sqrt(a); }
+    inline float Floor(float a) { return std::floor(a); }
+    inline float Select(bool mask, float a, float b) { return mask ? a : b; }
+    inline uint32_t Select(bool mask, uint32_t a, uint32_t b) { return mask ? a : b; }
+    inline uint32_t ToInt(float a) { return static_cast<uint32_t>(static_cast<int32_t>(a)); }
+    inline float ToFloat(uint32_t a) { return static_cast<float>(static_cast<int32_t>(a)); }
+    inline float Gather(const float* table, uint32_t index) { return table[index]; }
+
+    inline float FlipSign(float a, uint32_t bits)
+    {
+        uint32_t value;
+        std::memcpy(&value, &a, sizeof(value));
+        value ^= bits & 0x80000000u;
+        std::memcpy(&a, &value, sizeof(value));
+        return a;
+    }
+
+    // Lattice coordinates are premultiplied by these primes, so a neighbour is one addition away
+    constexpr uint32_t PRIME_X = 0x5205402Bu;
+    constexpr uint32_t PRIME_Y = 0x598CD327u;
+
+    template<typename I>
+    I Hash(I xPrimed, I yPrimed, I seed)
+    {
+        I h = seed ^ xPrimed ^ yPrimed;
+        h = (h ^ (h >> 16)) * I(0x7FEB352Du);
+        h = (h ^ (h >> 15)) * I(0x846CA68Bu);
+        return h ^ (h >> 16);
+    }
+
+    // Cell part of a position, premultiplied lattice coordinates and seed shared by a whole call.
+    // The low 32 bits of the cells wrap in the hashes, the high bits are folded in the seed
+    // (so the pattern only changes every 2^32 cells).
+    struct LatticeBase
+    {
+        uint32_t x = 0;
+        uint32_t y = 0;
+        uint32_t seed = 0;
+        float skew = 0.f; // Fraction of the skewed cell offset, OpenSimplex2 only
+
+        LatticeBase(int64_t cellX, int64_t cellY, int seed_)
+            : x(static_cast<uint32_t>(cellX) * PRIME_X)
+            , y(static_cast<uint32_t>(cellY) * PRIME_Y)
+            , seed(static_cast<uint32_t>(seed_))
+        {
+            // Zero for cells in the int32 range, where the local float path must give the same hashes
+            const uint32_t highX = static_cast<uint32_t>((static_cast<uint64_t>(cellX) + 0x80000000ull) >> 32);
+            const uint32_t highY = static_cast<uint32_t>((static_cast<uint64_t>(cellY) + 0x80000000ull) >> 32);
+            if (highX != 0 || highY != 0)
+                seed = Hash(highX * PRIME_X, highY * PRIME_Y, seed);
+        }
+    };
+
+    template<typename F>
+    F Fade(F t)
+    {
+        return t * t * t * (t * (t * F(6.f) - F(15.f)) + F(10.f));
+    }
+
+    template<typename F>
+    F Lerp(F a, F b, F t)
+    {
+        return a + (b - a) * t;
+    }
+
+    struct PerlinKernel
+    {
+        // Diagonal gradients (+-1, +-1) selected by two hash bits
+        template<typename F, typename I>
+        static F Gradient(I h, F dx, F dy)
+        {
+            return FlipSign(dx, h << 31) + FlipSign(dy, h << 30);
+        }
+
+        static LatticeBase Base(int64_t cellX, int64_t cellY, int seed) { return LatticeBase(cellX, cellY, seed); }
+
+        template<typename F, typename I>
+        static F Evaluate(F x, F y, const LatticeBase& base)
+        {
+            const I seed(base.seed);
+            const F fx = Floor(x);
+            const F fy = Floor(y);
+            const I x0 = ToInt(fx) * I(PRIME_X) + I(base.x);
+            const I y0 = ToInt(fy) * I(PRIME_Y) + I(base.y);
+            const I x1 = x0 + I(PRIME_X);
+            const I y1 = y0 + I(PRIME_Y);
+            const F dx = x - fx;
+            const F dy = y - fy;
+
+            const F n00 = Gradient(Hash(x0, y0, seed), dx, dy);
+            const F n10 = Gradient(Hash(x1, y0, seed), dx - F(1.f), dy);
+            const F n01 = Gradient(Hash(x0, y1, seed), dx, dy - F(1.f));
+            const F n11 = Gradient(Hash(x1, y1, seed), dx - F(1.f), dy - F(1.f));
+
+            const F u = Fade(dx);
+            return Lerp(Lerp(n00, n10, u), Lerp(n01, n11, u), Fade(dy));
+        }
+    };
+
+    struct ValueKernel
+    {
+        template<typename F, typename I>
+        static F Value(I h)
+        {
+            return ToFloat(h >> 8) * F(2.f / 16777216.f) - F(1.f);
+        }
+
+        static LatticeBase Base(int64_t cellX, int64_t cellY, int seed) { return LatticeBase(cellX, cellY, seed); }
+
+        template<typename F, typename I>
+        static F Evaluate(F x, F y, const LatticeBase& base)
+        {
+            const I seed(base.seed);
+            const F fx = Floor(x);
+            const F fy = Floor(y);
+            const I x0 = ToInt(fx) * I(PRIME_X) + I(base.x);
+            const I y0 = ToInt(fy) * I(PRIME_Y) + I(base.y);
+            const I x1 = x0 + I(PRIME_X);
+            const I y1 = y0 + I(PRIME_Y);
+
+            const F u = Fade(x - fx);
+            const F top = Lerp(Value<F>(Hash(x0, y0, seed)), Value<F>(Hash(x1, y0, seed)), u);
+            const F bottom = Lerp(Value<F>(Hash(x0, y1, seed)), Value<F>(Hash(x1, y1, seed)), u);
+            return Lerp(top, bottom, Fade(y - fy));
+        }
+    };
+
+    // OpenSimplex2 (fast variant) on its 2D simplex lattice, 24 unit gradients
+    struct OpenSimplex2Kernel
+    {
+        static constexpr float SKEW = 0.366025403784439f;
+        static constexpr float UNSKEW = -0.21132486540518713f;
+        static constexpr float RADIUS_SQUARED = 0.5f;
+        static constexpr float NORMALIZER = 99.83685446303647f;
+
+        struct Gradients
+        {
+            float x[24];
+            float y[24];
+
+            Gradients()
+            {
+                for (int i = 0; i < 24; ++i)
+                {
+                    const float angle = (i + 0.5f) * 6.2831853f / 24.f;
+                    x[i] = std::cos(angle) * NORMALIZER;
+                    y[i] = std::sin(angle) * NORMALIZER;
+                }
+            }
+        };
+
+        static const Gradients& GetGradients()
+        {
+            static const Gradients gradients;
+            return gradients;
+        }
+
+        template<typename F, typename I>
+        static F Contribution(I h, F dx, F dy)
+        {
+            const Gradients& g = GetGradients();
+            const F a = Max(F(RADIUS_SQUARED) - dx * dx - dy * dy, F(0.f));
+            const I index = ((h >> 8) * I(24)) >> 24;
+            const F a2 = a * a;
+            return a2 * a2 * (Gather(g.x, index) * dx + Gather(g.y, index) * dy);
+        }
+
+        // The skew of the cell offset is not integral: its integer part moves the base cell, its fraction
+        // is added to the local skewed coordinates. Computed in double once per call.
+        static LatticeBase Base(int64_t cellX, int64_t cellY, int seed)
+        {
+            const double skew = (static_cast<double>(cellX) + static_cast<double>(cellY)) * SKEW;
+            const double skewCells = std::floor(skew);
+            LatticeBase base(cellX + static_cast<int64_t>(skewCells), cellY + static_cast<int64_t>(skewCells), seed);
+            base.skew = static_cast<float>(skew - skewCells);
+            return base;
+        }
+
+        template<typename F, typename I>
+        static F Evaluate(F x, F y, const LatticeBase& base)
+        {
+            const I seed(base.seed);
+            const F s = (x + y) * F(SKEW) + F(base.skew);
+            const F xs = x + s;
+            const F ys = y + s;
+            const F fx = Floor(xs);
+            const F fy = Floor(ys);
+            const I xp = ToInt(fx) * I(PRIME_X) + I(base.x);
+            const I yp = ToInt(fy) * I(PRIME_Y) + I(base.y);
+            const F xi = xs - fx;
+            const F yi = ys - fy;
+
+            // Unskewed offsets to the base vertex, the opposite vertex, then one of the two others
+            const F t = (xi + yi) * F(UNSKEW);
+            const F dx0 = xi + t;
+            const F dy0 = yi + t;
+            F value = Contribution(Hash(xp, yp, seed), dx0, dy0);
+
+            constexpr float diagonal = 1.f + 2.f * UNSKEW;
+            value = value + Contribution(Hash(xp + I(PRIME_X), yp + I(PRIME_Y), seed), dx0 - F(diagonal), dy0 - F(diagonal));
+
+            const auto upper = dy0 > dx0;
+            const I xThird = xp + Select(upper, I(0u), I(PRIME_X));
+            const I yThird = yp + Select(upper, I(PRIME_Y), I(0u));
+            const F dx2 = dx0 - Select(upper, F(UNSKEW), F(UNSKEW + 1.f));
+            const F dy2 = dy0 - Select(upper, F(UNSKEW + 1.f), F(UNSKEW));
+            return value + Contribution(Hash(xThird, yThird, seed), dx2, dy2);
+        }
+    };
+
+    // Jittered feature point per cell, closest two over the 3x3 neighbourhood
+    template<bool SECOND>
+    struct WorleyKernel
+    {
+        static LatticeBase Base(int64_t cellX, int64_t cellY, int seed) { return LatticeBase(cellX, cellY, seed); }
+
+        template<typename F, typename I>
+        static F Evaluate(F x, F y, const LatticeBase& base)
+        {
+            const I seed(base.seed);
+            const F fx = Floor(x);
+            const F fy = Floor(y);
+            const I xp = ToInt(fx) * I(PRIME_X) + I(base.x);
+            const I yp = ToInt(fy) * I(PRIME_Y) + I(base.y);
+            const F dx = x - fx;
+            const F dy = y - fy;
+
+            F f1(8.f);
+            F f2(8.f);
+            for (int oy = -1; oy <= 1; ++oy)
+            {
+                for (int ox = -1; ox <= 1; ++ox)
+                {
+                    const I h = Hash(xp + I(static_cast<uint32_t>(ox) * PRIME_X), yp + I(static_cast<uint32_t>(oy) * PRIME_Y), seed);
+                    const F px = F(static_cast<float>(ox)) + ToFloat(h & I(0xFFFFu)) * F(1.f / 65536.f) - dx;
+                    const F py = F(static_cast<float>(oy)) + ToFloat(h >> 16) * F(1.f / 65536.f) - dy;
+                    const F d = px * px + py * py;
+                    f2 = Min(f2, Max(f1, d));
+                    f1 = Min(f1, d);
+                }
+            }
+            return Sqrt(SECOND ? f2 : f1);
+        }
+    };
+
+}
+
+namespace
+{
+    template<typename Kernel>
+    class KernelEngine final : public NoiseEngine
+    {
+    public:
+        KernelEngine(NoiseType type, int seed)
+            : NoiseEngine(type, seed)
+        {}
+
+        float sample(int64_t cellX, int64_t cellY, float x, float y) const override
+        {
+            return Kernel::template Evaluate<float, uint32_t>(x, y, Kernel::Base(cellX, cellY, m_seed));
+        }
+
+        void sampleBatch(const float* x, const float* y, int count, float* out) const override
+        {
+            const LatticeBase base = Kernel::Base(0, 0, m_seed);
+            int i = 0;
+            for (; i + 4 <= count; i += 4)
+                Kernel::template Evaluate<Float4, Int4>(Float4::Load(x + i), Float4::Load(y + i), base).store(out + i);
+            for (; i < count; ++i)
+                out[i] = Kernel::template Evaluate<float, uint32_t>(x[i], y[i], base);
+        }
+
+        void sampleRow(int64_t cellX, int64_t cellY, float x0, float dx, float y, int count, float* out, int first) const override
+        {
+            static const float lanes[4] = { 0.f, 1.f, 2.f, 3.f };
+            const LatticeBase base = Kernel::Base(cellX, cellY, m_seed);
+            const Float4 lane = Float4::Load(lanes);
+            const Float4 row(y);
+            int i = 0;
+            for (; i + 4 <= count; i += 4)
+                Kernel::template Evaluate<Float4, Int4>(Float4(x0) + (Float4(static_cast<float>(first + i)) + lane) * Float4(dx), row, base).store(out + i);
+            for (; i < count; ++i)
+                out[i] = Kernel::template Evaluate<float, uint32_t>(x0 + static_cast<float>(first + i) * dx, y, base);
+        }
+    };
+}
+
+namespace Noise
+{
+    const char* Name(NoiseType type)
+    {
+        switch (type)
+        {
+        case NoiseType::PERLIN: return "Perlin";
+        case NoiseType::OPENSIMPLEX2: return "OpenSimplex2";
+        case NoiseType::VALUE: return "Value";
+        case NoiseType::WORLEY_F1: return "Worley F1";
+        case NoiseType::WORLEY_F2: return "Worley F2";
+        default: return "Unknown";
+        }
+    }
+
+    std::unique_ptr<NoiseEngine> CreateEngine(NoiseType type, int seed)
+    {
+        switch (type)
+        {
+        case NoiseType::OPENSIMPLEX2: return std::make_unique<KernelEngine<OpenSimplex2Kernel>>(type, seed);
+        case NoiseType::VALUE: return std::make_unique<KernelEngine<ValueKernel>>(type, seed);
+        case NoiseType::WORLEY_F1: return std::make_unique<KernelEngine<WorleyKernel<false>>>(type, seed);
+        case NoiseType::WORLEY_F2: return std::make_unique<KernelEngine<WorleyKernel<true>>>(type, seed);
+        default: return std::make_unique<KernelEngine<PerlinKernel>>(NoiseType::PERLIN, seed);
+        }
+    }
+
+    void Benchmark(std::ostream& out, int sampleCount)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        constexpr int rowLength = 1024;
+        const int rowCount = std::max(1, sampleCount / rowLength);
+        const double samples = static_cast<double>(rowCount) * rowLength;
+        const float step = 1.f / 64.f;
+        std::vector<float> row(rowLength);
+
+        // Accumulated so the compiler cannot drop the work
+        float checksum = 0.f;
+        auto nsPerSample = [&](auto&& fillRow)
+        {
+            const auto start = Clock::now();
+            for (int y = 0; y < rowCount; ++y)
+            {
+                fillRow(y * step, row.data());
+                checksum += row[y % rowLength];
+            }
+            return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / samples;
+        };
+
+        out << "Noise benchmark, " << static_cast<long long>(samples) << " samples per run"
+#ifdef TERRAIN_SIMD_SSE2
+            << " (SSE2)"
+#endif
+            << std::endl;
+
+        const double legacy = nsPerSample([&](float y, float* values)
+        {
+            for (int x = 0; x < rowLength; ++x)
+                values[x] = perlin(x * step, y, 0);
+        });
+        out << "  perlin() (legacy linear): " << legacy << " ns/sample" << std::endl;
+
+        for (int type = 0; type < static_cast<int>(NoiseType::COUNT); ++type)
+        {
+            const auto engine = CreateEngine(static_cast<NoiseType>(type), 0);
+            const double scalar = nsPerSample([&](float y, float* values)
+            {
+                for (int x = 0; x < rowLength; ++x)
+                    values[x] = engine->sample(x * step, y);
+            });
+            const double batched = nsPerSample([&](float y, float* values)
+            {
+                engine->sampleRow(0.f, step, y, rowLength, values);
+            });
+
+            out << "  " << Name(engine->getType()) << ": " << scalar << " ns/sample scalar, "
+                << batched << " ns/sample batched" << std::endl;
+        }
+
+        out << "  (checksum " << checksum << ")" << std::endl;
+    }
+}
@@ -40,8 +40,8 @@ float interpolate(float a0, float a1, float w) {
 
 float perlin(float x, float y, int seed) 
 {
-    int x0 = (int)x;
-    int y0 = (int)y;
+    int x0 = (int)std::floor(x);
+    int y0 = (int)std::floor(y);
     int x1 = x0 + 1;
     int y1 = y0 + 1;
 
@@ -59,14 +59,14 @@ float perlin(float x, float y, int seed)
     return std::max(0.f, interpolate(ix0, ix1, sy));
 }
 
-std::vector<std::vector<float>> generatePerlinNoise(int width, int height, int seed)
+std::vector<std::vector<float>> generatePerlinNoise(int width, int height, int seed, float frequency)
 {
     std::vector<std::vector<float>> noiseData(height, std::vector<float>(width));
 
     // Generate Perlin noise data
     for (int y = 0; y < height; ++y) {
         for (int x = 0; x < width; ++x) {
-            noiseData[y][x] = perlin(x * 0.1, y * 0.1, seed);
+            noiseData[y][x] = perlin(x * frequency, y * frequency, seed);
         }
     }
 
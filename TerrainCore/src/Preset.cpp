@@ -0,0 +1,235 @@
+#include "Preset.h"
+
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+
+namespace
+{
+    const char* const NOISE_KEYS[] = { "perlin", "opensimplex2", "value", "worley_f1", "worley_f2" };
+    static_assert(std::size(NOISE_KEYS) == static_cast<size_t>(NoiseType::COUNT));
+
+    std::string Trim(const std::string& text)
+    {
+        const size_t first = text.find_first_not_of(" \t\r");
+        if (first == std::string::npos)
+            return {};
+        const size_t last = text.find_last_not_of(" \t\r");
+        return text.substr(first, last - first + 1);
+    }
+
+    template<typename T>
+    bool ParseValue(const std::string& text, T& value)
+    {
+        std::istringstream stream(text);
+        T parsed;
+        if (!(stream >> parsed) || !(stream >> std::ws).eof())
+            return false;
+        value = parsed;
+        return true;
+    }
+
+    // Shortest text that reads back as the same float
+    std::string Format(float value)
+    {
+        char buffer[32];
+        const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        return std::string(buffer, result.ptr);
+    }
+
+    bool ParseNoiseType(const std::string& text, NoiseType& type)
+    {
+        for (size_t i = 0; i < std::size(NOISE_KEYS); ++i)
+        {
+            if (text == NOISE_KEYS[i])
+            {
+                type = static_cast<NoiseType>(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Return false for unknown keys or malformed values
+    bool ParseKey(TerrainPreset& preset, const std::string& section, const std::string& key, const std::string& value)
+    {
+        if (section.empty())
+        {
+            if (key == "seed") return ParseValue(value, preset.seed);
+            if (key == "size") return ParseValue(value, preset.size);
+            if (key == "extent") return ParseValue(value, preset.extent);
+            if (key == "height_scale") return ParseValue(value, preset.heightScale);
+            if (key == "origin_x") return ParseValue(value, preset.origin.x);
+            if (key == "origin_z") return ParseValue(value, preset.origin.z);
+            if (key == "max_error") return ParseValue(value, preset.maxError);
+        }
+        else if (section == "noise")
+        {
+            NoiseStage& stage = preset.noise.back();
+            if (key == "type") return ParseNoiseType(value, stage.type);
+            if (key == "frequency") return ParseValue(value, stage.frequency);
+            if (key == "amplitude") return ParseValue(value, stage.amplitude);
+            if (key == "seed_offset") return ParseValue(value, stage.seedOffset);
+        }
+        else if (section == "erosion")
+        {
+            if (key == "iterations") return ParseValue(value, preset.erosion.iterations);
+            if (key == "talus") return ParseValue(value, preset.erosion.talus);
+            if (key == "rate") return ParseValue(value, preset.erosion.rate);
+        }
+        else if (section == "biomes")
+        {
+            if (key == "climate_frequency") return ParseValue(value, preset.biomes.climateFrequency);
+            if (key == "sand_height") return ParseValue(value, preset.biomes.sandHeight);
+            if (key == "snow_height") return ParseValue(value, preset.biomes.snowHeight);
+            if (key == "rock_slope") return ParseValue(value, preset.biomes.rockSlope);
+        }
+        return false;
+    }
+}
+
+GenerationSettings TerrainPreset::generation() const
+{
+    GenerationSettings settings;
+    settings.seed = seed;
+    settings.stageCount = static_cast<int>(std::min<size_t>(noise.size(), GenerationSettings::MAX_NOISE_STAGES));
+    std::copy(noise.begin(), noise.begin() + settings.stageCount, settings.stages);
+    settings.size = size;
+    settings.step = step();
+    settings.origin = origin;
+    settings.erosion = erosion;
+    return settings;
+}
+
+namespace Preset
+{
+    bool Read(std::istream& stream, TerrainPreset& preset, const std::string& name)
+    {
+        TerrainPreset result;
+        bool firstStage = true;
+        std::string section;
+        std::string line;
+        for (int lineNumber = 1; std::getline(stream, line); ++lineNumber)
+        {
+            const size_t comment = line.find('#');
+            if (comment != std::string::npos)
+                line.resize(comment);
+            line = Trim(line);
+            if (line.empty())
+                continue;
+
+            if (line.front() == '[' && line.back() == ']')
+            {
+                section = Trim(line.substr(1, line.size() - 2));
+                if (section == "noise")
+                {
+                    // The first section replaces the default stage, the next ones add stages
+                    if (firstStage)
+                        result.noise.assign(1, NoiseStage());
+                    else
+                        result.noise.emplace_back();
+                    firstStage = false;
+                }
+                else if (section != "erosion" && section != "biomes")
+                {
+                    std::cerr << name << ":" << lineNumber << ": unknown section [" << section << "]." << std::endl;
+                    return false;
+                }
+                continue;
+            }
+
+            const size_t equal = line.find('=');
+            const std::string key = Trim(line.substr(0, equal));
+            const std::string value = equal != std::string::npos ? Trim(line.substr(equal + 1)) : std::string();
+            if (equal == std::string::npos || !ParseKey(result, section, key, value))
+            {
+                std::cerr << name << ":" << lineNumber << ": invalid line \"" << line << "\"." << std::endl;
+                return false;
+            }
+        }
+
+        if (result.size < 2 || result.extent <= 0.f || result.noise.size() > GenerationSettings::MAX_NOISE_STAGES)
+        {
+            std::cerr << name << ": invalid size, extent or stage count." << std::endl;
+            return false;
+        }
+        for (const NoiseStage& stage : result.noise)
+        {
+            if (stage.frequency < 1)
+            {
+                std::cerr << name << ": noise frequencies must be positive integers." << std::endl;
+                return false;
+            }
+        }
+
+        preset = result;
+        return true;
+    }
+
+    void Write(std::ostream& stream, const TerrainPreset& preset)
+    {
+        stream << "seed = " << preset.seed << "\n"
+               << "size = " << preset.size << "\n"
+               << "extent = " << Format(preset.extent) << "\n"
+               << "height_scale = " << Format(preset.heightScale) << "\n"
+               << "origin_x = " << preset.origin.x << "\n"
+               << "origin_z = " << preset.origin.z << "\n"
+               << "max_error = " << Format(preset.maxError) << "\n";
+
+        for (const NoiseStage& stage : preset.noise)
+        {
+            stream << "\n[noise]\n"
+                   << "type = " << NOISE_KEYS[static_cast<int>(stage.type)] << "\n"
+                   << "frequency = " << stage.frequency << "\n"
+                   << "amplitude = " << Format(stage.amplitude) << "\n"
+                   << "seed_offset = " << stage.seedOffset << "\n";
+        }
+
+        stream << "\n[erosion]\n"
+               << "iterations = " << preset.erosion.iterations << "\n"
+               << "talus = " << Format(preset.erosion.talus) << "\n"
+               << "rate = " << Format(preset.erosion.rate) << "\n";
+
+        stream << "\n[biomes]\n"
+               << "climate_frequency = " << Format(preset.biomes.climateFrequency) << "\n"
+               << "sand_height = " << Format(preset.biomes.sandHeight) << "\n"
+               << "snow_height = " << Format(preset.biomes.snowHeight) << "\n"
+               << "rock_slope = " << Format(preset.biomes.rockSlope) << "\n";
+    }
+
+    bool Load(const std::string& filePath, TerrainPreset& preset)
+    {
+        std::ifstream file(filePath);
+        if (!file.is_open())
+        {
+            std::cerr << "Impossible to read preset " << filePath << "." << std::endl;
+            return false;
+        }
+        return Read(file, preset, filePath);
+    }
+
+    bool Save(const std::string& filePath, const TerrainPreset& preset)
+    {
+        std::ofstream file(filePath);
+        if (!file.is_open())
+        {
+            std::cerr << "Impossible to write preset " << filePath << "." << std::endl;
+            return false;
+        }
+        Write(file, preset);
+        return static_cast<bool>(file);
+    }
+
+    bool ParseArguments(int argc, char** argv, TerrainPreset& preset)
+    {
+        for (int i = 1; i + 1 < argc; ++i)
+        {
+            if (std::strcmp(argv[i], "--preset") == 0)
+                return Load(argv[i + 1], preset);
+        }
+        return true;
+    }
+}
@@ -0,0 +1,334 @@
+#include "Replay.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+
+namespace
+{
+    // Shortest text that reads back as the same value
+    template<typename T>
+    std::string Format(T value)
+    {
+        char buffer[32];
+        const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        return std::string(buffer, result.ptr);
+    }
+
+    std::string Trim(const std::string& text)
+    {
+        const size_t first = text.find_first_not_of(" \t\r");
+        if (first == std::string::npos)
+            return {};
+        const size_t last = text.find_last_not_of(" \t\r");
+        return text.substr(first, last - first + 1);
+    }
+
+    bool ReadFrame(std::istringstream& line, ReplayFrame& frame)
+    {
+        int movement = 0;
+        line >> frame.origin.x >> frame.origin.y >> frame.origin.z >> frame.position.x >> frame.position.y >> frame.position.z
+             >> frame.yaw >> frame.pitch >> movement >> frame.mouseX >> frame.mouseY;
+        frame.movement = static_cast<uint8_t>(movement);
+        return line && movement >= 0 && movement < 64 && (line >> std::ws).eof();
+    }
+
+    void WriteEvent(std::ostream& stream, const ReplayEvent& event)
+    {
+        stream << "set " << event.frame << " " << event.key << " ";
+        if (event.value.find('\n') == std::string::npos)
+        {
+            stream << event.value << "\n";
+            return;
+        }
+        stream << "{\n" << event.value;
+        if (event.value.back() != '\n')
+            stream << "\n";
+        stream << "}\n";
+    }
+
+    double Percentile(std::vector<double> values, double fraction)
+    {
+        if (values.empty())
+            return 0.0;
+        const size_t index = std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()));
+        std::nth_element(values.begin(), values.begin() + index, values.end());
+        return values[index];
+    }
+
+    bool EndsWith(const std::string& text, const std::string& suffix)
+    {
+        return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+}
+
+ReplayRecorder::ReplayRecorder(double timestep)
+{
+    m_recording.timestep = timestep;
+}
+
+void ReplayRecorder::addFrame(const ReplayFrame& frame, const ReplayParameters& parameters)
+{
+    const int index = static_cast<int>(m_recording.frames.size());
+    for (const auto& [key, value] : parameters)
+    {
+        const auto previous = m_parameters.find(key);
+        if (previous == m_parameters.end() || previous->second != value)
+            m_recording.events.push_back({ index, key, value });
+    }
+    m_parameters = parameters;
+    m_recording.frames.push_back(frame);
+}
+
+namespace Replay
+{
+    bool Read(std::istream& stream, Recording& recording, const std::string& name)
+    {
+        Recording result;
+        std::string text;
+        for (int lineNumber = 1; std::getline(stream, text); ++lineNumber)
+        {
+            text = Trim(text);
+            if (text.empty() || text.front() == '#')
+                continue;
+
+            std::istringstream line(text);
+            std::string type;
+            line >> type;
+            bool valid = false;
+            if (type == "timestep")
+            {
+                valid = static_cast<bool>(line >> result.timestep) && result.timestep > 0.0;
+            }
+            else if (type == "frame")
+            {
+                int index = -1;
+                ReplayFrame frame;
+                valid = (line >> index) && index == static_cast<int>(result.frames.size()) && ReadFrame(line, frame);
+                if (valid)
+                    result.frames.push_back(frame);
+            }
+            else if (type == "set")
+            {
+                ReplayEvent event;
+                valid = (line >> event.frame >> event.key) && event.frame >= 0
+                        && (result.events.empty() || result.events.back().frame <= event.frame);
+                std::getline(line, event.value);
+                event.value = Trim(event.value);
+
+                // Multi-line value, until its closing line
+                if (valid && event.value == "{")
+                {
+                    event.value.clear();
+                    bool closed = false;
+                    std::string valueLine;
+                    while (!closed && std::getline(stream, valueLine))
+                    {
+                        ++lineNumber;
+                        closed = Trim(valueLine) == "}";
+                        if (!closed)
+                            event.value += valueLine + "\n";
+                    }
+                    valid = closed;
+                }
+                float number = 0.f;
+                if (valid && Replay::IsNumericParameter(event.key))
+                    valid = Replay::ParseNumber(event.value, number);
+                if (valid)
+                    result.events.push_back(std::move(event));
+            }
+
+            if (!valid)
+            {
+                std::cerr << name << ":" << lineNumber << ": invalid line \"" << text << "\"." << std::endl;
+                return false;
+            }
+        }
+
+        recording = std::move(result);
+        return true;
+    }
+
+    bool ParseNumber(std::string_view text, float& value)
+    {
+        float parsed = 0.f;
+        const auto result = std::from_chars(text.data(), text.data() + text.size(), parsed);
+        if (result.ec != std::errc() || result.ptr != text.data() + text.size() || !std::isfinite(parsed))
+            return false;
+        value = parsed;
+        return true;
+    }
+
+    bool IsNumericParameter(const std::string& key)
+    {
+        return key == "sun_azimuth" || key == "sun_elevation";
+    }
+
+    void Write(std::ostream& stream, const Recording& recording)
+    {
+        stream << "# Terrain viewer recording\n"
+               << "timestep " << Format(recording.timestep) << "\n";
+
+        size_t event = 0;
+        for (size_t i = 0; i < recording.frames.size(); ++i)
+        {
+            for (; event < recording.events.size() && recording.events[event].frame <= static_cast<int>(i); ++event)
+                WriteEvent(stream, recording.events[event]);
+
+            const ReplayFrame& frame = recording.frames[i];
+            stream << "frame " << i << " " << frame.origin.x << " " << frame.origin.y << " " << frame.origin.z << " "
+                   << Format(frame.position.x) << " " << Format(frame.position.y) << " " << Format(frame.position.z) << " "
+                   << Format(frame.yaw) << " " << Format(frame.pitch) << " " << static_cast<int>(frame.movement) << " "
+                   << Format(frame.mouseX) << " " << Format(frame.mouseY) << "\n";
+        }
+        for (; event < recording.events.size(); ++event)
+            WriteEvent(stream, recording.events[event]);
+    }
+
+    bool Load(const std::string& filePath, Recording& recording)
+    {
+        std::ifstream file(filePath);
+        if (!file.is_open())
+        {
+            std::cerr << "Impossible to read recording " << filePath << "." << std::endl;
+            return false;
+        }
+        return Read(file, recording, filePath);
+    }
+
+    bool Save(const std::string& filePath, const Recording& recording)
+    {
+        std::ofstream file(filePath);
+        if (!file.is_open())
+        {
+            std::cerr << "Impossible to write recording " << filePath << "." << std::endl;
+            return false;
+        }
+        Write(file, recording);
+        return static_cast<bool>(file);
+    }
+
+    std::span<const ReplayEvent> Events(const Recording& recording, int frame)
+    {
+        const auto [first, last] = std::equal_range(recording.events.begin(), recording.events.end(), ReplayEvent{ frame, {}, {} },
+                                                    [](const ReplayEvent& a, const ReplayEvent& b) { return a.frame < b.frame; });
+        return { first, last };
+    }
+
+    ReplaySummary Summarize(std::span<const FrameMetrics> metrics)
+    {
+        ReplaySummary summary;
+        summary.frames = static_cast<int>(metrics.size());
+        if (metrics.empty())
+            return summary;
+
+        std::vector<double> cpuTimes;
+        std::vector<double> gpuTimes;
+        double drawCalls = 0.0;
+        double triangles = 0.0;
+        double stateChanges = 0.0;
+        for (const FrameMetrics& frame : metrics)
+        {
+            cpuTimes.push_back(frame.cpuTime);
+            if (frame.gpuTime >= 0.0)
+                gpuTimes.push_back(frame.gpuTime);
+            drawCalls += frame.drawCalls;
+            triangles += static_cast<double>(frame.triangles);
+            stateChanges += frame.stateChanges;
+            summary.uploadBytes += frame.uploadBytes;
+        }
+
+        const double count = static_cast<double>(metrics.size());
+        summary.meanCpuTime = std::accumulate(cpuTimes.begin(), cpuTimes.end(), 0.0) / count;
+        summary.maxCpuTime = *std::max_element(cpuTimes.begin(), cpuTimes.end());
+        summary.p95CpuTime = Percentile(std::move(cpuTimes), 0.95);
+        if (!gpuTimes.empty())
+        {
+            summary.meanGpuTime = std::accumulate(gpuTimes.begin(), gpuTimes.end(), 0.0) / gpuTimes.size();
+            summary.p95GpuTime = Percentile(std::move(gpuTimes), 0.95);
+        }
+        summary.meanDrawCalls = drawCalls / count;
+        summary.meanTriangles = triangles / count;
+        summary.meanStateChanges = stateChanges / count;
+        return summary;
+    }
+
+    void WriteCsv(std::ostream& stream, std::span<const FrameMetrics> metrics)
+    {
+        stream << "frame,cpu_ms,gpu_ms,draw_calls,triangles,upload_bytes,state_changes\n";
+        for (const FrameMetrics& frame : metrics)
+        {
+            stream << frame.frame << "," << Format(frame.cpuTime) << "," << (frame.gpuTime >= 0.0 ? Format(frame.gpuTime) : "") << ","
+                   << frame.drawCalls << "," << frame.triangles << "," << frame.uploadBytes << "," << frame.stateChanges << "\n";
+        }
+    }
+
+    void WriteJson(std::ostream& stream, std::span<const FrameMetrics> metrics)
+    {
+        auto optional = [](double value) { return value >= 0.0 ? Format(value) : std::string("null"); };
+
+        const ReplaySummary summary = Summarize(metrics);
+        stream << "{\n  \"summary\": {"
+               << "\"frames\": " << summary.frames
+               << ", \"mean_cpu_ms\": " << Format(summary.meanCpuTime)
+               << ", \"p95_cpu_ms\": " << Format(summary.p95CpuTime)
+               << ", \"max_cpu_ms\": " << Format(summary.maxCpuTime)
+               << ", \"mean_gpu_ms\": " << optional(summary.meanGpuTime)
+               << ", \"p95_gpu_ms\": " << optional(summary.p95GpuTime)
+               << ", \"mean_draw_calls\": " << Format(summary.meanDrawCalls)
+               << ", \"mean_triangles\": " << Format(summary.meanTriangles)
+               << ", \"mean_state_changes\": " << Format(summary.meanStateChanges)
+               << ", \"upload_bytes\": " << summary.uploadBytes << "},\n  \"frames\": [";
+
+        for (size_t i = 0; i < metrics.size(); ++i)
+        {
+            const FrameMetrics& frame = metrics[i];
+            stream << (i > 0 ? ",\n    " : "\n    ")
+                   << "{\"frame\": " << frame.frame
+                   << ", \"cpu_ms\": " << Format(frame.cpuTime)
+                   << ", \"gpu_ms\": " << optional(frame.gpuTime)
+                   << ", \"draw_calls\": " << frame.drawCalls
+                   << ", \"triangles\": " << frame.triangles
+                   << ", \"upload_bytes\": " << frame.uploadBytes
+                   << ", \"state_changes\": " << frame.stateChanges << "}";
+        }
+        stream << "\n  ]\n}\n";
+    }
+
+    bool SaveMetrics(const std::string& filePath, std::span<const FrameMetrics> metrics)
+    {
+        std::ofstream file(filePath);
+        if (!file.is_open())
+        {
+            std::cerr << "Impossible to write metrics " << filePath << "." << std::endl;
+            return false;
+        }
+        if (EndsWith(filePath, ".json"))
+            WriteJson(file, metrics);
+        else
+            WriteCsv(file, metrics);
+        return static_cast<bool>(file);
+    }
+
+    bool ParseArguments(int argc, char** argv, ReplaySettings& settings)
+    {
+        for (int i = 1; i + 1 < argc; ++i)
+        {
+            if (std::strcmp(argv[i], "--record") == 0)
+                settings.recordPath = argv[++i];
+            else if (std::strcmp(argv[i], "--record-step") == 0)
+                settings.timestep = std::max(1e-4, std::atof(argv[++i]));
+            else if (std::strcmp(argv[i], "--replay") == 0)
+                settings.replayPath = argv[++i];
+            else if (std::strcmp(argv[i], "--replay-out") == 0)
+                settings.metricsPath = argv[++i];
+        }
+        return !settings.recordPath.empty() || !settings.replayPath.empty();
+    }
+}
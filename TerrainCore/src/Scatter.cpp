@@ -0,0 +1,182 @@
+#include "Scatter.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    uint32_t Hash(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+    {
+        // Murmur3 style mixing of the four words
+        uint32_t h = 0x9E3779B9u;
+        for (uint32_t k : { a, b, c, d })
+        {
+            k *= 0xCC9E2D51u;
+            k = (k << 15) | (k >> 17);
+            k *= 0x1B873593u;
+            h ^= k;
+            h = ((h << 13) | (h >> 19)) * 5u + 0xE6546B64u;
+        }
+        h ^= h >> 16;
+        h *= 0x85EBCA6Bu;
+        h ^= h >> 13;
+        h *= 0xC2B2AE35u;
+        h ^= h >> 16;
+        return h;
+    }
+
+    float Unit(uint32_t h)
+    {
+        return (h >> 8) * (1.f / 16777216.f);
+    }
+
+    struct Cell
+    {
+        float x = 0.f;
+        float z = 0.f;
+        uint32_t priority = 0;
+        int round = -1;       // Round of the accepted point, -1 if the cell is empty
+        bool eligible = false;
+    };
+}
+
+ScatterGenerator::ScatterGenerator(uint32_t seed, uint32_t layer, const ScatterRule& rule)
+    : m_seed(seed)
+    , m_layer(layer)
+    , m_rule(rule)
+{
+}
+
+void ScatterGenerator::generate(const HeightfieldView& heightfield, float x0, float z0, float size, std::vector<ScatterInstance>& instances) const
+{
+    instances.clear();
+    if (!heightfield.valid() || m_rule.radius <= 0.f || size <= 0.f)
+        return;
+
+    const float radius = m_rule.radius;
+    const float radius2 = radius * radius;
+    const float cellSize = radius / std::sqrt(2.f);
+
+    // A cell depends on candidates up to 2 cells away, and on the previous round of those: 4 cells per round
+    constexpr int reach = 2;
+    constexpr int margin = 2 * reach * ROUNDS;
+    const int ci0 = static_cast<int>(std::floor(x0 / cellSize)) - margin;
+    const int cj0 = static_cast<int>(std::floor(z0 / cellSize)) - margin;
+    const int ci1 = static_cast<int>(std::floor((x0 + size) / cellSize)) + margin + 1;
+    const int cj1 = static_cast<int>(std::floor((z0 + size) / cellSize)) + margin + 1;
+    const int columns = ci1 - ci0;
+    const int rows = cj1 - cj0;
+
+    std::vector<Cell> cells(static_cast<size_t>(columns) * rows);
+    auto cell = [&](int i, int j) -> Cell& { return cells[static_cast<size_t>(j) * columns + i]; };
+
+    auto conflicts = [&](int i, int j, float x, float z, auto&& predicate)
+    {
+        for (int dj = -reach; dj <= reach; ++dj)
+        {
+            for (int di = -reach; di <= reach; ++di)
+            {
+                const int ni = i + di;
+                const int nj = j + dj;
+                if ((di == 0 && dj == 0) || ni < 0 || nj < 0 || ni >= columns || nj >= rows)
+                    continue;
+
+                const Cell& other = cell(ni, nj);
+                const float dx = other.x - x;
+                const float dz = other.z - z;
+                if (dx * dx + dz * dz < radius2 && predicate(other, ni, nj))
+                    return true;
+            }
+        }
+        return false;
+    };
+
+    for (int round = 0; round < ROUNDS; ++round)
+    {
+        // Candidates of the free cells that no accepted point rejects
+        for (int j = 0; j < rows; ++j)
+        {
+            for (int i = 0; i < columns; ++i)
+            {
+                Cell& c = cell(i, j);
+                c.eligible = false;
+                if (c.round >= 0)
+                    continue;
+
+                const uint32_t gi = static_cast<uint32_t>(ci0 + i);
+                const uint32_t gj = static_cast<uint32_t>(cj0 + j);
+                c.x = (ci0 + i + Unit(Hash(m_seed, m_layer * 4 + round, gi, gj))) * cellSize;
+                c.z = (cj0 + j + Unit(Hash(m_seed ^ 0x5BD1E995u, m_layer * 4 + round, gi, gj))) * cellSize;
+                c.priority = Hash(m_seed ^ 0x27D4EB2Fu, m_layer * 4 + round, gi, gj);
+            }
+        }
+        for (int j = 0; j < rows; ++j)
+        {
+            for (int i = 0; i < columns; ++i)
+            {
+                Cell& c = cell(i, j);
+                if (c.round < 0)
+                    c.eligible = !conflicts(i, j, c.x, c.z, [](const Cell& other, int, int) { return other.round >= 0; });
+            }
+        }
+
+        // Keep the eligible candidates that beat every eligible candidate in range, ties broken by cell
+        for (int j = 0; j < rows; ++j)
+        {
+            for (int i = 0; i < columns; ++i)
+            {
+                Cell& c = cell(i, j);
+                if (!c.eligible)
+                    continue;
+
+                const bool beaten = conflicts(i, j, c.x, c.z, [&](const Cell& other, int ni, int nj)
+                {
+                    return other.eligible && (other.priority > c.priority || (other.priority == c.priority && (nj < j || (nj == j && ni < i))));
+                });
+                if (!beaten)
+                    c.round = round;
+            }
+        }
+
+        // Marking after the whole pass keeps the decisions of a round independent of the scan order
+        for (Cell& c : cells)
+        {
+            if (c.round == round)
+                c.eligible = false;
+        }
+    }
+
+    // Placement rules
+    const uint32_t ruleSeed = Hash(m_seed, m_layer, 0xA511E9B3u, 0x63D83595u);
+    for (int j = margin; j < rows - margin; ++j)
+    {
+        for (int i = margin; i < columns - margin; ++i)
+        {
+            const Cell& c = cell(i, j);
+            if (c.round < 0 || c.x < x0 || c.z < z0 || c.x >= x0 + size || c.z >= z0 + size || !heightfield.contains(c.x, c.z))
+                continue;
+
+            const uint32_t h = Hash(ruleSeed, c.priority, static_cast<uint32_t>(ci0 + i), static_cast<uint32_t>(cj0 + j));
+            if (Unit(h) >= m_rule.density)
+                continue;
+
+            const float y = heightfield.height(c.x, c.z);
+            const float unscaled = heightfield.heightScale != 0.f ? y / heightfield.heightScale : 0.f;
+            if (unscaled < m_rule.minHeight || unscaled > m_rule.maxHeight)
+                continue;
+
+            const float slope = heightfield.slope(c.x, c.z);
+            if (slope < m_rule.minSlope || slope > m_rule.maxSlope)
+                continue;
+
+            const uint32_t shape = Hash(h, 1, 2, 3);
+            ScatterInstance instance;
+            instance.x = c.x;
+            instance.y = y;
+            instance.z = c.z;
+            instance.scale = m_rule.minScale + (m_rule.maxScale - m_rule.minScale) * Unit(shape);
+            instance.rotation = Unit(Hash(shape, 4, 5, 6)) * 6.2831853f;
+            instances.push_back(instance);
+        }
+    }
+}
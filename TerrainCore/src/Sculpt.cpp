@@ -0,0 +1,380 @@
+#include "Sculpt.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <zlib.h>
+
+#include "Parallel.h"
+#include "Simd.h"
+
+using Simd::Float4;
+using Simd::Int4;
+
+namespace
+{
+    // Smoothstep falloff from 1 within the inner radius to 0 at the radius
+    Float4 Falloff(const Float4& distance, float radius, float inverseFalloff)
+    {
+        const Float4 t = Simd::Saturate((Float4(radius) - distance) * Float4(inverseFalloff));
+        return t * t * (Float4(3.f) - Float4(2.f) * t);
+    }
+
+    float Falloff(float distance, float radius, float inverseFalloff)
+    {
+        const float t = std::clamp((radius - distance) * inverseFalloff, 0.f, 1.f);
+        return t * t * (3.f - 2.f * t);
+    }
+
+    // heights ^= bits over count samples
+    void XorBits(float* heights, const uint32_t* bits, int count)
+    {
+        int i = 0;
+        for (; i + 4 <= count; i += 4)
+            Simd::AsFloat(Simd::AsInt(Float4::Load(heights + i)) ^ Int4::Load(bits + i)).store(heights + i);
+        for (; i < count; ++i)
+        {
+            uint32_t value;
+            std::memcpy(&value, heights + i, sizeof(value));
+            value ^= bits[i];
+            std::memcpy(heights + i, &value, sizeof(value));
+        }
+    }
+}
+
+HeightRect HeightRect::merged(const HeightRect& other) const
+{
+    if (other.empty())
+        return *this;
+    if (empty())
+        return other;
+
+    HeightRect rect;
+    rect.x = std::min(x, other.x);
+    rect.y = std::min(y, other.y);
+    rect.width = std::max(x + width, other.x + other.width) - rect.x;
+    rect.height = std::max(y + height, other.y + other.height) - rect.y;
+    return rect;
+}
+
+namespace Sculpt
+{
+    const char* Name(BrushMode mode)
+    {
+        switch (mode)
+        {
+        case BrushMode::RAISE: return "Raise";
+        case BrushMode::LOWER: return "Lower";
+        case BrushMode::SMOOTH: return "Smooth";
+        default: return "Unknown";
+        }
+    }
+
+    HeightRect Bounds(int size, const Brush& brush, float x, float y)
+    {
+        const float radius = std::max(0.5f, brush.radius);
+        const int x0 = std::max(0, static_cast<int>(std::ceil(x - radius)));
+        const int y0 = std::max(0, static_cast<int>(std::ceil(y - radius)));
+        const int x1 = std::min(size - 1, static_cast<int>(std::floor(x + radius)));
+        const int y1 = std::min(size - 1, static_cast<int>(std::floor(y + radius)));
+        if (x1 < x0 || y1 < y0)
+            return {};
+        return { x0, y0, x1 - x0 + 1, y1 - y0 + 1 };
+    }
+
+    HeightRect Apply(float* heights, int size, const Brush& brush, float x, float y)
+    {
+        const HeightRect rect = Bounds(size, brush, x, y);
+        if (rect.empty())
+            return rect;
+
+        const float radius = std::max(0.5f, brush.radius);
+        const float inverseFalloff = 1.f / std::max(1e-3f, radius * (1.f - std::clamp(brush.hardness, 0.f, 1.f)));
+        const bool smooth = brush.mode == BrushMode::SMOOTH;
+        const float amount = smooth ? std::clamp(brush.strength, 0.f, 1.f) : brush.mode == BrushMode::LOWER ? -brush.strength : brush.strength;
+
+        // Smoothing reads the heights before the dab: the rectangle and a border of one sample, clamped to the map
+        const int sourceWidth = rect.width + 2;
+        std::vector<float> source;
+        if (smooth)
+        {
+            source.resize(static_cast<size_t>(sourceWidth) * (rect.height + 2));
+            for (int j = 0; j < rect.height + 2; ++j)
+            {
+                const float* row = heights + static_cast<size_t>(std::clamp(rect.y + j - 1, 0, size - 1)) * size;
+                for (int i = 0; i < sourceWidth; ++i)
+                    source[static_cast<size_t>(j) * sourceWidth + i] = row[std::clamp(rect.x + i - 1, 0, size - 1)];
+            }
+        }
+
+        alignas(16) static const float lanes[4] = { 0.f, 1.f, 2.f, 3.f };
+        const Float4 laneOffsets = Float4::Load(lanes);
+        Parallel::For(0, rect.height, [&](int j)
+        {
+            const float dy = rect.y + j - y;
+            float* row = heights + static_cast<size_t>(rect.y + j) * size;
+            const float* above = source.data() + static_cast<size_t>(j) * sourceWidth;
+            const float* center = above + sourceWidth;
+            const float* below = center + sourceWidth;
+
+            int i = 0;
+            for (; i + 4 <= rect.width; i += 4)
+            {
+                const Float4 dx = Float4(rect.x + i - x) + laneOffsets;
+                const Float4 weight = Falloff(Simd::Sqrt(dx * dx + Float4(dy * dy)), radius, inverseFalloff) * Float4(amount);
+                Float4 height = Float4::Load(row + rect.x + i);
+                if (smooth)
+                {
+                    const Float4 sum = Float4::Load(above + i) + Float4::Load(above + i + 1) + Float4::Load(above + i + 2)
+                                     + Float4::Load(center + i) + Float4::Load(center + i + 1) + Float4::Load(center + i + 2)
+                                     + Float4::Load(below + i) + Float4::Load(below + i + 1) + Float4::Load(below + i + 2);
+                    height = height + (sum * Float4(1.f / 9.f) - height) * weight;
+                }
+                else
+                {
+                    height = height + weight;
+                }
+                height.store(row + rect.x + i);
+            }
+
+            for (; i < rect.width; ++i)
+            {
+                const float dx = rect.x + i - x;
+                const float weight = Falloff(std::sqrt(dx * dx + dy * dy), radius, inverseFalloff) * amount;
+                float& height = row[rect.x + i];
+                if (smooth)
+                {
+                    const float sum = above[i] + above[i + 1] + above[i + 2] + center[i] + center[i + 1] + center[i + 2]
+                                    + below[i] + below[i + 1] + below[i + 2];
+                    height += (sum * (1.f / 9.f) - height) * weight;
+                }
+                else
+                {
+                    height += weight;
+                }
+            }
+        });
+        return rect;
+    }
+
+    bool Raycast(const HeightfieldView& heightfield, const Point3d<float>& origin, const Point3d<float>& direction,
+                 float maxDistance, Point3d<float>& hit)
+    {
+        if (!heightfield.valid())
+            return false;
+
+        const Point3d<float> ray = Math::Normalize(direction);
+        auto below = [&](float t)
+        {
+            const Point3d<float> p = origin + ray * t;
+            return heightfield.contains(p.x, p.z) && p.y <= heightfield.height(p.x, p.z);
+        };
+
+        // Half a sample at a time, then bisection between the last point above and the first one below
+        const float step = 0.5f * heightfield.step;
+        float previous = 0.f;
+        for (float t = step; t <= maxDistance; t += step)
+        {
+            if (!below(t))
+            {
+                previous = t;
+                continue;
+            }
+
+            float above = previous;
+            float under = t;
+            for (int i = 0; i < 16; ++i)
+            {
+                const float middle = 0.5f * (above + under);
+                (below(middle) ? under : above) = middle;
+            }
+            hit = origin + ray * under;
+            return true;
+        }
+        return false;
+    }
+}
+
+SculptHistory::SculptHistory(size_t maxBytes)
+    : m_maxBytes(maxBytes)
+{}
+
+void SculptHistory::reset(int size)
+{
+    m_size = size;
+    m_tiles = (size + TILE_SIZE - 1) / TILE_SIZE;
+    m_stroke.clear();
+    m_undo.clear();
+    m_redo.clear();
+    m_bytes = 0;
+    updateMemory();
+}
+
+void SculptHistory::touch(const float* heights, const HeightRect& rect)
+{
+    if (rect.empty())
+        return;
+
+    for (int ty = rect.y / TILE_SIZE; ty <= (rect.y + rect.height - 1) / TILE_SIZE; ++ty)
+    {
+        for (int tx = rect.x / TILE_SIZE; tx <= (rect.x + rect.width - 1) / TILE_SIZE; ++tx)
+        {
+            const int tile = ty * m_tiles + tx;
+            if (m_stroke.count(tile))
+                continue;
+
+            const HeightRect area = tileRect(tile);
+            std::vector<uint32_t>& bits = m_stroke[tile];
+            bits.resize(static_cast<size_t>(area.width) * area.height);
+            for (int j = 0; j < area.height; ++j)
+                std::memcpy(&bits[static_cast<size_t>(j) * area.width], heights + static_cast<size_t>(area.y + j) * m_size + area.x, area.width * sizeof(float));
+        }
+    }
+    updateMemory();
+}
+
+HeightRect SculptHistory::endStroke(const float* heights)
+{
+    Step step;
+    std::vector<int> tiles;
+    for (const auto& [tile, bits] : m_stroke)
+        tiles.push_back(tile);
+    std::sort(tiles.begin(), tiles.end());
+
+    std::vector<uint8_t> planes;
+    for (int tile : tiles)
+    {
+        // XOR of the bits before and after the stroke, zero wherever it left the heights unchanged
+        std::vector<uint32_t>& bits = m_stroke[tile];
+        const HeightRect area = tileRect(tile);
+        bool changed = false;
+        for (int j = 0; j < area.height; ++j)
+        {
+            uint32_t* row = &bits[static_cast<size_t>(j) * area.width];
+            const float* after = heights + static_cast<size_t>(area.y + j) * m_size + area.x;
+            int i = 0;
+            for (; i + 4 <= area.width; i += 4)
+                (Simd::AsInt(Float4::Load(after + i)) ^ Int4::Load(row + i)).store(row + i);
+            for (; i < area.width; ++i)
+            {
+                uint32_t value;
+                std::memcpy(&value, after + i, sizeof(value));
+                row[i] ^= value;
+            }
+            changed |= std::any_of(row, row + area.width, [](uint32_t value) { return value != 0; });
+        }
+        if (!changed)
+            continue;
+
+        // Byte planes: the high bytes of small changes are zero and deflate to almost nothing
+        const size_t count = bits.size();
+        planes.resize(count * 4);
+        for (size_t i = 0; i < count; ++i)
+        {
+            for (int p = 0; p < 4; ++p)
+                planes[p * count + i] = static_cast<uint8_t>(bits[i] >> (8 * p));
+        }
+
+        TileDelta delta;
+        delta.tile = tile;
+        uLongf length = compressBound(static_cast<uLong>(planes.size()));
+        delta.data.resize(length);
+        if (compress2(delta.data.data(), &length, planes.data(), static_cast<uLong>(planes.size()), Z_BEST_SPEED) != Z_OK)
+        {
+            std::cerr << "Impossible to compress the undo step of a stroke" << std::endl;
+            continue;
+        }
+        delta.data.resize(length);
+        delta.data.shrink_to_fit();
+
+        step.rect = step.rect.merged(area);
+        step.bytes += delta.data.size();
+        step.tiles.push_back(std::move(delta));
+    }
+    m_stroke.clear();
+
+    const HeightRect changed = step.rect;
+    if (!step.tiles.empty())
+    {
+        for (const Step& redo : m_redo)
+            m_bytes -= redo.bytes;
+        m_redo.clear();
+
+        m_bytes += step.bytes;
+        m_undo.push_back(std::move(step));
+        while (m_bytes > m_maxBytes && m_undo.size() > 1)
+        {
+            m_bytes -= m_undo.front().bytes;
+            m_undo.pop_front();
+        }
+    }
+    updateMemory();
+    return changed;
+}
+
+HeightRect SculptHistory::undo(float* heights)
+{
+    if (m_undo.empty())
+        return {};
+
+    m_redo.push_back(std::move(m_undo.back()));
+    m_undo.pop_back();
+    return apply(m_redo.back(), heights);
+}
+
+HeightRect SculptHistory::redo(float* heights)
+{
+    if (m_redo.empty())
+        return {};
+
+    m_undo.push_back(std::move(m_redo.back()));
+    m_redo.pop_back();
+    return apply(m_undo.back(), heights);
+}
+
+HeightRect SculptHistory::tileRect(int tile) const
+{
+    HeightRect rect;
+    rect.x = (tile % m_tiles) * TILE_SIZE;
+    rect.y = (tile / m_tiles) * TILE_SIZE;
+    rect.width = std::min(TILE_SIZE, m_size - rect.x);
+    rect.height = std::min(TILE_SIZE, m_size - rect.y);
+    return rect;
+}
+
+HeightRect SculptHistory::apply(const Step& step, float* heights) const
+{
+    std::vector<uint8_t> planes;
+    std::vector<uint32_t> bits;
+    for (const TileDelta& delta : step.tiles)
+    {
+        const HeightRect area = tileRect(delta.tile);
+        const size_t count = static_cast<size_t>(area.width) * area.height;
+        planes.resize(count * 4);
+        uLongf length = static_cast<uLongf>(planes.size());
+        if (uncompress(planes.data(), &length, delta.data.data(), static_cast<uLong>(delta.data.size())) != Z_OK || length != planes.size())
+        {
+            std::cerr << "Corrupt undo step, tile " << delta.tile << " is skipped" << std::endl;
+            continue;
+        }
+
+        bits.resize(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            bits[i] = static_cast<uint32_t>(planes[i]) | static_cast<uint32_t>(planes[count + i]) << 8
+                    | static_cast<uint32_t>(planes[2 * count + i]) << 16 | static_cast<uint32_t>(planes[3 * count + i]) << 24;
+        }
+        for (int j = 0; j < area.height; ++j)
+            XorBits(heights + static_cast<size_t>(area.y + j) * m_size + area.x, &bits[static_cast<size_t>(j) * area.width], area.width);
+    }
+    return step.rect;
+}
+
+void SculptHistory::updateMemory()
+{
+    size_t strokeBytes = 0;
+    for (const auto& [tile, bits] : m_stroke)
+        strokeBytes += MemoryBytes(bits);
+    m_memory.set(m_bytes + strokeBytes);
+}
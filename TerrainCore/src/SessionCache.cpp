@@ -0,0 +1,118 @@
+#include "SessionCache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+#include "CompressedHeightmap.h"
+#include "OutputSpan.h"
+
+namespace
+{
+    constexpr char MAGIC[4] = { 'T', 'R', 'S', 'C' };
+
+    // Bump when the generated heights of a preset change, older caches are then ignored
+    constexpr uint32_t VERSION = 1;
+
+    constexpr int TILE_SIZE = 256;
+
+    // Far more than a lossless tile can take, so that a corrupt length cannot allocate much
+    constexpr uint64_t MAX_TILE_BYTES = static_cast<uint64_t>(TILE_SIZE) * TILE_SIZE * 8 + 1024;
+
+    template<typename T>
+    void WriteValue(std::ofstream& file, const T& value)
+    {
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<typename T>
+    bool ReadValue(std::ifstream& file, T& value)
+    {
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+}
+
+namespace SessionCache
+{
+    bool Save(const std::string& path, uint64_t heightsKey, int size, std::span<const float> heights)
+    {
+        if (size < 1 || !OutputSpan::Fits(heights, static_cast<size_t>(size) * size, "SessionCache::Save"))
+            return false;
+
+        std::ofstream file(path, std::ios::binary);
+        if (!file)
+        {
+            std::cerr << "Cannot write " << path << "." << std::endl;
+            return false;
+        }
+
+        file.write(MAGIC, sizeof(MAGIC));
+        WriteValue<uint32_t>(file, VERSION);
+        WriteValue<uint64_t>(file, heightsKey);
+        WriteValue<int32_t>(file, size);
+
+        // Row-major tiles, the last ones cut at the border
+        for (int y = 0; y < size; y += TILE_SIZE)
+        {
+            for (int x = 0; x < size; x += TILE_SIZE)
+            {
+                const EncodedTile tile = HeightCodec::Encode(heights.data() + static_cast<size_t>(y) * size + x,
+                    std::min(TILE_SIZE, size - x), std::min(TILE_SIZE, size - y), size, HeightEncoding::LOSSLESS);
+                WriteValue<uint64_t>(file, tile.data.size());
+                file.write(reinterpret_cast<const char*>(tile.data.data()), tile.data.size());
+            }
+        }
+
+        if (!file)
+        {
+            std::cerr << "Cannot write " << path << "." << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool Load(const std::string& path, uint64_t heightsKey, int size, std::vector<float>& heights)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+
+        char magic[sizeof(MAGIC)];
+        uint32_t version = 0;
+        uint64_t key = 0;
+        int32_t storedSize = 0;
+        if (!file.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), MAGIC)
+            || !ReadValue(file, version) || version != VERSION || !ReadValue(file, key) || !ReadValue(file, storedSize))
+            return false;
+
+        // Another preset or size: not an error, the heights are generated
+        if (key != heightsKey || storedSize != size || size < 1)
+            return false;
+
+        std::vector<float> result(static_cast<size_t>(size) * size);
+        EncodedTile tile;
+        tile.encoding = HeightEncoding::LOSSLESS;
+        for (int y = 0; y < size; y += TILE_SIZE)
+        {
+            for (int x = 0; x < size; x += TILE_SIZE)
+            {
+                uint64_t bytes = 0;
+                if (!ReadValue(file, bytes) || bytes > MAX_TILE_BYTES)
+                    return false;
+
+                tile.width = std::min(TILE_SIZE, size - x);
+                tile.height = std::min(TILE_SIZE, size - y);
+                tile.data.resize(bytes);
+                if (!file.read(reinterpret_cast<char*>(tile.data.data()), bytes)
+                    || !HeightCodec::Decode(tile, result.data() + static_cast<size_t>(y) * size + x, size))
+                {
+                    std::cerr << path << " is corrupt, the heights are generated." << std::endl;
+                    return false;
+                }
+            }
+        }
+
+        heights.swap(result);
+        return true;
+    }
+}
@@ -0,0 +1,355 @@
+#include "TerrainDetail.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+
+#include "GenerationGraph.h"
+#include "Noise.h"
+#include "Parallel.h"
+
+namespace
+{
+    // Refinements are powers of two that fit the neighborhood bytes
+    int MaxRefinement(const DetailSettings& settings)
+    {
+        int refinement = 1;
+        while (refinement * 2 <= std::min(settings.maxRefinement, 128))
+            refinement *= 2;
+        return refinement;
+    }
+
+    // Octave o has a lattice of 2 / 2^o base cells: the finest is still two sub-cells of the finest patches
+    int OctaveCount(const DetailSettings& settings)
+    {
+        int octaves = 1;
+        for (int refinement = MaxRefinement(settings); refinement > 1; refinement /= 2)
+            ++octaves;
+        return octaves;
+    }
+
+    // Cells of the chunk along one side, the last chunks stop at the border of the map
+    int ChunkCells(const HeightfieldView& heightfield, const DetailSettings& settings, int chunk)
+    {
+        return std::min(settings.chunkCells, heightfield.size - 1 - chunk * settings.chunkCells);
+    }
+
+    // Distance from (x, y) to the square of cells of a chunk, in base cells
+    float ChunkDistance(float x, float y, int chunkX, int chunkY, int chunkCells)
+    {
+        const float x0 = static_cast<float>(chunkX * chunkCells);
+        const float y0 = static_cast<float>(chunkY * chunkCells);
+        const float dx = std::max({ x0 - x, 0.f, x - (x0 + chunkCells) });
+        const float dy = std::max({ y0 - y, 0.f, y - (y0 + chunkCells) });
+        return std::sqrt(dx * dx + dy * dy);
+    }
+}
+
+uint64_t DetailPatch::key() const
+{
+    InputHash hash;
+    hash.add(chunkX).add(chunkY);
+    for (uint8_t refinement : neighborhood)
+        hash.add(refinement);
+    return hash.value();
+}
+
+DetailLevels::DetailLevels(const DetailSettings& settings)
+    : m_settings(settings)
+{}
+
+void DetailLevels::setSettings(const DetailSettings& settings)
+{
+    m_settings = settings;
+    setHeightfield(m_heightfield);
+}
+
+void DetailLevels::setHeightfield(const HeightfieldView& heightfield)
+{
+    m_heightfield = heightfield;
+    m_patches.clear();
+    m_settings.chunkCells = std::max(1, m_settings.chunkCells);
+    if (!heightfield.valid())
+    {
+        m_chunksPerSide = 0;
+        m_refinements.clear();
+        return;
+    }
+
+    const int chunkCells = m_settings.chunkCells;
+    m_chunksPerSide = (heightfield.size - 2) / chunkCells + 1;
+    const size_t chunkCount = static_cast<size_t>(m_chunksPerSide) * m_chunksPerSide;
+    m_minHeights.assign(chunkCount, 0.f);
+    m_maxHeights.assign(chunkCount, 0.f);
+    m_refinements.assign(chunkCount, 1);
+
+    Parallel::For(0, static_cast<int>(chunkCount), [&](int index) { updateBounds(index); });
+}
+
+void DetailLevels::updateRegion(const HeightfieldView& heightfield, int x, int y, int width, int height)
+{
+    if (heightfield.size != m_heightfield.size || m_chunksPerSide == 0)
+    {
+        setHeightfield(heightfield);
+        return;
+    }
+
+    // Chunk c covers the samples [c * chunkCells, (c + 1) * chunkCells]
+    m_heightfield = heightfield;
+    const int chunkCells = m_settings.chunkCells;
+    const int cx0 = std::clamp((x - 1) / chunkCells, 0, m_chunksPerSide - 1);
+    const int cy0 = std::clamp((y - 1) / chunkCells, 0, m_chunksPerSide - 1);
+    const int cx1 = std::clamp((x + width - 1) / chunkCells, 0, m_chunksPerSide - 1);
+    const int cy1 = std::clamp((y + height - 1) / chunkCells, 0, m_chunksPerSide - 1);
+    for (int cy = cy0; cy <= cy1; ++cy)
+        for (int cx = cx0; cx <= cx1; ++cx)
+            updateBounds(cy * m_chunksPerSide + cx);
+}
+
+void DetailLevels::updateBounds(int chunk)
+{
+    // Detail octaves halve their amplitude, they stay under twice the first one
+    const HeightfieldView& heightfield = m_heightfield;
+    const float detail = 2.f * m_settings.amplitude * heightfield.step;
+    const int chunkCells = m_settings.chunkCells;
+    const int cx = chunk % m_chunksPerSide;
+    const int cy = chunk / m_chunksPerSide;
+    float minHeight = heightfield.sample(cx * chunkCells, cy * chunkCells);
+    float maxHeight = minHeight;
+    for (int y = cy * chunkCells; y <= (cy + 1) * chunkCells; ++y)
+    {
+        for (int x = cx * chunkCells; x <= (cx + 1) * chunkCells; ++x)
+        {
+            minHeight = std::min(minHeight, heightfield.sample(x, y));
+            maxHeight = std::max(maxHeight, heightfield.sample(x, y));
+        }
+    }
+    m_minHeights[chunk] = std::min(minHeight * heightfield.heightScale, maxHeight * heightfield.heightScale) - detail;
+    m_maxHeights[chunk] = std::max(minHeight * heightfield.heightScale, maxHeight * heightfield.heightScale) + detail;
+}
+
+void DetailLevels::update(const Point3d<float>& camera, float pixelScale)
+{
+    m_patches.clear();
+    std::fill(m_refinements.begin(), m_refinements.end(), 1);
+    if (m_chunksPerSide == 0)
+        return;
+
+    // Sub-cells per base cell so that a sub-cell covers at most cellPixels on screen
+    const int maxRefinement = MaxRefinement(m_settings);
+    const float chunkSize = m_settings.chunkCells * m_heightfield.step;
+    const float cellPixels = std::max(0.5f, m_settings.cellPixels);
+    for (int cy = 0; cy < m_chunksPerSide; ++cy)
+    {
+        for (int cx = 0; cx < m_chunksPerSide; ++cx)
+        {
+            const int index = cy * m_chunksPerSide + cx;
+            const float x0 = m_heightfield.origin.x + cx * chunkSize;
+            const float z0 = m_heightfield.origin.y + cy * chunkSize;
+            const float dx = std::max({ x0 - camera.x, 0.f, camera.x - (x0 + chunkSize) });
+            const float dy = std::max({ m_minHeights[index] - camera.y, 0.f, camera.y - m_maxHeights[index] });
+            const float dz = std::max({ z0 - camera.z, 0.f, camera.z - (z0 + chunkSize) });
+            const float distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+
+            const float pixels = m_heightfield.step * pixelScale / std::max(distance, 1e-4f);
+            int refinement = 1;
+            while (refinement < maxRefinement && pixels / refinement > cellPixels)
+                refinement *= 2;
+            if (refinement > 1)
+            {
+                DetailPatch patch;
+                patch.chunkX = cx;
+                patch.chunkY = cy;
+                patch.distance = distance;
+                patch.neighborhood[4] = static_cast<uint8_t>(refinement);
+                m_patches.push_back(patch);
+            }
+        }
+    }
+
+    // The closest chunks within the budget
+    std::sort(m_patches.begin(), m_patches.end(), [](const DetailPatch& a, const DetailPatch& b) { return a.distance < b.distance; });
+    if (m_patches.size() > static_cast<size_t>(std::max(0, m_settings.maxPatches)))
+        m_patches.resize(std::max(0, m_settings.maxPatches));
+
+    // Over the memory budget, the farthest patches lose a level each pass until they fit
+    if (m_settings.maxBytes > 0)
+    {
+        size_t bytes = 0;
+        for (const DetailPatch& patch : m_patches)
+            bytes += TerrainDetail::PatchBytes(m_settings, patch.refinement());
+
+        while (bytes > m_settings.maxBytes && !m_patches.empty())
+        {
+            for (int i = static_cast<int>(m_patches.size()) - 1; i >= 0 && bytes > m_settings.maxBytes; --i)
+            {
+                DetailPatch& patch = m_patches[i];
+                const int refinement = patch.refinement();
+                bytes -= TerrainDetail::PatchBytes(m_settings, refinement);
+                if (refinement > 2)
+                {
+                    patch.neighborhood[4] = static_cast<uint8_t>(refinement / 2);
+                    bytes += TerrainDetail::PatchBytes(m_settings, refinement / 2);
+                }
+                else
+                {
+                    m_patches.erase(m_patches.begin() + i);
+                }
+            }
+        }
+    }
+    for (const DetailPatch& patch : m_patches)
+        m_refinements[patch.chunkY * m_chunksPerSide + patch.chunkX] = static_cast<uint8_t>(patch.refinement());
+
+    for (DetailPatch& patch : m_patches)
+    {
+        for (int j = 0; j < 3; ++j)
+        {
+            for (int i = 0; i < 3; ++i)
+                patch.neighborhood[j * 3 + i] = static_cast<uint8_t>(getRefinement(patch.chunkX + i - 1, patch.chunkY + j - 1));
+        }
+    }
+}
+
+int DetailLevels::getRefinement(int chunkX, int chunkY) const
+{
+    if (chunkX < 0 || chunkY < 0 || chunkX >= m_chunksPerSide || chunkY >= m_chunksPerSide)
+        return 0;
+    return m_refinements[chunkY * m_chunksPerSide + chunkX];
+}
+
+namespace TerrainDetail
+{
+    DetailMesh BuildPatch(const HeightfieldView& heightfield, const DetailSettings& settings, const DetailPatch& patch)
+    {
+        DetailMesh mesh;
+        const int refinement = patch.refinement();
+        const int chunkCells = std::max(1, settings.chunkCells);
+        if (!heightfield.valid() || refinement < 1)
+            return mesh;
+
+        const int cellsX = ChunkCells(heightfield, settings, patch.chunkX);
+        const int cellsY = ChunkCells(heightfield, settings, patch.chunkY);
+        if (cellsX < 1 || cellsY < 1)
+            return mesh;
+
+        // Sub-cell indices from the map origin: a position is computed the same way by every patch sharing it
+        const int nx = cellsX * refinement;
+        const int ny = cellsY * refinement;
+        const int firstX = patch.chunkX * chunkCells * refinement;
+        const int firstY = patch.chunkY * chunkCells * refinement;
+        const float subStep = heightfield.step / refinement;
+
+        // Fading detail over the vertices and a one sample margin, for the slopes at the borders
+        const int width = nx + 3;
+        const int rows = ny + 3;
+        std::vector<float> detail(static_cast<size_t>(width) * rows, 0.f);
+
+        const int octaves = OctaveCount(settings);
+        std::vector<std::unique_ptr<NoiseEngine>> engines;
+        for (int octave = 0; octave < octaves; ++octave)
+            engines.push_back(Noise::CreateEngine(NoiseType::PERLIN, settings.seed + 7919 * (octave + 1)));
+
+        const float fade = std::clamp(settings.fadeCells, 0.5f, static_cast<float>(chunkCells));
+        std::vector<float> octaveRow(width);
+        for (int j = 0; j < rows; ++j)
+        {
+            float* row = &detail[static_cast<size_t>(j) * width];
+            const int gy = firstY + j - 1;
+            float amplitude = settings.amplitude * heightfield.step;
+            for (int octave = 0; octave < octaves; ++octave)
+            {
+                // Noise coordinates are exact multiples of powers of two, the same on every patch
+                const float dx = std::ldexp(1.f, octave - 1) / refinement;
+                engines[octave]->sampleRow(0, 0, 0.f, dx, gy * dx, width, octaveRow.data(), firstX - 1);
+                for (int i = 0; i < width; ++i)
+                    row[i] += amplitude * octaveRow[i];
+                amplitude *= 0.5f;
+            }
+
+            // No detail on the borders with unrefined chunks, full detail from fadeCells away
+            const float y = static_cast<float>(gy) / refinement;
+            for (int i = 0; i < width; ++i)
+            {
+                const float x = static_cast<float>(firstX + i - 1) / refinement;
+                float distance = fade;
+                for (int n = 0; n < 9; ++n)
+                {
+                    if (patch.neighborhood[n] == 1)
+                        distance = std::min(distance, ChunkDistance(x, y, patch.chunkX + n % 3 - 1, patch.chunkY + n / 3 - 1, chunkCells));
+                }
+                const float t = distance / fade;
+                row[i] *= t * t * (3.f - 2.f * t);
+            }
+        }
+
+        const int vertexWidth = nx + 1;
+        const size_t vertexCount = static_cast<size_t>(vertexWidth) * (ny + 1);
+        mesh.vertices.resize(vertexCount * DetailMesh::VERTEX_FLOATS);
+        for (int j = 0; j <= ny; ++j)
+        {
+            const int gy = firstY + j;
+            const int sampleY = gy / refinement;
+            const float fy = static_cast<float>(gy % refinement) / refinement;
+            for (int i = 0; i <= nx; ++i)
+            {
+                const int gx = firstX + i;
+                const int sampleX = gx / refinement;
+                const float fx = static_cast<float>(gx % refinement) / refinement;
+
+                // Bilinear base from the sample indices, exactly the base vertices on the sample positions
+                const float top = heightfield.sample(sampleX, sampleY) + (heightfield.sample(sampleX + 1, sampleY) - heightfield.sample(sampleX, sampleY)) * fx;
+                const float bottom = heightfield.sample(sampleX, sampleY + 1) + (heightfield.sample(sampleX + 1, sampleY + 1) - heightfield.sample(sampleX, sampleY + 1)) * fx;
+                const float base = (top + (bottom - top) * fy) * heightfield.heightScale;
+
+                const float* center = &detail[static_cast<size_t>(j + 1) * width + i + 1];
+                float* vertex = &mesh.vertices[(static_cast<size_t>(j) * vertexWidth + i) * DetailMesh::VERTEX_FLOATS];
+                vertex[0] = heightfield.origin.x + gx * subStep;
+                vertex[1] = base + center[0];
+                vertex[2] = heightfield.origin.y + gy * subStep;
+                vertex[3] = (center[1] - center[-1]) / (2.f * subStep);
+                vertex[4] = (center[width] - center[-width]) / (2.f * subStep);
+            }
+        }
+
+        // Edges shared with a coarser patch follow its vertices: the ones in between are interpolated
+        auto stitch = [&](int neighbor, int first, int stride, int count)
+        {
+            const int coarse = patch.neighborhood[neighbor];
+            if (coarse == 0 || coarse >= refinement)
+                return;
+
+            const int ratio = refinement / coarse;
+            auto height = [&](int t) -> float& { return mesh.vertices[(static_cast<size_t>(first) + static_cast<size_t>(t) * stride) * DetailMesh::VERTEX_FLOATS + 1]; };
+            for (int t = 0; t + ratio <= count; t += ratio)
+            {
+                const float a = height(t);
+                const float b = height(t + ratio);
+                for (int k = 1; k < ratio; ++k)
+                    height(t + k) = a + (b - a) * (static_cast<float>(k) / ratio);
+            }
+        };
+        stitch(1, 0, 1, nx);                            // -y
+        stitch(7, ny * vertexWidth, 1, nx);             // +y
+        stitch(3, 0, vertexWidth, ny);                  // -x
+        stitch(5, nx, vertexWidth, ny);                 // +x
+
+        // Same diagonals as the base grid
+        mesh.indices.reserve(static_cast<size_t>(nx) * ny * 6);
+        for (int j = 0; j < ny; ++j)
+        {
+            for (int i = 0; i < nx; ++i)
+            {
+                const uint32_t v = j * vertexWidth + i;
+                mesh.indices.insert(mesh.indices.end(), { v, v + vertexWidth, v + vertexWidth + 1, v, v + vertexWidth + 1, v + 1 });
+            }
+        }
+        return mesh;
+    }
+
+    size_t PatchBytes(const DetailSettings& settings, int refinement)
+    {
+        const size_t cells = static_cast<size_t>(settings.chunkCells) * refinement;
+        return (cells + 1) * (cells + 1) * DetailMesh::VERTEX_FLOATS * sizeof(float) + cells * cells * 6 * sizeof(uint32_t);
+    }
+}
@@ -0,0 +1,355 @@
+#include "TerrainSimplifier.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+#include "Parallel.h"
+
+namespace
+{
+    // Number of triangle ids processed by one parallel work item
+    constexpr uint32_t ID_BLOCK = 4096;
+
+    struct Triangle
+    {
+        int ax, ay, bx, by, cx, cy;
+    };
+
+    // Decode the hypotenuse (a, b) of the triangle with the given id.
+    // Ids 2 and 3 are the two root triangles, every bit after the leading one selects a child, root first.
+    void DecodeTriangle(uint32_t id, int tileSize, int& ax, int& ay, int& bx, int& by)
+    {
+        int cx = 0, cy = 0;
+        ax = ay = bx = by = 0;
+        if (id & 1)
+        {
+            bx = by = cx = tileSize;
+        }
+        else
+        {
+            ax = ay = cy = tileSize;
+        }
+
+        while ((id >>= 1) > 1)
+        {
+            const int mx = (ax + bx) >> 1;
+            const int my = (ay + by) >> 1;
+            if (id & 1)
+            {
+                bx = ax; by = ay;
+                ax = cx; ay = cy;
+            }
+            else
+            {
+                ax = bx; ay = by;
+                bx = cx; by = cy;
+            }
+            cx = mx;
+            cy = my;
+        }
+    }
+
+    void AtomicMax(float& target, float value)
+    {
+        std::atomic_ref<float> ref(target);
+        float current = ref.load(std::memory_order_relaxed);
+        while (value > current && !ref.compare_exchange_weak(current, value, std::memory_order_relaxed))
+        {
+        }
+    }
+}
+
+TerrainSimplifier::TerrainSimplifier(int size)
+    : m_size(std::max(2, size))
+    , m_gridSize(2)
+{
+    while (m_gridSize < m_size)
+        m_gridSize = (m_gridSize - 1) * 2 + 1;
+}
+
+void TerrainSimplifier::computeErrors(const float* heights)
+{
+    const int tileSize = m_gridSize - 1;
+    const uint32_t triangleCount = static_cast<uint32_t>(tileSize) * tileSize * 2 - 2;
+    const uint32_t parentCount = triangleCount - static_cast<uint32_t>(tileSize) * tileSize;
+
+    m_errors.assign(static_cast<size_t>(m_gridSize) * m_gridSize, 0.f);
+
+    // Finest level first: a triangle reads the errors of its children, which belong to the level below.
+    // Every vertex is the hypotenuse midpoint of one level only, so a level never reads what it writes.
+    int level = 0;
+    while ((2u << level) <= triangleCount + 1)
+        ++level;
+
+    for (; level >= 1; --level)
+    {
+        const uint32_t firstId = 1u << level;
+        const uint32_t endId = std::min(2u << level, triangleCount + 2);
+        const int blockCount = static_cast<int>((endId - firstId + ID_BLOCK - 1) / ID_BLOCK);
+
+        Parallel::For(0, blockCount, [&](int block)
+        {
+            const uint32_t blockStart = firstId + block * ID_BLOCK;
+            const uint32_t blockEnd = std::min(endId, blockStart + ID_BLOCK);
+            for (uint32_t id = blockStart; id < blockEnd; ++id)
+            {
+                int ax, ay, bx, by;
+                DecodeTriangle(id, tileSize, ax, ay, bx, by);
+
+                const int mx = (ax + bx) >> 1;
+                const int my = (ay + by) >> 1;
+                const float error = triangleError(heights, ax, ay, bx, by, mx + my - ay, my + ax - mx, id - 2 < parentCount);
+
+                // The two triangles sharing a hypotenuse update the same vertex
+                AtomicMax(m_errors[static_cast<size_t>(my) * m_gridSize + mx], error);
+            }
+        });
+    }
+}
+
+void TerrainSimplifier::updateErrors(const float* heights, int x, int y, int width, int height)
+{
+    if (m_errors.empty())
+    {
+        computeErrors(heights);
+        return;
+    }
+
+    // Grid samples past the heightmap repeat its last row / column, and change with it
+    const int tileSize = m_gridSize - 1;
+    const int last = m_size - 1;
+    int x0 = std::max(0, x);
+    int y0 = std::max(0, y);
+    int x1 = x + width - 1 >= last ? tileSize : x + width - 1;
+    int y1 = y + height - 1 >= last ? tileSize : y + height - 1;
+    if (x0 > x1 || y0 > y1)
+        return;
+
+    // Two levels per halving of the tile, the finest one has no children with errors
+    int depthCount = 0;
+    for (int side = tileSize; side > 1; side >>= 1)
+        depthCount += 2;
+
+    // Triangles of a level whose area touches the region, found from the roots
+    auto collect = [&](int depth)
+    {
+        std::vector<Triangle> found;
+        std::vector<std::pair<Triangle, int>> stack = {
+            { { 0, 0, tileSize, tileSize, tileSize, 0 }, 0 },
+            { { tileSize, tileSize, 0, 0, 0, tileSize }, 0 }
+        };
+        while (!stack.empty())
+        {
+            const auto [t, level] = stack.back();
+            stack.pop_back();
+            if (std::max({ t.ax, t.bx, t.cx }) < x0 || std::min({ t.ax, t.bx, t.cx }) > x1 ||
+                std::max({ t.ay, t.by, t.cy }) < y0 || std::min({ t.ay, t.by, t.cy }) > y1)
+            {
+                continue;
+            }
+            if (level == depth)
+            {
+                found.push_back(t);
+                continue;
+            }
+            const int mx = (t.ax + t.bx) >> 1;
+            const int my = (t.ay + t.by) >> 1;
+            stack.push_back({ { t.cx, t.cy, t.ax, t.ay, mx, my }, level + 1 });
+            stack.push_back({ { t.bx, t.by, t.cx, t.cy, mx, my }, level + 1 });
+        }
+        return found;
+    };
+
+    // Finest level first as in computeErrors(). A triangle depends on the samples it covers and on the vertices of its
+    // children, which the triangles across its legs change too: the region grows by every vertex whose error changed.
+    for (int depth = depthCount - 1; depth >= 0; --depth)
+    {
+        // One triangle per vertex, the one across its hypotenuse is computed with it
+        std::vector<Triangle> triangles = collect(depth);
+        auto vertex = [&](const Triangle& t) { return static_cast<size_t>((t.ay + t.by) >> 1) * m_gridSize + ((t.ax + t.bx) >> 1); };
+        std::sort(triangles.begin(), triangles.end(), [&](const Triangle& a, const Triangle& b) { return vertex(a) < vertex(b); });
+        triangles.erase(std::unique(triangles.begin(), triangles.end(), [&](const Triangle& a, const Triangle& b) { return vertex(a) == vertex(b); }),
+                        triangles.end());
+
+        const bool children = depth + 1 < depthCount;
+        std::vector<uint8_t> changed(triangles.size(), 0);
+        const int blockCount = static_cast<int>((triangles.size() + ID_BLOCK - 1) / ID_BLOCK);
+        Parallel::For(0, blockCount, [&](int block)
+        {
+            const size_t blockEnd = std::min(triangles.size(), static_cast<size_t>(block + 1) * ID_BLOCK);
+            for (size_t i = static_cast<size_t>(block) * ID_BLOCK; i < blockEnd; ++i)
+            {
+                const Triangle& t = triangles[i];
+                float error = triangleError(heights, t.ax, t.ay, t.bx, t.by, t.cx, t.cy, children);
+
+                // Unless the hypotenuse is on the border of the grid
+                const int nx = t.ax + t.bx - t.cx;
+                const int ny = t.ay + t.by - t.cy;
+                if (nx >= 0 && nx <= tileSize && ny >= 0 && ny <= tileSize)
+                    error = std::max(error, triangleError(heights, t.bx, t.by, t.ax, t.ay, nx, ny, children));
+
+                float& stored = m_errors[vertex(t)];
+                changed[i] = stored != error;
+                stored = error;
+            }
+        });
+
+        for (size_t i = 0; i < triangles.size(); ++i)
+        {
+            if (!changed[i])
+                continue;
+            const Triangle& t = triangles[i];
+            x0 = std::min(x0, (t.ax + t.bx) >> 1);
+            x1 = std::max(x1, (t.ax + t.bx) >> 1);
+            y0 = std::min(y0, (t.ay + t.by) >> 1);
+            y1 = std::max(y1, (t.ay + t.by) >> 1);
+        }
+    }
+}
+
+float TerrainSimplifier::triangleError(const float* heights, int ax, int ay, int bx, int by, int cx, int cy, bool children) const
+{
+    // Samples outside the heightmap repeat its last row / column
+    const int last = m_size - 1;
+    auto height = [&](int x, int y)
+    {
+        return heights[std::min(y, last) * m_size + std::min(x, last)];
+    };
+
+    const int mx = (ax + bx) >> 1;
+    const int my = (ay + by) >> 1;
+    float error = std::abs((height(ax, ay) + height(bx, by)) * 0.5f - height(mx, my));
+
+    // A triangle overlapping both the heightmap and the padding must always be split,
+    // so that extracted triangles are either fully inside (kept) or fully outside (dropped)
+    const bool inside = std::max({ ax, bx, cx }) <= last && std::max({ ay, by, cy }) <= last;
+    if (!inside && std::min({ ax, bx, cx }) < last && std::min({ ay, by, cy }) < last)
+        error = std::numeric_limits<float>::infinity();
+
+    // Within a child, the child plane and this triangle plane differ by at most the midpoint error,
+    // so midpoint error + worst child error bounds the error of every sample covered by the triangle
+    if (children)
+    {
+        const size_t left = static_cast<size_t>((ay + cy) >> 1) * m_gridSize + ((ax + cx) >> 1);
+        const size_t right = static_cast<size_t>((by + cy) >> 1) * m_gridSize + ((bx + cx) >> 1);
+        error += std::max(m_errors[left], m_errors[right]);
+    }
+    return error;
+}
+
+void TerrainSimplifier::extract(float maxError, std::vector<uint32_t>& triangles) const
+{
+    triangles.clear();
+    if (m_errors.empty())
+        return;
+
+    const int tileSize = m_gridSize - 1;
+    const int last = m_size - 1;
+
+    auto shouldSplit = [&](const Triangle& t)
+    {
+        const int mx = (t.ax + t.bx) >> 1;
+        const int my = (t.ay + t.by) >> 1;
+        return std::abs(t.ax - t.cx) + std::abs(t.ay - t.cy) > 1 && m_errors[static_cast<size_t>(my) * m_gridSize + mx] > maxError;
+    };
+
+    auto split = [](const Triangle& t, Triangle& left, Triangle& right)
+    {
+        const int mx = (t.ax + t.bx) >> 1;
+        const int my = (t.ay + t.by) >> 1;
+        left = { t.cx, t.cy, t.ax, t.ay, mx, my };
+        right = { t.bx, t.by, t.cx, t.cy, mx, my };
+    };
+
+    auto emit = [&](const Triangle& t, std::vector<uint32_t>& out)
+    {
+        if (std::max({ t.ax, t.bx, t.cx }) > last || std::max({ t.ay, t.by, t.cy }) > last)
+            return; // Padding
+
+        out.push_back(static_cast<uint32_t>(t.ay * m_size + t.ax));
+        out.push_back(static_cast<uint32_t>(t.by * m_size + t.bx));
+        out.push_back(static_cast<uint32_t>(t.cy * m_size + t.cx));
+    };
+
+    // Refine breadth-first until there are enough subtrees to keep every thread busy
+    std::vector<Triangle> frontier = {
+        { 0, 0, tileSize, tileSize, tileSize, 0 },
+        { tileSize, tileSize, 0, 0, 0, tileSize }
+    };
+    const size_t targetSubtrees = static_cast<size_t>(Parallel::ThreadCount()) * 16;
+    while (!frontier.empty() && frontier.size() < targetSubtrees)
+    {
+        std::vector<Triangle> next;
+        next.reserve(frontier.size() * 2);
+        for (const Triangle& t : frontier)
+        {
+            if (shouldSplit(t))
+            {
+                Triangle left, right;
+                split(t, left, right);
+                next.push_back(left);
+                next.push_back(right);
+            }
+            else
+            {
+                emit(t, triangles);
+            }
+        }
+        frontier.swap(next);
+    }
+
+    std::vector<std::vector<uint32_t>> subtreeTriangles(frontier.size());
+    Parallel::For(0, static_cast<int>(frontier.size()), [&](int i)
+    {
+        std::vector<Triangle> stack = { frontier[i] };
+        std::vector<uint32_t>& out = subtreeTriangles[i];
+        while (!stack.empty())
+        {
+            const Triangle t = stack.back();
+            stack.pop_back();
+            if (shouldSplit(t))
+            {
+                Triangle left, right;
+                split(t, left, right);
+                stack.push_back(right);
+                stack.push_back(left);
+            }
+            else
+            {
+                emit(t, out);
+            }
+        }
+    });
+
+    for (const auto& subtree : subtreeTriangles)
+        triangles.insert(triangles.end(), subtree.begin(), subtree.end());
+}
+
+TerrainMesh TerrainSimplifier::buildMesh(const float* heights, float maxError, const Point2d<float>& origin, float step, float heightScale) const
+{
+    std::vector<uint32_t> triangles;
+    extract(heightScale != 0.f ? maxError / std::abs(heightScale) : std::numeric_limits<float>::infinity(), triangles);
+
+    // Share the vertices between triangles
+    constexpr uint32_t UNUSED = std::numeric_limits<uint32_t>::max();
+    std::vector<uint32_t> remap(static_cast<size_t>(m_size) * m_size, UNUSED);
+
+    TerrainMesh mesh;
+    mesh.indices.reserve(triangles.size());
+    for (uint32_t sample : triangles)
+    {
+        uint32_t& index = remap[sample];
+        if (index == UNUSED)
+        {
+            index = static_cast<uint32_t>(mesh.vertexCount());
+            mesh.positions.push_back(origin.x + (sample % m_size) * step);
+            mesh.positions.push_back(heights[sample] * heightScale);
+            mesh.positions.push_back(origin.y + (sample / m_size) * step);
+        }
+        mesh.indices.push_back(index);
+    }
+
+    return mesh;
+}
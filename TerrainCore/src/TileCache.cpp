@@ -0,0 +1,179 @@
+#include "TileCache.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "OutputSpan.h"
+
+TileCache::TileCache(const GenerationSettings& settings, int tileSize, size_t capacity)
+    : m_settings(settings)
+    , m_tileSize(std::max(1, tileSize))
+    , m_tiles((std::max(1, settings.size) + m_tileSize - 1) / m_tileSize)
+    , m_capacity(std::max<size_t>(1, capacity))
+{
+}
+
+template<typename Fn>
+TileCache::Tile TileCache::cached(Level& level, int tx, int ty, Fn&& generate)
+{
+    const uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(ty)) << 32) | static_cast<uint32_t>(tx);
+
+    std::promise<Tile> promise;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto found = level.find(key);
+    if (found != level.end())
+    {
+        ++m_stats.hits;
+        found->second.lastUse = ++m_clock;
+        const std::shared_future<Tile> value = found->second.value;
+        lock.unlock();
+        return value.get();
+    }
+    ++m_stats.misses;
+
+    // Evict the least recently used tile that is not being generated
+    if (level.size() >= m_capacity)
+    {
+        auto oldest = level.end();
+        for (auto it = level.begin(); it != level.end(); ++it)
+        {
+            const bool ready = it->second.value.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+            if (ready && (oldest == level.end() || it->second.lastUse < oldest->second.lastUse))
+                oldest = it;
+        }
+        if (oldest != level.end())
+            level.erase(oldest);
+    }
+    level[key] = { promise.get_future().share(), ++m_clock };
+    lock.unlock();
+
+    // Generated outside the lock, other requests for this tile wait on the future
+    const auto start = std::chrono::steady_clock::now();
+    const Tile tile = std::make_shared<const std::vector<float>>(generate());
+    promise.set_value(tile);
+
+    lock.lock();
+    m_stats.generationSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return tile;
+}
+
+TileCache::Tile TileCache::noiseTile(int tx, int ty)
+{
+    return cached(m_noise, tx, ty, [&]()
+    {
+        const int width = tileWidth(tx);
+        const int height = tileWidth(ty);
+        std::vector<float> heights(static_cast<size_t>(width) * height);
+        TileGeneration::GenerateNoise(m_settings, tx * m_tileSize, ty * m_tileSize, width, height, heights);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.generatedSamples += heights.size();
+        return heights;
+    });
+}
+
+TileCache::Tile TileCache::tile(int tx, int ty)
+{
+    tx = std::clamp(tx, 0, m_tiles - 1);
+    ty = std::clamp(ty, 0, m_tiles - 1);
+
+    const int halo = Erosion::Halo(m_settings.erosion);
+    if (halo == 0)
+        return noiseTile(tx, ty);
+
+    return cached(m_heights, tx, ty, [&]()
+    {
+        // Erosion over the tile grown by its halo, the halo noise comes from the neighbor tiles
+        const int x0 = tx * m_tileSize;
+        const int y0 = ty * m_tileSize;
+        const int width = tileWidth(tx);
+        const int height = tileWidth(ty);
+        const int rx0 = std::max(0, x0 - halo);
+        const int ry0 = std::max(0, y0 - halo);
+        const int regionWidth = std::min(m_settings.size, x0 + width + halo) - rx0;
+        const int regionHeight = std::min(m_settings.size, y0 + height + halo) - ry0;
+
+        std::vector<float> region(static_cast<size_t>(regionWidth) * regionHeight);
+        readLevel(true, rx0, ry0, regionWidth, regionHeight, region.data());
+        Erosion::Thermal(region, regionWidth, regionHeight, m_settings.erosion);
+
+        std::vector<float> heights(static_cast<size_t>(width) * height);
+        for (int y = 0; y < height; ++y)
+        {
+            const float* source = region.data() + static_cast<size_t>(y0 - ry0 + y) * regionWidth + (x0 - rx0);
+            std::copy(source, source + width, heights.data() + static_cast<size_t>(y) * width);
+        }
+        return heights;
+    });
+}
+
+bool TileCache::read(int x0, int y0, int width, int height, std::span<float> heights)
+{
+    if (width <= 0 || height <= 0)
+        return true;
+    if (!OutputSpan::Fits(heights, static_cast<size_t>(width) * height, "TileCache::read"))
+        return false;
+
+    readLevel(false, x0, y0, width, height, heights.data());
+    return true;
+}
+
+void TileCache::readWithApron(int tx, int ty, int apron, std::vector<float>& heights)
+{
+    const int width = tileWidth(tx) + 2 * apron;
+    const int height = tileWidth(ty) + 2 * apron;
+    heights.resize(static_cast<size_t>(width) * height);
+    read(tx * m_tileSize - apron, ty * m_tileSize - apron, width, height, heights);
+}
+
+void TileCache::readLevel(bool noise, int x0, int y0, int width, int height, float* heights)
+{
+    const int last = m_settings.size - 1;
+    const int tx0 = std::clamp(x0, 0, last) / m_tileSize;
+    const int tx1 = std::clamp(x0 + width - 1, 0, last) / m_tileSize;
+    const int ty0 = std::clamp(y0, 0, last) / m_tileSize;
+    const int ty1 = std::clamp(y0 + height - 1, 0, last) / m_tileSize;
+
+    for (int ty = ty0; ty <= ty1; ++ty)
+    {
+        for (int tx = tx0; tx <= tx1; ++tx)
+        {
+            const Tile tile = noise ? noiseTile(tx, ty) : this->tile(tx, ty);
+            const int tileX = tx * m_tileSize;
+            const int tileY = ty * m_tileSize;
+            const int w = tileWidth(tx);
+
+            // Output samples whose clamped position falls in this tile: the border tiles also take the outside
+            const int outX0 = tx == 0 ? 0 : std::clamp(tileX - x0, 0, width);
+            const int outX1 = tx == m_tiles - 1 ? width : std::clamp(tileX + w - x0, 0, width);
+            const int outY0 = ty == 0 ? 0 : std::clamp(tileY - y0, 0, height);
+            const int outY1 = ty == m_tiles - 1 ? height : std::clamp(tileY + tileWidth(ty) - y0, 0, height);
+
+            for (int y = outY0; y < outY1; ++y)
+            {
+                const float* row = tile->data() + static_cast<size_t>(std::clamp(y0 + y, 0, last) - tileY) * w;
+                float* out = heights + static_cast<size_t>(y) * width;
+                for (int x = outX0; x < outX1; ++x)
+                    out[x] = row[std::clamp(x0 + x, 0, last) - tileX];
+            }
+        }
+    }
+}
+
+TileCacheStats TileCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void TileCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_noise.clear();
+    m_heights.clear();
+}
+
+int TileCache::tileWidth(int tx) const
+{
+    return std::min(m_tileSize, m_settings.size - tx * m_tileSize);
+}
@@ -0,0 +1,99 @@
+#include "TileGeneration.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "OutputSpan.h"
+#include "Parallel.h"
+
+namespace
+{
+    // Sum of the noise stages over rows [y0, y0 + height), added to heights. clamp keeps sums at 0 or above.
+    void AccumulateStages(const GenerationSettings& settings, int x0, int y0, int width, int height, float* heights, bool clamp)
+    {
+        const int stageCount = std::clamp(settings.stageCount, 0, GenerationSettings::MAX_NOISE_STAGES);
+        std::unique_ptr<NoiseEngine> engines[GenerationSettings::MAX_NOISE_STAGES];
+        for (int s = 0; s < stageCount; ++s)
+            engines[s] = Noise::CreateEngine(settings.stages[s].type, settings.seed + settings.stages[s].seedOffset);
+
+        Parallel::For(0, height, [&](int r)
+        {
+            float* row = heights + static_cast<size_t>(r) * width;
+
+            std::vector<float> layer(width);
+            for (int s = 0; s < stageCount; ++s)
+            {
+                // Sample x of the stage at frequency * (origin - 1 + x * step)
+                const NoiseStage& stage = settings.stages[s];
+                const float frequency = static_cast<float>(stage.frequency);
+                engines[s]->sampleRow(settings.origin.x * stage.frequency, settings.origin.z * stage.frequency,
+                                      -frequency, settings.step * frequency, -frequency + (y0 + r) * (settings.step * frequency),
+                                      width, layer.data(), x0);
+                for (int x = 0; x < width; ++x)
+                    row[x] += stage.amplitude * layer[x];
+            }
+
+            if (clamp)
+            {
+                for (int x = 0; x < width; ++x)
+                    row[x] = std::max(0.f, row[x]);
+            }
+        });
+    }
+}
+
+namespace TileGeneration
+{
+    bool GenerateNoise(const GenerationSettings& settings, int x0, int y0, int width, int height, std::span<float> heights)
+    {
+        if (width <= 0 || height <= 0)
+            return true;
+        if (!OutputSpan::Fits(heights, static_cast<size_t>(width) * height, "TileGeneration::GenerateNoise"))
+            return false;
+
+        std::fill(heights.begin(), heights.begin() + static_cast<size_t>(width) * height, 0.f);
+        AccumulateStages(settings, x0, y0, width, height, heights.data(), true);
+        return true;
+    }
+
+    bool AddNoise(const GenerationSettings& settings, int x0, int y0, int width, int height, std::span<float> heights)
+    {
+        if (width <= 0 || height <= 0)
+            return true;
+        if (!OutputSpan::Fits(heights, static_cast<size_t>(width) * height, "TileGeneration::AddNoise"))
+            return false;
+
+        AccumulateStages(settings, x0, y0, width, height, heights.data(), false);
+        return true;
+    }
+
+    bool GenerateTile(const GenerationSettings& settings, int x0, int y0, int width, int height, std::span<float> heights)
+    {
+        const int halo = Erosion::Halo(settings.erosion);
+        if (halo == 0)
+            return GenerateNoise(settings, x0, y0, width, height, heights);
+        if (width <= 0 || height <= 0)
+            return true;
+        if (!OutputSpan::Fits(heights, static_cast<size_t>(width) * height, "TileGeneration::GenerateTile"))
+            return false;
+
+        const int rx0 = std::max(0, x0 - halo);
+        const int ry0 = std::max(0, y0 - halo);
+        const int rx1 = std::min(settings.size, x0 + width + halo);
+        const int ry1 = std::min(settings.size, y0 + height + halo);
+        const int regionWidth = rx1 - rx0;
+        const int regionHeight = ry1 - ry0;
+
+        std::vector<float> region(static_cast<size_t>(regionWidth) * regionHeight);
+        GenerateNoise(settings, rx0, ry0, regionWidth, regionHeight, region);
+        Erosion::Thermal(region, regionWidth, regionHeight, settings.erosion);
+
+        for (int y = 0; y < height; ++y)
+        {
+            const float* source = region.data() + static_cast<size_t>(y0 - ry0 + y) * regionWidth + (x0 - rx0);
+            std::copy(source, source + width, heights.begin() + static_cast<size_t>(y) * width);
+        }
+        return true;
+    }
+}
@@ -0,0 +1,356 @@
+#include "VirtualTexture.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "BiomeClassifier.h"
+#include "Noise.h"
+#include "OutputSpan.h"
+
+namespace
+{
+    // Octaves of the material detail: frequency in cycles per world unit, and amplitude
+    struct DetailOctave
+    {
+        float frequency;
+        float amplitude;
+    };
+    constexpr DetailOctave DETAIL_OCTAVES[] = { { 4.f, 0.15f }, { 16.f, 0.25f }, { 64.f, 0.12f }, { 256.f, 0.06f } };
+
+    // An octave is faded out between these cycles per texel, finer ones would alias
+    constexpr float DETAIL_FADE_START = 0.25f;
+    constexpr float DETAIL_FADE_END = 0.5f;
+}
+
+VirtualTextureCache::VirtualTextureCache(const VirtualTextureSettings& settings)
+    : m_settings(settings)
+{
+    // Power of two pages per side, 8-bit page coordinates
+    int pages = 1;
+    while (pages * 2 <= std::clamp(m_settings.pagesPerSide, 1, 256))
+        pages *= 2;
+    m_settings.pagesPerSide = pages;
+    m_settings.pageSize = std::max(1, m_settings.pageSize);
+    m_settings.slotsPerSide = std::clamp(m_settings.slotsPerSide, 2, 256);
+    m_settings.maxPendingPages = std::max(1, m_settings.maxPendingPages);
+
+    m_levelCount = 1;
+    while ((pages >> m_levelCount) > 0)
+        ++m_levelCount;
+
+    m_slots.resize(static_cast<size_t>(m_settings.slotsPerSide) * m_settings.slotsPerSide);
+    m_slotOf.resize(m_levelCount);
+    m_tables.resize(m_levelCount);
+    m_dirty.resize(m_levelCount);
+    clear();
+}
+
+void VirtualTextureCache::clear()
+{
+    for (Slot& slot : m_slots)
+        slot = Slot();
+    for (int level = 0; level < m_levelCount; ++level)
+    {
+        const int pages = getPagesPerSide(level);
+        m_slotOf[level].assign(static_cast<size_t>(pages) * pages, -1);
+        m_tables[level].assign(static_cast<size_t>(pages) * pages * ENTRY_BYTES, 0);
+        m_dirty[level] = { 0, 0, pages, pages };
+    }
+    m_readCounts.clear();
+    m_pending.clear();
+    m_stats = VirtualTextureStats();
+}
+
+void VirtualTextureCache::addFeedback(std::span<const uint8_t> texels)
+{
+    // Neighbor texels mostly read the same page
+    uint32_t lastKey = ~0u;
+    int* lastCount = nullptr;
+    for (size_t i = 0; i + ENTRY_BYTES <= texels.size(); i += ENTRY_BYTES)
+    {
+        if (texels[i + 3] == 0)
+            continue;
+
+        const VirtualPage page = { texels[i + 2], texels[i], texels[i + 1] };
+        if (page.level >= m_levelCount || page.x >= getPagesPerSide(page.level) || page.y >= getPagesPerSide(page.level))
+            continue;
+
+        const uint32_t key = page.key();
+        if (key != lastKey)
+        {
+            auto [it, inserted] = m_readCounts.try_emplace(key, 0);
+            lastKey = key;
+            lastCount = &it->second;
+
+            const int slot = slotOf(page);
+            if (inserted && slot >= 0)
+                m_slots[slot].lastUsed = m_frame;
+        }
+        ++*lastCount;
+    }
+}
+
+std::vector<VirtualPage> VirtualTextureCache::takeRequests(int maxCount)
+{
+    struct Request
+    {
+        VirtualPage page;
+        int reads;
+    };
+
+    // The missing pages and their missing ancestors, which cover them until they arrive
+    std::unordered_map<uint32_t, Request> missing;
+    auto request = [&](const VirtualPage& page, int reads)
+    {
+        if (slotOf(page) >= 0 || m_pending.count(page.key()))
+            return;
+        auto [it, inserted] = missing.try_emplace(page.key(), Request{ page, 0 });
+        it->second.reads += reads;
+    };
+
+    // The coarsest page is the fallback of every other one
+    request({ m_levelCount - 1, 0, 0 }, 1);
+
+    int missingReads = 0;
+    for (const auto& [key, reads] : m_readCounts)
+    {
+        VirtualPage page = { static_cast<int>(key >> 16), static_cast<int>(key & 0xff), static_cast<int>((key >> 8) & 0xff) };
+        if (slotOf(page) >= 0)
+            continue;
+
+        ++missingReads;
+        for (; page.level < m_levelCount; ++page.level, page.x /= 2, page.y /= 2)
+            request(page, reads);
+    }
+    m_stats.requestedPages = static_cast<int>(m_readCounts.size());
+    m_stats.missingPages = missingReads;
+
+    std::vector<Request> sorted;
+    sorted.reserve(missing.size());
+    for (const auto& [key, entry] : missing)
+        sorted.push_back(entry);
+    std::sort(sorted.begin(), sorted.end(), [](const Request& a, const Request& b)
+    {
+        if (a.page.level != b.page.level)
+            return a.page.level > b.page.level;
+        return a.reads != b.reads ? a.reads > b.reads : a.page.key() < b.page.key();
+    });
+
+    std::vector<VirtualPage> pages;
+    for (int i = 0; i < std::min(maxCount, static_cast<int>(sorted.size())); ++i)
+    {
+        pages.push_back(sorted[i].page);
+        m_pending.insert(sorted[i].page.key());
+    }
+    m_stats.pendingPages = static_cast<int>(m_pending.size());
+    return pages;
+}
+
+int VirtualTextureCache::makeResident(const VirtualPage& page)
+{
+    m_pending.erase(page.key());
+    m_stats.pendingPages = static_cast<int>(m_pending.size());
+    if (slotOf(page) >= 0)
+        return slotOf(page);
+
+    // A free slot, else the least recently used page that the current frame does not read
+    int victim = -1;
+    for (int i = 0; i < static_cast<int>(m_slots.size()); ++i)
+    {
+        const Slot& slot = m_slots[i];
+        if (!slot.used)
+        {
+            victim = i;
+            break;
+        }
+        if (slot.lastUsed < m_frame && slot.page.level != m_levelCount - 1 && (victim < 0 || slot.lastUsed < m_slots[victim].lastUsed))
+            victim = i;
+    }
+    if (victim < 0)
+        return -1;
+
+    Slot& slot = m_slots[victim];
+    if (slot.used)
+    {
+        slotOf(slot.page) = -1;
+        updateTable(slot.page);
+        ++m_stats.evictedPages;
+        --m_stats.residentPages;
+    }
+
+    slot.page = page;
+    slot.used = true;
+    slot.lastUsed = m_frame;
+    slotOf(page) = victim;
+    updateTable(page);
+    ++m_stats.generatedPages;
+    ++m_stats.residentPages;
+    return victim;
+}
+
+void VirtualTextureCache::cancel(const VirtualPage& page)
+{
+    m_pending.erase(page.key());
+    m_stats.pendingPages = static_cast<int>(m_pending.size());
+}
+
+void VirtualTextureCache::endFrame()
+{
+    ++m_frame;
+    m_readCounts.clear();
+    m_stats.generatedPages = 0;
+    m_stats.evictedPages = 0;
+}
+
+bool VirtualTextureCache::isResident(const VirtualPage& page) const
+{
+    return page.level >= 0 && page.level < m_levelCount && page.x >= 0 && page.y >= 0
+        && page.x < getPagesPerSide(page.level) && page.y < getPagesPerSide(page.level) && slotOf(page) >= 0;
+}
+
+void VirtualTextureCache::clearDirty()
+{
+    for (Rect& rect : m_dirty)
+        rect = Rect();
+}
+
+void VirtualTextureCache::updateTable(const VirtualPage& page)
+{
+    // The entries under the page, from its level down to the finest: each is its own page when resident,
+    // else the entry of its parent, which is already up to date
+    for (int level = page.level; level >= 0; --level)
+    {
+        const int shift = page.level - level;
+        const int pages = getPagesPerSide(level);
+        const Rect rect = { page.x << shift, page.y << shift, (page.x + 1) << shift, (page.y + 1) << shift };
+        std::vector<uint8_t>& table = m_tables[level];
+        for (int y = rect.y0; y < rect.y1; ++y)
+        {
+            for (int x = rect.x0; x < rect.x1; ++x)
+            {
+                uint8_t* entry = &table[(static_cast<size_t>(y) * pages + x) * ENTRY_BYTES];
+                const int slot = m_slotOf[level][y * pages + x];
+                if (slot >= 0)
+                {
+                    entry[0] = static_cast<uint8_t>(slot % m_settings.slotsPerSide);
+                    entry[1] = static_cast<uint8_t>(slot / m_settings.slotsPerSide);
+                    entry[2] = static_cast<uint8_t>(level);
+                    entry[3] = 255;
+                }
+                else if (level + 1 < m_levelCount)
+                {
+                    const uint8_t* parent = &m_tables[level + 1][(static_cast<size_t>(y / 2) * (pages / 2) + x / 2) * ENTRY_BYTES];
+                    std::copy(parent, parent + ENTRY_BYTES, entry);
+                }
+                else
+                    std::fill(entry, entry + ENTRY_BYTES, uint8_t(0));
+            }
+        }
+
+        Rect& dirty = m_dirty[level];
+        dirty = dirty.empty() ? rect : Rect{ std::min(dirty.x0, rect.x0), std::min(dirty.y0, rect.y0),
+                                             std::max(dirty.x1, rect.x1), std::max(dirty.y1, rect.y1) };
+    }
+}
+
+namespace VirtualTexture
+{
+    bool GenerateMaterialPage(const MaterialPageSource& source, const VirtualTextureSettings& settings, const VirtualPage& page,
+                              std::span<uint8_t> texels)
+    {
+        const int slotSize = settings.pageSize + 2 * VirtualTextureCache::BORDER;
+        if (!OutputSpan::Fits(texels, static_cast<size_t>(slotSize) * slotSize * 4, "VirtualTexture::GenerateMaterialPage"))
+            return false;
+        if (!source.weights || source.size < 2 || source.weights->size() < static_cast<size_t>(source.size) * source.size * 4)
+            return false;
+
+        constexpr int layerCount = static_cast<int>(Material::COUNT);
+        std::unique_ptr<NoiseEngine> engines[layerCount];
+        Color3<float> colors[layerCount];
+        for (int layer = 0; layer < layerCount; ++layer)
+        {
+            engines[layer] = Noise::CreateEngine(NoiseType::PERLIN, source.seed + 7919 * (layer + 1));
+            colors[layer] = MaterialColor(static_cast<Material>(layer));
+        }
+
+        // Texel centers of the page, the border continues the neighbor pages
+        const int pages = settings.pagesPerSide >> page.level;
+        const double texelUv = 1.0 / (static_cast<double>(pages) * settings.pageSize);
+        const double u0 = static_cast<double>(page.x) / pages + (0.5 - VirtualTextureCache::BORDER) * texelUv;
+        const double v0 = static_cast<double>(page.y) / pages + (0.5 - VirtualTextureCache::BORDER) * texelUv;
+        const float texelWorld = static_cast<float>(texelUv * source.extent);
+
+        float fades[std::size(DETAIL_OCTAVES)];
+        for (size_t o = 0; o < std::size(DETAIL_OCTAVES); ++o)
+        {
+            const float cycles = DETAIL_OCTAVES[o].frequency * texelWorld;
+            fades[o] = std::clamp((DETAIL_FADE_END - cycles) / (DETAIL_FADE_END - DETAIL_FADE_START), 0.f, 1.f);
+        }
+
+        const uint8_t* weights = source.weights->data();
+        const int last = source.size - 1;
+        std::vector<float> grain(static_cast<size_t>(layerCount) * slotSize);
+        std::vector<float> octave(slotSize);
+        for (int ty = 0; ty < slotSize; ++ty)
+        {
+            const double v = v0 + ty * texelUv;
+
+            // Detail of each material along the row, in world space
+            std::fill(grain.begin(), grain.end(), 0.8f);
+            for (size_t o = 0; o < std::size(DETAIL_OCTAVES); ++o)
+            {
+                if (fades[o] <= 0.f)
+                    continue;
+                const float frequency = DETAIL_OCTAVES[o].frequency;
+                const float amplitude = DETAIL_OCTAVES[o].amplitude * fades[o];
+                for (int layer = 0; layer < layerCount; ++layer)
+                {
+                    engines[layer]->sampleRow(static_cast<float>(u0 * source.extent * frequency), texelWorld * frequency,
+                                              static_cast<float>(v * source.extent * frequency), slotSize, octave.data());
+                    float* layerGrain = &grain[static_cast<size_t>(layer) * slotSize];
+                    for (int tx = 0; tx < slotSize; ++tx)
+                        layerGrain[tx] += amplitude * octave[tx];
+                }
+            }
+
+            // Weights between the samples, clamped at the map border
+            const float sy = static_cast<float>(std::clamp(v, 0.0, 1.0) * last);
+            const int y = std::min(static_cast<int>(sy), last - 1);
+            const float fy = sy - y;
+            uint8_t* out = texels.data() + static_cast<size_t>(ty) * slotSize * 4;
+            for (int tx = 0; tx < slotSize; ++tx)
+            {
+                const float sx = static_cast<float>(std::clamp(u0 + tx * texelUv, 0.0, 1.0) * last);
+                const int x = std::min(static_cast<int>(sx), last - 1);
+                const float fx = sx - x;
+                const uint8_t* w00 = weights + (static_cast<size_t>(y) * source.size + x) * 4;
+                const uint8_t* w10 = w00 + 4;
+                const uint8_t* w01 = w00 + static_cast<size_t>(source.size) * 4;
+                const uint8_t* w11 = w01 + 4;
+
+                float blend[layerCount];
+                float total = 0.f;
+                for (int layer = 0; layer < layerCount; ++layer)
+                {
+                    blend[layer] = (w00[layer] * (1.f - fx) + w10[layer] * fx) * (1.f - fy) + (w01[layer] * (1.f - fx) + w11[layer] * fx) * fy;
+                    total += blend[layer];
+                }
+                const float normalize = 1.f / std::max(total, 1e-3f);
+
+                float r = 0.f, g = 0.f, b = 0.f;
+                for (int layer = 0; layer < layerCount; ++layer)
+                {
+                    const float weight = blend[layer] * normalize * grain[static_cast<size_t>(layer) * slotSize + tx];
+                    r += weight * colors[layer].r;
+                    g += weight * colors[layer].g;
+                    b += weight * colors[layer].b;
+                }
+                out[tx * 4 + 0] = static_cast<uint8_t>(std::clamp(r, 0.f, 1.f) * 255.f + 0.5f);
+                out[tx * 4 + 1] = static_cast<uint8_t>(std::clamp(g, 0.f, 1.f) * 255.f + 0.5f);
+                out[tx * 4 + 2] = static_cast<uint8_t>(std::clamp(b, 0.f, 1.f) * 255.f + 0.5f);
+                out[tx * 4 + 3] = 255;
+            }
+        }
+        return true;
+    }
+}
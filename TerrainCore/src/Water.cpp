@@ -0,0 +1,297 @@
+#include "Water.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "Parallel.h"
+
+namespace
+{
+    enum Pipe { LEFT, RIGHT, UP, DOWN };
+
+    // Simulated time kept when the solver falls behind
+    constexpr double MAX_ACCUMULATED_STEPS = 8.0;
+}
+
+WaterSimulation::WaterSimulation(const WaterSettings& settings)
+    : m_settings(settings)
+{
+}
+
+void WaterSimulation::setTerrain(const HeightfieldView& heightfield)
+{
+    m_size = heightfield.valid() ? heightfield.size : 0;
+    m_tiles = (m_size + TILE_SIZE - 1) / TILE_SIZE;
+    m_origin = heightfield.origin;
+    m_cellSize = heightfield.step;
+
+    const size_t cells = static_cast<size_t>(m_size) * m_size;
+    m_ground.resize(cells);
+    for (size_t i = 0; i < cells; ++i)
+        m_ground[i] = heightfield.heights[i] * heightfield.heightScale;
+
+    m_sources.clear();
+    m_stats = WaterStats();
+    m_stats.tileCount = m_tiles * m_tiles;
+    clear();
+}
+
+void WaterSimulation::clear()
+{
+    const size_t cells = static_cast<size_t>(m_size) * m_size;
+    m_depth.assign(cells, 0.f);
+    m_flux.assign(cells * 4, 0.f);
+    m_active.assign(static_cast<size_t>(m_tiles) * m_tiles, 0);
+    m_dirty.assign(static_cast<size_t>(m_tiles) * m_tiles, 1);
+    m_accumulator = 0.0;
+}
+
+bool WaterSimulation::toCell(float x, float z, int& cx, int& cy) const
+{
+    cx = static_cast<int>(std::lround((x - m_origin.x) / m_cellSize));
+    cy = static_cast<int>(std::lround((z - m_origin.y) / m_cellSize));
+    return m_size > 0 && cx >= 0 && cy >= 0 && cx < m_size && cy < m_size;
+}
+
+void WaterSimulation::activateAround(int cx, int cy, int radius)
+{
+    const int tx0 = std::max(0, cx - radius) / TILE_SIZE;
+    const int ty0 = std::max(0, cy - radius) / TILE_SIZE;
+    const int tx1 = std::min(m_size - 1, cx + radius) / TILE_SIZE;
+    const int ty1 = std::min(m_size - 1, cy + radius) / TILE_SIZE;
+    for (int ty = ty0; ty <= ty1; ++ty)
+    {
+        for (int tx = tx0; tx <= tx1; ++tx)
+        {
+            m_active[ty * m_tiles + tx] = 1;
+            m_dirty[ty * m_tiles + tx] = 1;
+        }
+    }
+}
+
+void WaterSimulation::addWater(float x, float z, float radius, float depth)
+{
+    int cx, cy;
+    if (!toCell(x, z, cx, cy))
+        return;
+
+    const int cells = std::max(0, static_cast<int>(radius / m_cellSize));
+    for (int y = std::max(0, cy - cells); y <= std::min(m_size - 1, cy + cells); ++y)
+    {
+        for (int x = std::max(0, cx - cells); x <= std::min(m_size - 1, cx + cells); ++x)
+        {
+            if ((x - cx) * (x - cx) + (y - cy) * (y - cy) <= cells * cells)
+                m_depth[index(x, y)] += depth;
+        }
+    }
+    activateAround(cx, cy, cells);
+}
+
+void WaterSimulation::addSource(float x, float z, float rate)
+{
+    int cx, cy;
+    if (!toCell(x, z, cx, cy))
+        return;
+
+    m_sources.push_back({ static_cast<int>(index(cx, cy)), rate });
+    activateAround(cx, cy, 0);
+}
+
+void WaterSimulation::rain(float depth)
+{
+    for (float& d : m_depth)
+        d += depth;
+    std::fill(m_active.begin(), m_active.end(), 1);
+    std::fill(m_dirty.begin(), m_dirty.end(), 1);
+}
+
+void WaterSimulation::update(double seconds)
+{
+    if (m_size < 2)
+        return;
+
+    const auto start = std::chrono::steady_clock::now();
+    const double timeStep = m_settings.timeStep;
+    m_accumulator = std::min(m_accumulator + seconds, timeStep * MAX_ACCUMULATED_STEPS);
+
+    m_stats.steps = 0;
+    m_stats.overBudget = false;
+    while (m_accumulator >= timeStep)
+    {
+        const double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (elapsed >= m_settings.budget)
+        {
+            // Out of time: drop the rest, the water slows down instead of the frame
+            m_stats.overBudget = true;
+            m_accumulator = 0.0;
+            break;
+        }
+
+        step();
+        m_accumulator -= timeStep;
+        ++m_stats.steps;
+    }
+
+    m_stats.solverTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void WaterSimulation::step()
+{
+    for (const Source& source : m_sources)
+        m_active[tileOf(source.cell % m_size, source.cell / m_size)] = 1;
+
+    // Fluxes leave active tiles only, depths change in the active tiles and their neighbors
+    std::vector<int> fluxTiles;
+    std::vector<uint8_t> touched(m_active.size(), 0);
+    for (int t = 0; t < static_cast<int>(m_active.size()); ++t)
+    {
+        if (!m_active[t])
+            continue;
+
+        fluxTiles.push_back(t);
+        const int tx = t % m_tiles;
+        const int ty = t / m_tiles;
+        touched[t] = 1;
+        if (tx > 0) touched[t - 1] = 1;
+        if (tx + 1 < m_tiles) touched[t + 1] = 1;
+        if (ty > 0) touched[t - m_tiles] = 1;
+        if (ty + 1 < m_tiles) touched[t + m_tiles] = 1;
+    }
+
+    std::vector<int> depthTiles;
+    for (int t = 0; t < static_cast<int>(touched.size()); ++t)
+    {
+        if (touched[t])
+            depthTiles.push_back(t);
+    }
+    m_stats.activeTiles = static_cast<int>(fluxTiles.size());
+
+    Parallel::For(0, static_cast<int>(fluxTiles.size()), [&](int i) { computeFlux(fluxTiles[i]); });
+
+    // A tile stays active while its depths change
+    std::vector<uint8_t> changed(depthTiles.size());
+    Parallel::For(0, static_cast<int>(depthTiles.size()), [&](int i) { changed[i] = updateDepth(depthTiles[i]); });
+
+    for (size_t i = 0; i < depthTiles.size(); ++i)
+    {
+        const int t = depthTiles[i];
+        if (changed[i])
+        {
+            m_active[t] = 1;
+            m_dirty[t] = 1;
+        }
+        else if (m_active[t])
+        {
+            // Settled: the remaining fluxes are too small to move water
+            m_active[t] = 0;
+            const int x0 = (t % m_tiles) * TILE_SIZE;
+            const int y0 = (t / m_tiles) * TILE_SIZE;
+            for (int y = y0; y < std::min(m_size, y0 + TILE_SIZE); ++y)
+                std::fill(m_flux.begin() + index(x0, y) * 4, m_flux.begin() + index(std::min(m_size, x0 + TILE_SIZE), y) * 4, 0.f);
+        }
+    }
+}
+
+void WaterSimulation::computeFlux(int tile)
+{
+    const float dt = m_settings.timeStep;
+    const float area = m_cellSize * m_cellSize;
+    const float factor = dt * m_settings.gravity * m_cellSize; // Pipe cross-section over its length: l^2 / l
+    const int x0 = (tile % m_tiles) * TILE_SIZE;
+    const int y0 = (tile / m_tiles) * TILE_SIZE;
+
+    for (int y = y0; y < std::min(m_size, y0 + TILE_SIZE); ++y)
+    {
+        for (int x = x0; x < std::min(m_size, x0 + TILE_SIZE); ++x)
+        {
+            const size_t c = index(x, y);
+            float* flux = &m_flux[c * 4];
+            const float depth = m_depth[c];
+            if (depth <= 0.f)
+            {
+                flux[LEFT] = flux[RIGHT] = flux[UP] = flux[DOWN] = 0.f;
+                continue;
+            }
+
+            // Closed borders: no pipe leaves the map
+            const float surface = m_ground[c] + depth;
+            auto pipe = [&](float previous, bool exists, size_t neighbor)
+            {
+                if (!exists)
+                    return 0.f;
+                const float difference = surface - m_ground[neighbor] - m_depth[neighbor];
+                return std::max(0.f, previous * m_settings.damping + factor * difference);
+            };
+            flux[LEFT] = pipe(flux[LEFT], x > 0, c - 1);
+            flux[RIGHT] = pipe(flux[RIGHT], x + 1 < m_size, c + 1);
+            flux[UP] = pipe(flux[UP], y > 0, c - m_size);
+            flux[DOWN] = pipe(flux[DOWN], y + 1 < m_size, c + m_size);
+
+            // A cell cannot give more water than it has
+            const float outflow = (flux[LEFT] + flux[RIGHT] + flux[UP] + flux[DOWN]) * dt;
+            if (outflow > depth * area)
+            {
+                const float scale = depth * area / outflow;
+                for (int p = 0; p < 4; ++p)
+                    flux[p] *= scale;
+            }
+        }
+    }
+}
+
+bool WaterSimulation::updateDepth(int tile)
+{
+    const float dt = m_settings.timeStep;
+    const float area = m_cellSize * m_cellSize;
+    const float evaporation = std::max(0.f, 1.f - m_settings.evaporation * dt);
+    const int x0 = (tile % m_tiles) * TILE_SIZE;
+    const int y0 = (tile / m_tiles) * TILE_SIZE;
+
+    float maxChange = 0.f;
+    for (int y = y0; y < std::min(m_size, y0 + TILE_SIZE); ++y)
+    {
+        for (int x = x0; x < std::min(m_size, x0 + TILE_SIZE); ++x)
+        {
+            const size_t c = index(x, y);
+            const float* flux = &m_flux[c * 4];
+
+            float inflow = 0.f;
+            if (x > 0) inflow += m_flux[(c - 1) * 4 + RIGHT];
+            if (x + 1 < m_size) inflow += m_flux[(c + 1) * 4 + LEFT];
+            if (y > 0) inflow += m_flux[(c - m_size) * 4 + DOWN];
+            if (y + 1 < m_size) inflow += m_flux[(c + m_size) * 4 + UP];
+            const float outflow = flux[LEFT] + flux[RIGHT] + flux[UP] + flux[DOWN];
+
+            const float depth = std::max(0.f, (m_depth[c] + dt * (inflow - outflow) / area) * evaporation);
+            maxChange = std::max(maxChange, std::abs(depth - m_depth[c]));
+            m_depth[c] = depth;
+        }
+    }
+
+    for (const Source& source : m_sources)
+    {
+        const int x = source.cell % m_size;
+        const int y = source.cell / m_size;
+        if (tileOf(x, y) == tile)
+        {
+            m_depth[source.cell] += source.rate * dt;
+            maxChange = std::max(maxChange, source.rate * dt);
+        }
+    }
+
+    return maxChange > m_settings.epsilon;
+}
+
+void WaterSimulation::takeDirtyTiles(std::vector<int>& tiles)
+{
+    tiles.clear();
+    for (int t = 0; t < static_cast<int>(m_dirty.size()); ++t)
+    {
+        if (m_dirty[t])
+        {
+            tiles.push_back(t);
+            m_dirty[t] = 0;
+        }
+    }
+}
@@ -2,6 +2,7 @@
 #define CAMERA_H
 
 #include "MathHelper.h"
+#include "WorldOrigin.h"
 
 // Camera movement options
 enum class CameraMovement
@@ -21,6 +22,8 @@ constexpr float PITCH_LIMIT = 89.9f;
 constexpr float SPEED = 5.0f;
 constexpr float SENSITIVITY = 0.1f;
 constexpr float FOV = 45.0f;
+constexpr float NEAR_PLANE = 0.1f;
+constexpr float FAR_PLANE = 100.0f;
 
 // Free movement and view camera
 class Camera
@@ -37,10 +40,28 @@ public:
 	virtual void ProcessMouseScrollInputs(float yoffset);
 
 	void SetDeltaTime(float deltaTime);
+	void SetPose(const Point3d<float>& position, float yaw, float pitch);
+
+	// Position in the origin frame, angles in degrees
+	const Point3d<float>& GetPosition() const;
+	float GetYaw() const;
+	float GetPitch() const;
+	// Vertical field of view in degrees
+	float GetFov() const;
+
+	// The view matrix is relative to the origin, so the float position stays small in very large worlds.
+	// Render objects with their own origin offset by RelativeOffset(GetOrigin(), objectOrigin).
+	const WorldOrigin& GetOrigin() const;
+	void SetOrigin(const WorldOrigin& origin);
+	Point3d<double> GetWorldPosition() const;
+
+	// Move whole units from the position to the origin once the position is further than threshold, true if moved
+	bool RebaseOrigin(float threshold = 1024.f);
 
 private:
-	float m_deltaTime;
+	float m_deltaTime = 0.f;
 
+	WorldOrigin m_origin;
 	Point3d<float> m_position;
 	Point3d<float> m_up;
 	Point3d<float> m_right;
@@ -0,0 +1,137 @@
+#ifndef DETAIL_RENDERER_H
+#define DETAIL_RENDERER_H
+
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include <GL/glew.h>
+
+#include "JobSystem.h"
+#include "MemoryAccounting.h"
+#include "RenderQueue.h"
+#include "Shader.h"
+#include "TerrainDetail.h"
+
+struct DetailStats
+{
+    int selectedPatches = 0;
+    int drawnPatches = 0;
+    uint64_t drawnTriangles = 0;
+    int residentPatches = 0;
+    size_t residentBytes = 0;
+
+    // Patches uploaded by the last frame that had any, and how long after their request in milliseconds
+    int generatedPatches = 0;
+    double generationTime = 0.0;
+
+    // Patches being built in the background
+    int pendingPatches = 0;
+};
+
+// Refined terrain patches near the camera (see DetailLevels). Missing patches are built on the job system and
+// uploaded by a later frame, resident ones are cached by key so that a patch coming back into range costs nothing.
+// The terrain draws each resident patch with its own shader and discards its base triangles under them through a
+// mask texture of one texel per chunk.
+class DetailRenderer
+{
+public:
+    explicit DetailRenderer(const DetailSettings& settings = {});
+    ~DetailRenderer();
+
+    DetailRenderer(const DetailRenderer&) = delete;
+    DetailRenderer& operator=(const DetailRenderer&) = delete;
+
+    // New terrain: every patch is dropped and built again on demand.
+    // owner (optional) keeps the heights alive while background jobs read them.
+    void setTerrain(const HeightfieldView& heightfield, std::shared_ptr<const void> owner = nullptr);
+
+    // Same terrain with the samples [x, x + width) x [y, y + height) edited: only the patches over them are dropped
+    void updateRegion(const HeightfieldView& heightfield, std::shared_ptr<const void> owner, int x, int y, int width, int height);
+
+    const DetailSettings& getSettings() const { return m_levels.getSettings(); }
+    void setSettings(const DetailSettings& settings);
+
+    // Synchronous: update() waits for the patches it selects and draws them the same frame, so that a replay draws
+    // the same patches on every run whatever the job timing
+    bool isSynchronous() const { return m_synchronous; }
+    void setSynchronous(bool synchronous) { m_synchronous = synchronous; }
+
+    // Mesh bytes of the selected and cached patches, 0 for no limit
+    void setMemoryBudget(size_t bytes);
+
+    // Select the patches for a camera in the frame of the terrain, upload the built ones and queue the missing ones.
+    // pixelScale: see DetailLevels::update.
+    void update(const Point3d<float>& camera, float pixelScale);
+
+    // Mask of the chunks drawn by patches on a unit of the terrain command, and its uniforms
+    void bind(RenderCommand& command, int unit) const;
+    void setUniforms(const Shader& shader, int unit) const;
+
+    // Whether the terrain has chunks to discard, drawn by patches
+    bool hasPatches() const { return !m_drawn.empty(); }
+
+    // One command per resident patch, with the state and uniforms of the terrain command
+    void render(RenderQueue& queue, const RenderCommand& terrainCommand);
+
+    const DetailStats& getStats() const { return m_stats; }
+
+private:
+    // Uploaded patch, its vertices are a DetailMesh
+    struct Patch
+    {
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        GLuint ebo = 0;
+        GLsizei indexCount = 0;
+        size_t bytes = 0;
+        int chunk = 0;
+        std::list<uint64_t>::iterator lru;
+    };
+
+    // A patch built by a job, uploaded once its fence is done
+    struct PendingPatch
+    {
+        JobFence fence;
+        DetailPatch patch;
+        uint64_t key = 0;
+        DetailMesh mesh;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    DetailLevels m_levels;
+    std::shared_ptr<const void> m_heightsOwner;
+
+    // Resident patches by key, least recently drawn first in m_lru
+    std::unordered_map<uint64_t, Patch> m_patches;
+    std::list<uint64_t> m_lru;
+    std::unordered_map<int, uint64_t> m_latest;    // Last uploaded patch per chunk, drawn until the current one arrives
+    std::vector<std::unique_ptr<PendingPatch>> m_pending;
+
+    // Patches drawn this frame, and the chunks they cover as one byte per chunk, uploaded when it changes
+    std::vector<uint64_t> m_drawn;
+    std::vector<uint8_t> m_mask;
+    GLuint m_maskTexture = 0;
+    int m_maskSize = 0;
+
+    // The uniforms are set once for all the patches of a render call
+    uint64_t m_uniformsKey = 0;
+
+    // Resident patches and the mask, by their allocated size
+    MemoryCharge m_memory{ MemoryTag::DETAIL, MemoryDomain::GPU };
+
+    DetailStats m_stats;
+    bool m_synchronous = false;
+
+    void requestPatch(const DetailPatch& patch);
+    void waitForJobs();
+    void releasePatches();
+    void uploadFinished();
+    void uploadMask();
+    void evict(size_t capacity, size_t incomingBytes);
+    std::unordered_map<uint64_t, Patch>::iterator erasePatch(std::unordered_map<uint64_t, Patch>::iterator patch);
+};
+
+#endif // DETAIL_RENDERER_H
@@ -0,0 +1,59 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <chrono>
+#include <vector>
+
+struct FramePacing
+{
+    bool vsync = true;
+    int frameCap = 0; // Frames per second, 0 for none
+};
+
+// Over the last frames, in milliseconds
+struct FrameStats
+{
+    double frameTime = 0.0;
+    double meanFrameTime = 0.0;
+    double frameTimeDeviation = 0.0;
+    double maxFrameTime = 0.0;
+
+    // Estimated time from the input sample to the display of the frame using it
+    double inputLatency = 0.0;
+};
+
+// Frame cap and frame time statistics of the render loop. Call endFrame right after the buffer swap.
+class FramePacer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit FramePacer(int historySize = 120);
+
+    const FramePacing& getPacing() const { return m_pacing; }
+    void setPacing(const FramePacing& pacing) { m_pacing = pacing; }
+
+    // Monitor refresh rate in Hz, for the latency estimate
+    void setRefreshRate(int refreshRate) { m_refreshRate = refreshRate; }
+
+    // Sleep until the frame cap allows the next swap
+    void waitForSwap();
+
+    // The frame displays the input sampled at inputTime
+    void endFrame(Clock::time_point inputTime);
+
+    const FrameStats& getStats() const { return m_stats; }
+
+private:
+    FramePacing m_pacing;
+    int m_refreshRate = 60;
+
+    Clock::time_point m_lastSwap = Clock::now();
+    std::vector<double> m_frameTimes;
+    std::vector<double> m_latencies;
+    size_t m_next = 0;
+
+    FrameStats m_stats;
+};
+
+#endif // FRAME_PACER_H
@@ -0,0 +1,43 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <array>
+#include <utility>
+#include <vector>
+#include <GL/glew.h>
+
+// GPU time of frames from GL_TIME_ELAPSED queries. The results are read a few frames later, when the GPU has
+// finished them, so timing does not stall the pipeline; a frame waits only when every query is still in flight.
+class GpuTimer
+{
+public:
+    static constexpr int QUERY_COUNT = 4;
+
+    GpuTimer();
+    ~GpuTimer();
+
+    GpuTimer(const GpuTimer&) = delete;
+    GpuTimer& operator=(const GpuTimer&) = delete;
+
+    // Time the GL commands between begin and end as the given frame
+    void begin(int frame);
+    void end();
+
+    // Frames finished since the last call as (frame, milliseconds), all of them with wait (e.g. after the last frame)
+    void collect(std::vector<std::pair<int, double>>& results, bool wait = false);
+
+private:
+    struct Query
+    {
+        GLuint id = 0;
+        int frame = -1;     // -1 when no result is pending
+    };
+
+    std::array<Query, QUERY_COUNT> m_queries;
+    int m_next = 0;
+    std::vector<std::pair<int, double>> m_results;
+
+    void read(Query& query);
+};
+
+#endif // GPU_TIMER_H
@@ -0,0 +1,50 @@
+#ifndef HEADLESS_RENDERER_H
+#define HEADLESS_RENDERER_H
+
+#include <string>
+#include <vector>
+
+#include "MathHelper.h"
+#include "Preset.h"
+
+// Camera pose used for a preview shot
+struct CameraPose
+{
+    Point3d<float> position;
+    float yaw;
+    float pitch;
+};
+
+// Settings of the offscreen batch renderer (see --help)
+struct HeadlessSettings
+{
+    int width = 512;
+    int height = 512;
+
+    int firstSeed = 0;
+    int seedCount = 1;
+
+    // Terrain of every preview, the seed is replaced by each rendered seed
+    TerrainPreset preset;
+    bool wireframe = true;
+
+    // Create the context through OSMesa instead of the windowing system (CPU-only machines)
+    bool useOSMesa = false;
+
+    std::string outputDirectory = "previews";
+    std::string posesPath;
+};
+
+namespace Headless
+{
+    // Return true if the command line asks for the headless mode, and fill the settings
+    bool ParseArguments(int argc, char** argv, HeadlessSettings& settings);
+
+    // Parse a camera script: one "x y z yaw pitch" pose per line, '#' starts a comment
+    std::vector<CameraPose> LoadPoses(const std::string& filePath);
+
+    // Render every seed from every pose into PNG files, return the process exit code
+    int Run(const HeadlessSettings& settings);
+}
+
+#endif // HEADLESS_RENDERER_H
@@ -0,0 +1,56 @@
+#ifndef RENDER_COUNTERS_H
+#define RENDER_COUNTERS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Work submitted to OpenGL since the last reset, counted where the renderers draw and upload.
+// Only the render thread issues GL calls, so the counters are not atomic.
+struct RenderCounters
+{
+    int drawCalls = 0;
+    uint64_t triangles = 0;
+    uint64_t uploadBytes = 0;
+
+    // Bindings issued by the GL state cache, and those it skipped as already set
+    int stateChanges = 0;
+    int redundantStateChanges = 0;
+};
+
+namespace RenderStats
+{
+    inline RenderCounters& Frame()
+    {
+        static RenderCounters counters;
+        return counters;
+    }
+
+    // indexCount indices of GL_TRIANGLES, drawn instanceCount times
+    inline void Draw(int64_t indexCount, int64_t instanceCount = 1)
+    {
+        RenderCounters& counters = Frame();
+        ++counters.drawCalls;
+        counters.triangles += static_cast<uint64_t>(indexCount / 3 * instanceCount);
+    }
+
+    inline void Upload(size_t bytes)
+    {
+        Frame().uploadBytes += bytes;
+    }
+
+    inline void StateChange(bool issued)
+    {
+        RenderCounters& counters = Frame();
+        ++(issued ? counters.stateChanges : counters.redundantStateChanges);
+    }
+
+    // Counters of the frame that ended, the next one starts from zero
+    inline RenderCounters EndFrame()
+    {
+        const RenderCounters counters = Frame();
+        Frame() = RenderCounters();
+        return counters;
+    }
+}
+
+#endif // RENDER_COUNTERS_H
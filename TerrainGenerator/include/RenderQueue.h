@@ -0,0 +1,100 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include <GL/glew.h>
+
+#include "Shader.h"
+
+// Bindings last set through the cache: setting the current value again issues no GL call. GL calls made around the
+// cache (uploads, the UI) can change any binding, so the state is unknown again after invalidate().
+class GLStateCache
+{
+public:
+    static constexpr int TEXTURE_UNITS = 8;
+
+    void invalidate();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vertexArray);
+    void bindTexture(int unit, GLenum target, GLuint texture);
+    void setDepthMask(bool write);
+
+private:
+    static constexpr GLuint UNKNOWN = ~0u;
+
+    struct TextureUnit
+    {
+        GLenum target = 0;
+        GLuint texture = UNKNOWN;
+    };
+
+    GLuint m_program = UNKNOWN;
+    GLuint m_vertexArray = UNKNOWN;
+    int m_activeUnit = -1;
+    std::array<TextureUnit, TEXTURE_UNITS> m_units;
+    int m_depthMask = -1;
+
+    bool apply(bool changed);
+};
+
+// Commands are drawn by pass, transparent surfaces over the opaque ones
+enum class RenderPass : uint8_t
+{
+    OPAQUE,
+    TRANSPARENT
+};
+
+struct TextureBinding
+{
+    GLenum target = GL_TEXTURE_2D;
+    GLuint texture = 0;     // 0 leaves the unit as it is
+};
+
+// One indexed draw of GL_TRIANGLES with the state it needs
+struct RenderCommand
+{
+    RenderPass pass = RenderPass::OPAQUE;
+    const Shader* shader = nullptr;
+    GLuint vertexArray = 0;
+    std::array<TextureBinding, GLStateCache::TEXTURE_UNITS> textures = {};  // By unit
+    bool depthWrite = true;
+
+    GLsizei indexCount = 0;
+    GLsizei instanceCount = 0;  // 0 for a non-instanced draw
+
+    // Uniforms of the shader, skipped after a command of the same shader with the same non-zero uniformsKey
+    std::function<void(const Shader&)> uniforms;
+    uint64_t uniformsKey = 0;
+
+    // Per-draw state after the binds, e.g. the instance buffer of the vertex array
+    std::function<void()> prepare;
+};
+
+// Draw commands recorded by the renderers, sorted by pass, program, vertex array and textures so that consecutive
+// draws share their state, then submitted through a GLStateCache. Commands of equal state keep their order.
+class RenderQueue
+{
+public:
+    void submit(RenderCommand command);
+
+    // Draw and clear the commands, the state starting unknown
+    void flush(GLStateCache& state);
+
+    bool empty() const { return m_commands.empty(); }
+
+private:
+    struct Entry
+    {
+        uint64_t key = 0;
+        uint32_t index = 0;
+    };
+
+    std::vector<RenderCommand> m_commands;
+    std::vector<Entry> m_order;
+};
+
+#endif // RENDER_QUEUE_H
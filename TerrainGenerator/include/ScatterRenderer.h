@@ -0,0 +1,161 @@
+#ifndef SCATTER_RENDERER_H
+#define SCATTER_RENDERER_H
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <vector>
+#include <GL/glew.h>
+
+#include "Frustum.h"
+#include "JobSystem.h"
+#include "MemoryAccounting.h"
+#include "RenderQueue.h"
+#include "Scatter.h"
+#include "Shader.h"
+
+enum class ScatterKind
+{
+    TREE,
+    ROCK,
+    COUNT
+};
+
+struct ScatterStats
+{
+    int visibleChunks = 0;
+    int residentChunks = 0;
+    int drawCalls = 0;
+    size_t drawnInstances = 0;
+
+    // Chunks uploaded by the last frame that had any, and how long after their request in milliseconds
+    int generatedChunks = 0;
+    double generationTime = 0.0;
+
+    // Chunks being scattered in the background
+    int pendingChunks = 0;
+
+    // Instance buffers released over the memory budget, since the terrain was set
+    int evictedChunks = 0;
+};
+
+// Instanced trees and rocks over the terrain. The terrain is cut in square chunks that are scattered
+// on the job system the first time they are visible, then drawn with one instanced draw call per kind and chunk.
+// A chunk appears the first frame after its scatter job finished, rendering never waits for it.
+class ScatterRenderer
+{
+public:
+    static constexpr int KIND_COUNT = static_cast<int>(ScatterKind::COUNT);
+
+    explicit ScatterRenderer(float chunkSize = 2.f);
+    ~ScatterRenderer();
+
+    ScatterRenderer(const ScatterRenderer&) = delete;
+    ScatterRenderer& operator=(const ScatterRenderer&) = delete;
+
+    // New terrain: every chunk is dropped and will be scattered again on demand.
+    // owner (optional) keeps the heights alive while background jobs read them.
+    void setTerrain(const HeightfieldView& heightfield, uint32_t seed, std::shared_ptr<const void> owner = nullptr);
+
+    // Same terrain with the samples [x, x + width) x [y, y + height) edited: only the chunks over them are scattered again
+    void updateRegion(const HeightfieldView& heightfield, std::shared_ptr<const void> owner, int x, int y, int width, int height);
+
+    // GPU bytes of the instance buffers, 0 for no limit: over it the chunks out of view the longest are released
+    // and scattered again when they come back
+    size_t getMemoryBudget() const { return m_memoryBudget; }
+    void setMemoryBudget(size_t bytes) { m_memoryBudget = bytes; }
+
+    // Synchronous: render() waits for the chunks it queues and draws them the same frame, so that a replay draws the
+    // same chunks on every run whatever the job timing
+    bool isSynchronous() const { return m_synchronous; }
+    void setSynchronous(bool synchronous) { m_synchronous = synchronous; }
+
+    const ScatterRule& getRule(ScatterKind kind) const { return m_rules[static_cast<int>(kind)]; }
+    void setRule(ScatterKind kind, const ScatterRule& rule);
+
+    // Start culling the chunks against VP on the job system, call it early in the frame
+    void prepare(const Mat4<float>& VP);
+
+    // Wait for the culling, queue the missing chunks and submit the resident ones, one instanced draw per chunk
+    // and kind. Prepares first if needed.
+    void render(RenderQueue& queue, const Mat4<float>& VP);
+
+    const ScatterStats& getStats() const { return m_stats; }
+
+private:
+    struct Mesh
+    {
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        GLuint ebo = 0;
+        GLsizei indexCount = 0;
+    };
+
+    struct Chunk
+    {
+        float x0 = 0.f;
+        float z0 = 0.f;
+        float minY = 0.f;
+        float maxY = 0.f;
+        bool generated = false;
+        bool pending = false;
+        std::array<GLuint, KIND_COUNT> buffers = {};
+        std::array<GLsizei, KIND_COUNT> counts = {};
+        size_t bytes = 0;
+        uint64_t lastVisible = 0;   // Frame
+    };
+
+    Shader m_shader;
+    float m_chunkSize;
+    HeightfieldView m_heightfield;
+    uint32_t m_seed = 0;
+
+    std::array<ScatterRule, KIND_COUNT> m_rules;
+    std::array<Mesh, KIND_COUNT> m_meshes;
+
+    int m_chunkCount = 0; // Per side
+    std::vector<Chunk> m_chunks;
+
+    // Chunks scattered by jobs, uploaded by render() once their fence is done
+    struct PendingBatch
+    {
+        JobFence fence;
+        std::vector<int> chunks;
+        std::vector<std::array<std::vector<ScatterInstance>, KIND_COUNT>> instances;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    std::shared_ptr<const void> m_heightsOwner;
+    std::vector<std::unique_ptr<PendingBatch>> m_pending;
+
+    // Culling of the current frame, one flag per chunk
+    std::optional<Frustum> m_frustum;
+    std::vector<uint8_t> m_visible;
+    JobFence m_cullFence;
+    bool m_prepared = false;
+    bool m_synchronous = false;
+
+    // VP is set once for all the draws of a render call
+    uint64_t m_uniformsKey = 0;
+    uint64_t m_frame = 0;
+
+    // Meshes and instance buffers
+    MemoryCharge m_memory{ MemoryTag::SCATTER, MemoryDomain::GPU };
+    size_t m_meshBytes = 0;
+    size_t m_memoryBudget = 0;
+
+    ScatterStats m_stats;
+
+    void createMeshes();
+    void releaseChunks();
+    void waitForJobs();
+    void uploadFinished();
+    void generateChunks(const std::vector<int>& chunks);
+    void releaseChunk(Chunk& chunk);
+    void updateBounds(int index);
+    void evictChunks();
+};
+
+#endif // SCATTER_RENDERER_H
@@ -0,0 +1,49 @@
+#ifndef SHADOW_MAPS_H
+#define SHADOW_MAPS_H
+
+#include <array>
+#include <functional>
+#include <GL/glew.h>
+
+#include "MathHelper.h"
+#include "MemoryAccounting.h"
+#include "RenderQueue.h"
+#include "Shader.h"
+
+// Cascaded shadow maps of the sun. The view frustum up to the shadow distance is split in cascades, near
+// cascades cover less ground with the same resolution. Each cascade is fitted on a bounding sphere of its slice,
+// and snapped to whole texels, so the shadows do not shimmer when the camera turns or moves.
+class ShadowMaps
+{
+public:
+    static constexpr int CASCADE_COUNT = 3;
+
+    explicit ShadowMaps(int resolution = 2048);
+    ~ShadowMaps();
+
+    ShadowMaps(const ShadowMaps&) = delete;
+    ShadowMaps& operator=(const ShadowMaps&) = delete;
+
+    // Fit the cascades on the frustum of VP (in the frame the casters are drawn in), sunDirection points to the sun
+    void update(const Mat4<float>& VP, const Point3d<float>& sunDirection, float nearPlane, float farPlane, float shadowDistance = 40.f);
+
+    // Draw the casters once per cascade, with the light view-projection of the cascade
+    void render(const std::function<void(const Mat4<float>&)>& drawCasters);
+
+    // Depth texture of a command on the given texture unit, and the light matrices, splits and unit of the shader
+    void bind(RenderCommand& command, int unit) const;
+    void setUniforms(const Shader& shader, int unit) const;
+
+    const Mat4<float>& getLightVP(int cascade) const { return m_lightVP[cascade]; }
+
+private:
+    int m_resolution;
+    GLuint m_texture = 0;
+    GLuint m_framebuffer = 0;
+    MemoryCharge m_memory{ MemoryTag::SHADOWS, MemoryDomain::GPU };
+
+    std::array<Mat4<float>, CASCADE_COUNT> m_lightVP;
+    std::array<float, CASCADE_COUNT> m_splits = {}; // Far view depth of each cascade
+};
+
+#endif // SHADOW_MAPS_H
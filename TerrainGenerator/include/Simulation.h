@@ -0,0 +1,81 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "Camera.h"
+
+using SimulationClock = std::chrono::steady_clock;
+
+// Input sampled by the render thread. Held keys apply to every step until the next sample, mouse offsets
+// accumulate until a step consumes them.
+struct InputState
+{
+    std::array<bool, 6> movement = {}; // Indexed by CameraMovement
+    float mouseX = 0.f;
+    float mouseY = 0.f;
+};
+
+// Camera pose at the end of a simulation step
+struct CameraState
+{
+    WorldOrigin origin;
+    Point3d<float> position;
+    float yaw = 0.f;
+    float pitch = 0.f;
+
+    SimulationClock::time_point time;
+    SimulationClock::time_point inputTime; // Sample time of the newest input the step applied
+};
+
+// Camera movement at a fixed timestep on its own thread, so its speed does not depend on the frame rate
+// and slow frames do not stall it. The render thread interpolates between the last two steps, one step
+// in the past: the interpolation adds one step of latency.
+class Simulation
+{
+public:
+    explicit Simulation(const Camera& camera, int stepsPerSecond = 120);
+    ~Simulation();
+
+    Simulation(const Simulation&) = delete;
+    Simulation& operator=(const Simulation&) = delete;
+
+    void submitInput(const InputState& input);
+
+    // Move the camera frame, the local position stays the same
+    void setOrigin(const WorldOrigin& origin);
+
+    // Set camera to its pose at time `now`, returns when the input of that pose was sampled
+    SimulationClock::time_point interpolate(Camera& camera, SimulationClock::time_point now) const;
+
+    int getStepsPerSecond() const { return m_stepsPerSecond; }
+
+    // Steps dropped because the thread fell behind
+    int getSkippedSteps() const { return m_skippedSteps.load(std::memory_order_relaxed); }
+
+private:
+    Camera m_camera;
+    int m_stepsPerSecond;
+    SimulationClock::duration m_step;
+
+    // Guards the input, the camera and the states
+    mutable std::mutex m_mutex;
+    InputState m_input;
+    SimulationClock::time_point m_inputTime;
+    CameraState m_previous;
+    CameraState m_current;
+
+    std::atomic<bool> m_stop = false;
+    std::atomic<int> m_skippedSteps = 0;
+    std::thread m_thread;
+
+    CameraState capture(SimulationClock::time_point time) const;
+    void step(SimulationClock::time_point time);
+    void run();
+};
+
+#endif // SIMULATION_H
@@ -4,10 +4,12 @@
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
+#include <string>
 
 namespace Utils
 {
-	std::string StringFromFile(const std::string& filePath)
+	inline std::string StringFromFile(const std::string& filePath)
 	{
 		std::ifstream file;
 		file.open(filePath, std::ios::in);
@@ -0,0 +1,111 @@
+#ifndef VIRTUAL_TEXTURE_RENDERER_H
+#define VIRTUAL_TEXTURE_RENDERER_H
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <GL/glew.h>
+
+#include "JobSystem.h"
+#include "MemoryAccounting.h"
+#include "RenderQueue.h"
+#include "Shader.h"
+#include "VirtualTexture.h"
+
+// Terrain materials as a software virtual texture: a page table texture, a fixed atlas of resident pages, and a low
+// resolution feedback pass writing the page each pixel reads. The feedback is read back asynchronously, its missing
+// pages are generated on the job system and uploaded within a per-frame byte budget, so texture memory stays the
+// same however much surface detail the terrain has. Until a page arrives, its closest resident ancestor is drawn.
+class VirtualTextureRenderer
+{
+public:
+    // The feedback is rendered at 1 / FEEDBACK_DIVISOR of the viewport per side
+    static constexpr int FEEDBACK_DIVISOR = 8;
+
+    explicit VirtualTextureRenderer(const VirtualTextureSettings& settings = {});
+    ~VirtualTextureRenderer();
+
+    VirtualTextureRenderer(const VirtualTextureRenderer&) = delete;
+    VirtualTextureRenderer& operator=(const VirtualTextureRenderer&) = delete;
+
+    // New materials: every page is dropped and generated again on demand. A source with the same weights is
+    // ignored, so it can be set every frame.
+    void setSource(const MaterialPageSource& source);
+
+    // Collect the feedback read back since the last frame, upload the generated pages within the budget and
+    // start generating the missing ones
+    void update();
+
+    // Feedback pass into the low resolution target: draw(shader) draws the textured geometry with the feedback
+    // shader (MVP and virtualTransform left to set). The pixels are read back without waiting for the GPU.
+    void renderFeedback(const std::function<void(const Shader&)>& draw);
+
+    // Page table and atlas of a command on units unit and unit + 1, and the uniforms of the lookup
+    void bind(RenderCommand& command, int unit) const;
+    void setUniforms(const Shader& shader, int unit) const;
+
+    // Synchronous: update() waits for the feedback of the previous frame and for the pages it requests, so that a
+    // replay has the same pages resident at each frame on every run whatever the GPU and job timing
+    bool isSynchronous() const { return m_synchronous; }
+    void setSynchronous(bool synchronous) { m_synchronous = synchronous; }
+
+    size_t getUploadBudget() const { return m_uploadBudget; }
+    void setUploadBudget(size_t bytes) { m_uploadBudget = bytes; }
+
+    // GPU memory of the page table and atlas, fixed
+    size_t textureBytes() const;
+
+    const VirtualTextureStats& getStats() const { return m_stats; }
+
+private:
+    // A page being generated by a job, uploaded once its fence is done
+    struct PendingPage
+    {
+        JobFence fence;
+        VirtualPage page;
+        uint64_t generation = 0;
+        std::vector<uint8_t> texels;
+        double milliseconds = 0.0;
+        bool generated = false;
+    };
+
+    // Asynchronous read back of one feedback frame
+    struct Readback
+    {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+    };
+
+    VirtualTextureCache m_cache;
+    Shader m_feedbackShader;
+    MaterialPageSource m_source;
+    uint64_t m_generation = 0;
+    size_t m_uploadBudget;
+    bool m_synchronous = false;
+
+    GLuint m_pageTable = 0;
+    GLuint m_atlas = 0;
+
+    GLuint m_framebuffer = 0;
+    GLuint m_feedbackColor = 0;
+    GLuint m_feedbackDepth = 0;
+    int m_feedbackWidth = 0;
+    int m_feedbackHeight = 0;
+    std::array<Readback, 2> m_readbacks;
+    int m_nextReadback = 0;
+
+    // Page table, atlas and the feedback target with its read back buffers
+    MemoryCharge m_memory{ MemoryTag::VIRTUAL_TEXTURE, MemoryDomain::GPU };
+
+    std::vector<std::unique_ptr<PendingPage>> m_pending;
+    VirtualTextureStats m_stats;
+
+    void resizeFeedback(int width, int height);
+    void collectFeedback();
+    void uploadPages();
+    void uploadPageTable();
+    void requestPages();
+};
+
+#endif // VIRTUAL_TEXTURE_RENDERER_H
@@ -0,0 +1,49 @@
+#ifndef WATER_RENDERER_H
+#define WATER_RENDERER_H
+
+#include <vector>
+#include <GL/glew.h>
+
+#include "MemoryAccounting.h"
+#include "RenderQueue.h"
+#include "Shader.h"
+#include "Water.h"
+
+// Water surface of a WaterSimulation, drawn after the terrain. A grid of the map size is displaced in the vertex
+// shader by a float texture (surface height, depth); only the tiles the solver changed are uploaded.
+class WaterRenderer
+{
+public:
+    WaterRenderer();
+    ~WaterRenderer();
+
+    WaterRenderer(const WaterRenderer&) = delete;
+    WaterRenderer& operator=(const WaterRenderer&) = delete;
+
+    // Rebuild the grid and the texture for the current terrain of the simulation
+    void setTerrain(const WaterSimulation& water, const Point2d<float>& origin, float step);
+
+    // Upload the tiles changed since the last call, returns the uploaded bytes
+    size_t upload(WaterSimulation& water);
+
+    // Transparent surface: tested against the terrain, but does not hide what is drawn later
+    void render(RenderQueue& queue, const Mat4<float>& VP);
+
+private:
+    Shader m_shader;
+    GLuint m_vao = 0;
+    GLuint m_vbo = 0;
+    GLuint m_ebo = 0;
+    GLuint m_texture = 0;
+    GLsizei m_indexCount = 0;
+    MemoryCharge m_memory{ MemoryTag::WATER, MemoryDomain::GPU };
+
+    int m_size = 0;
+    Point2d<float> m_origin = { 0.f, 0.f };
+    float m_step = 1.f;
+
+    std::vector<int> m_dirtyTiles;
+    std::vector<float> m_staging;
+};
+
+#endif // WATER_RENDERER_H
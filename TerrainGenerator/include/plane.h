@@ -1,13 +1,32 @@
 #ifndef PLANE_H
 #define PLANE_H
 
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
 #include <vector>
 #include <GL/glew.h>
 
+#include "BiomeClassifier.h"
 #include "Color3.h"
+#include "DetailRenderer.h"
+#include "GenerationGraph.h"
+#include "GridMesh.h"
+#include "Heightfield.h"
+#include "HorizonAO.h"
 #include "MathHelper.h"
+#include "MemoryAccounting.h"
+#include "RenderCounters.h"
+#include "RenderQueue.h"
+#include "Sculpt.h"
 #include "Shader.h"
+#include "ShadowMaps.h"
+#include "VirtualTextureRenderer.h"
 #include "PerlinNoise.h"
+#include "WorldOrigin.h"
 
 template<typename T>
 struct PlaneVertex
@@ -16,25 +35,46 @@ struct PlaneVertex
     // Color3<T> color;
 };
 
+// Timings of the last generation, in milliseconds (0 for the stages whose inputs did not change)
+struct TerrainStats
+{
+    double heightmapTime = 0.0;
+    double materialTime = 0.0;
+    double simplifyTime = 0.0;
+    double meshTime = 0.0;
+    double occlusionTime = 0.0;
+    int occlusionTiles = 0;
+    size_t triangleCount = 0;
+
+    // Last sculpting dab (brush, mesh rows, normals) and last stroke end (occlusion, materials, shared heights)
+    double sculptTime = 0.0;
+    double strokeTime = 0.0;
+};
+
 template<typename T>
 class Terrain
 {
 public:
     using vertex_type = PlaneVertex<T>;
 
-    Terrain(int size)
-        : m_size(size)
-        , m_shader("plane.vert", "plane.frag")
+    // generate = false only creates the GPU objects, prepareTerrain() and uploadTerrain() then generate in two steps.
+    // The shaders are compiled by the first upload, or earlier by compileShaders() while prepareTerrain() runs.
+    explicit Terrain(const TerrainPreset& preset = {}, bool generate = true)
     {
-        load();
+        m_graph.setPreset(preset);
+        load(generate);
     }
     ~Terrain()
     {
+        glDeleteTextures(1, &m_shadingTexture);
+        glDeleteTextures(1, &m_materialWeightsTexture);
+        glDeleteTextures(1, &m_materialLayersTexture);
+        glDeleteBuffers(1, &m_ebo);
         glDeleteBuffers(1, &m_vbo);
         glDeleteVertexArrays(1, &m_vao);
     }
 
-    void load()
+    void load(bool generate = true)
     {
         // Initialize OpenGL objects
         glGenVertexArrays(1, &m_vao);
@@ -43,95 +83,673 @@ public:
         glGenBuffers(1, &m_vbo);
         glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
 
+        glGenBuffers(1, &m_ebo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+
+        glVertexAttribPointer(0, decltype(vertex_type::position)::ndim, GL_FLOAT, GL_FALSE, sizeof(vertex_type), 0);
+        glEnableVertexAttribArray(0);
+
+        createMaterialTextures();
+        createShadingTexture();
+        if (generate)
+            generateTerrain();
+    }
+
+    // Change the generation parameters: only the stages whose inputs changed are recomputed and uploaded
+    void setPreset(const TerrainPreset& preset)
+    {
+        m_graph.setPreset(preset);
         generateTerrain();
     }
+    const TerrainPreset& getPreset() const { return m_graph.getPreset(); }
 
-    void generateTerrain(int seed = 0, float scale = 1.f)
+    // Identifies the current heights, equal keys mean equal heightmaps
+    uint64_t getHeightsKey() const { return m_graph.heightsKey(); }
+
+    // Heights of the current preset restored without generating them, see GenerationGraph::setHeights
+    bool setHeights(std::vector<float> heights) { return m_graph.setHeights(std::move(heights)); }
+
+    void generateTerrain()
     {
-        float step = 16.0f / (m_size - 1);
-        generateMap(step, seed);
+        prepareTerrain();
+        uploadTerrain();
+    }
 
-        // Generate terrain geometry
-        // Each grid cell is represented by two triangles
-        std::vector<float> vertices;
-        for (int i = 0; i < m_size - 1; ++i) {
-            for (int j = 0; j < m_size - 1; ++j) {
-                // Triangle 1
-                vertices.push_back(-1.0f + j * step);
-                vertices.push_back(m_map[i * m_size + j] * scale);
-                vertices.push_back(-1.0f + i * step);
+    // CPU part of the generation, without any OpenGL call: it can run on another thread as long as the terrain is
+    // not used meanwhile. progress(stage, fraction) is called before each stage that has work to do.
+    void prepareTerrain(const std::function<void(const char*, float)>& progress = {})
+    {
+        auto report = [&](const char* stage, float fraction)
+        {
+            if (progress)
+                progress(stage, fraction);
+        };
 
-                vertices.push_back(-1.0f + (j + 1) * step);
-                vertices.push_back(m_map[i * m_size + j + 1] * scale);
-                vertices.push_back(-1.0f + i * step);
+        const TerrainPreset& preset = m_graph.getPreset();
+        m_graph.resetStats();
 
-                vertices.push_back(-1.0f + (j + 1) * step);
-                vertices.push_back(m_map[(i + 1) * m_size + j + 1] * scale);
-                vertices.push_back(-1.0f + (i + 1) * step);
+        // A generation replaces the sculpted heights
+        m_sculpted = {};
+        m_publishedHeights.reset();
+        m_spareHeights.reset();
+        m_sculptErrors.reset();
+        m_sculpting = false;
+        m_history.reset(0);
 
-                // Triangle 2
-                vertices.push_back(-1.0f + j * step);
-                vertices.push_back(m_map[i * m_size + j]);
-                vertices.push_back(-1.0f + i * step);
+        report("Generating heights", 0.f);
+        m_pending.heights = m_graph.heights();
+        report("Classifying materials", 0.5f);
+        m_pending.materials = m_graph.materials();
 
-                vertices.push_back(-1.0f + (j + 1) * step);
-                vertices.push_back(m_map[(i + 1) * m_size + j + 1] * scale);
-                vertices.push_back(-1.0f + (i + 1) * step);
+        // Simplification errors are evaluated by the mesh, only when the max error needs them
+        InputHash meshKey;
+        meshKey.add(m_graph.heightsKey()).add(preset.maxError).add(preset.heightScale);
+        m_stats.meshTime = 0.0;
+        if (meshKey.value() != m_meshKey)
+        {
+            report("Building the mesh", 0.7f);
+            m_meshKey = meshKey.value();
+            buildMesh(*m_pending.heights);
+        }
 
-                vertices.push_back(-1.0f + j * step);
-                vertices.push_back(m_map[(i + 1) * m_size + j] * scale);
-                vertices.push_back(-1.0f + (i + 1) * step);
-            }
+        // Normals and occlusion, only the tiles around changed heights are baked again
+        InputHash shadingKey;
+        shadingKey.add(m_graph.heightsKey()).add(preset.heightScale).add(preset.step());
+        m_pending.shading = shadingKey.value() != m_shadingKey;
+        if (m_pending.shading)
+        {
+            report("Baking ambient occlusion", 0.8f);
+            m_shadingKey = shadingKey.value();
+            m_pending.shadingTiles = m_occlusion.update(makeHeightfield(m_pending.heights->data(), preset.size));
         }
+        report("Uploading", 1.f);
+    }
 
-        // Bind VBO and buffer terrain data
-        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    void compileShaders()
+    {
+        if (!m_shader)
+            m_shader.emplace("plane.vert", "plane.frag");
+        if (!m_depthShader)
+            m_depthShader.emplace("shadow.vert", "shadow.frag");
+    }
 
-        m_shader.use();
+    // GPU part of the generation, on the thread owning the OpenGL context
+    void uploadTerrain()
+    {
+        compileShaders();
+        const TerrainPreset& preset = m_graph.getPreset();
+        if (preset.size != m_size)
+            resizeMaterialWeights(preset.size);
 
-        glVertexAttribPointer(0, decltype(vertex_type::position)::ndim, GL_FLOAT, GL_FALSE, sizeof(vertex_type), 0);
-        glEnableVertexAttribArray(0);
+        m_map = std::move(m_pending.heights);
+        m_sculptMemory.set(0);
+
+        // Material weights
+        if (m_pending.materials != m_materialWeights)
+        {
+            m_materialWeights = m_pending.materials;
+            uploadMaterialWeights(0, 0, m_size, m_size);
+        }
+        m_pending.materials.reset();
+
+        if (m_pending.mesh)
+        {
+            uploadMesh(*m_pending.mesh);
+            m_pending.mesh.reset();
+        }
+
+        if (m_pending.shading)
+        {
+            uploadShading(m_pending.shadingTiles);
+            m_stats.occlusionTime = m_occlusion.getBakeTime();
+        }
+        else
+        {
+            m_stats.occlusionTime = 0.0;
+            m_stats.occlusionTiles = 0;
+        }
+
+        const GraphStats& graphStats = m_graph.getStats();
+        m_stats.heightmapTime = graphStats.heightsTime;
+        m_stats.materialTime = graphStats.materialsTime;
+        m_stats.simplifyTime = graphStats.errorsTime;
     }
 
-    void renderTerrain(const Mat4<float>& VP)
+    // Maximum vertical error of the rendered mesh in world units, 0 renders every heightmap cell
+    void setMaxError(float maxError)
     {
-        glBindVertexArray(m_vao);
-        glEnableVertexAttribArray(0);
+        TerrainPreset preset = m_graph.getPreset();
+        preset.maxError = maxError;
+        setPreset(preset);
+    }
 
-        // Set up shader program and texture
-        m_shader.use();
-        glBindVertexArray(m_vao);
+    // Adaptive triangulation of the current heightmap, e.g. for far chunks or lightweight exports
+    TerrainMesh buildSimplifiedMesh(float maxError)
+    {
+        if (m_sculptErrors)
+            return m_sculptErrors->buildMesh(m_map->data(), maxError, m_graph.biomeSettings().origin, getStep(), getScale());
+        return buildSimplifiedMesh(*m_map, maxError);
+    }
+
+    // Integer world position of the local frame of the terrain (TerrainPreset::origin): the heights follow
+    // the world noise there, vertices stay in small local coordinates
+    const WorldOrigin& getWorldOrigin() const { return m_graph.getPreset().origin; }
+
+    // Camera-relative placement, to multiply on the right of the camera view-projection
+    Mat4<float> getModelMatrix(const WorldOrigin& cameraOrigin) const
+    {
+        return Mat4<float>::translation(RelativeOffset(cameraOrigin, getWorldOrigin()));
+    }
+
+
+    int getSize() const { return m_size; }
+    float getStep() const { return m_graph.getPreset().step(); }
+    float getScale() const { return m_graph.getPreset().heightScale; }
+    const std::vector<float>& getHeightmap() const { return *m_map; }
+
+    // Keeps the heights of a view alive after the next generation
+    std::shared_ptr<const std::vector<float>> shareHeightmap() const { return m_map; }
+
+    // Valid until the next generation
+    HeightfieldView getHeightfield() const
+    {
+        return makeHeightfield(m_map->data(), m_size);
+    }
+
+    // Reclassify the materials of the samples [x, x + width) x [y, y + height) only, e.g. after a local edit
+    void updateMaterials(int x, int y, int width, int height)
+    {
+        auto weights = std::make_shared<std::vector<uint8_t>>(*m_materialWeights);
+        BiomeClassifier(m_graph.biomeSettings()).classifyRegion(*m_map, m_size, x, y, width, height, *weights);
+        m_materialWeights = weights;
+        uploadMaterialWeights(x, y, width, height);
+    }
+
+    // Rebake the normals and occlusion around the samples [x, x + width) x [y, y + height), e.g. after a local edit
+    void updateShading(int x, int y, int width, int height)
+    {
+        uploadShading(m_occlusion.updateRegion(getHeightfield(), x, y, width, height));
+        m_stats.occlusionTime = m_occlusion.getBakeTime();
+    }
+
+    // Sculpting: the dabs of a stroke edit a copy of the heights, the mesh vertices and normals under each dab are
+    // updated at once. (x, z) in the local frame, the brush in samples. The edits last until the next generation.
+    void sculpt(const Brush& brush, float x, float z)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        if (m_sculpted.empty())
+        {
+            // The next generation rebuilds what the edits changed
+            m_sculpted.assign(m_map->begin(), m_map->end());
+            m_history.reset(m_size);
+            m_meshKey = 0;
+            m_shadingKey = 0;
+        }
+
+        const Point2d<float> origin = m_graph.biomeSettings().origin;
+        const float sampleX = (x - origin.x) / getStep();
+        const float sampleY = (z - origin.y) / getStep();
+        m_history.touch(m_sculpted.data(), Sculpt::Bounds(m_size, brush, sampleX, sampleY));
+        const HeightRect rect = Sculpt::Apply(m_sculpted.data(), m_size, brush, sampleX, sampleY);
+        m_sculpting = true;
+
+        if (!rect.empty())
+        {
+            if (m_gridMesh)
+                uploadMeshRows(rect);
+            uploadShading(m_occlusion.updateNormals(makeHeightfield(m_sculpted.data(), m_size), rect.x, rect.y, rect.width, rect.height));
+        }
+        m_stats.sculptTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // The stroke becomes one undo step, and its heights those of getHeightfield() and shareHeightmap().
+    // Returns the samples it changed, for the views of the heights to update.
+    HeightRect endStroke()
+    {
+        if (!m_sculpting)
+            return {};
+        m_sculpting = false;
+        const HeightRect rect = m_history.endStroke(m_sculpted.data());
+        commitEdit(rect);
+        return rect;
+    }
+    bool isSculpting() const { return m_sculpting; }
+
+    // Whether the heights differ from those of the preset, until the next generation
+    bool isSculpted() const { return !m_sculpted.empty(); }
+
+    // Strokes back and forth, both return the samples they changed
+    bool canUndo() const { return !m_sculpting && m_history.canUndo(); }
+    bool canRedo() const { return !m_sculpting && m_history.canRedo(); }
+    HeightRect undo() { return canUndo() ? replay(m_history.undo(m_sculpted.data())) : HeightRect(); }
+    HeightRect redo() { return canRedo() ? replay(m_history.redo(m_sculpted.data())) : HeightRect(); }
+    const SculptHistory& getSculptHistory() const { return m_history; }
+
+    // Point of the surface under a ray in the local frame, the current stroke included
+    bool raycast(const Point3d<float>& origin, const Point3d<float>& direction, float maxDistance, Point3d<float>& hit) const
+    {
+        const float* heights = m_sculpted.empty() ? m_map->data() : m_sculpted.data();
+        return Sculpt::Raycast(makeHeightfield(heights, m_size), origin, direction, maxDistance, hit);
+    }
+
+    // Direction to the sun in the local frame, and whether the ambient light is occluded
+    void setLighting(const Point3d<float>& sunDirection, bool ambientOcclusion)
+    {
+        m_sunDirection = Math::Normalize(sunDirection);
+        m_ambientOcclusion = ambientOcclusion;
+    }
+
+    const TerrainStats& getStats() const { return m_stats; }
+
+    // Drop the generation outputs of earlier presets, e.g. over a memory budget: going back to one generates it again
+    void trimCaches() { m_graph.trimCaches(); }
+
+    // Materials of the virtual texture: the current weights over the map
+    MaterialPageSource getMaterialPageSource() const
+    {
+        MaterialPageSource source;
+        source.weights = m_materialWeights;
+        source.size = m_size;
+        source.extent = (m_size - 1) * getStep();
+        source.seed = m_graph.getPreset().seed;
+        return source;
+    }
+
+    // Without shadow maps the sun is never occluded, without a virtual texture the material layers are drawn.
+    // The chunks that detail has patches for are drawn by them instead.
+    void renderTerrain(RenderQueue& queue, const Mat4<float>& VP, const ShadowMaps* shadows = nullptr,
+                       const VirtualTextureRenderer* virtualTexture = nullptr, DetailRenderer* detail = nullptr)
+    {
+        RenderCommand command;
+        command.shader = &*m_shader;
+        command.vertexArray = m_vao;
+        command.indexCount = m_indexCount;
+        command.textures[0] = { GL_TEXTURE_2D, m_materialWeightsTexture };
+        command.textures[1] = { GL_TEXTURE_2D_ARRAY, m_materialLayersTexture };
+        command.textures[2] = { GL_TEXTURE_2D, m_shadingTexture };
+        if (shadows)
+            shadows->bind(command, 3);
+        if (virtualTexture)
+            virtualTexture->bind(command, 4);
+        if (detail)
+            detail->bind(command, 6);
+
+        command.uniforms = [this, VP, shadows, virtualTexture, detail](const Shader& shader)
+        {
+            shader.setInt("materialWeights", 0);
+            shader.setInt("materialLayers", 1);
+            shader.setInt("shading", 2);
+
+            // The shadow sampler needs a unit of its own even when unused
+            shader.setInt("shadowMap", 3);
+            if (shadows)
+                shadows->setUniforms(shader, 3);
+            shader.setInt("shadows", shadows ? 1 : 0);
+            shader.setInt("ambientOcclusion", m_ambientOcclusion ? 1 : 0);
 
-        // Set up MVP matrix
-        m_shader.setMat4("MVP", VP);
+            // Same for the page table and atlas
+            shader.setInt("pageTable", 4);
+            shader.setInt("pageAtlas", 5);
+            if (virtualTexture)
+                virtualTexture->setUniforms(shader, 4);
+            shader.setInt("virtualTexture", virtualTexture ? 1 : 0);
+            setVirtualTransform(shader);
+            shader.setVec3("sunDirection", m_sunDirection);
 
-        // Draw terrain
-        glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>((m_size - 1) * (m_size - 1) * 6));
+            // And for the mask of the refined chunks
+            shader.setInt("detailMask", 6);
+            if (detail)
+                detail->setUniforms(shader, 6);
+            shader.setInt("detailPatches", detail && detail->hasPatches() ? 1 : 0);
+
+            // Weights texel centers are mapped on the grid samples
+            const BiomeSettings biome = m_graph.biomeSettings();
+            const float uvScale = 1.f / (m_size * biome.step);
+            shader.setFloat4("weightsTransform", uvScale, -biome.origin.x * uvScale + 0.5f / m_size,
+                                                 uvScale, -biome.origin.y * uvScale + 0.5f / m_size);
+
+            // Shading texel i is on sample i * stride
+            const int shadingSize = std::max(1, m_occlusion.getSize());
+            const float shadingScale = 1.f / (m_occlusion.getStride() * biome.step * shadingSize);
+            shader.setFloat4("shadingTransform", shadingScale, -biome.origin.x * shadingScale + 0.5f / shadingSize,
+                                                 shadingScale, -biome.origin.y * shadingScale + 0.5f / shadingSize);
+
+            shader.setMat4("MVP", VP);
+        };
+        if (detail)
+            detail->render(queue, command);
+        queue.submit(std::move(command));
+    }
+
+    // Pages read by the view, into the feedback of a virtual texture
+    void renderFeedback(RenderQueue& queue, const Mat4<float>& VP, const Shader& feedbackShader)
+    {
+        RenderCommand command;
+        command.shader = &feedbackShader;
+        command.vertexArray = m_vao;
+        command.indexCount = m_indexCount;
+        command.uniforms = [this, VP](const Shader& shader)
+        {
+            shader.setMat4("MVP", VP);
+            setVirtualTransform(shader);
+        };
+        queue.submit(std::move(command));
+    }
+
+    // Depth only, into a shadow map
+    void renderDepth(RenderQueue& queue, const Mat4<float>& lightVP)
+    {
+        RenderCommand command;
+        command.shader = &*m_depthShader;
+        command.vertexArray = m_vao;
+        command.indexCount = m_indexCount;
+        command.uniforms = [lightVP](const Shader& shader) { shader.setMat4("lightVP", lightVP); };
+        queue.submit(std::move(command));
     }
 
 private:
-    Shader m_shader;
-    int m_size;
-    std::vector<float> m_map;
+    static constexpr int MATERIAL_LAYER_SIZE = 64;
+
+    std::optional<Shader> m_shader;
+    std::optional<Shader> m_depthShader;
     GLuint m_vao;
     GLuint m_vbo;
+    GLuint m_ebo;
+    GLsizei m_indexCount = 0;
+
+    // Outputs of the generation graph in use, shared with its caches
+    GenerationGraph m_graph;
+    int m_size = 0;
+    std::shared_ptr<const std::vector<float>> m_map;
+    std::shared_ptr<const std::vector<uint8_t>> m_materialWeights;
+    uint64_t m_meshKey = 0;
+
+
+    GLuint m_materialWeightsTexture = 0;
+    GLuint m_materialLayersTexture = 0;
+
+    // Normals and ambient occlusion, baked on the CPU
+    HorizonAO m_occlusion;
+    uint64_t m_shadingKey = 0;
+    int m_shadingSize = 0;
+    GLuint m_shadingTexture = 0;
+    Point3d<float> m_sunDirection = Math::Normalize(Point3d<float>(0.4f, 1.f, 0.3f));
+    bool m_ambientOcclusion = true;
+
+    TerrainStats m_stats;
+
+    // Heights being sculpted, and the undo steps of their strokes
+    TaggedVector<float, MemoryTag::HEIGHTMAPS> m_sculpted;
+    SculptHistory m_history;
+
+    // Sculpted heights published to the views, the previous buffer and the samples it misses, see publishHeights()
+    std::shared_ptr<std::vector<float>> m_publishedHeights;
+    std::shared_ptr<std::vector<float>> m_spareHeights;
+    HeightRect m_spareStale;
+
+    // Simplification errors of the sculpted heights, updated over each edit
+    std::optional<TerrainSimplifier> m_sculptErrors;
+    bool m_sculpting = false;
+    bool m_gridMesh = false;    // Vertex i is sample i, so edits update the vertices in place
+    MemoryCharge m_sculptMemory{ MemoryTag::HEIGHTMAPS };
+
+    // Allocated sizes of the GL objects
+    MemoryCharge m_meshMemory{ MemoryTag::MESHES, MemoryDomain::GPU };
+    MemoryCharge m_weightsMemory{ MemoryTag::MATERIALS, MemoryDomain::GPU };
+    MemoryCharge m_layersMemory{ MemoryTag::MATERIALS, MemoryDomain::GPU };
+    MemoryCharge m_shadingMemory{ MemoryTag::SHADING, MemoryDomain::GPU };
+
+    // Outputs of prepareTerrain() waiting for uploadTerrain()
+    struct PendingUpload
+    {
+        std::shared_ptr<const std::vector<float>> heights;
+        std::shared_ptr<const std::vector<uint8_t>> materials;
+        std::optional<TerrainMesh> mesh;
+        std::vector<int> shadingTiles;
+        bool shading = false;
+    };
+    PendingUpload m_pending;
+
+    HeightfieldView makeHeightfield(const float* heights, int size) const
+    {
+        HeightfieldView view;
+        view.heights = heights;
+        view.size = size;
+        view.origin = m_graph.biomeSettings().origin;
+        view.step = getStep();
+        view.heightScale = getScale();
+        return view;
+    }
+
+    // The samples of the map span [0, 1] of the virtual texture
+    void setVirtualTransform(const Shader& shader) const
+    {
+        const BiomeSettings biome = m_graph.biomeSettings();
+        const float scale = 1.f / (std::max(1, m_size - 1) * biome.step);
+        shader.setFloat4("virtualTransform", scale, -biome.origin.x * scale, scale, -biome.origin.y * scale);
+    }
+
+    TerrainMesh buildSimplifiedMesh(const std::vector<float>& heights, float maxError)
+    {
+        return m_graph.simplifier()->buildMesh(heights.data(), maxError, m_graph.biomeSettings().origin, getStep(), getScale());
+    }
+
+    void createMaterialTextures()
+    {
+        glGenTextures(1, &m_materialWeightsTexture);
+        glBindTexture(GL_TEXTURE_2D, m_materialWeightsTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        // One procedural detail layer per material, until real textures are authored
+        constexpr int layerCount = static_cast<int>(Material::COUNT);
+        constexpr int texels = MATERIAL_LAYER_SIZE * MATERIAL_LAYER_SIZE;
+
+        std::vector<uint8_t> layers(texels * 4 * layerCount);
+        for (int layer = 0; layer < layerCount; ++layer)
+        {
+            const Color3<float> color = MaterialColor(static_cast<Material>(layer));
+            for (int i = 0; i < texels; ++i)
+            {
+                const float x = (i % MATERIAL_LAYER_SIZE) * 0.25f;
+                const float y = (i / MATERIAL_LAYER_SIZE) * 0.25f;
+                const float grain = 0.8f + 0.5f * perlin(x, y, layer);
+
+                uint8_t* texel = &layers[(layer * texels + i) * 4];
+                texel[0] = static_cast<uint8_t>(std::min(1.f, color.r * grain) * 255.f);
+                texel[1] = static_cast<uint8_t>(std::min(1.f, color.g * grain) * 255.f);
+                texel[2] = static_cast<uint8_t>(std::min(1.f, color.b * grain) * 255.f);
+                texel[3] = 255;
+            }
+        }
+
+        glGenTextures(1, &m_materialLayersTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_materialLayersTexture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, MATERIAL_LAYER_SIZE, MATERIAL_LAYER_SIZE, layerCount, 0, GL_RGBA, GL_UNSIGNED_BYTE, layers.data());
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        m_layersMemory.set(layers.size() * 4 / 3);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    }
+
+    void createShadingTexture()
+    {
+        glGenTextures(1, &m_shadingTexture);
+        glBindTexture(GL_TEXTURE_2D, m_shadingTexture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
 
-    void generateMap(const float& step, int seed)
+    // Upload the baked tiles only, the whole texture when its size changed
+    void uploadShading(const std::vector<int>& dirtyTiles)
     {
-        // Generate terrain heights
-        m_map.resize(m_size * m_size);
-        float x, z;
+        m_stats.occlusionTiles = static_cast<int>(dirtyTiles.size());
+        const int size = m_occlusion.getSize();
+        const auto& texels = m_occlusion.getTexels();
+        glBindTexture(GL_TEXTURE_2D, m_shadingTexture);
+        if (size != m_shadingSize)
+        {
+            m_shadingSize = size;
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+            RenderStats::Upload(texels.size());
+            m_shadingMemory.set(texels.size());
+            return;
+        }
+
+        constexpr int tileSize = HorizonAO::TILE_SIZE;
+        const int tiles = m_occlusion.getTilesPerSide();
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, size);
+        for (int tile : dirtyTiles)
+        {
+            const int x = (tile % tiles) * tileSize;
+            const int y = (tile / tiles) * tileSize;
+            const int width = std::min(tileSize, size - x);
+            const int height = std::min(tileSize, size - y);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &texels[(static_cast<size_t>(y) * size + x) * 4]);
+            RenderStats::Upload(static_cast<size_t>(width) * height * 4);
+        }
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    }
 
-        for (int i = 0; i < m_size; ++i) {
-            for (int j = 0; j < m_size; ++j) {
-                x = -1.0f + j * step;
-                z = -1.0f + i * step;
+    // The weights texture follows the heightmap size of the preset
+    void resizeMaterialWeights(int size)
+    {
+        m_size = size;
+        m_materialWeights.reset();
+        glBindTexture(GL_TEXTURE_2D, m_materialWeightsTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_size, m_size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        m_weightsMemory.set(static_cast<size_t>(m_size) * m_size * 4);
+    }
+
+    void buildMesh(const std::vector<float>& heights)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const float maxError = m_graph.getPreset().maxError;
+
+        // Every heightmap cell, or the adaptive triangulation for the max error
+        m_gridMesh = maxError <= 0.f;
+        m_pending.mesh = maxError > 0.f ? buildSimplifiedMesh(heights, maxError)
+                                        : GridMesh::Build(makeHeightfield(heights.data(), m_graph.getPreset().size));
+        m_stats.meshTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
 
-                // Define a simple height function (e.g., sine wave)
-                m_map[i * m_size + j] = perlin(x, z, seed);
+    void uploadMesh(const TerrainMesh& mesh)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        // Bind VBO and buffer terrain data
+        glBindVertexArray(m_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glBufferData(GL_ARRAY_BUFFER, mesh.positions.size() * sizeof(float), mesh.positions.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(uint32_t), mesh.indices.data(), GL_STATIC_DRAW);
+        RenderStats::Upload(mesh.positions.size() * sizeof(float) + mesh.indices.size() * sizeof(uint32_t));
+        m_meshMemory.set(mesh.positions.size() * sizeof(float) + mesh.indices.size() * sizeof(uint32_t));
+
+        m_indexCount = static_cast<GLsizei>(mesh.indices.size());
+        m_stats.triangleCount = mesh.triangleCount();
+        m_stats.meshTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Vertices of the edited samples of the grid mesh, one buffer range per row
+    void uploadMeshRows(const HeightRect& rect)
+    {
+        const HeightfieldView heightfield = makeHeightfield(m_sculpted.data(), m_size);
+        std::vector<float> row(static_cast<size_t>(rect.width) * 3);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        for (int y = rect.y; y < rect.y + rect.height; ++y)
+        {
+            GridMesh::WriteRow(heightfield, rect.x, y, rect.width, row.data());
+            glBufferSubData(GL_ARRAY_BUFFER, (static_cast<size_t>(y) * m_size + rect.x) * 3 * sizeof(float), row.size() * sizeof(float), row.data());
+        }
+        RenderStats::Upload(row.size() * sizeof(float) * rect.height);
+    }
+
+    // Undo or redo: the vertices and normals as for a dab, then the rest as for the end of a stroke
+    HeightRect replay(const HeightRect& rect)
+    {
+        if (!rect.empty())
+        {
+            if (m_gridMesh)
+                uploadMeshRows(rect);
+            uploadShading(m_occlusion.updateNormals(makeHeightfield(m_sculpted.data(), m_size), rect.x, rect.y, rect.width, rect.height));
+        }
+        commitEdit(rect);
+        return rect;
+    }
+
+    // Occlusion, materials and the adaptive mesh follow the edited samples
+    void commitEdit(const HeightRect& rect)
+    {
+        if (rect.empty())
+            return;
+
+        const auto start = std::chrono::steady_clock::now();
+        publishHeights(rect);
+
+        // Slopes read one sample around
+        updateShading(rect.x, rect.y, rect.width, rect.height);
+        updateMaterials(rect.x - 1, rect.y - 1, rect.width + 2, rect.height + 2);
+        if (!m_gridMesh)
+        {
+            // Errors of the triangles over the edit and of their ancestors only, the mesh is extracted from all of them
+            if (!m_sculptErrors)
+                m_sculptErrors = *m_graph.simplifier();
+            m_sculptErrors->updateErrors(m_sculpted.data(), rect.x, rect.y, rect.width, rect.height);
+            uploadMesh(m_sculptErrors->buildMesh(m_sculpted.data(), m_graph.getPreset().maxError, m_graph.biomeSettings().origin, getStep(), getScale()));
+        }
+        m_stats.strokeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // The views of the heights get their own buffer: the renderers read it from background jobs while the next
+    // stroke edits the sculpted heights. The buffer published before is reused once no view holds it anymore, only
+    // the samples of the last two edits are copied into it.
+    void publishHeights(const HeightRect& rect)
+    {
+        std::shared_ptr<std::vector<float>> heights;
+        if (m_spareHeights && m_spareHeights.use_count() == 1)
+        {
+            heights = std::move(m_spareHeights);
+            const HeightRect stale = m_spareStale.merged(rect);
+            for (int y = stale.y; y < stale.y + stale.height; ++y)
+            {
+                const size_t row = static_cast<size_t>(y) * m_size + stale.x;
+                std::copy_n(m_sculpted.begin() + row, stale.width, heights->begin() + row);
             }
         }
+        else
+        {
+            heights = std::make_shared<std::vector<float>>(m_sculpted.begin(), m_sculpted.end());
+        }
+
+        // The buffer published until now misses this edit
+        m_spareHeights = std::move(m_publishedHeights);
+        m_spareStale = rect;
+        m_publishedHeights = heights;
+        m_map = std::move(heights);
+        m_sculptMemory.set(MemoryBytes(*m_map) * (m_spareHeights ? 2 : 1));
+    }
+
+    void uploadMaterialWeights(int x, int y, int width, int height)
+    {
+        x = std::max(0, x);
+        y = std::max(0, y);
+        width = std::min(width, m_size - x);
+        height = std::min(height, m_size - y);
+        if (width <= 0 || height <= 0)
+            return;
+
+        glBindTexture(GL_TEXTURE_2D, m_materialWeightsTexture);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, m_size);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &(*m_materialWeights)[(y * m_size + x) * 4]);
+        RenderStats::Upload(static_cast<size_t>(width) * height * 4);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
     }
 };
 
@@ -1,5 +1,7 @@
 #include "Camera.h"
 
+#include <cmath>
+
 Camera::Camera(const Point3d<float>& position, const Point3d<float>& up, float yaw, float pitch) :
 	m_front({0.f, 0.f, -1.f}),
 	m_movementSpeed(SPEED),
@@ -33,7 +35,7 @@ Mat4<float> Camera::GetViewMatrix() const
 }
 Mat4<float> Camera::GetProjectionMatrix(int windowWidth, int windowHeight) const
 {
-	return  Mat4<float>::projection(Math::Radians(m_fov), (float)windowWidth / (float)windowHeight, 0.1f, 100.0f);
+	return  Mat4<float>::projection(Math::Radians(m_fov), (float)windowWidth / (float)windowHeight, NEAR_PLANE, FAR_PLANE);
 }
 
 void Camera::ProcessKeyboardInputs(CameraMovement direction)
@@ -100,6 +102,72 @@ void Camera::SetDeltaTime(float deltaTime)
 	m_deltaTime = deltaTime;
 }
 
+void Camera::SetPose(const Point3d<float>& position, float yaw, float pitch)
+{
+	m_position = position;
+	m_yaw = yaw;
+	m_pitch = pitch;
+
+	UpdateCameraVectors();
+}
+
+const Point3d<float>& Camera::GetPosition() const
+{
+	return m_position;
+}
+
+float Camera::GetYaw() const
+{
+	return m_yaw;
+}
+
+float Camera::GetPitch() const
+{
+	return m_pitch;
+}
+
+float Camera::GetFov() const
+{
+	return m_fov;
+}
+
+const WorldOrigin& Camera::GetOrigin() const
+{
+	return m_origin;
+}
+
+void Camera::SetOrigin(const WorldOrigin& origin)
+{
+	m_origin = origin;
+}
+
+Point3d<double> Camera::GetWorldPosition() const
+{
+	return Point3d<double>(m_origin.x + static_cast<double>(m_position.x),
+	                       m_origin.y + static_cast<double>(m_position.y),
+	                       m_origin.z + static_cast<double>(m_position.z));
+}
+
+bool Camera::RebaseOrigin(float threshold)
+{
+	bool moved = false;
+	auto rebase = [&](float& position, int64_t& origin)
+	{
+		if (std::abs(position) <= threshold)
+			return;
+
+		const float shift = std::floor(position);
+		origin += static_cast<int64_t>(shift);
+		position -= shift;
+		moved = true;
+	};
+
+	rebase(m_position.x, m_origin.x);
+	rebase(m_position.y, m_origin.y);
+	rebase(m_position.z, m_origin.z);
+	return moved;
+}
+
 void Camera::UpdateCameraVectors()
 {
 	// Calculate the new front vector
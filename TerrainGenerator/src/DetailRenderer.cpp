@@ -0,0 +1,336 @@
+#include "DetailRenderer.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#include "RenderCounters.h"
+
+DetailRenderer::DetailRenderer(const DetailSettings& settings)
+    : m_levels(settings)
+{
+    glGenTextures(1, &m_maskTexture);
+    glBindTexture(GL_TEXTURE_2D, m_maskTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+DetailRenderer::~DetailRenderer()
+{
+    releasePatches();
+    glDeleteTextures(1, &m_maskTexture);
+}
+
+void DetailRenderer::setTerrain(const HeightfieldView& heightfield, std::shared_ptr<const void> owner)
+{
+    releasePatches();
+    m_levels.setHeightfield(heightfield);
+    m_heightsOwner = std::move(owner);
+}
+
+void DetailRenderer::updateRegion(const HeightfieldView& heightfield, std::shared_ptr<const void> owner, int x, int y, int width, int height)
+{
+    if (heightfield.size != m_levels.getHeightfield().size)
+    {
+        setTerrain(heightfield, std::move(owner));
+        return;
+    }
+
+    // Patches being built read the previous heights
+    waitForJobs();
+    m_levels.updateRegion(heightfield, x, y, width, height);
+    m_heightsOwner = std::move(owner);
+
+    // Chunks sharing a sample with the region
+    const int chunkCells = m_levels.getSettings().chunkCells;
+    const int chunks = m_levels.getChunksPerSide();
+    if (chunks == 0)
+        return;
+    const int cx0 = std::clamp((x - 1) / chunkCells, 0, chunks - 1);
+    const int cy0 = std::clamp((y - 1) / chunkCells, 0, chunks - 1);
+    const int cx1 = std::clamp((x + width - 1) / chunkCells, 0, chunks - 1);
+    const int cy1 = std::clamp((y + height - 1) / chunkCells, 0, chunks - 1);
+    for (auto patch = m_patches.begin(); patch != m_patches.end();)
+    {
+        const int cx = patch->second.chunk % chunks;
+        const int cy = patch->second.chunk / chunks;
+        if (cx >= cx0 && cx <= cx1 && cy >= cy0 && cy <= cy1)
+        {
+            m_drawn.erase(std::remove(m_drawn.begin(), m_drawn.end(), patch->first), m_drawn.end());
+            patch = erasePatch(patch);
+        }
+        else
+        {
+            ++patch;
+        }
+    }
+    m_stats.residentPatches = static_cast<int>(m_patches.size());
+    m_stats.pendingPatches = 0;
+    m_memory.set(m_stats.residentBytes + m_mask.size());
+}
+
+void DetailRenderer::setSettings(const DetailSettings& settings)
+{
+    // Every patch depends on the settings
+    releasePatches();
+    m_levels.setSettings(settings);
+}
+
+void DetailRenderer::setMemoryBudget(size_t bytes)
+{
+    // The patches do not depend on the budget, the resident ones stay
+    DetailSettings settings = m_levels.getSettings();
+    if (settings.maxBytes == bytes)
+        return;
+    settings.maxBytes = bytes;
+    m_levels.setSettings(settings);
+}
+
+void DetailRenderer::update(const Point3d<float>& camera, float pixelScale)
+{
+    uploadFinished();
+    m_levels.update(camera, pixelScale);
+
+    const std::vector<DetailPatch>& selected = m_levels.getPatches();
+    if (m_synchronous)
+    {
+        JobSystem& jobs = JobSystem::Instance();
+        for (const DetailPatch& patch : selected)
+            requestPatch(patch);
+        for (const auto& pending : m_pending)
+            jobs.wait(pending->fence);
+        uploadFinished();
+    }
+
+    const int chunksPerSide = m_levels.getChunksPerSide();
+    m_drawn.clear();
+    std::vector<uint8_t> mask(static_cast<size_t>(chunksPerSide) * chunksPerSide, 0);
+
+    for (const DetailPatch& patch : selected)
+    {
+        const int chunk = patch.chunkY * chunksPerSide + patch.chunkX;
+        const uint64_t key = patch.key();
+
+        // The current patch, or the last one of the chunk until it arrives
+        auto resident = m_patches.find(key);
+        if (resident == m_patches.end())
+        {
+            requestPatch(patch);
+            const auto latest = m_latest.find(chunk);
+            if (latest != m_latest.end())
+                resident = m_patches.find(latest->second);
+        }
+        if (resident == m_patches.end())
+            continue;
+
+        m_lru.splice(m_lru.end(), m_lru, resident->second.lru);
+        m_drawn.push_back(resident->first);
+        mask[chunk] = 255;
+    }
+
+    if (mask != m_mask || chunksPerSide != m_maskSize)
+    {
+        m_mask = std::move(mask);
+        uploadMask();
+    }
+
+    m_stats.selectedPatches = static_cast<int>(selected.size());
+    m_stats.pendingPatches = static_cast<int>(m_pending.size());
+    m_memory.set(m_stats.residentBytes + m_mask.size());
+}
+
+void DetailRenderer::bind(RenderCommand& command, int unit) const
+{
+    command.textures[unit] = { GL_TEXTURE_2D, m_maskTexture };
+}
+
+void DetailRenderer::setUniforms(const Shader& shader, int unit) const
+{
+    // Mask texel i covers the cells [i * chunkCells, (i + 1) * chunkCells) of the map
+    const HeightfieldView& heightfield = m_levels.getHeightfield();
+    const float cells = static_cast<float>(std::max(1, heightfield.size - 1));
+    shader.setInt("detailMask", unit);
+    shader.setFloat("detailMaskScale", cells / std::max(1, m_levels.getSettings().chunkCells * m_maskSize));
+}
+
+void DetailRenderer::render(RenderQueue& queue, const RenderCommand& terrainCommand)
+{
+    m_stats.drawnPatches = 0;
+    m_stats.drawnTriangles = 0;
+
+    // The uniforms of the terrain, without the mask: the patches are what it masks
+    auto uniforms = [terrainUniforms = terrainCommand.uniforms](const Shader& shader)
+    {
+        terrainUniforms(shader);
+        shader.setInt("detailPatches", 0);
+    };
+    ++m_uniformsKey;
+
+    for (uint64_t key : m_drawn)
+    {
+        const Patch& patch = m_patches.at(key);
+        RenderCommand command = terrainCommand;
+        command.vertexArray = patch.vao;
+        command.indexCount = patch.indexCount;
+        command.uniforms = uniforms;
+        command.uniformsKey = m_uniformsKey;
+        queue.submit(std::move(command));
+
+        ++m_stats.drawnPatches;
+        m_stats.drawnTriangles += patch.indexCount / 3;
+    }
+}
+
+void DetailRenderer::requestPatch(const DetailPatch& patch)
+{
+    const uint64_t key = patch.key();
+    if (m_patches.count(key) > 0 || std::any_of(m_pending.begin(), m_pending.end(), [&](const auto& p) { return p->key == key; }))
+        return;
+
+    auto request = std::make_unique<PendingPatch>();
+    request->patch = patch;
+    request->key = key;
+    request->start = std::chrono::steady_clock::now();
+
+    PendingPatch* job = request.get();
+    const HeightfieldView heightfield = m_levels.getHeightfield();
+    const DetailSettings settings = m_levels.getSettings();
+    JobSystem::Instance().run([job, heightfield, settings]()
+    {
+        job->mesh = TerrainDetail::BuildPatch(heightfield, settings, job->patch);
+    }, &request->fence, nullptr, "Detail patch");
+    m_pending.push_back(std::move(request));
+}
+
+void DetailRenderer::waitForJobs()
+{
+    JobSystem& jobs = JobSystem::Instance();
+    for (const auto& pending : m_pending)
+        jobs.wait(pending->fence);
+    m_pending.clear();
+}
+
+void DetailRenderer::releasePatches()
+{
+    waitForJobs();
+    for (auto& [key, patch] : m_patches)
+    {
+        glDeleteBuffers(1, &patch.ebo);
+        glDeleteBuffers(1, &patch.vbo);
+        glDeleteVertexArrays(1, &patch.vao);
+    }
+    m_patches.clear();
+    m_lru.clear();
+    m_latest.clear();
+    m_drawn.clear();
+    m_stats = DetailStats();
+    m_memory.set(m_mask.size());
+}
+
+void DetailRenderer::uploadFinished()
+{
+    // The cache keeps the selected patches and as many recently drawn ones, within the budget
+    const size_t capacity = 2 * static_cast<size_t>(std::max(1, m_levels.getSettings().maxPatches));
+    const int chunksPerSide = m_levels.getChunksPerSide();
+
+    int uploaded = 0;
+    for (size_t i = 0; i < m_pending.size();)
+    {
+        PendingPatch& pending = *m_pending[i];
+        if (!pending.fence.done())
+        {
+            ++i;
+            continue;
+        }
+
+        const DetailMesh& mesh = pending.mesh;
+        if (!mesh.indices.empty())
+        {
+            Patch patch;
+            patch.indexCount = static_cast<GLsizei>(mesh.indices.size());
+            patch.bytes = mesh.vertices.size() * sizeof(float) + mesh.indices.size() * sizeof(uint32_t);
+            evict(capacity - 1, patch.bytes);
+            patch.chunk = pending.patch.chunkY * chunksPerSide + pending.patch.chunkX;
+
+            glGenVertexArrays(1, &patch.vao);
+            glBindVertexArray(patch.vao);
+
+            glGenBuffers(1, &patch.vbo);
+            glBindBuffer(GL_ARRAY_BUFFER, patch.vbo);
+            glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(float), mesh.vertices.data(), GL_STATIC_DRAW);
+
+            glGenBuffers(1, &patch.ebo);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, patch.ebo);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(uint32_t), mesh.indices.data(), GL_STATIC_DRAW);
+            RenderStats::Upload(patch.bytes);
+
+            // Position, then the detail slope the terrain shader tilts its normal by
+            constexpr GLsizei stride = DetailMesh::VERTEX_FLOATS * sizeof(float);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, 0);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+            glEnableVertexAttribArray(1);
+            glBindVertexArray(0);
+
+            patch.lru = m_lru.insert(m_lru.end(), pending.key);
+            m_stats.residentBytes += patch.bytes;
+            m_latest[patch.chunk] = pending.key;
+            m_patches.emplace(pending.key, patch);
+
+            ++uploaded;
+            m_stats.generationTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pending.start).count();
+        }
+        m_pending.erase(m_pending.begin() + i);
+    }
+
+    if (uploaded > 0)
+        m_stats.generatedPatches = uploaded;
+    m_stats.residentPatches = static_cast<int>(m_patches.size());
+}
+
+void DetailRenderer::uploadMask()
+{
+    const int size = m_levels.getChunksPerSide();
+    if (size == 0)
+        return;
+
+    glBindTexture(GL_TEXTURE_2D, m_maskTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (size != m_maskSize)
+    {
+        m_maskSize = size;
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, size, size, 0, GL_RED, GL_UNSIGNED_BYTE, m_mask.data());
+    }
+    else
+    {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RED, GL_UNSIGNED_BYTE, m_mask.data());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    RenderStats::Upload(m_mask.size());
+}
+
+void DetailRenderer::evict(size_t capacity, size_t incomingBytes)
+{
+    // Least recently drawn first. The selection is coarsened to fit the budget, the patches it needs stay resident.
+    const size_t maxBytes = m_levels.getSettings().maxBytes;
+    while (!m_lru.empty() && (m_patches.size() > capacity || (maxBytes > 0 && m_stats.residentBytes + incomingBytes > maxBytes)))
+    {
+        erasePatch(m_patches.find(m_lru.front()));
+    }
+}
+
+std::unordered_map<uint64_t, DetailRenderer::Patch>::iterator DetailRenderer::erasePatch(std::unordered_map<uint64_t, Patch>::iterator found)
+{
+    Patch& patch = found->second;
+    glDeleteBuffers(1, &patch.ebo);
+    glDeleteBuffers(1, &patch.vbo);
+    glDeleteVertexArrays(1, &patch.vao);
+    m_stats.residentBytes -= patch.bytes;
+    m_lru.erase(patch.lru);
+
+    const auto latest = m_latest.find(patch.chunk);
+    if (latest != m_latest.end() && latest->second == found->first)
+        m_latest.erase(latest);
+    return m_patches.erase(found);
+}
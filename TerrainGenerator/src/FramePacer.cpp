@@ -0,0 +1,73 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+namespace
+{
+    // sleep_until overshoots by up to a scheduler tick, the end of the wait spins
+    constexpr std::chrono::microseconds SPIN_TIME(1500);
+}
+
+FramePacer::FramePacer(int historySize)
+{
+    m_frameTimes.reserve(std::max(1, historySize));
+    m_latencies.reserve(std::max(1, historySize));
+}
+
+void FramePacer::waitForSwap()
+{
+    if (m_pacing.frameCap <= 0)
+        return;
+
+    const auto deadline = m_lastSwap + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_pacing.frameCap));
+    if (deadline - Clock::now() > SPIN_TIME)
+        std::this_thread::sleep_until(deadline - SPIN_TIME);
+    while (Clock::now() < deadline)
+        std::this_thread::yield();
+}
+
+void FramePacer::endFrame(Clock::time_point inputTime)
+{
+    const auto now = Clock::now();
+    const double frameTime = std::chrono::duration<double, std::milli>(now - m_lastSwap).count();
+    m_lastSwap = now;
+
+    // The swapped image shows at the next refresh: a full interval later with vsync, half on average without
+    const double refresh = 1000.0 / std::max(1, m_refreshRate);
+    const double latency = std::chrono::duration<double, std::milli>(now - inputTime).count() + (m_pacing.vsync ? refresh : refresh * 0.5);
+
+    if (m_frameTimes.size() < m_frameTimes.capacity())
+    {
+        m_frameTimes.push_back(frameTime);
+        m_latencies.push_back(latency);
+    }
+    else
+    {
+        m_frameTimes[m_next] = frameTime;
+        m_latencies[m_next] = latency;
+        m_next = (m_next + 1) % m_frameTimes.size();
+    }
+
+    double sum = 0.0;
+    double maxTime = 0.0;
+    double latencySum = 0.0;
+    for (size_t i = 0; i < m_frameTimes.size(); ++i)
+    {
+        sum += m_frameTimes[i];
+        maxTime = std::max(maxTime, m_frameTimes[i]);
+        latencySum += m_latencies[i];
+    }
+    const double mean = sum / m_frameTimes.size();
+
+    double variance = 0.0;
+    for (double time : m_frameTimes)
+        variance += (time - mean) * (time - mean);
+
+    m_stats.frameTime = frameTime;
+    m_stats.meanFrameTime = mean;
+    m_stats.frameTimeDeviation = std::sqrt(variance / m_frameTimes.size());
+    m_stats.maxFrameTime = maxTime;
+    m_stats.inputLatency = latencySum / m_latencies.size();
+}
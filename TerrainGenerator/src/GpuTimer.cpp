@@ -0,0 +1,58 @@
+#include "GpuTimer.h"
+
+GpuTimer::GpuTimer()
+{
+    for (Query& query : m_queries)
+        glGenQueries(1, &query.id);
+}
+
+GpuTimer::~GpuTimer()
+{
+    for (Query& query : m_queries)
+        glDeleteQueries(1, &query.id);
+}
+
+void GpuTimer::begin(int frame)
+{
+    // Every query in flight: wait for the oldest one
+    Query& query = m_queries[m_next];
+    if (query.frame >= 0)
+        read(query);
+
+    query.frame = frame;
+    glBeginQuery(GL_TIME_ELAPSED, query.id);
+}
+
+void GpuTimer::end()
+{
+    glEndQuery(GL_TIME_ELAPSED);
+    m_next = (m_next + 1) % QUERY_COUNT;
+}
+
+void GpuTimer::collect(std::vector<std::pair<int, double>>& results, bool wait)
+{
+    // In submission order, a query is not finished before the ones started earlier
+    for (int i = 0; i < QUERY_COUNT; ++i)
+    {
+        Query& query = m_queries[(m_next + i) % QUERY_COUNT];
+        if (query.frame < 0)
+            continue;
+
+        GLint available = GL_FALSE;
+        glGetQueryObjectiv(query.id, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available && !wait)
+            break;
+        read(query);
+    }
+
+    results.insert(results.end(), m_results.begin(), m_results.end());
+    m_results.clear();
+}
+
+void GpuTimer::read(Query& query)
+{
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(query.id, GL_QUERY_RESULT, &nanoseconds);
+    m_results.emplace_back(query.frame, nanoseconds * 1e-6);
+    query.frame = -1;
+}
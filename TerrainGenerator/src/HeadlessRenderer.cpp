@@ -0,0 +1,290 @@
+#include "HeadlessRenderer.h"
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "Camera.h"
+#include "ImageWriter.h"
+#include "plane.h"
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    double SecondsSince(const Clock::time_point& start)
+    {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    // Offscreen color + depth target
+    struct Framebuffer
+    {
+        GLuint fbo = 0;
+        GLuint color = 0;
+        GLuint depth = 0;
+
+        bool create(int width, int height)
+        {
+            glGenFramebuffers(1, &fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+            glGenRenderbuffers(1, &color);
+            glBindRenderbuffer(GL_RENDERBUFFER, color);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+
+            glGenRenderbuffers(1, &depth);
+            glBindRenderbuffer(GL_RENDERBUFFER, depth);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+            return glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        }
+
+        ~Framebuffer()
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            glDeleteRenderbuffers(1, &depth);
+            glDeleteRenderbuffers(1, &color);
+            glDeleteFramebuffers(1, &fbo);
+        }
+    };
+
+    void PrintUsage()
+    {
+        std::cout << "Usage: TerrainGenerator --headless [options]\n"
+                  << "  --size WxH          Preview resolution (default 512x512)\n"
+                  << "  --seeds N           Number of seeds to render (default 1)\n"
+                  << "  --first-seed S      First seed (default 0)\n"
+                  << "  --terrain-size N    Samples per terrain side (default 100)\n"
+                  << "  --scale F           Height scale (default 1)\n"
+                  << "  --preset FILE       Generation parameters, overridden by the options above\n"
+                  << "  --poses FILE        Camera script, one \"x y z yaw pitch\" per line\n"
+                  << "  --out DIR           Output directory (default previews)\n"
+                  << "  --fill              Filled polygons instead of wireframe\n"
+                  << "  --osmesa            Software context through OSMesa\n";
+    }
+}
+
+namespace Headless
+{
+    bool ParseArguments(int argc, char** argv, HeadlessSettings& settings)
+    {
+        bool headless = false;
+        for (int i = 1; i < argc; ++i)
+        {
+            const std::string arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+
+            if (arg == "--headless")
+                headless = true;
+            else if (arg == "--size" && hasValue)
+                std::sscanf(argv[++i], "%dx%d", &settings.width, &settings.height);
+            else if (arg == "--seeds" && hasValue)
+                settings.seedCount = std::atoi(argv[++i]);
+            else if (arg == "--first-seed" && hasValue)
+                settings.firstSeed = std::atoi(argv[++i]);
+            else if (arg == "--terrain-size" && hasValue)
+                settings.preset.size = std::atoi(argv[++i]);
+            else if (arg == "--scale" && hasValue)
+                settings.preset.heightScale = static_cast<float>(std::atof(argv[++i]));
+            else if (arg == "--poses" && hasValue)
+                settings.posesPath = argv[++i];
+            else if (arg == "--out" && hasValue)
+                settings.outputDirectory = argv[++i];
+            else if (arg == "--fill")
+                settings.wireframe = false;
+            else if (arg == "--osmesa")
+                settings.useOSMesa = true;
+            else if (arg == "--help")
+            {
+                PrintUsage();
+                std::exit(0);
+            }
+        }
+
+        return headless;
+    }
+
+    std::vector<CameraPose> LoadPoses(const std::string& filePath)
+    {
+        std::ifstream file(filePath);
+        if (!file.is_open())
+            throw std::runtime_error("Impossible to read camera poses.");
+
+        std::vector<CameraPose> poses;
+        std::string line;
+        while (std::getline(file, line))
+        {
+            const size_t comment = line.find('#');
+            if (comment != std::string::npos)
+                line.resize(comment);
+
+            std::istringstream stream(line);
+            CameraPose pose;
+            if (stream >> pose.position.x >> pose.position.y >> pose.position.z >> pose.yaw >> pose.pitch)
+                poses.push_back(pose);
+        }
+
+        return poses;
+    }
+
+    int Run(const HeadlessSettings& settings)
+    {
+        if (settings.width <= 0 || settings.height <= 0 || settings.seedCount <= 0 || settings.preset.size < 2)
+        {
+            std::cerr << "Invalid headless settings." << std::endl;
+            return -1;
+        }
+
+        std::vector<CameraPose> poses;
+        if (!settings.posesPath.empty())
+            poses = LoadPoses(settings.posesPath);
+        if (poses.empty())
+            poses.push_back({ { 7.f, -7.5f, 25.f }, -90.f, 25.f }); // Same as the viewer start
+
+        if (!glfwInit())
+        {
+            std::cerr << "GLFW Initialisation failed." << std::endl;
+            return -1;
+        }
+
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GLFW_TRUE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef GLFW_OSMESA_CONTEXT_API
+        if (settings.useOSMesa)
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+#endif
+
+        // The window is never shown, everything is drawn into the framebuffer below
+        GLFWwindow* window = glfwCreateWindow(1, 1, "Headless", nullptr, nullptr);
+        if (window == nullptr)
+        {
+            std::cerr << "GLFW Window creation failed." << std::endl;
+            glfwTerminate();
+            return -2;
+        }
+
+        glfwMakeContextCurrent(window);
+        glfwSwapInterval(0);
+
+        glewExperimental = GLFW_TRUE;
+        if (glewInit() != GLEW_OK)
+        {
+            std::cerr << "Glew Initialisation failed." << std::endl;
+            glfwDestroyWindow(window);
+            glfwTerminate();
+            return -3;
+        }
+
+        std::filesystem::create_directories(settings.outputDirectory);
+
+        int exitCode = 0;
+        {
+            Framebuffer framebuffer;
+            if (!framebuffer.create(settings.width, settings.height))
+            {
+                std::cerr << "Offscreen framebuffer is incomplete." << std::endl;
+                exitCode = -4;
+            }
+            else
+            {
+                glViewport(0, 0, settings.width, settings.height);
+                glClearColor(0.2f, 0.2f, 0.2f, 1.0f);
+                glEnable(GL_DEPTH_TEST);
+                glEnable(GL_BLEND);
+                glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+                glPolygonMode(GL_FRONT_AND_BACK, settings.wireframe ? GL_LINE : GL_FILL);
+                glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+                TerrainPreset preset = settings.preset;
+                preset.seed = settings.firstSeed;
+                Terrain<float> terrain(preset);
+                Camera camera;
+                RenderQueue renderQueue;
+                GLStateCache glState;
+
+                // PNG encoding runs on worker threads while the GPU renders the next frame
+                const size_t maxPendingWrites = std::max(1u, std::thread::hardware_concurrency());
+                std::deque<std::future<bool>> pendingWrites;
+
+                double generationTime = 0.0, renderTime = 0.0;
+                const auto start = Clock::now();
+
+                for (int s = 0; s < settings.seedCount && exitCode == 0; ++s)
+                {
+                    const int seed = settings.firstSeed + s;
+
+                    auto stepStart = Clock::now();
+                    preset.seed = seed;
+                    terrain.setPreset(preset);
+                    generationTime += SecondsSince(stepStart);
+
+                    for (size_t p = 0; p < poses.size(); ++p)
+                    {
+                        stepStart = Clock::now();
+
+                        camera.SetPose(poses[p].position, poses[p].yaw, poses[p].pitch);
+                        const Mat4<float> VP = camera.GetProjectionMatrix(settings.width, settings.height) * camera.GetViewMatrix();
+
+                        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                        terrain.renderTerrain(renderQueue, VP);
+                        renderQueue.flush(glState);
+
+                        auto pixels = std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(settings.width) * settings.height * 4);
+                        glReadPixels(0, 0, settings.width, settings.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels->data());
+                        renderTime += SecondsSince(stepStart);
+
+                        const std::string path = (std::filesystem::path(settings.outputDirectory) /
+                            ("seed_" + std::to_string(seed) + "_view_" + std::to_string(p) + ".png")).string();
+
+                        if (pendingWrites.size() >= maxPendingWrites)
+                        {
+                            if (!pendingWrites.front().get())
+                                exitCode = -5;
+                            pendingWrites.pop_front();
+                        }
+
+                        // OpenGL rows start at the bottom of the image
+                        pendingWrites.push_back(std::async(std::launch::async, [path, pixels, &settings]()
+                        {
+                            return Image::WritePng(path, settings.width, settings.height, 4, pixels->data(), true);
+                        }));
+                    }
+                }
+
+                for (auto& write : pendingWrites)
+                {
+                    if (!write.get())
+                        exitCode = -5;
+                }
+
+                const double totalTime = SecondsSince(start);
+                const size_t frames = static_cast<size_t>(settings.seedCount) * poses.size();
+                std::cout << "Rendered " << frames << " previews (" << settings.width << "x" << settings.height << ") in " << totalTime << " s\n"
+                          << "  generation: " << generationTime * 1000.0 / settings.seedCount << " ms/seed\n"
+                          << "  render + readback: " << renderTime * 1000.0 / frames << " ms/frame ("
+                          << frames / std::max(renderTime, 1e-9) << " frames/s)\n"
+                          << "  end to end: " << frames / std::max(totalTime, 1e-9) << " previews/s" << std::endl;
+            }
+        }
+
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return exitCode;
+    }
+}
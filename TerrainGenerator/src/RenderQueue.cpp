@@ -0,0 +1,135 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+#include "RenderCounters.h"
+
+namespace
+{
+    // Pass, then program, vertex array and first texture: names are small integers, 20 bits each are plenty
+    uint64_t SortKey(const RenderCommand& command)
+    {
+        constexpr uint64_t MASK = (1u << 20) - 1;
+        return (static_cast<uint64_t>(command.pass) << 60)
+             | ((command.shader->getID() & MASK) << 40)
+             | ((command.vertexArray & MASK) << 20)
+             | (command.textures[0].texture & MASK);
+    }
+}
+
+void GLStateCache::invalidate()
+{
+    m_program = UNKNOWN;
+    m_vertexArray = UNKNOWN;
+    m_activeUnit = -1;
+    m_units.fill(TextureUnit());
+    m_depthMask = -1;
+}
+
+bool GLStateCache::apply(bool changed)
+{
+    RenderStats::StateChange(changed);
+    return changed;
+}
+
+void GLStateCache::useProgram(GLuint program)
+{
+    if (apply(program != m_program))
+    {
+        glUseProgram(program);
+        m_program = program;
+    }
+}
+
+void GLStateCache::bindVertexArray(GLuint vertexArray)
+{
+    if (apply(vertexArray != m_vertexArray))
+    {
+        glBindVertexArray(vertexArray);
+        m_vertexArray = vertexArray;
+    }
+}
+
+void GLStateCache::bindTexture(int unit, GLenum target, GLuint texture)
+{
+    TextureUnit& bound = m_units[unit];
+    if (!apply(texture != bound.texture || target != bound.target))
+        return;
+
+    if (unit != m_activeUnit)
+    {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        m_activeUnit = unit;
+    }
+    glBindTexture(target, texture);
+    bound.target = target;
+    bound.texture = texture;
+}
+
+void GLStateCache::setDepthMask(bool write)
+{
+    if (apply(static_cast<int>(write) != m_depthMask))
+    {
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+        m_depthMask = write;
+    }
+}
+
+void RenderQueue::submit(RenderCommand command)
+{
+    if (!command.shader || command.indexCount == 0)
+        return;
+
+    m_order.push_back({ SortKey(command), static_cast<uint32_t>(m_commands.size()) });
+    m_commands.push_back(std::move(command));
+}
+
+void RenderQueue::flush(GLStateCache& state)
+{
+    state.invalidate();
+    std::sort(m_order.begin(), m_order.end(), [](const Entry& a, const Entry& b)
+    {
+        return a.key != b.key ? a.key < b.key : a.index < b.index;
+    });
+
+    const Shader* uniformsShader = nullptr;
+    uint64_t uniformsKey = 0;
+    for (const Entry& entry : m_order)
+    {
+        const RenderCommand& command = m_commands[entry.index];
+        state.useProgram(command.shader->getID());
+        if (command.uniforms && (command.uniformsKey == 0 || command.shader != uniformsShader || command.uniformsKey != uniformsKey))
+            command.uniforms(*command.shader);
+        uniformsShader = command.shader;
+        uniformsKey = command.uniformsKey;
+
+        state.bindVertexArray(command.vertexArray);
+        for (int unit = 0; unit < GLStateCache::TEXTURE_UNITS; ++unit)
+        {
+            const TextureBinding& binding = command.textures[unit];
+            if (binding.texture != 0)
+                state.bindTexture(unit, binding.target, binding.texture);
+        }
+        state.setDepthMask(command.depthWrite);
+        if (command.prepare)
+            command.prepare();
+
+        if (command.instanceCount > 0)
+        {
+            glDrawElementsInstanced(GL_TRIANGLES, command.indexCount, GL_UNSIGNED_INT, nullptr, command.instanceCount);
+            RenderStats::Draw(command.indexCount, command.instanceCount);
+        }
+        else
+        {
+            glDrawElements(GL_TRIANGLES, command.indexCount, GL_UNSIGNED_INT, nullptr);
+            RenderStats::Draw(command.indexCount);
+        }
+    }
+
+    // Later GL calls expect no vertex array bound, and clears need depth writes
+    state.bindVertexArray(0);
+    state.setDepthMask(true);
+
+    m_commands.clear();
+    m_order.clear();
+}
@@ -0,0 +1,483 @@
+#include "ScatterRenderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+
+#include "Parallel.h"
+#include "RenderCounters.h"
+
+namespace
+{
+    // Chunks culled per job
+    constexpr int CULL_BLOCK = 256;
+
+    // Position, normal and color
+    struct MeshVertex
+    {
+        float position[3];
+        float normal[3];
+        float color[3];
+    };
+
+    // Flat shaded triangle
+    void AddTriangle(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices,
+                     const Point3d<float>& a, const Point3d<float>& b, const Point3d<float>& c, const Color3<float>& color)
+    {
+        const Point3d<float> n = Math::Normalize(Math::Cross(b - a, c - a));
+        for (const Point3d<float>* p : { &a, &b, &c })
+        {
+            indices.push_back(static_cast<uint32_t>(vertices.size()));
+            vertices.push_back({ { p->x, p->y, p->z }, { n.x, n.y, n.z }, { color.r, color.g, color.b } });
+        }
+    }
+
+    // Unit height tree: square trunk and a 6 sided cone
+    void BuildTree(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices)
+    {
+        const Color3<float> bark(0.36f, 0.25f, 0.14f);
+        const Color3<float> leaves(0.13f, 0.38f, 0.14f);
+
+        constexpr float trunkRadius = 0.06f;
+        constexpr float trunkHeight = 0.25f;
+        const Point3d<float> trunk[4] = { { -trunkRadius, 0.f, -trunkRadius }, { trunkRadius, 0.f, -trunkRadius },
+                                          { trunkRadius, 0.f, trunkRadius }, { -trunkRadius, 0.f, trunkRadius } };
+        for (int i = 0; i < 4; ++i)
+        {
+            const Point3d<float>& a = trunk[i];
+            const Point3d<float>& b = trunk[(i + 1) % 4];
+            const Point3d<float> aTop(a.x, trunkHeight, a.z);
+            const Point3d<float> bTop(b.x, trunkHeight, b.z);
+            AddTriangle(vertices, indices, a, bTop, b, bark);
+            AddTriangle(vertices, indices, a, aTop, bTop, bark);
+        }
+
+        constexpr int sides = 6;
+        constexpr float coneRadius = 0.35f;
+        const Point3d<float> apex(0.f, 1.f, 0.f);
+        const Point3d<float> center(0.f, trunkHeight, 0.f);
+        for (int i = 0; i < sides; ++i)
+        {
+            const float a0 = i * 6.2831853f / sides;
+            const float a1 = (i + 1) * 6.2831853f / sides;
+            const Point3d<float> p0(std::cos(a0) * coneRadius, trunkHeight, std::sin(a0) * coneRadius);
+            const Point3d<float> p1(std::cos(a1) * coneRadius, trunkHeight, std::sin(a1) * coneRadius);
+            AddTriangle(vertices, indices, p0, apex, p1, leaves);
+            AddTriangle(vertices, indices, p0, p1, center, leaves);
+        }
+    }
+
+    // Unit size rock: squashed, irregular octahedron
+    void BuildRock(std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices)
+    {
+        const Color3<float> stone(0.47f, 0.45f, 0.43f);
+        const Point3d<float> top(0.1f, 0.7f, -0.05f);
+        const Point3d<float> bottom(0.f, -0.2f, 0.f);
+        const Point3d<float> ring[4] = { { 1.f, 0.15f, 0.f }, { 0.f, 0.25f, 0.8f }, { -0.9f, 0.1f, 0.f }, { 0.f, 0.2f, -1.1f } };
+        for (int i = 0; i < 4; ++i)
+        {
+            const Point3d<float>& a = ring[i];
+            const Point3d<float>& b = ring[(i + 1) % 4];
+            AddTriangle(vertices, indices, a, top, b, stone);
+            AddTriangle(vertices, indices, a, b, bottom, stone);
+        }
+    }
+}
+
+ScatterRenderer::ScatterRenderer(float chunkSize)
+    : m_shader("scatter.vert", "scatter.frag")
+    , m_chunkSize(chunkSize)
+{
+    ScatterRule& trees = m_rules[static_cast<int>(ScatterKind::TREE)];
+    trees.radius = 0.12f;
+    trees.minHeight = 0.08f;
+    trees.maxHeight = 0.45f;
+    trees.maxSlope = 0.7f;
+    trees.density = 0.85f;
+    trees.minScale = 0.15f;
+    trees.maxScale = 0.3f;
+
+    ScatterRule& rocks = m_rules[static_cast<int>(ScatterKind::ROCK)];
+    rocks.radius = 0.3f;
+    rocks.minSlope = 0.35f;
+    rocks.maxSlope = 100.f;
+    rocks.density = 0.5f;
+    rocks.minScale = 0.04f;
+    rocks.maxScale = 0.09f;
+
+    createMeshes();
+}
+
+ScatterRenderer::~ScatterRenderer()
+{
+    releaseChunks();
+    for (Mesh& mesh : m_meshes)
+    {
+        glDeleteBuffers(1, &mesh.ebo);
+        glDeleteBuffers(1, &mesh.vbo);
+        glDeleteVertexArrays(1, &mesh.vao);
+    }
+}
+
+void ScatterRenderer::setTerrain(const HeightfieldView& heightfield, uint32_t seed, std::shared_ptr<const void> owner)
+{
+    releaseChunks();
+    m_heightfield = heightfield;
+    m_heightsOwner = std::move(owner);
+    m_seed = seed;
+    if (!heightfield.valid())
+    {
+        m_chunkCount = 0;
+        return;
+    }
+
+    m_chunkCount = std::max(1, static_cast<int>(std::ceil(heightfield.extent() / m_chunkSize)));
+    m_chunks.assign(static_cast<size_t>(m_chunkCount) * m_chunkCount, Chunk());
+    Parallel::For(0, static_cast<int>(m_chunks.size()), [&](int index) { updateBounds(index); });
+}
+
+void ScatterRenderer::updateRegion(const HeightfieldView& heightfield, std::shared_ptr<const void> owner, int x, int y, int width, int height)
+{
+    if (heightfield.size != m_heightfield.size || heightfield.step != m_heightfield.step || m_chunks.empty())
+    {
+        setTerrain(heightfield, m_seed, std::move(owner));
+        return;
+    }
+
+    // Chunks being scattered read the previous heights: they are uploaded, then those over the region dropped
+    JobSystem& jobs = JobSystem::Instance();
+    jobs.wait(m_cullFence);
+    for (const auto& batch : m_pending)
+        jobs.wait(batch->fence);
+    uploadFinished();
+    m_heightfield = heightfield;
+    m_heightsOwner = std::move(owner);
+
+    // Instances sit on the bilinear heights, one sample around the region moves them too
+    auto chunkOf = [&](int sample) { return std::clamp(static_cast<int>(sample * heightfield.step / m_chunkSize), 0, m_chunkCount - 1); };
+    for (int cz = chunkOf(y - 1); cz <= chunkOf(y + height); ++cz)
+    {
+        for (int cx = chunkOf(x - 1); cx <= chunkOf(x + width); ++cx)
+        {
+            const int index = cz * m_chunkCount + cx;
+            if (m_chunks[index].generated)
+                releaseChunk(m_chunks[index]);
+            updateBounds(index);
+        }
+    }
+    m_prepared = false;
+}
+
+void ScatterRenderer::updateBounds(int index)
+{
+    // Conservative vertical bounds for culling before a chunk is generated
+    float tallest = 0.f;
+    for (const ScatterRule& rule : m_rules)
+        tallest = std::max(tallest, rule.maxScale);
+
+    const HeightfieldView& heightfield = m_heightfield;
+    Chunk& chunk = m_chunks[index];
+    const int cx = index % m_chunkCount;
+    const int cz = index / m_chunkCount;
+    chunk.x0 = heightfield.origin.x + cx * m_chunkSize;
+    chunk.z0 = heightfield.origin.y + cz * m_chunkSize;
+
+    // Samples around the world extent of the chunk, the bilinear heights inside it lie between them
+    auto firstSample = [&](float start) { return std::clamp(static_cast<int>(std::floor(start / heightfield.step)), 0, heightfield.size - 1); };
+    auto lastSample = [&](float end) { return std::clamp(static_cast<int>(std::ceil(end / heightfield.step)), 0, heightfield.size - 1); };
+    const int x0 = firstSample(cx * m_chunkSize);
+    const int x1 = lastSample((cx + 1) * m_chunkSize);
+    const int y0 = firstSample(cz * m_chunkSize);
+    const int y1 = lastSample((cz + 1) * m_chunkSize);
+
+    float minHeight = heightfield.sample(x0, y0);
+    float maxHeight = minHeight;
+    for (int y = y0; y <= y1; ++y)
+    {
+        for (int x = x0; x <= x1; ++x)
+        {
+            minHeight = std::min(minHeight, heightfield.sample(x, y));
+            maxHeight = std::max(maxHeight, heightfield.sample(x, y));
+        }
+    }
+    chunk.minY = std::min(minHeight * heightfield.heightScale, maxHeight * heightfield.heightScale) - tallest;
+    chunk.maxY = std::max(minHeight * heightfield.heightScale, maxHeight * heightfield.heightScale) + tallest;
+}
+
+void ScatterRenderer::setRule(ScatterKind kind, const ScatterRule& rule)
+{
+    // setTerrain drops the chunks, the jobs reading the old rule finish first
+    waitForJobs();
+    m_rules[static_cast<int>(kind)] = rule;
+    setTerrain(m_heightfield, m_seed, m_heightsOwner);
+}
+
+void ScatterRenderer::prepare(const Mat4<float>& VP)
+{
+    JobSystem& jobs = JobSystem::Instance();
+    jobs.wait(m_cullFence);
+
+    m_frustum.emplace(VP);
+    m_visible.assign(m_chunks.size(), 0);
+    m_prepared = true;
+
+    const int chunkCount = static_cast<int>(m_chunks.size());
+    for (int first = 0; first < chunkCount; first += CULL_BLOCK)
+    {
+        jobs.run([this, first, chunkCount]()
+        {
+            const int last = std::min(first + CULL_BLOCK, chunkCount);
+            for (int i = first; i < last; ++i)
+            {
+                const Chunk& chunk = m_chunks[i];
+                const Point3d<float> boxMin(chunk.x0, chunk.minY, chunk.z0);
+                const Point3d<float> boxMax(chunk.x0 + m_chunkSize, chunk.maxY, chunk.z0 + m_chunkSize);
+                m_visible[i] = m_frustum->intersects(boxMin, boxMax);
+            }
+        }, &m_cullFence, nullptr, "Scatter culling");
+    }
+}
+
+void ScatterRenderer::render(RenderQueue& queue, const Mat4<float>& VP)
+{
+    if (!m_prepared)
+        prepare(VP);
+    JobSystem& jobs = JobSystem::Instance();
+    jobs.wait(m_cullFence);
+    m_prepared = false;
+
+    m_stats.generatedChunks = 0;
+    uploadFinished();
+
+    ++m_frame;
+    std::vector<int> visible;
+    std::vector<int> missing;
+    for (int i = 0; i < static_cast<int>(m_chunks.size()); ++i)
+    {
+        if (!m_visible[i])
+            continue;
+
+        visible.push_back(i);
+        m_chunks[i].lastVisible = m_frame;
+        if (!m_chunks[i].generated && !m_chunks[i].pending)
+            missing.push_back(i);
+    }
+    evictChunks();
+
+    if (!missing.empty())
+        generateChunks(missing);
+    if (m_synchronous && !m_pending.empty())
+    {
+        for (const auto& batch : m_pending)
+            jobs.wait(batch->fence);
+        uploadFinished();
+    }
+
+    m_stats.visibleChunks = static_cast<int>(visible.size());
+    m_stats.drawCalls = 0;
+    m_stats.drawnInstances = 0;
+
+    ++m_uniformsKey;
+    for (int kind = 0; kind < KIND_COUNT; ++kind)
+    {
+        const Mesh& mesh = m_meshes[kind];
+        for (int i : visible)
+        {
+            const Chunk& chunk = m_chunks[i];
+            if (chunk.counts[kind] == 0)
+                continue;
+
+            RenderCommand command;
+            command.shader = &m_shader;
+            command.vertexArray = mesh.vao;
+            command.indexCount = mesh.indexCount;
+            command.instanceCount = chunk.counts[kind];
+            command.uniforms = [VP](const Shader& shader) { shader.setMat4("VP", VP); };
+            command.uniformsKey = m_uniformsKey;
+
+            // Instance attributes read the buffer of the chunk
+            const GLuint buffer = chunk.buffers[kind];
+            command.prepare = [buffer]()
+            {
+                glBindBuffer(GL_ARRAY_BUFFER, buffer);
+                glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(ScatterInstance), (void*)offsetof(ScatterInstance, x));
+                glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, sizeof(ScatterInstance), (void*)offsetof(ScatterInstance, rotation));
+            };
+            queue.submit(std::move(command));
+
+            ++m_stats.drawCalls;
+            m_stats.drawnInstances += chunk.counts[kind];
+        }
+    }
+}
+
+void ScatterRenderer::createMeshes()
+{
+    for (int kind = 0; kind < KIND_COUNT; ++kind)
+    {
+        std::vector<MeshVertex> vertices;
+        std::vector<uint32_t> indices;
+        if (kind == static_cast<int>(ScatterKind::TREE))
+            BuildTree(vertices, indices);
+        else
+            BuildRock(vertices, indices);
+
+        Mesh& mesh = m_meshes[kind];
+        mesh.indexCount = static_cast<GLsizei>(indices.size());
+
+        glGenVertexArrays(1, &mesh.vao);
+        glBindVertexArray(mesh.vao);
+
+        glGenBuffers(1, &mesh.vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MeshVertex), vertices.data(), GL_STATIC_DRAW);
+
+        glGenBuffers(1, &mesh.ebo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+        RenderStats::Upload(vertices.size() * sizeof(MeshVertex) + indices.size() * sizeof(uint32_t));
+        m_meshBytes += vertices.size() * sizeof(MeshVertex) + indices.size() * sizeof(uint32_t);
+
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, position));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, normal));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex), (void*)offsetof(MeshVertex, color));
+        glEnableVertexAttribArray(2);
+
+        // Per instance: position + scale, rotation
+        glEnableVertexAttribArray(3);
+        glVertexAttribDivisor(3, 1);
+        glEnableVertexAttribArray(4);
+        glVertexAttribDivisor(4, 1);
+    }
+
+    glBindVertexArray(0);
+    m_memory.set(m_meshBytes);
+}
+
+void ScatterRenderer::releaseChunks()
+{
+    waitForJobs();
+    for (Chunk& chunk : m_chunks)
+    {
+        if (chunk.generated)
+            glDeleteBuffers(KIND_COUNT, chunk.buffers.data());
+    }
+    m_chunks.clear();
+    m_visible.clear();
+    m_prepared = false;
+    m_stats.residentChunks = 0;
+    m_stats.pendingChunks = 0;
+    m_stats.evictedChunks = 0;
+    m_memory.set(m_meshBytes);
+}
+
+void ScatterRenderer::releaseChunk(Chunk& chunk)
+{
+    glDeleteBuffers(KIND_COUNT, chunk.buffers.data());
+    chunk.buffers = {};
+    chunk.counts = {};
+    chunk.generated = false;
+    m_memory.add(-static_cast<int64_t>(chunk.bytes));
+    chunk.bytes = 0;
+    --m_stats.residentChunks;
+}
+
+void ScatterRenderer::evictChunks()
+{
+    if (m_memoryBudget == 0 || m_memory.bytes() <= m_memoryBudget)
+        return;
+
+    // Out of view the longest first, the visible chunks are kept whatever the budget
+    std::vector<int> candidates;
+    for (int i = 0; i < static_cast<int>(m_chunks.size()); ++i)
+    {
+        if (m_chunks[i].generated && m_chunks[i].lastVisible != m_frame)
+            candidates.push_back(i);
+    }
+    std::sort(candidates.begin(), candidates.end(), [this](int a, int b) { return m_chunks[a].lastVisible < m_chunks[b].lastVisible; });
+
+    for (size_t i = 0; i < candidates.size() && m_memory.bytes() > m_memoryBudget; ++i)
+    {
+        releaseChunk(m_chunks[candidates[i]]);
+        ++m_stats.evictedChunks;
+    }
+}
+
+void ScatterRenderer::waitForJobs()
+{
+    JobSystem& jobs = JobSystem::Instance();
+    jobs.wait(m_cullFence);
+    for (const auto& batch : m_pending)
+        jobs.wait(batch->fence);
+    m_pending.clear();
+}
+
+void ScatterRenderer::generateChunks(const std::vector<int>& chunks)
+{
+    auto batch = std::make_unique<PendingBatch>();
+    batch->chunks = chunks;
+    batch->instances.resize(chunks.size());
+    batch->start = std::chrono::steady_clock::now();
+
+    // One job per chunk, the instances are uploaded on this thread by a later frame
+    JobSystem& jobs = JobSystem::Instance();
+    PendingBatch* pending = batch.get();
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        m_chunks[chunks[i]].pending = true;
+        jobs.run([this, pending, i]()
+        {
+            const Chunk& chunk = m_chunks[pending->chunks[i]];
+            for (int kind = 0; kind < KIND_COUNT; ++kind)
+            {
+                const ScatterGenerator generator(m_seed, kind, m_rules[kind]);
+                generator.generate(m_heightfield, chunk.x0, chunk.z0, m_chunkSize, pending->instances[i][kind]);
+            }
+        }, &batch->fence, nullptr, "Scatter chunk");
+    }
+
+    m_stats.pendingChunks += static_cast<int>(chunks.size());
+    m_pending.push_back(std::move(batch));
+}
+
+void ScatterRenderer::uploadFinished()
+{
+    for (size_t b = 0; b < m_pending.size();)
+    {
+        const PendingBatch& batch = *m_pending[b];
+        if (!batch.fence.done())
+        {
+            ++b;
+            continue;
+        }
+
+        for (size_t i = 0; i < batch.chunks.size(); ++i)
+        {
+            Chunk& chunk = m_chunks[batch.chunks[i]];
+            glGenBuffers(KIND_COUNT, chunk.buffers.data());
+            for (int kind = 0; kind < KIND_COUNT; ++kind)
+            {
+                const std::vector<ScatterInstance>& kindInstances = batch.instances[i][kind];
+                glBindBuffer(GL_ARRAY_BUFFER, chunk.buffers[kind]);
+                glBufferData(GL_ARRAY_BUFFER, kindInstances.size() * sizeof(ScatterInstance), kindInstances.data(), GL_STATIC_DRAW);
+                RenderStats::Upload(kindInstances.size() * sizeof(ScatterInstance));
+                chunk.counts[kind] = static_cast<GLsizei>(kindInstances.size());
+                chunk.bytes += kindInstances.size() * sizeof(ScatterInstance);
+            }
+            m_memory.add(static_cast<int64_t>(chunk.bytes));
+            chunk.generated = true;
+            chunk.pending = false;
+        }
+
+        const int count = static_cast<int>(batch.chunks.size());
+        m_stats.residentChunks += count;
+        m_stats.pendingChunks -= count;
+        m_stats.generatedChunks += count;
+        m_stats.generationTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - batch.start).count();
+
+        m_pending.erase(m_pending.begin() + b);
+    }
+}
@@ -0,0 +1,157 @@
+#include "ShadowMaps.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+    // Blend of the logarithmic and uniform splits: the logarithmic one leaves too little to the far cascades
+    constexpr float SPLIT_BLEND = 0.75f;
+
+    // Distance behind the cascade where casters are still drawn, e.g. mountains between the sun and the view
+    constexpr float CASTER_DISTANCE = 30.f;
+}
+
+ShadowMaps::ShadowMaps(int resolution)
+    : m_resolution(resolution)
+{
+    glGenTextures(1, &m_texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, m_resolution, m_resolution, CASCADE_COUNT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    m_memory.set(static_cast<size_t>(m_resolution) * m_resolution * CASCADE_COUNT * sizeof(float));
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // Hardware comparison, filtered between the 4 nearest texels
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    glGenFramebuffers(1, &m_framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_texture, 0, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "Shadow map framebuffer is incomplete." << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    m_lightVP.fill(Mat4<float>::identity());
+}
+
+ShadowMaps::~ShadowMaps()
+{
+    glDeleteFramebuffers(1, &m_framebuffer);
+    glDeleteTextures(1, &m_texture);
+}
+
+void ShadowMaps::update(const Mat4<float>& VP, const Point3d<float>& sunDirection, float nearPlane, float farPlane, float shadowDistance)
+{
+    // Frustum corners in the frame of VP, near then far
+    const Mat4<float> inverseVP = Math::Inverse(VP);
+    std::array<Point3d<float>, 8> corners;
+    for (int i = 0; i < 8; ++i)
+    {
+        const Point3d<float> ndc((i & 1) ? 1.f : -1.f, (i & 2) ? 1.f : -1.f, (i & 4) ? 1.f : -1.f);
+        corners[i] = Math::TransformPoint(inverseVP, ndc);
+    }
+
+    const Point3d<float> sun = Math::Normalize(sunDirection);
+    const Point3d<float> up = std::abs(sun.y) > 0.99f ? Point3d<float>(0.f, 0.f, 1.f) : Point3d<float>(0.f, 1.f, 0.f);
+    const float lastDepth = std::clamp(shadowDistance, nearPlane, farPlane);
+
+    float splitNear = nearPlane;
+    for (int cascade = 0; cascade < CASCADE_COUNT; ++cascade)
+    {
+        const float ratio = static_cast<float>(cascade + 1) / CASCADE_COUNT;
+        const float logarithmic = nearPlane * std::pow(lastDepth / nearPlane, ratio);
+        const float uniform = nearPlane + (lastDepth - nearPlane) * ratio;
+        const float splitFar = SPLIT_BLEND * logarithmic + (1.f - SPLIT_BLEND) * uniform;
+        m_splits[cascade] = splitFar;
+
+        // The view depth is linear along the corner rays
+        const float t0 = (splitNear - nearPlane) / (farPlane - nearPlane);
+        const float t1 = (splitFar - nearPlane) / (farPlane - nearPlane);
+        std::array<Point3d<float>, 8> slice;
+        Point3d<float> center;
+        for (int i = 0; i < 4; ++i)
+        {
+            const Point3d<float> ray = corners[i + 4] - corners[i];
+            slice[i] = corners[i] + ray * t0;
+            slice[i + 4] = corners[i] + ray * t1;
+            center += slice[i] + slice[i + 4];
+        }
+        center = center * (1.f / 8.f);
+
+        // The sphere does not change with the orientation of the camera, neither does the texel size
+        float radius = 0.f;
+        for (const Point3d<float>& corner : slice)
+        {
+            const Point3d<float> offset = corner - center;
+            radius = std::max(radius, std::sqrt(offset.x * offset.x + offset.y * offset.y + offset.z * offset.z));
+        }
+        radius = std::ceil(radius * 16.f) / 16.f;
+
+        const Mat4<float> view = Math::LookAt(center + sun * (radius + CASTER_DISTANCE), center, up);
+        Mat4<float> projection = Mat4<float>::orthographic(-radius, radius, -radius, radius, 0.f, 2.f * radius + CASTER_DISTANCE);
+
+        // Snap the origin to a texel: the same world point stays on the same texel while the camera moves
+        const Mat4<float> lightVP = projection * view;
+        const float texels = m_resolution * 0.5f;
+        const Point3d<float> origin = Math::TransformPoint(lightVP, Point3d<float>(0.f, 0.f, 0.f));
+        projection(0, 3) += (std::round(origin.x * texels) - origin.x * texels) / texels;
+        projection(1, 3) += (std::round(origin.y * texels) - origin.y * texels) / texels;
+
+        m_lightVP[cascade] = projection * view;
+        splitNear = splitFar;
+    }
+}
+
+void ShadowMaps::render(const std::function<void(const Mat4<float>&)>& drawCasters)
+{
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    GLint polygonMode[2];
+    glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glViewport(0, 0, m_resolution, m_resolution);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+
+    // Slope scaled bias against shadow acne
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(2.f, 4.f);
+
+    for (int cascade = 0; cascade < CASCADE_COUNT; ++cascade)
+    {
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_texture, 0, cascade);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        drawCasters(m_lightVP[cascade]);
+    }
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glPolygonMode(GL_FRONT_AND_BACK, polygonMode[0]);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void ShadowMaps::bind(RenderCommand& command, int unit) const
+{
+    command.textures[unit] = { GL_TEXTURE_2D_ARRAY, m_texture };
+}
+
+void ShadowMaps::setUniforms(const Shader& shader, int unit) const
+{
+    static const char* names[] = { "lightVP[0]", "lightVP[1]", "lightVP[2]", "lightVP[3]" };
+    static_assert(CASCADE_COUNT <= 4, "cascadeSplits is a vec4");
+    for (int cascade = 0; cascade < CASCADE_COUNT; ++cascade)
+        shader.setMat4(names[cascade], m_lightVP[cascade]);
+
+    float splits[4] = { 0.f, 0.f, 0.f, 0.f };
+    std::copy(m_splits.begin(), m_splits.end(), splits);
+    shader.setFloat4("cascadeSplits", splits[0], splits[1], splits[2], splits[3]);
+
+    shader.setInt("shadowMap", unit);
+}
@@ -0,0 +1,136 @@
+#include "Simulation.h"
+
+#include <algorithm>
+
+namespace
+{
+    // Steps behind schedule before the thread gives up catching up
+    constexpr int MAX_LATE_STEPS = 8;
+
+    // World position of a state, in double so that states on both sides of a rebase compare
+    Point3d<double> WorldPosition(const CameraState& state)
+    {
+        return Point3d<double>(state.origin.x + static_cast<double>(state.position.x),
+                               state.origin.y + static_cast<double>(state.position.y),
+                               state.origin.z + static_cast<double>(state.position.z));
+    }
+}
+
+Simulation::Simulation(const Camera& camera, int stepsPerSecond)
+    : m_camera(camera)
+    , m_stepsPerSecond(std::max(1, stepsPerSecond))
+    , m_step(std::chrono::duration_cast<SimulationClock::duration>(std::chrono::duration<double>(1.0 / m_stepsPerSecond)))
+{
+    m_camera.SetDeltaTime(1.f / m_stepsPerSecond);
+
+    const auto now = SimulationClock::now();
+    m_inputTime = now;
+    m_previous = m_current = capture(now);
+
+    m_thread = std::thread([this]() { run(); });
+}
+
+Simulation::~Simulation()
+{
+    m_stop.store(true);
+    m_thread.join();
+}
+
+void Simulation::submitInput(const InputState& input)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_input.movement = input.movement;
+    m_input.mouseX += input.mouseX;
+    m_input.mouseY += input.mouseY;
+    m_inputTime = SimulationClock::now();
+}
+
+void Simulation::setOrigin(const WorldOrigin& origin)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_camera.SetOrigin(origin);
+
+    // Both states move with the frame, or the interpolation would sweep between the old and new world position
+    m_previous.origin = origin;
+    m_current.origin = origin;
+}
+
+SimulationClock::time_point Simulation::interpolate(Camera& camera, SimulationClock::time_point now) const
+{
+    CameraState previous;
+    CameraState current;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        previous = m_previous;
+        current = m_current;
+    }
+
+    // Render one step in the past, between the last two states
+    const auto renderTime = now - m_step;
+    const double span = std::chrono::duration<double>(current.time - previous.time).count();
+    const double alpha = span > 0.0 ? std::clamp(std::chrono::duration<double>(renderTime - previous.time).count() / span, 0.0, 1.0) : 1.0;
+
+    const Point3d<double> a = WorldPosition(previous);
+    const Point3d<double> b = WorldPosition(current);
+    const Point3d<float> position(static_cast<float>(a.x + (b.x - a.x) * alpha - current.origin.x),
+                                  static_cast<float>(a.y + (b.y - a.y) * alpha - current.origin.y),
+                                  static_cast<float>(a.z + (b.z - a.z) * alpha - current.origin.z));
+    const float yaw = previous.yaw + (current.yaw - previous.yaw) * static_cast<float>(alpha);
+    const float pitch = previous.pitch + (current.pitch - previous.pitch) * static_cast<float>(alpha);
+
+    camera.SetOrigin(current.origin);
+    camera.SetPose(position, yaw, pitch);
+    return alpha > 0.0 ? current.inputTime : previous.inputTime;
+}
+
+CameraState Simulation::capture(SimulationClock::time_point time) const
+{
+    CameraState state;
+    state.origin = m_camera.GetOrigin();
+    state.position = m_camera.GetPosition();
+    state.yaw = m_camera.GetYaw();
+    state.pitch = m_camera.GetPitch();
+    state.time = time;
+    state.inputTime = m_inputTime;
+    return state;
+}
+
+void Simulation::step(SimulationClock::time_point time)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_input.mouseX != 0.f || m_input.mouseY != 0.f)
+        m_camera.ProcessMouseMovementInputs(m_input.mouseX, m_input.mouseY);
+    m_input.mouseX = 0.f;
+    m_input.mouseY = 0.f;
+
+    for (int direction = 0; direction < static_cast<int>(m_input.movement.size()); ++direction)
+    {
+        if (m_input.movement[direction])
+            m_camera.ProcessKeyboardInputs(static_cast<CameraMovement>(direction));
+    }
+    m_camera.RebaseOrigin();
+
+    m_previous = m_current;
+    m_current = capture(time);
+}
+
+void Simulation::run()
+{
+    auto next = SimulationClock::now() + m_step;
+    while (!m_stop.load(std::memory_order_relaxed))
+    {
+        std::this_thread::sleep_until(next);
+
+        // Catch up after a stall, but not forever: past a few steps the time is dropped
+        const auto now = SimulationClock::now();
+        if (now - next > m_step * MAX_LATE_STEPS)
+        {
+            m_skippedSteps.fetch_add(static_cast<int>((now - next) / m_step), std::memory_order_relaxed);
+            next = now;
+        }
+
+        step(next);
+        next += m_step;
+    }
+}
@@ -0,0 +1,339 @@
+#include "VirtualTextureRenderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+#include "RenderCounters.h"
+
+VirtualTextureRenderer::VirtualTextureRenderer(const VirtualTextureSettings& settings)
+    : m_cache(settings)
+    , m_feedbackShader("feedback.vert", "feedback.frag")
+    , m_uploadBudget(settings.uploadBudget)
+{
+    // One mip per level, entries are read exactly
+    const int levels = m_cache.getLevelCount();
+    glGenTextures(1, &m_pageTable);
+    glBindTexture(GL_TEXTURE_2D, m_pageTable);
+    for (int level = 0; level < levels; ++level)
+    {
+        const int pages = m_cache.getPagesPerSide(level);
+        glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, pages, pages, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    uploadPageTable();
+
+    // Pages are filtered within their border, the level is chosen by the page table instead of mipmaps
+    const int atlasSize = m_cache.getAtlasSize();
+    glGenTextures(1, &m_atlas);
+    glBindTexture(GL_TEXTURE_2D, m_atlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, atlasSize, atlasSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glGenFramebuffers(1, &m_framebuffer);
+    glGenTextures(1, &m_feedbackColor);
+    glGenRenderbuffers(1, &m_feedbackDepth);
+    for (Readback& readback : m_readbacks)
+        glGenBuffers(1, &readback.buffer);
+    m_memory.set(textureBytes());
+}
+
+VirtualTextureRenderer::~VirtualTextureRenderer()
+{
+    // Jobs write into the pending pages
+    JobSystem& jobs = JobSystem::Instance();
+    for (const auto& pending : m_pending)
+        jobs.wait(pending->fence);
+
+    for (Readback& readback : m_readbacks)
+    {
+        if (readback.fence)
+            glDeleteSync(readback.fence);
+        glDeleteBuffers(1, &readback.buffer);
+    }
+    glDeleteRenderbuffers(1, &m_feedbackDepth);
+    glDeleteTextures(1, &m_feedbackColor);
+    glDeleteFramebuffers(1, &m_framebuffer);
+    glDeleteTextures(1, &m_atlas);
+    glDeleteTextures(1, &m_pageTable);
+}
+
+void VirtualTextureRenderer::setSource(const MaterialPageSource& source)
+{
+    if (source.weights == m_source.weights && source.size == m_source.size && source.extent == m_source.extent && source.seed == m_source.seed)
+        return;
+
+    // Pages still being generated belong to the old materials, they are dropped when done
+    m_source = source;
+    ++m_generation;
+    m_cache.clear();
+    uploadPageTable();
+}
+
+void VirtualTextureRenderer::update()
+{
+    collectFeedback();
+    if (m_synchronous)
+    {
+        requestPages();
+        JobSystem& jobs = JobSystem::Instance();
+        for (const auto& pending : m_pending)
+            jobs.wait(pending->fence);
+    }
+    uploadPages();
+    uploadPageTable();
+    requestPages();
+
+    // Stats of this frame, before the cache starts the next one
+    const size_t uploadedBytes = m_stats.uploadedBytes;
+    const double generationTime = m_stats.generationTime;
+    m_stats = m_cache.getStats();
+    m_stats.uploadedBytes = uploadedBytes;
+    m_stats.generationTime = generationTime;
+    m_cache.endFrame();
+}
+
+void VirtualTextureRenderer::renderFeedback(const std::function<void(const Shader&)>& draw)
+{
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    const int width = std::max(1, viewport[2] / FEEDBACK_DIVISOR);
+    const int height = std::max(1, viewport[3] / FEEDBACK_DIVISOR);
+    if (width != m_feedbackWidth || height != m_feedbackHeight)
+        resizeFeedback(width, height);
+
+    // Readback slot still in flight: skip this frame rather than wait for the GPU
+    Readback& readback = m_readbacks[m_nextReadback];
+    if (readback.fence)
+        return;
+
+    GLfloat clearColor[4];
+    GLint polygonMode[2];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+    glGetIntegerv(GL_POLYGON_MODE, polygonMode);
+    const GLboolean blend = glIsEnabled(GL_BLEND);
+
+    // Exact bytes: no blending, filled polygons even in wireframe mode, 0 alpha where no page is read
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glViewport(0, 0, width, height);
+    glDisable(GL_BLEND);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    m_feedbackShader.use();
+    const VirtualTextureSettings& settings = m_cache.getSettings();
+    m_feedbackShader.setFloat("virtualSize", static_cast<float>(settings.pagesPerSide * settings.pageSize));
+    m_feedbackShader.setFloat("pagesPerSide", static_cast<float>(settings.pagesPerSide));
+    m_feedbackShader.setInt("levelCount", m_cache.getLevelCount());
+    m_feedbackShader.setFloat("levelBias", std::log2(static_cast<float>(FEEDBACK_DIVISOR)));
+    draw(m_feedbackShader);
+
+    // Into a pixel buffer, mapped by a later update() once the GPU is done
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_nextReadback = (m_nextReadback + 1) % static_cast<int>(m_readbacks.size());
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    glPolygonMode(GL_FRONT_AND_BACK, polygonMode[0]);
+    if (blend)
+        glEnable(GL_BLEND);
+}
+
+void VirtualTextureRenderer::bind(RenderCommand& command, int unit) const
+{
+    command.textures[unit] = { GL_TEXTURE_2D, m_pageTable };
+    command.textures[unit + 1] = { GL_TEXTURE_2D, m_atlas };
+}
+
+void VirtualTextureRenderer::setUniforms(const Shader& shader, int unit) const
+{
+    shader.setInt("pageTable", unit);
+    shader.setInt("pageAtlas", unit + 1);
+
+    const VirtualTextureSettings& settings = m_cache.getSettings();
+    shader.setFloat("virtualSize", static_cast<float>(settings.pagesPerSide * settings.pageSize));
+    shader.setFloat("pagesPerSide", static_cast<float>(settings.pagesPerSide));
+    shader.setInt("levelCount", m_cache.getLevelCount());
+    shader.setFloat4("atlasLayout", static_cast<float>(m_cache.getSlotSize()), static_cast<float>(settings.pageSize),
+                     static_cast<float>(VirtualTextureCache::BORDER), static_cast<float>(m_cache.getAtlasSize()));
+}
+
+size_t VirtualTextureRenderer::textureBytes() const
+{
+    size_t tableBytes = 0;
+    for (int level = 0; level < m_cache.getLevelCount(); ++level)
+        tableBytes += m_cache.getPageTable(level).size();
+    const size_t atlasSize = m_cache.getAtlasSize();
+    return tableBytes + atlasSize * atlasSize * 4;
+}
+
+void VirtualTextureRenderer::resizeFeedback(int width, int height)
+{
+    m_feedbackWidth = width;
+    m_feedbackHeight = height;
+
+    glBindTexture(GL_TEXTURE_2D, m_feedbackColor);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindRenderbuffer(GL_RENDERBUFFER, m_feedbackDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_feedbackColor, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, m_feedbackDepth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        std::cerr << "Virtual texture feedback framebuffer is incomplete." << std::endl;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // Frames in flight were read at the old size
+    for (Readback& readback : m_readbacks)
+    {
+        if (readback.fence)
+        {
+            glDeleteSync(readback.fence);
+            readback.fence = nullptr;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(width) * height * 4, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    // Color and depth, then the read back buffers
+    const size_t feedbackBytes = static_cast<size_t>(width) * height * 4;
+    m_memory.set(textureBytes() + feedbackBytes * (2 + m_readbacks.size()));
+}
+
+void VirtualTextureRenderer::collectFeedback()
+{
+    for (Readback& readback : m_readbacks)
+    {
+        if (!readback.fence)
+            continue;
+        if (m_synchronous)
+            glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, std::numeric_limits<GLuint64>::max());
+        else if (glClientWaitSync(readback.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+            continue;
+
+        glDeleteSync(readback.fence);
+        readback.fence = nullptr;
+        const size_t bytes = static_cast<size_t>(m_feedbackWidth) * m_feedbackHeight * 4;
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+        if (const void* texels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(bytes), GL_MAP_READ_BIT))
+        {
+            m_cache.addFeedback(std::span<const uint8_t>(static_cast<const uint8_t*>(texels), bytes));
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void VirtualTextureRenderer::uploadPages()
+{
+    const int slotSize = m_cache.getSlotSize();
+    const size_t pageBytes = static_cast<size_t>(slotSize) * slotSize * 4;
+    const int slotsPerSide = m_cache.getSettings().slotsPerSide;
+
+    size_t uploaded = 0;
+    double generationTime = 0.0;
+    int generated = 0;
+    glBindTexture(GL_TEXTURE_2D, m_atlas);
+    for (size_t i = 0; i < m_pending.size();)
+    {
+        PendingPage& pending = *m_pending[i];
+        if (!pending.fence.done())
+        {
+            ++i;
+            continue;
+        }
+
+        // Pages of older materials are dropped, the others wait for a frame with budget left (at least one per frame)
+        if (pending.generation == m_generation)
+        {
+            if (uploaded > 0 && uploaded + pageBytes > m_uploadBudget)
+            {
+                ++i;
+                continue;
+            }
+
+            const int slot = pending.generated ? m_cache.makeResident(pending.page) : -1;
+            if (slot >= 0)
+            {
+                glTexSubImage2D(GL_TEXTURE_2D, 0, (slot % slotsPerSide) * slotSize, (slot / slotsPerSide) * slotSize, slotSize, slotSize,
+                                GL_RGBA, GL_UNSIGNED_BYTE, pending.texels.data());
+                uploaded += pageBytes;
+                generationTime += pending.milliseconds;
+                ++generated;
+            }
+            else
+                m_cache.cancel(pending.page);
+        }
+        m_pending.erase(m_pending.begin() + i);
+    }
+
+    m_stats.uploadedBytes = uploaded;
+    RenderStats::Upload(uploaded);
+    m_stats.generationTime = generated > 0 ? generationTime / generated : 0.0;
+}
+
+void VirtualTextureRenderer::uploadPageTable()
+{
+    glBindTexture(GL_TEXTURE_2D, m_pageTable);
+    for (int level = 0; level < m_cache.getLevelCount(); ++level)
+    {
+        const VirtualTextureCache::Rect& dirty = m_cache.getDirtyRect(level);
+        if (dirty.empty())
+            continue;
+
+        const int pages = m_cache.getPagesPerSide(level);
+        const std::vector<uint8_t>& table = m_cache.getPageTable(level);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, pages);
+        glTexSubImage2D(GL_TEXTURE_2D, level, dirty.x0, dirty.y0, dirty.x1 - dirty.x0, dirty.y1 - dirty.y0, GL_RGBA, GL_UNSIGNED_BYTE,
+                        &table[(static_cast<size_t>(dirty.y0) * pages + dirty.x0) * VirtualTextureCache::ENTRY_BYTES]);
+        RenderStats::Upload(static_cast<size_t>(dirty.x1 - dirty.x0) * (dirty.y1 - dirty.y0) * VirtualTextureCache::ENTRY_BYTES);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    m_cache.clearDirty();
+}
+
+void VirtualTextureRenderer::requestPages()
+{
+    if (!m_source.weights)
+        return;
+
+    const VirtualTextureSettings& settings = m_cache.getSettings();
+    const int slotSize = m_cache.getSlotSize();
+    JobSystem& jobs = JobSystem::Instance();
+    for (const VirtualPage& page : m_cache.takeRequests(settings.maxPendingPages - static_cast<int>(m_pending.size())))
+    {
+        auto pending = std::make_unique<PendingPage>();
+        pending->page = page;
+        pending->generation = m_generation;
+        pending->texels.resize(static_cast<size_t>(slotSize) * slotSize * 4);
+
+        // The job keeps the materials alive, a new source does not wait for it
+        PendingPage* target = pending.get();
+        jobs.run([target, source = m_source, settings]()
+        {
+            const auto start = std::chrono::steady_clock::now();
+            target->generated = VirtualTexture::GenerateMaterialPage(source, settings, target->page, target->texels);
+            target->milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }, &pending->fence, nullptr, "Virtual texture page");
+        m_pending.push_back(std::move(pending));
+    }
+}
@@ -0,0 +1,138 @@
+#include "WaterRenderer.h"
+
+#include <algorithm>
+
+#include "RenderCounters.h"
+
+WaterRenderer::WaterRenderer()
+    : m_shader("water.vert", "water.frag")
+{
+    glGenVertexArrays(1, &m_vao);
+    glBindVertexArray(m_vao);
+
+    glGenBuffers(1, &m_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+    glGenBuffers(1, &m_ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+
+    // Grid coordinates of the sample, the shader places it
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
+    glEnableVertexAttribArray(0);
+    glBindVertexArray(0);
+
+    glGenTextures(1, &m_texture);
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+WaterRenderer::~WaterRenderer()
+{
+    glDeleteTextures(1, &m_texture);
+    glDeleteBuffers(1, &m_ebo);
+    glDeleteBuffers(1, &m_vbo);
+    glDeleteVertexArrays(1, &m_vao);
+}
+
+void WaterRenderer::setTerrain(const WaterSimulation& water, const Point2d<float>& origin, float step)
+{
+    m_origin = origin;
+    m_step = step;
+    if (water.getSize() != m_size)
+    {
+        m_size = water.getSize();
+
+        std::vector<float> vertices;
+        vertices.reserve(static_cast<size_t>(m_size) * m_size * 2);
+        for (int y = 0; y < m_size; ++y)
+        {
+            for (int x = 0; x < m_size; ++x)
+            {
+                vertices.push_back(static_cast<float>(x));
+                vertices.push_back(static_cast<float>(y));
+            }
+        }
+
+        std::vector<uint32_t> indices;
+        indices.reserve(static_cast<size_t>(std::max(0, m_size - 1)) * (m_size - 1) * 6);
+        for (int y = 0; y + 1 < m_size; ++y)
+        {
+            for (int x = 0; x + 1 < m_size; ++x)
+            {
+                const uint32_t v = y * m_size + x;
+                indices.insert(indices.end(), { v, v + m_size, v + m_size + 1 });
+                indices.insert(indices.end(), { v, v + m_size + 1, v + 1 });
+            }
+        }
+
+        glBindVertexArray(m_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_STATIC_DRAW);
+        RenderStats::Upload(vertices.size() * sizeof(float) + indices.size() * sizeof(uint32_t));
+        glBindVertexArray(0);
+        m_indexCount = static_cast<GLsizei>(indices.size());
+
+        glBindTexture(GL_TEXTURE_2D, m_texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RG32F, m_size, m_size, 0, GL_RG, GL_FLOAT, nullptr);
+        m_memory.set(vertices.size() * sizeof(float) + indices.size() * sizeof(uint32_t) + static_cast<size_t>(m_size) * m_size * 2 * sizeof(float));
+    }
+}
+
+size_t WaterRenderer::upload(WaterSimulation& water)
+{
+    water.takeDirtyTiles(m_dirtyTiles);
+    if (m_dirtyTiles.empty() || m_size != water.getSize())
+        return 0;
+
+    constexpr int tileSize = WaterSimulation::TILE_SIZE;
+    const int tiles = water.getTilesPerSide();
+    m_staging.resize(tileSize * tileSize * 2);
+
+    size_t bytes = 0;
+    glBindTexture(GL_TEXTURE_2D, m_texture);
+    for (int tile : m_dirtyTiles)
+    {
+        const int x0 = (tile % tiles) * tileSize;
+        const int y0 = (tile / tiles) * tileSize;
+        const int width = std::min(tileSize, m_size - x0);
+        const int height = std::min(tileSize, m_size - y0);
+
+        // Surface height and depth
+        for (int y = 0; y < height; ++y)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                const float depth = water.depth(x0 + x, y0 + y);
+                m_staging[(y * width + x) * 2] = water.ground(x0 + x, y0 + y) + depth;
+                m_staging[(y * width + x) * 2 + 1] = depth;
+            }
+        }
+
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x0, y0, width, height, GL_RG, GL_FLOAT, m_staging.data());
+        bytes += static_cast<size_t>(width) * height * 2 * sizeof(float);
+    }
+    RenderStats::Upload(bytes);
+    return bytes;
+}
+
+void WaterRenderer::render(RenderQueue& queue, const Mat4<float>& VP)
+{
+    RenderCommand command;
+    command.pass = RenderPass::TRANSPARENT;
+    command.shader = &m_shader;
+    command.vertexArray = m_vao;
+    command.textures[0] = { GL_TEXTURE_2D, m_texture };
+    command.depthWrite = false;
+    command.indexCount = m_indexCount;
+    command.uniforms = [this, VP](const Shader& shader)
+    {
+        shader.setMat4("VP", VP);
+        shader.setFloat3("gridTransform", m_origin.x, m_origin.y, m_step);
+        shader.setInt("water", 0);
+    };
+    queue.submit(std::move(command));
+}
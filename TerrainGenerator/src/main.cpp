@@ -1,15 +1,39 @@
-﻿#include <GL/glew.h>
+#include <GL/glew.h>
 #include <GLFW/glfw3.h>
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <charconv>
+#include <chrono>
 #include <filesystem>
+#include <limits>
+#include <sstream>
+#include <string_view>
 
 #include "Shader.h"
-#include "Plane.h"
+#include "plane.h"
 #include "Camera.h"
+#include "DetailRenderer.h"
+#include "DistributedGenerator.h"
+#include "FramePacer.h"
+#include "GpuTimer.h"
+#include "HeadlessRenderer.h"
+#include "HeightmapImport.h"
+#include "JobSystem.h"
+#include "MemoryAccounting.h"
+#include "MeshExporter.h"
+#include "RenderCounters.h"
+#include "RenderQueue.h"
+#include "Replay.h"
+#include "ScatterRenderer.h"
+#include "SessionCache.h"
+#include "Simulation.h"
+#include "VirtualTextureRenderer.h"
+#include "WaterRenderer.h"
 #include <iostream>
 
 // Screen settings
@@ -26,16 +50,67 @@ bool firstMouse = true;
 float lastMouseX = SCREEN_WIDTH / 2.0f;
 float lastMouseY = SCREEN_HEIGHT / 2.0f;
 
+// Mouse motion since the last input sample
+float mouseOffsetX = 0.f;
+float mouseOffsetY = 0.f;
+
 // Cursor settings
 bool cursorShown = true;
 
-// Time
-float currentTime, lastFrameTime = glfwGetTime();
-float deltaTime = 0;
+// Sculpting with the left button while the cursor is shown, strength per second of holding it
+bool sculptMode = false;
+Brush sculptBrush{ BrushMode::RAISE, 12.f, 0.5f, 0.3f };
+
+// Polygon mode, wireframe at start
+GLenum polygonMode = GL_LINE;
+
+// Vsync and frame cap, the camera moves at a fixed timestep regardless
+FramePacing framePacing;
+
+// Generation parameters, loaded with --preset and saved from the UI
+TerrainPreset preset;
+std::string presetPath = "terrain.preset";
+
+// Last session, saved on exit: --resume reloads its preset, its heights are reused whenever they match the preset
+const char* const SESSION_PRESET = "session.preset";
+const char* const SESSION_HEIGHTS = "session.heights";
+
+// Startup milestones, in milliseconds since the process started
+const auto processStart = std::chrono::steady_clock::now();
+double timeToFirstFrame = 0.0;
+double timeToInteractive = 0.0;
+
+// Stage of the startup generation, written by its job and shown by the loading screen
+std::atomic<const char*> loadingStage = "Compiling shaders";
+std::atomic<float> loadingProgress = 0.f;
+
+// Terrain position in the world, in units
+int64_t worldX = 0;
+int64_t worldZ = 0;
 
-// seed
-int seed = 0;
-float scale = 1.f;
+// Vegetation and rocks
+bool showScatter = true;
+
+// Procedural detail patches over the chunks close to the camera
+bool terrainDetail = true;
+
+// Shallow water over the terrain
+bool showWater = true;
+
+// Sun angles in degrees, cascaded shadows and baked ambient occlusion
+float sunAzimuth = 37.f;
+float sunElevation = 40.f;
+bool showShadows = true;
+bool showAmbientOcclusion = true;
+
+// Materials through the virtual texture instead of the tiled material layers
+bool virtualTexturing = true;
+
+// Jobs executed during the last frame, in seconds of the job system clock
+bool showJobTimeline = false;
+std::vector<JobTrace> frameTraces;
+double frameStart = 0.0;
+double frameEnd = 0.0;
 
 void SetWindowHints()
 {
@@ -51,7 +126,8 @@ void TerminateWindow(GLFWwindow* window)
     glfwTerminate();
 }
 
-void ProcessInputs(GLFWwindow* window)
+// Sample the inputs of the frame, camera movement is applied by the simulation
+InputState ProcessInputs(GLFWwindow* window)
 {
     // Close the game on espace
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
@@ -61,11 +137,12 @@ void ProcessInputs(GLFWwindow* window)
 
     // Process Polygon mode changes
     if (glfwGetKey(window, GLFW_KEY_F1) == GLFW_PRESS)
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+        polygonMode = GL_FILL;
     if (glfwGetKey(window, GLFW_KEY_F2) == GLFW_PRESS)
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+        polygonMode = GL_LINE;
     if (glfwGetKey(window, GLFW_KEY_F3) == GLFW_PRESS)
-        glPolygonMode(GL_FRONT_AND_BACK, GL_POINT);
+        polygonMode = GL_POINT;
+    glPolygonMode(GL_FRONT_AND_BACK, polygonMode);
 
     if (glfwGetKey(window, GLFW_KEY_F5) == GLFW_PRESS && freeCameraButtonPressed == false)
     {
@@ -79,19 +156,24 @@ void ProcessInputs(GLFWwindow* window)
     if (glfwGetKey(window, GLFW_KEY_F5) == GLFW_RELEASE)
         freeCameraButtonPressed = false;
 
-    // Process Camera movement
-    if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
-        camera.ProcessKeyboardInputs(CameraMovement::FORWARD);
-    if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
-        camera.ProcessKeyboardInputs(CameraMovement::BACKWARD);
-    if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
-        camera.ProcessKeyboardInputs(CameraMovement::LEFT);
-    if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
-        camera.ProcessKeyboardInputs(CameraMovement::RIGHT);
-    if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
-        camera.ProcessKeyboardInputs(CameraMovement::DOWN);
-    if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS)
-        camera.ProcessKeyboardInputs(CameraMovement::UP);
+    // Camera movement
+    InputState input;
+    auto hold = [&](int key, CameraMovement direction)
+    {
+        input.movement[static_cast<int>(direction)] = glfwGetKey(window, key) == GLFW_PRESS;
+    };
+    hold(GLFW_KEY_W, CameraMovement::FORWARD);
+    hold(GLFW_KEY_S, CameraMovement::BACKWARD);
+    hold(GLFW_KEY_A, CameraMovement::LEFT);
+    hold(GLFW_KEY_D, CameraMovement::RIGHT);
+    hold(GLFW_KEY_LEFT_SHIFT, CameraMovement::DOWN);
+    hold(GLFW_KEY_SPACE, CameraMovement::UP);
+
+    input.mouseX = mouseOffsetX;
+    input.mouseY = mouseOffsetY;
+    mouseOffsetX = 0.f;
+    mouseOffsetY = 0.f;
+    return input;
 }
 
 void HandleMouseCallback(GLFWwindow* window, double xPos, double yPos)
@@ -111,7 +193,8 @@ void HandleMouseCallback(GLFWwindow* window, double xPos, double yPos)
         lastMouseX = xPos;
         lastMouseY = yPos;
 
-        camera.ProcessMouseMovementInputs(xOffset, yOffset);
+        mouseOffsetX += xOffset;
+        mouseOffsetY += yOffset;
     }
 }
 
@@ -120,13 +203,274 @@ void HandlescrollCallback(GLFWwindow* window, double xOffset, double yOffset)
     // camera.ProcessMouseScrollInputs(yOffset);
 }
 
+// One row per thread, one bar per job over the last frame
+void DrawJobTimeline(int threadCount)
+{
+    constexpr float rowHeight = 14.f;
+    const double duration = std::max(frameEnd - frameStart, 1e-6);
+    ImGui::Text("CPU frame: %.2f ms, %d jobs on %d threads", duration * 1000.0, static_cast<int>(frameTraces.size()), threadCount);
+
+    const ImVec2 origin = ImGui::GetCursorScreenPos();
+    const float width = std::max(ImGui::GetContentRegionAvail().x, 100.f);
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    for (int thread = 0; thread < threadCount; ++thread)
+    {
+        const float y = origin.y + thread * rowHeight;
+        drawList->AddRectFilled(ImVec2(origin.x, y), ImVec2(origin.x + width, y + rowHeight - 1.f), IM_COL32(40, 40, 40, 255));
+    }
+
+    for (const JobTrace& trace : frameTraces)
+    {
+        // Jobs started by the previous frame are clipped
+        const float x0 = origin.x + static_cast<float>(std::max(trace.start - frameStart, 0.0) / duration) * width;
+        const float x1 = std::max(origin.x + static_cast<float>((trace.end - frameStart) / duration) * width, x0 + 1.f);
+        const float y = origin.y + trace.thread * rowHeight;
+
+        // Color from the name, the same job keeps its color
+        const ImU32 hash = static_cast<ImU32>(std::hash<std::string_view>()(trace.name));
+        const ImU32 color = IM_COL32(90 + (hash & 0x7F), 90 + ((hash >> 8) & 0x7F), 90 + ((hash >> 16) & 0x7F), 255);
+        drawList->AddRectFilled(ImVec2(x0, y + 1.f), ImVec2(x1, y + rowHeight - 2.f), color);
+
+        if (ImGui::IsMouseHoveringRect(ImVec2(x0, y), ImVec2(x1, y + rowHeight)))
+            ImGui::SetTooltip("%s: %.3f ms on thread %d", trace.name, (trace.end - trace.start) * 1000.0, trace.thread);
+    }
+
+    ImGui::Dummy(ImVec2(width, threadCount * rowHeight));
+}
+
+std::string FormatParameter(float value)
+{
+    char buffer[32];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    return std::string(buffer, result.ptr);
+}
+
+// Viewer parameters recorded with --record and set back by --replay, the preset as its file text
+ReplayParameters CaptureParameters()
+{
+    std::ostringstream presetText;
+    Preset::Write(presetText, preset);
+
+    return {
+        { "preset", presetText.str() },
+        { "polygon_mode", polygonMode == GL_FILL ? "fill" : polygonMode == GL_POINT ? "point" : "line" },
+        { "scatter", showScatter ? "1" : "0" },
+        { "terrain_detail", terrainDetail ? "1" : "0" },
+        { "water", showWater ? "1" : "0" },
+        { "shadows", showShadows ? "1" : "0" },
+        { "ambient_occlusion", showAmbientOcclusion ? "1" : "0" },
+        { "virtual_texture", virtualTexturing ? "1" : "0" },
+        { "sun_azimuth", FormatParameter(sunAzimuth) },
+        { "sun_elevation", FormatParameter(sunElevation) },
+    };
+}
+
+// Returns true if the preset changed
+bool ApplyParameter(const ReplayEvent& event)
+{
+    if (event.key == "preset")
+    {
+        std::istringstream presetText(event.value);
+        if (!Preset::Read(presetText, preset, "replayed preset"))
+            return false;
+        worldX = preset.origin.x;
+        worldZ = preset.origin.z;
+        return true;
+    }
+
+    const bool enabled = event.value == "1";
+    if (event.key == "polygon_mode")
+        polygonMode = event.value == "fill" ? GL_FILL : event.value == "point" ? GL_POINT : GL_LINE;
+    else if (event.key == "scatter") showScatter = enabled;
+    else if (event.key == "terrain_detail") terrainDetail = enabled;
+    else if (event.key == "water") showWater = enabled;
+    else if (event.key == "shadows") showShadows = enabled;
+    else if (event.key == "ambient_occlusion") showAmbientOcclusion = enabled;
+    else if (event.key == "virtual_texture") virtualTexturing = enabled;
+    else if (event.key == "sun_azimuth") Replay::ParseNumber(event.value, sunAzimuth);
+    else if (event.key == "sun_elevation") Replay::ParseNumber(event.value, sunElevation);
+    else
+        std::cerr << "Unknown replayed parameter " << event.key << "." << std::endl;
+    return false;
+}
+
+ReplayFrame CaptureFrame(const Camera& camera, const InputState& input)
+{
+    ReplayFrame frame;
+    frame.origin = camera.GetOrigin();
+    frame.position = camera.GetPosition();
+    frame.yaw = camera.GetYaw();
+    frame.pitch = camera.GetPitch();
+    for (size_t i = 0; i < input.movement.size(); ++i)
+        frame.movement |= input.movement[i] ? static_cast<uint8_t>(1 << i) : 0;
+    frame.mouseX = input.mouseX;
+    frame.mouseY = input.mouseY;
+    return frame;
+}
+
+double MillisecondsSinceStart()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - processStart).count();
+}
+
+// Loading screen frame: the current startup stage and its progress
+void DrawLoadingFrame(GLFWwindow* window)
+{
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    ImGui_ImplOpenGL3_NewFrame();
+    ImGui_ImplGlfw_NewFrame();
+    ImGui::NewFrame();
+
+    const ImVec2 center(ImGui::GetIO().DisplaySize.x * 0.5f, ImGui::GetIO().DisplaySize.y * 0.5f);
+    ImGui::SetNextWindowPos(center, ImGuiCond_Always, ImVec2(0.5f, 0.5f));
+    ImGui::Begin("Loading", nullptr, ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_AlwaysAutoResize);
+    ImGui::Text("%s...", loadingStage.load());
+    ImGui::ProgressBar(loadingProgress, ImVec2(300.f, 0.f));
+    ImGui::End();
+
+    ImGui::Render();
+    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+    glfwSwapBuffers(window);
+    glfwPollEvents();
+}
+
 void HandleFramebufferSize(GLFWwindow* windo, int width, int height)
 {
     glViewport(0, 0, width, height);
 }
 
-int main()
+// Export the displayed terrain, simplified with the current max error if any
+template<typename T>
+void ExportTerrain(Terrain<T>& terrain, const std::string& path)
+{
+    ExportStats stats;
+    bool exported = false;
+    const float maxError = terrain.getPreset().maxError;
+    if (maxError > 0.f)
+    {
+        exported = MeshExport::ExportMesh(terrain.buildSimplifiedMesh(maxError), MeshExport::FormatFromPath(path), path, &stats);
+    }
+    else
+    {
+        ExportSettings settings;
+        settings.format = MeshExport::FormatFromPath(path);
+        settings.path = path;
+        settings.width = settings.height = terrain.getSize();
+        settings.step = terrain.getStep();
+        settings.heightScale = terrain.getScale();
+
+        const float* heights = terrain.getHeightmap().data();
+        exported = MeshExport::ExportGrid(settings, [&](int firstRow, int rowCount, std::span<float> out)
+        {
+            std::copy(heights + firstRow * settings.width, heights + (firstRow + rowCount) * settings.width, out.begin());
+        }, &stats);
+    }
+
+    if (exported)
+        std::cout << "Exported " << path << " (" << stats.megabytesPerSecond() << " MB/s)" << std::endl;
+    else
+        std::cerr << "Export to " << path << " failed." << std::endl;
+}
+
+int main(int argc, char** argv)
 {
+    // Noise engines cost
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--bench-noise")
+        {
+            Noise::Benchmark(std::cout);
+            return 0;
+        }
+    }
+
+    // Every mode starts from the preset file, if any
+    for (int i = 1; i + 1 < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--preset")
+            presetPath = argv[i + 1];
+    }
+    if (!Preset::ParseArguments(argc, argv, preset))
+    {
+        return -1;
+    }
+
+    // Tile worker spawned by a coordinator
+    std::string workerAddress;
+    int workerThreads = 0;
+    if (Distributed::ParseWorkerArguments(argc, argv, workerAddress, workerThreads))
+    {
+        return Distributed::RunWorker(workerAddress, workerThreads);
+    }
+
+    // Multi-process tile generation, no window
+    DistributedSettings distributedSettings;
+    distributedSettings.preset = preset;
+    if (Distributed::ParseArguments(argc, argv, distributedSettings))
+    {
+        return Distributed::RunCoordinator(distributedSettings, argv[0]);
+    }
+
+    // Offscreen batch previews
+    HeadlessSettings headlessSettings;
+    headlessSettings.preset = preset;
+    if (Headless::ParseArguments(argc, argv, headlessSettings))
+    {
+        return Headless::Run(headlessSettings);
+    }
+
+    // Streaming mesh export, no window
+    ExportSettings exportSettings;
+    TerrainPreset exportPreset = preset;
+    if (MeshExport::ParseArguments(argc, argv, exportSettings, exportPreset))
+    {
+        return MeshExport::Run(exportSettings, exportPreset.generation());
+    }
+
+    // Last session preset, its heights are restored below if still cached
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::string(argv[i]) == "--resume" && std::filesystem::exists(SESSION_PRESET) && !Preset::Load(SESSION_PRESET, preset))
+            return -1;
+    }
+
+    // Heights imported from a raster instead of generated, the terrain takes the import size
+    ImportSettings importSettings;
+    const bool importing = HeightmapImport::ParseArguments(argc, argv, importSettings, preset);
+    if (importing)
+        preset.size = importSettings.size;
+
+    // Session recorded on exit, or a recording replayed at its fixed timestep with vsync off, then exit
+    ReplaySettings replaySettings;
+    Recording recording;
+    const bool recordingMode = Replay::ParseArguments(argc, argv, replaySettings);
+    const bool replaying = !replaySettings.replayPath.empty();
+    if (replaying)
+    {
+        if (!Replay::Load(replaySettings.replayPath, recording))
+            return -1;
+        if (recording.frames.empty())
+        {
+            std::cerr << replaySettings.replayPath << " has no frame." << std::endl;
+            return -1;
+        }
+
+        // The terrain is generated with the parameters of the first frame
+        for (const ReplayEvent& event : Replay::Events(recording, 0))
+            ApplyParameter(event);
+        framePacing = FramePacing{ false, 0 };
+    }
+    const bool recordingSession = recordingMode && !replaying;
+
+    // Strokes are not recorded, a session that sculpts would replay another terrain
+    const bool sculptingAllowed = !replaying && !recordingSession;
+    ReplayRecorder recorder(replaySettings.timestep);
+
+    // Workers of the job system, this thread is thread 0. Created first, so that they start with the window.
+    JobSystem& jobs = JobSystem::Instance();
+
     if (!glfwInit())
     {
         std::cerr << "GLFW Initialisation failed." << std::endl;
@@ -172,7 +516,7 @@ int main()
     glEnable(GL_DEPTH_TEST);
 
     // Wireframe mode at start
-    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+    glPolygonMode(GL_FRONT_AND_BACK, polygonMode);
 
     // Initialise ImGUI
     IMGUI_CHECKVERSION();
@@ -181,22 +525,194 @@ int main()
     ImGui_ImplGlfw_InitForOpenGL(window, true);
     ImGui_ImplOpenGL3_Init("#version 330");
 
+    // Staged startup: the loading screen is up from the first frame, then the terrain is generated (or restored from
+    // the last session) by a job while the shaders are compiled on this thread, and uploaded once done
+    DrawLoadingFrame(window);
+    timeToFirstFrame = MillisecondsSinceStart();
+
     using TerrainF = Terrain<float>;
-    TerrainF terrain(100);
+    TerrainF terrain(preset, false);
 
-    while (!glfwWindowShouldClose(window))
+    uint64_t sessionHeightsKey = 0;
+    uint64_t importedHeightsKey = 0;
+    JobFence terrainFence;
+    jobs.run([&]()
+    {
+        if (importing)
+        {
+            // Streamed band by band into the terrain heights, the raster itself is never resident
+            loadingStage = "Importing the heightmap";
+            std::vector<float> imported(static_cast<size_t>(preset.size) * preset.size);
+            ImportStats importStats;
+            const bool done = HeightmapImport::Import(importSettings, [&](int firstRow, int rowCount, std::span<const float> heights)
+            {
+                std::copy(heights.begin(), heights.end(), imported.begin() + static_cast<size_t>(firstRow) * preset.size);
+                loadingProgress = static_cast<float>(firstRow + rowCount) / preset.size;
+            }, &importStats);
+            if (done && terrain.setHeights(std::move(imported)))
+            {
+                importedHeightsKey = terrain.getHeightsKey();
+                std::cout << "Imported " << importSettings.path << ": " << importStats.sourceWidth << " x " << importStats.sourceHeight
+                          << " to " << preset.size << " x " << preset.size << " in " << importStats.seconds * 1000.0 << " ms, "
+                          << importStats.peakSourceRows << " source rows resident at most" << std::endl;
+            }
+        }
+        else
+        {
+            loadingStage = "Restoring the last session";
+            std::vector<float> cached;
+            if (SessionCache::Load(SESSION_HEIGHTS, terrain.getHeightsKey(), preset.size, cached) && terrain.setHeights(std::move(cached)))
+                sessionHeightsKey = terrain.getHeightsKey();
+        }
+
+        terrain.prepareTerrain([](const char* stage, float fraction)
+        {
+            loadingStage = stage;
+            loadingProgress = fraction;
+        });
+    }, &terrainFence, nullptr, "Startup terrain");
+
+    // Shaders and GPU objects of the renderers, one per loading frame so that the screen stays responsive
+    terrain.compileShaders();
+    DrawLoadingFrame(window);
+    ScatterRenderer scatter;
+    DrawLoadingFrame(window);
+    DetailRenderer detail;
+    ShadowMaps shadows;
+    VirtualTextureRenderer virtualTexture;
+    DrawLoadingFrame(window);
+    WaterRenderer waterRenderer;
+    DrawLoadingFrame(window);
+
+    // Without worker threads nothing else would run the job
+    if (jobs.getThreadCount() == 1)
+        jobs.wait(terrainFence);
+    while (!terrainFence.done())
+        DrawLoadingFrame(window);
+    terrain.uploadTerrain();
+
+    worldX = preset.origin.x;
+    worldZ = preset.origin.z;
+    camera.SetOrigin(preset.origin);
+
+    // Camera movement thread, from here on it owns the camera state
+    Simulation simulation(camera);
+    FramePacer pacer;
+    glfwSwapInterval(framePacing.vsync ? 1 : 0);
+    if (const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor()))
+        pacer.setRefreshRate(mode->refreshRate);
+    pacer.setPacing(framePacing);
+
+    scatter.setTerrain(terrain.getHeightfield(), preset.seed, terrain.shareHeightmap());
+    uint64_t scatterKey = InputHash().add(terrain.getHeightsKey()).add(preset.heightScale).value();
+
+    detail.setTerrain(terrain.getHeightfield(), terrain.shareHeightmap());
+
+    // Over their budget, the generation caches keep their current entries, scatter evicts the chunks out of view
+    // and the detail patches are coarsened
+    MemoryBudgets budgets;
+    budgets.set(MemoryTag::HEIGHTMAPS, MemoryDomain::CPU, size_t(512) << 20);
+    budgets.set(MemoryTag::CACHES, MemoryDomain::CPU, size_t(256) << 20);
+    budgets.set(MemoryTag::SCATTER, MemoryDomain::GPU, size_t(128) << 20);
+    budgets.set(MemoryTag::DETAIL, MemoryDomain::GPU, size_t(64) << 20);
+
+    // Draws of every pass, sorted by state and submitted without redundant binds
+    RenderQueue renderQueue;
+    GLStateCache glState;
+    RenderCounters counters;
+
+    WaterSimulation water;
+    auto resetWater = [&]()
+    {
+        const HeightfieldView heightfield = terrain.getHeightfield();
+        water.setTerrain(heightfield);
+        waterRenderer.setTerrain(water, heightfield.origin, heightfield.step);
+    };
+    resetWater();
+
+    // Every change is applied at once, only the stages depending on it are recomputed
+    auto applyPreset = [&]()
     {
-        lastFrameTime = currentTime;
-        currentTime = glfwGetTime();
-        deltaTime = currentTime - lastFrameTime;
+        // A generation replaces the sculpted heights, even with the same key
+        const bool sculpted = terrain.isSculpted();
+        terrain.setPreset(preset);
 
-        camera.SetDeltaTime(deltaTime);
+        // Scatter, detail and water follow the heights and their scale
+        InputHash key;
+        key.add(terrain.getHeightsKey()).add(preset.heightScale);
+        if (key.value() != scatterKey || sculpted)
+        {
+            scatterKey = key.value();
+            scatter.setTerrain(terrain.getHeightfield(), preset.seed, terrain.shareHeightmap());
+            detail.setTerrain(terrain.getHeightfield(), terrain.shareHeightmap());
+            resetWater();
+        }
+    };
+
+    // A stroke, undo or redo changed these samples: only the chunks and patches over them are scattered and built again
+    auto updateSculptedRegion = [&](const HeightRect& rect)
+    {
+        if (rect.empty())
+            return;
+        scatter.updateRegion(terrain.getHeightfield(), terrain.shareHeightmap(), rect.x, rect.y, rect.width, rect.height);
+        detail.updateRegion(terrain.getHeightfield(), terrain.shareHeightmap(), rect.x, rect.y, rect.width, rect.height);
+    };
+
+    // Replay metrics, the GPU times arrive a few frames late
+    int frameIndex = 0;
+    GpuTimer gpuTimer;
+    std::vector<FrameMetrics> frameMetrics;
+    std::vector<std::pair<int, double>> gpuTimes;
+    if (replaying)
+    {
+        // Whole solver steps whatever the frame time, the water is the same on every run
+        WaterSettings waterSettings = water.getSettings();
+        waterSettings.budget = std::numeric_limits<double>::infinity();
+        water.setSettings(waterSettings);
+
+        // Scatter chunks, detail patches and virtual texture pages are drawn the frame they are needed
+        scatter.setSynchronous(true);
+        detail.setSynchronous(true);
+        virtualTexture.setSynchronous(true);
+    }
+
+    while (!glfwWindowShouldClose(window))
+    {
+        const double cpuFrameStart = jobs.now();
+        if (replaying)
+            gpuTimer.begin(frameIndex);
 
         // Clear render
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Inputs
-        ProcessInputs(window);
+        // Inputs, then the camera pose interpolated from the simulation, or the recorded parameters and pose
+        const InputState input = ProcessInputs(window);
+        SimulationClock::time_point inputTime;
+        if (replaying)
+        {
+            // Those of frame 0 were set before the startup generation
+            bool replayedPreset = false;
+            if (frameIndex > 0)
+            {
+                for (const ReplayEvent& event : Replay::Events(recording, frameIndex))
+                    replayedPreset |= ApplyParameter(event);
+            }
+            if (replayedPreset)
+                applyPreset();
+            glPolygonMode(GL_FRONT_AND_BACK, polygonMode);
+
+            const ReplayFrame& frame = recording.frames[frameIndex];
+            camera.SetOrigin(frame.origin);
+            camera.SetPose(frame.position, frame.yaw, frame.pitch);
+            inputTime = SimulationClock::now();
+        }
+        else
+        {
+            simulation.submitInput(input);
+            inputTime = simulation.interpolate(camera, SimulationClock::now());
+        }
+        if (recordingSession)
+            recorder.addFrame(CaptureFrame(camera, input), CaptureParameters());
 
         Mat4<float> V = camera.GetViewMatrix();
         Mat4<float> P = camera.GetProjectionMatrix(SCREEN_WIDTH, SCREEN_HEIGHT);
@@ -204,8 +720,107 @@ int main()
         // Calcul de la matrice de vue-projection
         Mat4<float> VP = P * V;
 
-        // Rendu du terrain
-        terrain.renderTerrain(VP);
+        // Rendu du terrain, relatif a la camera
+        const Mat4<float> terrainVP = VP * terrain.getModelMatrix(camera.GetOrigin());
+
+        if (sculptMode && sculptingAllowed && !freeCamera && !ImGui::GetIO().WantCaptureMouse &&
+            glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
+        {
+            // Ray under the cursor in the frame of the terrain, from the near plane to the far one
+            double cursorX = 0.0;
+            double cursorY = 0.0;
+            glfwGetCursorPos(window, &cursorX, &cursorY);
+            const float ndcX = static_cast<float>(2.0 * cursorX / SCREEN_WIDTH - 1.0);
+            const float ndcY = static_cast<float>(1.0 - 2.0 * cursorY / SCREEN_HEIGHT);
+            const Mat4<float> inverseVP = Math::Inverse(terrainVP);
+            const Point3d<float> rayStart = Math::TransformPoint(inverseVP, Point3d<float>(ndcX, ndcY, -1.f));
+            const Point3d<float> rayEnd = Math::TransformPoint(inverseVP, Point3d<float>(ndcX, ndcY, 1.f));
+
+            Point3d<float> hit;
+            if (terrain.raycast(rayStart, rayEnd - rayStart, 1.f, hit))
+            {
+                Brush dab = sculptBrush;
+                dab.strength *= static_cast<float>(pacer.getStats().frameTime / 1000.0);
+                terrain.sculpt(dab, hit.x, hit.z);
+            }
+        }
+        else if (terrain.isSculpting())
+        {
+            updateSculptedRegion(terrain.endStroke());
+        }
+
+        const MemoryUsage memoryUsage = Memory::Snapshot();
+        if (budgets.excess(MemoryTag::HEIGHTMAPS, MemoryDomain::CPU, memoryUsage) > 0 ||
+            budgets.excess(MemoryTag::MATERIALS, MemoryDomain::CPU, memoryUsage) > 0 ||
+            budgets.excess(MemoryTag::CACHES, MemoryDomain::CPU, memoryUsage) > 0)
+        {
+            terrain.trimCaches();
+        }
+        scatter.setMemoryBudget(budgets.get(MemoryTag::SCATTER, MemoryDomain::GPU));
+        detail.setMemoryBudget(budgets.get(MemoryTag::DETAIL, MemoryDomain::GPU));
+
+        if (showScatter)
+        {
+            // Culled by the workers while the terrain draws
+            scatter.prepare(terrainVP);
+        }
+
+        // Sun, then the shadow cascades fitted on the view
+        const float azimuth = Math::Radians(sunAzimuth);
+        const float elevation = Math::Radians(sunElevation);
+        const Point3d<float> sunDirection(std::cos(elevation) * std::cos(azimuth), std::sin(elevation), std::cos(elevation) * std::sin(azimuth));
+        terrain.setLighting(sunDirection, showAmbientOcclusion);
+        if (showShadows)
+        {
+            shadows.update(terrainVP, sunDirection, NEAR_PLANE, FAR_PLANE);
+            shadows.render([&](const Mat4<float>& lightVP)
+            {
+                terrain.renderDepth(renderQueue, lightVP);
+                renderQueue.flush(glState);
+            });
+        }
+        if (virtualTexturing)
+        {
+            // Pages read by earlier frames arrive, then this frame reports its own
+            virtualTexture.setSource(terrain.getMaterialPageSource());
+            virtualTexture.update();
+            virtualTexture.renderFeedback([&](const Shader& shader)
+            {
+                terrain.renderFeedback(renderQueue, terrainVP, shader);
+                renderQueue.flush(glState);
+            });
+        }
+        // Patches would hide the stroke being sculpted, they follow it once it ends
+        const bool drawDetail = terrainDetail && !terrain.isSculpting();
+        if (drawDetail)
+        {
+            // Camera in the frame of the terrain, and the pixels covered by a unit at unit distance
+            const Point3d<float> terrainCamera = camera.GetPosition() - RelativeOffset(camera.GetOrigin(), terrain.getWorldOrigin());
+            detail.update(terrainCamera, SCREEN_HEIGHT / (2.f * std::tan(Math::Radians(camera.GetFov()) / 2.f)));
+        }
+        terrain.renderTerrain(renderQueue, terrainVP, showShadows ? &shadows : nullptr, virtualTexturing ? &virtualTexture : nullptr,
+                              drawDetail ? &detail : nullptr);
+        if (showScatter)
+        {
+            scatter.render(renderQueue, terrainVP);
+        }
+        if (showWater)
+        {
+            // Real time of the last frame, the solver stops at its budget. Replays step the recorded timestep.
+            water.update(replaying ? recording.timestep : pacer.getStats().frameTime / 1000.0);
+            waterRenderer.upload(water);
+            waterRenderer.render(renderQueue, terrainVP);
+        }
+        renderQueue.flush(glState);
+
+        // The scene only, without the UI
+        counters = RenderStats::EndFrame();
+        if (replaying)
+        {
+            gpuTimer.end();
+            frameMetrics.push_back({ frameIndex, (jobs.now() - cpuFrameStart) * 1000.0, -1.0, counters.drawCalls, counters.triangles,
+                                     counters.uploadBytes, counters.stateChanges });
+        }
 
         // ImGUI new frame
         ImGui_ImplOpenGL3_NewFrame();
@@ -214,16 +829,240 @@ int main()
 
         // Imgui render
         ImGui::Begin("Configs");
-        std::string fps = "FPS: " + std::to_string(static_cast<int>(1.f / deltaTime));
+        const FrameStats& frameStats = pacer.getStats();
+        std::string fps = "FPS: " + std::to_string(static_cast<int>(1000.0 / std::max(frameStats.meanFrameTime, 1e-3)));
         ImGui::Text(fps.c_str()); 
+        ImGui::Text("Frame: %.2f ms (sd %.2f, max %.2f)", frameStats.meanFrameTime, frameStats.frameTimeDeviation, frameStats.maxFrameTime);
+        ImGui::Text("Input latency: ~%.1f ms", frameStats.inputLatency);
+        ImGui::Text("Startup: first frame %.0f ms, interactive %.0f ms%s", timeToFirstFrame, timeToInteractive,
+                    sessionHeightsKey != 0 ? " (restored)" : "");
+        bool pacingChanged = ImGui::Checkbox("VSync", &framePacing.vsync);
+        ImGui::SameLine();
+        pacingChanged |= ImGui::SliderInt("Frame cap", &framePacing.frameCap, 0, 240);
+        if (pacingChanged)
+        {
+            glfwSwapInterval(framePacing.vsync ? 1 : 0);
+            pacer.setPacing(framePacing);
+        }
+
+        const Point3d<double> cameraPosition = camera.GetWorldPosition();
+        ImGui::Text("Camera: %.2f %.2f %.2f", cameraPosition.x, cameraPosition.y, cameraPosition.z);
+
+        const TerrainStats& stats = terrain.getStats();
+        ImGui::Text("Heightmap: %.2f ms", stats.heightmapTime);
+        ImGui::Text("Materials: %.2f ms", stats.materialTime);
+        ImGui::Text("Simplification: %.2f ms", stats.simplifyTime);
+        ImGui::Text("Mesh: %.2f ms", stats.meshTime);
+        ImGui::Text("Triangles: %d", static_cast<int>(stats.triangleCount));
+        ImGui::Text("Occlusion: %d tiles in %.2f ms", stats.occlusionTiles, stats.occlusionTime);
+        ImGui::Text("Draw calls: %d, %d KB uploaded", counters.drawCalls, static_cast<int>(counters.uploadBytes / 1024));
+        ImGui::Text("State changes: %d (%d redundant skipped)", counters.stateChanges, counters.redundantStateChanges);
 
         ImGui::Separator();
         
-        ImGui::SliderInt("Seed", &seed, 0, 1000);
-        ImGui::SliderFloat("Scale", &scale, 0.5f, 15.f);
-        if (ImGui::Button("Regenerate Terrain"))
+        bool presetChanged = false;
+        presetChanged |= ImGui::SliderInt("Seed", &preset.seed, 0, 1000);
+        presetChanged |= ImGui::SliderFloat("Scale", &preset.heightScale, 0.5f, 15.f);
+        NoiseStage& baseNoise = preset.noise.front();
+        if (ImGui::BeginCombo("Noise", Noise::Name(baseNoise.type)))
+        {
+            for (int type = 0; type < static_cast<int>(NoiseType::COUNT); ++type)
+            {
+                if (ImGui::Selectable(Noise::Name(static_cast<NoiseType>(type)), baseNoise.type == static_cast<NoiseType>(type)))
+                {
+                    baseNoise.type = static_cast<NoiseType>(type);
+                    presetChanged = true;
+                }
+            }
+            ImGui::EndCombo();
+        }
+        presetChanged |= ImGui::SliderInt("Erosion", &preset.erosion.iterations, 0, 64);
+        presetChanged |= ImGui::SliderFloat("Sand height", &preset.biomes.sandHeight, 0.f, 0.3f);
+        presetChanged |= ImGui::SliderFloat("Snow height", &preset.biomes.snowHeight, 0.1f, 1.f);
+        presetChanged |= ImGui::SliderFloat("Max error", &preset.maxError, 0.f, 0.25f);
+        ImGui::InputScalar("World X", ImGuiDataType_S64, &worldX);
+        ImGui::InputScalar("World Z", ImGuiDataType_S64, &worldZ);
+        if (ImGui::Button("Move Terrain"))
+        {
+            // Move the camera frame with the terrain, the view stays the same
+            preset.origin.x = worldX;
+            preset.origin.z = worldZ;
+            simulation.setOrigin(preset.origin);
+            presetChanged = true;
+        }
+        if (ImGui::Button("Save Preset"))
+        {
+            Preset::Save(presetPath, preset);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Load Preset") && Preset::Load(presetPath, preset))
+        {
+            worldX = preset.origin.x;
+            worldZ = preset.origin.z;
+            simulation.setOrigin(preset.origin);
+            presetChanged = true;
+        }
+        if (presetChanged)
+        {
+            applyPreset();
+        }
+        if (ImGui::Button("Export GLB"))
+        {
+            ExportTerrain(terrain, "terrain.glb");
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Export OBJ"))
+        {
+            ExportTerrain(terrain, "terrain.obj");
+        }
+
+        ImGui::Separator();
+        ImGui::Checkbox("Shadows", &showShadows);
+        ImGui::SameLine();
+        ImGui::Checkbox("Ambient occlusion", &showAmbientOcclusion);
+        ImGui::SliderFloat("Sun azimuth", &sunAzimuth, 0.f, 360.f);
+        ImGui::SliderFloat("Sun elevation", &sunElevation, 5.f, 90.f);
+
+        ImGui::Separator();
+        ImGui::Checkbox("Virtual texture", &virtualTexturing);
+        const VirtualTextureStats& virtualStats = virtualTexture.getStats();
+        ImGui::Text("Pages: %d resident, %d/%d missing, %d pending (%.1f MB of textures)", virtualStats.residentPages,
+                    virtualStats.missingPages, virtualStats.requestedPages, virtualStats.pendingPages, virtualTexture.textureBytes() / (1024.0 * 1024.0));
+        ImGui::Text("Pages: %d generated (%.2f ms each), %d evicted, %.0f KB uploaded", virtualStats.generatedPages,
+                    virtualStats.generationTime, virtualStats.evictedPages, virtualStats.uploadedBytes / 1024.0);
+        int uploadBudget = static_cast<int>(virtualTexture.getUploadBudget() >> 10);
+        if (ImGui::SliderInt("Page upload budget (KB)", &uploadBudget, 64, 8192))
+        {
+            virtualTexture.setUploadBudget(static_cast<size_t>(uploadBudget) << 10);
+        }
+
+        ImGui::Separator();
+        if (!sculptingAllowed)
+        {
+            ImGui::Text("Sculpt: off while recording or replaying");
+        }
+        else
+        {
+            ImGui::Checkbox("Sculpt", &sculptMode);
+            for (int mode = 0; mode < static_cast<int>(BrushMode::COUNT); ++mode)
+            {
+                if (mode > 0)
+                    ImGui::SameLine();
+                if (ImGui::RadioButton(Sculpt::Name(static_cast<BrushMode>(mode)), sculptBrush.mode == static_cast<BrushMode>(mode)))
+                    sculptBrush.mode = static_cast<BrushMode>(mode);
+            }
+            ImGui::SliderFloat("Brush radius (samples)", &sculptBrush.radius, 1.f, 256.f);
+            ImGui::SliderFloat("Brush strength", &sculptBrush.strength, 0.01f, 2.f);
+            ImGui::SliderFloat("Brush hardness", &sculptBrush.hardness, 0.f, 1.f);
+            if (ImGui::Button("Undo") && terrain.canUndo())
+            {
+                updateSculptedRegion(terrain.undo());
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Redo") && terrain.canRedo())
+            {
+                updateSculptedRegion(terrain.redo());
+            }
+        }
+        const SculptHistory& sculptHistory = terrain.getSculptHistory();
+        ImGui::Text("Sculpt: dab %.2f ms, stroke end %.2f ms, %d steps (%.0f KB)", stats.sculptTime, stats.strokeTime,
+                    sculptHistory.getStepCount(), sculptHistory.getBytes() / 1024.0);
+
+        ImGui::Separator();
+        ImGui::Checkbox("Terrain detail", &terrainDetail);
+        const DetailStats& detailStats = detail.getStats();
+        ImGui::Text("Patches: %d/%d drawn (%d triangles), %d resident (%.1f MB)", detailStats.drawnPatches, detailStats.selectedPatches,
+                    static_cast<int>(detailStats.drawnTriangles), detailStats.residentPatches, detailStats.residentBytes / (1024.0 * 1024.0));
+        ImGui::Text("Patches: %d built in %.2f ms, %d pending", detailStats.generatedPatches, detailStats.generationTime, detailStats.pendingPatches);
+        DetailSettings detailSettings = detail.getSettings();
+        bool detailChanged = ImGui::SliderFloat("Detail cell pixels", &detailSettings.cellPixels, 2.f, 32.f);
+        detailChanged |= ImGui::SliderInt("Detail patches", &detailSettings.maxPatches, 1, 128);
+        detailChanged |= ImGui::SliderFloat("Detail amplitude", &detailSettings.amplitude, 0.f, 1.f);
+        if (detailChanged)
         {
-            terrain.generateTerrain(seed, scale);
+            detail.setSettings(detailSettings);
+        }
+
+        ImGui::Separator();
+        ImGui::Checkbox("Scatter", &showScatter);
+        const ScatterStats& scatterStats = scatter.getStats();
+        ImGui::Text("Instances: %d (%d draws)", static_cast<int>(scatterStats.drawnInstances), scatterStats.drawCalls);
+        ImGui::Text("Chunks: %d visible, %d resident", scatterStats.visibleChunks, scatterStats.residentChunks);
+        ImGui::Text("Scatter: %d chunks in %.2f ms, %d pending, %d evicted", scatterStats.generatedChunks, scatterStats.generationTime,
+                    scatterStats.pendingChunks, scatterStats.evictedChunks);
+
+        ScatterRule trees = scatter.getRule(ScatterKind::TREE);
+        if (ImGui::SliderFloat("Tree spacing", &trees.radius, 0.05f, 1.f))
+        {
+            scatter.setRule(ScatterKind::TREE, trees);
+        }
+        ScatterRule rocks = scatter.getRule(ScatterKind::ROCK);
+        if (ImGui::SliderFloat("Rock spacing", &rocks.radius, 0.05f, 1.f))
+        {
+            scatter.setRule(ScatterKind::ROCK, rocks);
+        }
+
+        ImGui::Separator();
+        ImGui::Checkbox("Water", &showWater);
+        const WaterStats& waterStats = water.getStats();
+        ImGui::Text("Water: %d steps in %.2f ms%s, %d/%d tiles active", waterStats.steps, waterStats.solverTime,
+                    waterStats.overBudget ? " (over budget)" : "", waterStats.activeTiles, waterStats.tileCount);
+        WaterSettings waterSettings = water.getSettings();
+        float waterBudget = static_cast<float>(waterSettings.budget);
+        if (ImGui::SliderFloat("Water budget (ms)", &waterBudget, 0.5f, 16.f))
+        {
+            waterSettings.budget = waterBudget;
+            water.setSettings(waterSettings);
+        }
+        if (ImGui::Button("Rain"))
+        {
+            water.rain(0.01f);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Spring"))
+        {
+            // Under the camera, in the local frame of the terrain
+            const Point3d<double> position = camera.GetWorldPosition();
+            water.addSource(static_cast<float>(position.x - preset.origin.x), static_cast<float>(position.z - preset.origin.z), 0.5f);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Clear Water"))
+        {
+            resetWater();
+        }
+
+        ImGui::Separator();
+        constexpr double MB = 1024.0 * 1024.0;
+        ImGui::Text("Memory: %.1f MB CPU, %.1f MB GPU", memoryUsage.total(MemoryDomain::CPU) / MB, memoryUsage.total(MemoryDomain::GPU) / MB);
+        for (int i = 0; i < MemoryUsage::TAG_COUNT; ++i)
+        {
+            const MemoryTag tag = static_cast<MemoryTag>(i);
+            const bool over = budgets.excess(tag, MemoryDomain::CPU, memoryUsage) > 0 || budgets.excess(tag, MemoryDomain::GPU, memoryUsage) > 0;
+            ImGui::Text("  %-16s %8.1f MB CPU %8.1f MB GPU%s", Memory::Name(tag), memoryUsage.get(tag, MemoryDomain::CPU) / MB,
+                        memoryUsage.get(tag, MemoryDomain::GPU) / MB, over ? " (over budget)" : "");
+        }
+        auto budgetSlider = [&](const char* label, MemoryTag tag, MemoryDomain domain, int maxMB)
+        {
+            int budget = static_cast<int>(budgets.get(tag, domain) >> 20);
+            if (ImGui::SliderInt(label, &budget, 0, maxMB))
+            {
+                budgets.set(tag, domain, static_cast<size_t>(budget) << 20);
+            }
+        };
+        budgetSlider("Heightmaps budget (MB, 0 = none)", MemoryTag::HEIGHTMAPS, MemoryDomain::CPU, 4096);
+        budgetSlider("Caches budget (MB, 0 = none)", MemoryTag::CACHES, MemoryDomain::CPU, 4096);
+        budgetSlider("Scatter GPU budget (MB, 0 = none)", MemoryTag::SCATTER, MemoryDomain::GPU, 1024);
+        budgetSlider("Detail GPU budget (MB, 0 = none)", MemoryTag::DETAIL, MemoryDomain::GPU, 1024);
+
+        ImGui::Separator();
+        if (ImGui::Checkbox("Job timeline", &showJobTimeline))
+        {
+            jobs.setProfiling(showJobTimeline);
+            frameTraces.clear();
+        }
+        if (showJobTimeline)
+        {
+            DrawJobTimeline(jobs.getThreadCount());
         }
 
         ImGui::Separator();
@@ -243,12 +1082,65 @@ int main()
         ImGui::Render();
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
 
+        // Jobs of this frame, drawn by the next one
+        if (showJobTimeline)
+        {
+            frameTraces.clear();
+            jobs.collectTraces(frameTraces);
+            frameStart = cpuFrameStart;
+            frameEnd = jobs.now();
+        }
+
         // Swap buffer with the front buffer
+        pacer.waitForSwap();
         glfwSwapBuffers(window);
+        pacer.endFrame(inputTime);
+
+        // First frame with the terrain
+        if (timeToInteractive == 0.0)
+        {
+            timeToInteractive = MillisecondsSinceStart();
+            std::cout << "Startup: first frame after " << timeToFirstFrame << " ms, interactive after " << timeToInteractive << " ms"
+                      << (sessionHeightsKey != 0 ? ", heights restored from " : "") << (sessionHeightsKey != 0 ? SESSION_HEIGHTS : "") << std::endl;
+        }
         // Take care of GLFW events
         glfwPollEvents();
+
+        ++frameIndex;
+        if (replaying)
+        {
+            gpuTimer.collect(gpuTimes);
+            if (frameIndex == static_cast<int>(recording.frames.size()))
+                glfwSetWindowShouldClose(window, GLFW_TRUE);
+        }
     }
 
+    if (replaying)
+    {
+        gpuTimer.collect(gpuTimes, true);
+        for (const auto& [frame, milliseconds] : gpuTimes)
+            frameMetrics[frame].gpuTime = milliseconds;
+
+        const ReplaySummary summary = Replay::Summarize(frameMetrics);
+        std::cout << "Replayed " << summary.frames << " frames: CPU " << summary.meanCpuTime << " ms (p95 " << summary.p95CpuTime
+                  << ", max " << summary.maxCpuTime << "), GPU " << summary.meanGpuTime << " ms (p95 " << summary.p95GpuTime << "), "
+                  << summary.meanDrawCalls << " draw calls and " << summary.meanTriangles << " triangles per frame, "
+                  << summary.uploadBytes / (1024.0 * 1024.0) << " MB uploaded" << std::endl;
+        if (!replaySettings.metricsPath.empty() && Replay::SaveMetrics(replaySettings.metricsPath, frameMetrics))
+            std::cout << "Metrics written to " << replaySettings.metricsPath << std::endl;
+    }
+    if (recordingSession && Replay::Save(replaySettings.recordPath, recorder.getRecording()))
+    {
+        std::cout << "Recorded " << recorder.getRecording().frames.size() << " frames to " << replaySettings.recordPath << std::endl;
+    }
+
+    // The next start restores this terrain instead of generating it, a replay leaves the session as it was
+    if (!replaying)
+        Preset::Save(SESSION_PRESET, terrain.getPreset());
+    // Imported and sculpted heights are not those of the preset, a resumed session generates it
+    if (!replaying && !terrain.isSculpted() && terrain.getHeightsKey() != sessionHeightsKey && terrain.getHeightsKey() != importedHeightsKey)
+        SessionCache::Save(SESSION_HEIGHTS, terrain.getHeightsKey(), terrain.getSize(), terrain.getHeightmap());
+
     // Terminate ImGui
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();